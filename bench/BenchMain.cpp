@@ -0,0 +1,101 @@
+#include <Benchmark.h>
+#include <Corpus.h>
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+
+namespace Arcanelab::Mano::Bench
+{
+    std::vector<std::pair<std::string, BenchmarkFunction>>& Registry()
+    {
+        static std::vector<std::pair<std::string, BenchmarkFunction>> registry;
+        return registry;
+    }
+
+    bool jsonOutput = false;
+
+    void WriteJsonString(std::string_view text)
+    {
+        std::putchar('"');
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                std::putchar('\\');
+            std::putchar(c);
+        }
+        std::putchar('"');
+    }
+
+    void Report(std::string_view benchmark, std::string_view metric, double value, std::string_view unit)
+    {
+        if (jsonOutput)
+        {
+            std::fputs("{\"benchmark\": ", stdout);
+            WriteJsonString(benchmark);
+            std::fputs(", \"metric\": ", stdout);
+            WriteJsonString(metric);
+            std::printf(", \"value\": %.6g, \"unit\": ", value);
+            WriteJsonString(unit);
+            std::fputs("}\n", stdout);
+            return;
+        }
+        std::printf("%-28.*s %-22.*s %14.3f %.*s\n",
+            static_cast<int>(benchmark.size()), benchmark.data(),
+            static_cast<int>(metric.size()), metric.data(),
+            value,
+            static_cast<int>(unit.size()), unit.data());
+    }
+} // namespace Arcanelab::Mano::Bench
+
+// Usage: bench [--json] [filter]. Runs every benchmark whose name contains
+// the filter; --json prints one object per result line, for comparing runs
+// across commits. bench --corpus <shape> [scale] prints a generated corpus
+// instead, at the suite's scale unless one is given.
+int main(int argc, char** argv)
+{
+    using namespace Arcanelab::Mano::Bench;
+
+    std::string_view filter;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view argument = argv[i];
+        if (argument == "--json")
+            jsonOutput = true;
+        else if (argument == "--corpus" && i + 1 < argc)
+        {
+            std::optional<CorpusInfo> corpus = FindCorpus(argv[++i]);
+            if (!corpus)
+            {
+                std::cerr << "Unknown corpus " << argv[i] << "; one of";
+                for (const CorpusInfo& known : Corpora())
+                    std::cerr << " " << known.name;
+                std::cerr << "\n";
+                return 1;
+            }
+            int scale = corpus->scale;
+            if (i + 1 < argc)
+            {
+                std::string_view text = argv[++i];
+                if (std::from_chars(text.data(), text.data() + text.size(), scale).ec != std::errc() || scale < 0)
+                {
+                    std::cerr << "Invalid corpus scale " << text << "\n";
+                    return 1;
+                }
+            }
+            std::string source = GenerateCorpus(corpus->shape, scale);
+            std::fwrite(source.data(), 1, source.size(), stdout);
+            return 0;
+        }
+        else
+            filter = argument;
+    }
+
+    for (auto& [name, function] : Registry())
+    {
+        if (name.find(filter) == std::string::npos)
+            continue;
+        function();
+    }
+    return 0;
+}
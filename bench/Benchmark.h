@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Arcanelab::Mano::Bench
+{
+    using BenchmarkFunction = void (*)();
+
+    std::vector<std::pair<std::string, BenchmarkFunction>>& Registry();
+
+    struct BenchmarkRegistration
+    {
+        BenchmarkRegistration(const char* name, BenchmarkFunction function)
+        {
+            Registry().emplace_back(name, function);
+        }
+    };
+
+#define MANO_BENCHMARK(name)                                                                   \
+    static void name();                                                                        \
+    static ::Arcanelab::Mano::Bench::BenchmarkRegistration name##Registration(#name, name);   \
+    static void name()
+
+    // Runs the function `repetitions` times and returns the fastest run in seconds.
+    template<typename F>
+    double MeasureBest(int repetitions, F&& function)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < repetitions; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    void Report(std::string_view benchmark, std::string_view metric, double value, std::string_view unit);
+
+    // Keeps the optimizer from discarding a benchmarked result.
+    template<typename T>
+    void DoNotOptimize(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T* sink;
+        sink = &value;
+#endif
+    }
+} // namespace Arcanelab::Mano::Bench
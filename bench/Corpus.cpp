@@ -0,0 +1,268 @@
+#include <Corpus.h>
+
+#include <array>
+#include <iterator>
+
+namespace Arcanelab::Mano::Bench
+{
+    namespace
+    {
+        constexpr std::array<CorpusInfo, 5> CorpusList =
+        {{
+            { CorpusShape::Mixed, "mixed", 4000 },
+            { CorpusShape::Nested, "nested", 1000 },
+            { CorpusShape::Classes, "classes", 3000 },
+            { CorpusShape::Expressions, "expressions", 1000 },
+            { CorpusShape::Literals, "literals", 400 },
+        }};
+
+        void Indent(std::string& source, int depth)
+        {
+            source.append(static_cast<size_t>(depth) * 4, ' ');
+        }
+
+        void Mixed(std::string& source, int scale)
+        {
+            for (int i = 0; i < scale; i++)
+            {
+                std::string n = std::to_string(i);
+                source += "enum Mode" + n + " { Idle, Run, Stop, }\n";
+                source += "var global" + n + ": int = " + n + " * 2 + 1;\n";
+                source += "fun Work" + n + "(a: int, b: float, c: const string): int\n{\n";
+                source += "    var total: int = a * 3 + (a - 1) / 2;\n";
+                source += "    var scale: float = b * 0.5 + 1.25;\n";
+                source += "    var name: string = \"item " + n + "\";\n";
+                source += "    let values: [int] = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10];\n";
+                source += "    var mode: Mode" + n + " = Mode" + n + ".Idle;\n";
+                source += "    for (var i: int = 0; i < 10; i = i + 1)\n    {\n";
+                source += "        if (i == 3 && total > 10 || i != 7)\n        {\n";
+                source += "            total = total + values[i] * 2;\n";
+                source += "            mode = Mode" + n + ".Run;\n";
+                source += "            continue;\n        }\n";
+                source += "        total = total - (i << 1) + (i >> 1);\n    }\n";
+                source += "    while (total > 1000)\n    {\n        total = total / 2;\n    }\n";
+                source += "    switch (mode)\n    {\n";
+                source += "        case Mode" + n + ".Run:\n        {\n            total = total + global" + n + ";\n        }\n";
+                source += "        case Mode" + n + ".Stop:\n        {\n            return 0;\n        }\n";
+                source += "        default:\n        {\n            total = -total;\n        }\n    }\n";
+                source += "    switch (total % 3)\n    {\n";
+                source += "        case 0:\n        {\n            total = Work" + n + "(total, scale, name);\n        }\n";
+                source += "        default:\n        {\n            total = total * 2;\n        }\n    }\n";
+                source += "    return total;\n}\n\n";
+            }
+        }
+
+        // Every function nests 16 statement levels, cycling through if,
+        // while, for and else branches, around an expression with 24 levels
+        // of parentheses.
+        void Nested(std::string& source, int scale)
+        {
+            constexpr int statementDepth = 16;
+            constexpr int expressionDepth = 24;
+            for (int i = 0; i < scale; i++)
+            {
+                source += "fun Nest" + std::to_string(i) + "(a: int): int\n{\n    var v0: int = a;\n";
+                for (int level = 1; level <= statementDepth; level++)
+                {
+                    std::string v = "v" + std::to_string(level);
+                    std::string outer = "v" + std::to_string(level - 1);
+                    Indent(source, level);
+                    switch (level % 4)
+                    {
+                        case 1: source += "if (" + outer + " > " + std::to_string(level) + ")\n"; break;
+                        case 2: source += "while (" + outer + " > 1000)\n"; break;
+                        case 3: source += "for (var i" + std::to_string(level) + ": int = 0; i" + std::to_string(level) + " < 2; i" + std::to_string(level) + " = i" + std::to_string(level) + " + 1)\n"; break;
+                        default:
+                            source += "if (" + outer + " < 0)\n";
+                            Indent(source, level);
+                            source += "{\n";
+                            Indent(source, level + 1);
+                            source += outer + " = -" + outer + ";\n";
+                            Indent(source, level);
+                            source += "}\n";
+                            Indent(source, level);
+                            source += "else\n";
+                            break;
+                    }
+                    Indent(source, level);
+                    source += "{\n";
+                    Indent(source, level + 1);
+                    source += "var " + v + ": int = " + outer + " + " + std::to_string(level) + ";\n";
+                    if (level % 4 == 2)
+                    {
+                        Indent(source, level + 1);
+                        source += outer + " = " + outer + " / 2;\n";
+                    }
+                }
+
+                Indent(source, statementDepth + 1);
+                source += "v0 = v0 + ";
+                source.append(expressionDepth, '(');
+                source += "v" + std::to_string(statementDepth);
+                for (int level = 0; level < expressionDepth; level++)
+                {
+                    static constexpr const char* Steps[] = { " + 1)", " * 3)", " - 2)", " ^ 5)" };
+                    source += Steps[(i + level) % 4];
+                }
+                source += ";\n";
+
+                for (int level = statementDepth; level >= 1; level--)
+                {
+                    Indent(source, level);
+                    source += "}\n";
+                }
+                source += "    return v0;\n}\n\n";
+            }
+        }
+
+        void Classes(std::string& source, int scale)
+        {
+            for (int i = 0; i < scale; i++)
+            {
+                std::string n = std::to_string(i);
+                std::string entity = "Entity" + n;
+                source += "class " + entity + "\n{\n";
+                source += "    var id: int = " + n + ";\n";
+                source += "    var health: float = 100.0;\n";
+                source += "    var armor: float = 0.25;\n";
+                source += "    var name: string = \"" + entity + "\";\n";
+                source += "    var alive: bool = true;\n\n";
+                source += "    fun " + entity + "(newId: int, newHealth: float)\n    {\n";
+                source += "        id = newId;\n        health = newHealth;\n    }\n\n";
+                source += "    fun Damage(amount: float): bool\n    {\n";
+                source += "        health = health - amount * (1.0 - armor);\n";
+                source += "        if (health <= 0.0)\n        {\n            alive = false;\n        }\n";
+                source += "        return alive;\n    }\n\n";
+                source += "    fun Heal(amount: float)\n    {\n";
+                source += "        if (alive)\n        {\n            health = health + amount;\n        }\n    }\n\n";
+                source += "    fun Describe(): string\n    {\n        return name + \" (entity)\";\n    }\n}\n\n";
+
+                source += "fun Spawn" + n + "(count: int): int\n{\n";
+                source += "    var entity: " + entity + " = " + entity + "(count, 50.0);\n";
+                source += "    var hits: int = 0;\n";
+                source += "    while (entity.Damage(5.0))\n    {\n        hits = hits + 1;\n    }\n";
+                source += "    entity.Heal(1.0);\n";
+                source += "    return hits + entity.id;\n}\n\n";
+            }
+        }
+
+        // Chain<i>(count) updates two ints with 48-term chains mixing every
+        // arithmetic and bitwise precedence level, count times. The loop body
+        // is straight-line, so the instructions it runs are known from its
+        // back edge.
+        void Expressions(std::string& source, int scale)
+        {
+            constexpr int terms = 48;
+            auto chain = [&](int seed, const char* first, const char* second)
+            {
+                static constexpr const char* Joins[] = { " + ", " - ", " ^ ", " + ", " | ", " - " };
+                std::string text = "(";
+                for (int term = 0; term < terms; term++)
+                {
+                    if (term)
+                        text += Joins[(seed + term) % 6];
+                    std::string k = std::to_string((seed * 31 + term * 7) % 97 + 1);
+                    const char* a = term % 2 ? second : first;
+                    switch ((seed + term) % 6)
+                    {
+                        case 0: text += std::string(a) + " * " + k; break;
+                        case 1: text += "(" + std::string(a) + " ^ " + k + ")"; break;
+                        case 2: text += "(" + std::string(a) + " & " + k + ")"; break;
+                        case 3: text += "(" + std::string(a) + " >> " + std::to_string(term % 5 + 1) + ")"; break;
+                        case 4: text += "(" + std::string(a) + " | " + k + ")"; break;
+                        default: text += "(" + std::string(a) + " << 1)"; break;
+                    }
+                }
+                return text + ") & 65535";
+            };
+
+            for (int i = 0; i < scale; i++)
+            {
+                source += "fun " + std::string(ChainFunctionPrefix) + std::to_string(i) + "(count: int): int\n{\n";
+                source += "    var x: int = " + std::to_string(i) + ";\n";
+                source += "    var y: int = 7;\n";
+                source += "    var i: int = 0;\n";
+                source += "    while (i < count)\n    {\n";
+                source += "        x = " + chain(i, "x", "y") + ";\n";
+                source += "        y = " + chain(i + 3, "y", "x") + ";\n";
+                source += "        i = i + 1;\n    }\n";
+                source += "    return x + y;\n}\n\n";
+            }
+        }
+
+        // A 2 KB string with escapes, and int and float tables of 512 and
+        // 256 entries, per unit.
+        void Literals(std::string& source, int scale)
+        {
+            static constexpr std::string_view Words[] =
+            {
+                "lorem", "ipsum", "\\\"quoted\\\"", "dolor", "C:\\\\path\\\\to", "sit", "amet\\n", "\\ttabbed",
+            };
+            for (int i = 0; i < scale; i++)
+            {
+                std::string n = std::to_string(i);
+                source += "let Text" + n + ": string = \"";
+                for (size_t length = 0, word = static_cast<size_t>(i); length < 2048; word++)
+                {
+                    std::string_view text = Words[word % std::size(Words)];
+                    source += text;
+                    source += ' ';
+                    length += text.size() + 1;
+                }
+                source += "\";\n";
+
+                source += "let Table" + n + ": [int] =\n[";
+                for (int entry = 0; entry < 512; entry++)
+                {
+                    source += entry % 16 ? " " : "\n    ";
+                    source += std::to_string((entry * 2654435761u + static_cast<unsigned>(i)) % 100000);
+                    if (entry < 511)
+                        source += ',';
+                }
+                source += "\n];\n";
+
+                source += "let Weights" + n + ": [float] =\n[";
+                for (int entry = 0; entry < 256; entry++)
+                {
+                    source += entry % 8 ? " " : "\n    ";
+                    source += std::to_string((entry * 37 + i) % 1000) + "." + std::to_string((entry * 13 + i) % 100);
+                    if (entry < 255)
+                        source += ',';
+                }
+                source += "\n];\n";
+
+                source += "fun Lookup" + n + "(k: uint): int\n{\n";
+                source += "    return Table" + n + "[k % Table" + n + ".size()];\n}\n\n";
+            }
+        }
+    }
+
+    std::span<const CorpusInfo> Corpora()
+    {
+        return CorpusList;
+    }
+
+    std::optional<CorpusInfo> FindCorpus(std::string_view name)
+    {
+        for (const CorpusInfo& corpus : CorpusList)
+        {
+            if (corpus.name == name)
+                return corpus;
+        }
+        return std::nullopt;
+    }
+
+    std::string GenerateCorpus(CorpusShape shape, int scale)
+    {
+        std::string source;
+        switch (shape)
+        {
+            case CorpusShape::Mixed:        Mixed(source, scale); break;
+            case CorpusShape::Nested:       Nested(source, scale); break;
+            case CorpusShape::Classes:      Classes(source, scale); break;
+            case CorpusShape::Expressions:  Expressions(source, scale); break;
+            case CorpusShape::Literals:     Literals(source, scale); break;
+        }
+        return source;
+    }
+} // namespace Arcanelab::Mano::Bench
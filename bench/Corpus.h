@@ -0,0 +1,40 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Arcanelab::Mano::Bench
+{
+    // Synthetic programs that stress one part of the front end each. Every
+    // shape is a valid program that analyzes and compiles without errors,
+    // and the same shape and scale give the same bytes on every machine, so
+    // throughput measured on them compares across commits.
+    enum class CorpusShape
+    {
+        Mixed,          // Enums, globals and functions with loops and switches
+        Nested,         // Blocks and parenthesized expressions nested deeply
+        Classes,        // Many classes with fields, constructors and methods
+        Expressions,    // Long arithmetic chains in straight-line loop bodies
+        Literals,       // Long string literals and large array literals
+    };
+
+    struct CorpusInfo
+    {
+        CorpusShape shape;
+        std::string_view name;
+        int scale;              // Units generated by the throughput suite, a few MB of source
+    };
+
+    std::span<const CorpusInfo> Corpora();
+    std::optional<CorpusInfo> FindCorpus(std::string_view name);
+
+    // scale is the number of top-level units: functions, classes, or
+    // groups of literals.
+    std::string GenerateCorpus(CorpusShape shape, int scale);
+
+    // Functions of the Expressions shape are Chain0, Chain1, ...; each
+    // Chain<i>(count: int): int runs a straight-line loop count times.
+    inline constexpr std::string_view ChainFunctionPrefix = "Chain";
+} // namespace Arcanelab::Mano::Bench
@@ -0,0 +1,57 @@
+#include <Benchmark.h>
+
+#include <IncrementalCompiler.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Arcanelab::Mano;
+
+namespace
+{
+    // A bundle of 400 functions, each a small loop over the previous one's
+    // result; edit picks the constant in the body of the middle function.
+    std::vector<SourceFile> MakeBundle(int edit)
+    {
+        std::string source;
+        for (int i = 0; i < 400; i++)
+        {
+            int factor = i == 200 ? edit : i + 1;
+            source += "fun Step" + std::to_string(i) + "(n: int): int\n{\n    var total: int = 0;\n"
+                "    for (var i: int = 0; i < n; i = i + 1)\n    {\n        total = total + i * " + std::to_string(factor) + ";\n    }\n"
+                "    if (total > 1000)\n    {\n        return total - n;\n    }\n    return total;\n}\n";
+        }
+        return { SourceFile{ "bundle.mano", source } };
+    }
+}
+
+// Full compile of the bundle against recompiling it after a one-function
+// edit, the hot-reload path.
+MANO_BENCHMARK(IncrementalRecompile)
+{
+    std::vector<SourceFile> edits[2] = { MakeBundle(1), MakeBundle(2) };
+
+    double full = Bench::MeasureBest(5, [&]
+    {
+        IncrementalCompiler compiler;
+        compiler.Compile(edits[0]);
+        Bench::DoNotOptimize(compiler.GetModule());
+    });
+
+    IncrementalCompiler compiler;
+    compiler.Compile(edits[0]);
+    int next = 1;
+    bool patched = true;
+    double incremental = Bench::MeasureBest(5, [&]
+    {
+        patched &= compiler.Compile(edits[next]) == IncrementalCompiler::Outcome::Patched;
+        next ^= 1;
+    });
+    if (!patched)
+        std::cerr << "IncrementalRecompile: edit was not patched\n";
+
+    Bench::Report("IncrementalRecompile", "full compile", full * 1e3, "ms");
+    Bench::Report("IncrementalRecompile", "one-function edit", incremental * 1e3, "ms");
+    Bench::Report("IncrementalRecompile", "speedup", full / incremental, "x");
+}
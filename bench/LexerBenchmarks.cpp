@@ -0,0 +1,50 @@
+#include <Benchmark.h>
+
+#include <ErrorReporter.h>
+#include <Lexer.h>
+
+#include <string>
+
+using namespace Arcanelab::Mano;
+
+namespace
+{
+    // Shaped like a generated data script: a long comment header, then
+    // tables of long string literals with deep indentation.
+    std::string MakeDataScript(int records)
+    {
+        std::string source;
+        for (int i = 0; i < 200; i++)
+            source += "// Generated table. Do not edit. This header line is padded to look like a license text.\n";
+        source += "\n";
+        for (int i = 0; i < records; i++)
+        {
+            std::string n = std::to_string(i);
+            source += "let record" + n + ": [string] =\n";
+            source += "                [\n";
+            source += "                    \"name of record " + n + ", with a fairly long description attached to it\",\n";
+            source += "                    \"C:\\\\data\\\\tables\\\\record" + n + ".bin, stored next to its \\\"index\\\" file\",\n";
+            source += "                    \"the quick brown fox jumps over the lazy dog the quick brown fox jumps\",\n";
+            source += "                ];\n\n";
+        }
+        return source;
+    }
+}
+
+MANO_BENCHMARK(TokenizeDataScript)
+{
+    const std::string source = MakeDataScript(20000);
+    size_t tokenCount = 0;
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        ErrorReporter errors(ErrorReporter::Phase::Lexer);
+        Lexer lexer(source, errors);
+        auto tokens = lexer.Tokenize();
+        tokenCount = tokens.size();
+        Bench::DoNotOptimize(tokens);
+    });
+
+    double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+    Bench::Report("TokenizeDataScript", "lex throughput", megabytes / seconds, "MB/s");
+    Bench::Report("TokenizeDataScript", "token throughput", static_cast<double>(tokenCount) / seconds / 1e6, "Mtokens/s");
+}
@@ -0,0 +1,92 @@
+#include <Benchmark.h>
+
+#include <AstArena.h>
+#include <ErrorReporter.h>
+#include <Lexer.h>
+#include <Parser.h>
+
+#include <memory>
+#include <string>
+
+using namespace Arcanelab::Mano;
+
+namespace
+{
+    // Roughly 50k lines of declarations, statements and expressions.
+    std::string MakeParserCorpus(int functions)
+    {
+        std::string source;
+        source.reserve(static_cast<size_t>(functions) * 1024);
+        for (int i = 0; i < functions; i++)
+        {
+            std::string n = std::to_string(i);
+            source += "enum Mode" + n + " { Idle, Run, Stop, }\n";
+            source += "var global" + n + ": int = " + n + " * 2 + 1;\n";
+            source += "fun Work" + n + "(a: int, b: float, c: const string): int\n{\n";
+            source += "    var total: int = a * 3 + (a - 1) / 2;\n";
+            source += "    var scale: float = b * 0.5 + 1.25;\n";
+            source += "    var name: string = \"item " + n + "\";\n";
+            source += "    let values: [int] = [1, 2, 3, 4, 5];\n";
+            source += "    for (var i: int = 0; i < 10; i = i + 1)\n    {\n";
+            source += "        if (i == 3 && total > 10 || i != 7)\n        {\n";
+            source += "            total = total + values[i] * 2;\n";
+            source += "            continue;\n        }\n";
+            source += "        total = total - (i << 1) + (i >> 1);\n    }\n";
+            source += "    while (total > 1000)\n    {\n        total = total / 2;\n    }\n";
+            source += "    switch (total % 3)\n    {\n";
+            source += "        case 0:\n        {\n            total = Work" + n + "(total, scale, name);\n        }\n";
+            source += "        default:\n        {\n            total = -total;\n        }\n    }\n";
+            source += "    return total + global" + n + ";\n}\n\n";
+        }
+        return source;
+    }
+}
+
+MANO_BENCHMARK(ParseProgram)
+{
+    const std::string source = MakeParserCorpus(1800);
+    size_t tokenCount = 0;
+    {
+        ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
+        Lexer lexer(source, lexErrors);
+        tokenCount = lexer.Tokenize().size();
+    }
+
+    double parseSeconds = 0.0;
+    double teardownSeconds = 0.0;
+    for (int run = 0; run < 5; run++)
+    {
+        double parse = 0.0;
+        double teardown = 0.0;
+        {
+            auto start = std::chrono::steady_clock::now();
+            // Lexing is fused into the parse, so it is part of the timing.
+            ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
+            Lexer lexer(source, lexErrors);
+            TokenStream tokens(lexer);
+            ErrorReporter parseErrors(ErrorReporter::Phase::Parser);
+            auto arena = std::make_unique<AstArena>();
+            Parser parser(tokens, parseErrors, *arena);
+            ASTNodePtr ast = parser.ParseProgram();
+            auto parsed = std::chrono::steady_clock::now();
+            Bench::DoNotOptimize(ast);
+            arena.reset();
+            auto destroyed = std::chrono::steady_clock::now();
+            parse = std::chrono::duration<double>(parsed - start).count();
+            teardown = std::chrono::duration<double>(destroyed - parsed).count();
+        }
+        if (run == 0 || parse + teardown < parseSeconds + teardownSeconds)
+        {
+            parseSeconds = parse;
+            teardownSeconds = teardown;
+        }
+    }
+
+    double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+    Bench::Report("ParseProgram", "parse time", parseSeconds * 1e3, "ms");
+    Bench::Report("ParseProgram", "teardown time", teardownSeconds * 1e3, "ms");
+    Bench::Report("ParseProgram", "parse throughput", megabytes / parseSeconds, "MB/s");
+    Bench::Report("ParseProgram", "token throughput", static_cast<double>(tokenCount) / parseSeconds / 1e6, "Mtokens/s");
+    Bench::Report("ParseProgram", "materialized tokens", static_cast<double>(tokenCount * sizeof(Token)) / 1024.0, "KB");
+    Bench::Report("ParseProgram", "streamed tokens", static_cast<double>(sizeof(TokenStream)) / 1024.0, "KB");
+}
@@ -0,0 +1,89 @@
+#include <Benchmark.h>
+
+#include <AstArena.h>
+#include <ErrorReporter.h>
+#include <Lexer.h>
+#include <Parser.h>
+#include <SemanticAnalyzer.h>
+#include <ThreadPool.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace Arcanelab::Mano;
+
+namespace
+{
+    // The analyzer's test script, from bin/ (where the bench runs) or the repo root.
+    std::string LoadSemanticTest()
+    {
+        for (const char* path : { "semantictest.mano", "bin/semantictest.mano" })
+        {
+            std::ifstream file(path);
+            if (file)
+            {
+                std::ostringstream buffer;
+                buffer << file.rdbuf();
+                return buffer.str();
+            }
+        }
+        return {};
+    }
+}
+
+MANO_BENCHMARK(AnalyzeSemanticTest)
+{
+    const std::string script = LoadSemanticTest();
+    if (script.empty())
+    {
+        std::cerr << "AnalyzeSemanticTest: semantictest.mano not found\n";
+        return;
+    }
+
+    // Every copy redeclares the same globals, so the scaled program also
+    // exercises the duplicate-declaration paths on every repetition.
+    constexpr int copies = 1000;
+    std::string source;
+    source.reserve(script.size() * copies);
+    for (int i = 0; i < copies; i++)
+        source += script;
+
+    // Top-level declarations are resolved on the pool when there is one; the
+    // diagnostics must come out the same either way.
+    ThreadPool pool(4);
+    for (ThreadPool* threads : { static_cast<ThreadPool*>(nullptr), &pool })
+    {
+        const char* name = threads ? "AnalyzeSemanticTest/4 threads" : "AnalyzeSemanticTest";
+        const int repetitions = 5;
+        double best = 0.0;
+        size_t errorCount = 0;
+        for (int run = 0; run < repetitions; run++)
+        {
+            // Analysis annotates the tree, so every run starts from a fresh parse.
+            ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
+            ErrorReporter parseErrors(ErrorReporter::Phase::Parser);
+            Lexer lexer(source, lexErrors);
+            TokenStream tokens(lexer);
+            AstArena arena;
+            Parser parser(tokens, parseErrors, arena);
+            ASTNodePtr ast = parser.ParseProgram();
+
+            double seconds = Bench::MeasureBest(1, [&]
+            {
+                SemanticAnalyzer analyzer(ast, arena);
+                analyzer.SetThreadPool(threads);
+                analyzer.Analyze();
+                errorCount = analyzer.GetErrors()[0].GetErrors().size();
+            });
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+
+        double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+        Bench::Report(name, "analysis time", best * 1e3, "ms");
+        Bench::Report(name, "analysis throughput", megabytes / best, "MB/s");
+        Bench::Report(name, "diagnostics", static_cast<double>(errorCount), "errors");
+    }
+}
@@ -0,0 +1,185 @@
+#include <Benchmark.h>
+#include <Corpus.h>
+
+#include <AstArena.h>
+#include <CodeGenerator.h>
+#include <CompileStats.h>
+#include <ConstantFolder.h>
+#include <ErrorReporter.h>
+#include <Lexer.h>
+#include <Parser.h>
+#include <SemanticAnalyzer.h>
+#include <VM.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Arcanelab::Mano;
+
+// Throughput of every stage on every corpus shape, at the fixed scales in
+// Corpus.cpp. The metric is the shape, so `bench --json Throughput` output
+// from two commits lines up key by key.
+namespace
+{
+    struct ParsedCorpus
+    {
+        std::unique_ptr<AstArena> arena = std::make_unique<AstArena>();
+        ASTNodePtr ast = nullptr;
+    };
+
+    ParsedCorpus Parse(const std::string& source, std::string_view name)
+    {
+        ParsedCorpus parsed;
+        ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
+        ErrorReporter parseErrors(ErrorReporter::Phase::Parser);
+        Lexer lexer(source, lexErrors);
+        TokenStream tokens(lexer);
+        Parser parser(tokens, parseErrors, *parsed.arena);
+        parsed.ast = parser.ParseProgram();
+        if (parseErrors.HasErrors())
+        {
+            std::cerr << "Throughput: " << name << " corpus: " << parseErrors.GetErrors()[0].message << "\n";
+            parsed.ast = nullptr;
+        }
+        return parsed;
+    }
+
+    // Same as VMBenchmarks: the loops measured are straight-line, so the
+    // back edge spans exactly the instructions of one iteration.
+    size_t LoopBodyLength(const FunctionProto& function)
+    {
+        size_t length = 0;
+        for (Instruction instruction : function.code)
+        {
+            if (GetOp(instruction) == OpCode::JMP && GetSJ(instruction) < 0)
+                length = static_cast<size_t>(-GetSJ(instruction));
+        }
+        return length;
+    }
+}
+
+MANO_BENCHMARK(ThroughputLex)
+{
+    for (const Bench::CorpusInfo& corpus : Bench::Corpora())
+    {
+        const std::string source = Bench::GenerateCorpus(corpus.shape, corpus.scale);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            ErrorReporter errors(ErrorReporter::Phase::Lexer);
+            Lexer lexer(source, errors);
+            size_t tokens = 0;
+            while (lexer.NextToken().kind != TokenKind::EndOfFile)
+                tokens++;
+            Bench::DoNotOptimize(tokens);
+        });
+
+        double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+        Bench::Report("ThroughputLex", corpus.name, megabytes / seconds, "MB/s");
+    }
+}
+
+MANO_BENCHMARK(ThroughputParse)
+{
+    for (const Bench::CorpusInfo& corpus : Bench::Corpora())
+    {
+        const std::string source = Bench::GenerateCorpus(corpus.shape, corpus.scale);
+        size_t nodes = 0;
+        {
+            ParsedCorpus parsed = Parse(source, corpus.name);
+            if (!parsed.ast)
+                continue;
+            CompileStats stats;
+            stats.CountNodes(parsed.ast);
+            for (size_t count : stats.nodes)
+                nodes += count;
+        }
+
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            ParsedCorpus parsed = Parse(source, corpus.name);
+            Bench::DoNotOptimize(parsed.ast);
+        });
+        Bench::Report("ThroughputParse", corpus.name, static_cast<double>(nodes) / seconds / 1e6, "Mnodes/s");
+    }
+}
+
+MANO_BENCHMARK(ThroughputAnalyze)
+{
+    for (const Bench::CorpusInfo& corpus : Bench::Corpora())
+    {
+        const std::string source = Bench::GenerateCorpus(corpus.shape, corpus.scale);
+        double best = 0.0;
+        size_t functions = 0;
+        bool analyzed = true;
+        for (int run = 0; run < 5 && analyzed; run++)
+        {
+            // Analysis annotates the tree, so every run starts from a fresh parse.
+            ParsedCorpus parsed = Parse(source, corpus.name);
+            if (!parsed.ast)
+                break;
+            CompileStats stats;
+            stats.CountNodes(parsed.ast);
+            functions = stats.nodes[static_cast<size_t>(ASTType::FunctionDeclaration)];
+
+            double seconds = Bench::MeasureBest(1, [&]
+            {
+                SemanticAnalyzer analyzer(parsed.ast, *parsed.arena);
+                analyzed = analyzer.Analyze();
+                if (!analyzed)
+                    std::cerr << "ThroughputAnalyze: " << corpus.name << " corpus: " << analyzer.GetErrors()[0].GetErrors()[0].message << "\n";
+            });
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+        if (analyzed)
+            Bench::Report("ThroughputAnalyze", corpus.name, static_cast<double>(functions) / best / 1e3, "kfunctions/s");
+    }
+}
+
+// Instructions dispatched per second over the first chains of the
+// expressions corpus, interpreted and with the JIT.
+MANO_BENCHMARK(ThroughputVM)
+{
+    constexpr int chains = 16;
+    constexpr int64_t iterations = 20'000;
+    const std::string source = Bench::GenerateCorpus(Bench::CorpusShape::Expressions, chains);
+
+    ParsedCorpus parsed = Parse(source, "expressions");
+    if (!parsed.ast)
+        return;
+    SemanticAnalyzer analyzer(parsed.ast, *parsed.arena);
+    if (!analyzer.Analyze())
+    {
+        std::cerr << "ThroughputVM: expressions corpus: " << analyzer.GetErrors()[0].GetErrors()[0].message << "\n";
+        return;
+    }
+    ConstantFolder(*parsed.arena).Fold({ &parsed.ast, 1 });
+    ErrorReporter codeGenErrors(ErrorReporter::Phase::CodeGen);
+    std::unique_ptr<Module> module = CodeGenerator(codeGenErrors).Generate(parsed.ast);
+    if (!module)
+        return;
+
+    std::vector<int32_t> functions;
+    double instructions = 0.0;
+    for (int i = 0; i < chains; i++)
+    {
+        functions.push_back(module->FindFunction(std::string(Bench::ChainFunctionPrefix) + std::to_string(i)));
+        instructions += static_cast<double>(LoopBodyLength(module->functions[functions.back()])) * static_cast<double>(iterations);
+    }
+
+    for (bool jit : { false, true })
+    {
+        VM vm;
+        vm.SetJitEnabled(jit);
+        vm.Load(*module);
+        Value argument = Value::Int(iterations);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            for (int32_t function : functions)
+                Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+        });
+        Bench::Report("ThroughputVM", jit ? "expressions, compiled" : "expressions, interpreted", instructions / seconds / 1e6, "Mops/s");
+    }
+}
@@ -0,0 +1,901 @@
+#include <Benchmark.h>
+
+#include <Binding.h>
+#include <CodeGenerator.h>
+#include <ConstantFolder.h>
+#include <ErrorReporter.h>
+#include <Lexer.h>
+#include <ModuleImage.h>
+#include <Parser.h>
+#include <Profiler.h>
+#include <SemanticAnalyzer.h>
+#include <SharedModule.h>
+#include <ThreadPool.h>
+#include <VM.h>
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Arcanelab::Mano;
+
+namespace
+{
+    std::unique_ptr<Module> CompileModule(const std::string& source, bool fold = true, const Binding* binding = nullptr)
+    {
+        ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
+        Lexer lexer(source, lexErrors);
+        TokenStream tokens(lexer);
+        ErrorReporter parseErrors(ErrorReporter::Phase::Parser);
+        AstArena arena;
+        Parser parser(tokens, parseErrors, arena);
+        ASTNodePtr ast = parser.ParseProgram();
+        if (parseErrors.HasErrors())
+        {
+            for (const auto& error : parseErrors.GetErrors())
+                std::cerr << "Parse error: " << error.message << "\n";
+            return nullptr;
+        }
+
+        SemanticAnalyzer analyzer(ast, arena);
+        if (binding)
+            analyzer.Bind(*binding);
+        if (!analyzer.Analyze())
+        {
+            for (const auto& error : analyzer.GetErrors()[0].GetErrors())
+                std::cerr << "Semantic error: " << error.line << ": " << error.message << "\n";
+            return nullptr;
+        }
+        if (fold)
+            ConstantFolder(arena).Fold({ &ast, 1 });
+
+        ErrorReporter codeGenErrors(ErrorReporter::Phase::CodeGen);
+        CodeGenerator codeGenerator(codeGenErrors);
+        auto module = codeGenerator.Generate(ast);
+        if (!module)
+        {
+            for (const auto& error : codeGenErrors.GetErrors())
+                std::cerr << "Code generation error: " << error.message << "\n";
+        }
+        return module;
+    }
+
+    // Instructions dispatched per iteration of the function's innermost
+    // loop, measured from the back edge to its target. The benchmark loops
+    // are straight-line so this is exact.
+    size_t LoopBodyLength(const FunctionProto& function)
+    {
+        size_t length = 0;
+        for (size_t pc = 0; pc < function.code.size(); pc++)
+        {
+            Instruction instruction = function.code[pc];
+            if (GetOp(instruction) == OpCode::JMP && GetSJ(instruction) < 0)
+                length = static_cast<size_t>(-GetSJ(instruction));
+        }
+        return length;
+    }
+
+    // RETAIN and RELEASE instructions in the function's innermost loop,
+    // found the same way as LoopBodyLength.
+    size_t LoopRefCountOps(const FunctionProto& function)
+    {
+        size_t count = 0;
+        for (size_t pc = 0; pc < function.code.size(); pc++)
+        {
+            Instruction instruction = function.code[pc];
+            if (GetOp(instruction) != OpCode::JMP || GetSJ(instruction) >= 0)
+                continue;
+            count = 0;
+            for (size_t body = pc + 1 - static_cast<size_t>(-GetSJ(instruction)); body <= pc; body++)
+            {
+                OpCode op = GetOp(function.code[body]);
+                count += op == OpCode::RETAIN || op == OpCode::RELEASE;
+            }
+        }
+        return count;
+    }
+
+    void RunLoopBenchmark(const char* name, const std::string& source, const char* entry, int64_t iterations)
+    {
+        auto module = CompileModule(source);
+        if (!module)
+            return;
+
+        int32_t function = module->FindFunction(entry);
+        size_t perIteration = LoopBodyLength(module->functions[function]);
+
+        // The interpreter's dispatch; VMJit measures the compiled loops.
+        VM vm;
+        vm.SetJitEnabled(false);
+        vm.Load(*module);
+        Value argument = Value::Int(iterations);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+        });
+
+        double dispatches = static_cast<double>(perIteration) * static_cast<double>(iterations);
+        Bench::Report(name, "dispatch throughput", dispatches / seconds / 1e6, "Minstr/s");
+        Bench::Report(name, "time per instruction", seconds * 1e9 / dispatches, "ns");
+    }
+
+    const std::string intLoopSource = R"(
+fun IntLoop(n: int): int
+{
+    var sum: int = 0;
+    var i: int = 0;
+    while (i < n)
+    {
+        sum = sum + (i * 3 ^ i) - (i & 7);
+        i = i + 1;
+    }
+    return sum;
+}
+)";
+
+    const std::string floatLoopSource = R"(
+fun FloatLoop(n: int): float
+{
+    var x: float = 0.0;
+    var v: float = 1.0;
+    var i: int = 0;
+    while (i < n)
+    {
+        v = v * 0.999 + 0.001;
+        x = x + v * 0.5;
+        i = i + 1;
+    }
+    return x;
+}
+)";
+
+    // Tuning constants and a disabled debug path, as configuration code
+    // tends to look; all of it folds away.
+    const std::string constantLoopSource = R"(
+let Scale: int = 1 << 4;
+let Bias: int = Scale * 3 - 7;
+let Tracing: bool = false;
+
+fun ConstantLoop(n: int): int
+{
+    var sum: int = 0;
+    var i: int = 0;
+    while (i < n)
+    {
+        sum = sum + i * (Scale / 2) + Bias % 5;
+        if (Tracing && i > 0)
+        {
+            sum = sum - 1;
+        }
+        i = i + 1;
+    }
+    return sum;
+}
+)";
+
+    // Objects handed down through calls and copied into locals, the way
+    // ProcessUsers(users) style code passes them around.
+    const std::string objectSource = R"(
+class Particle
+{
+    var x: float = 0.0;
+    var v: float = 1.0;
+}
+
+fun Step(p: Particle, dt: float)
+{
+    var q: Particle = p;
+    q.x = q.x + q.v * dt;
+}
+
+fun ObjectLoop(n: int): float
+{
+    var p: Particle = Particle();
+    var i: int = 0;
+    while (i < n)
+    {
+        Step(p, 0.5);
+        i = i + 1;
+    }
+    return p.x;
+}
+)";
+
+    // Five part concatenation and an equality test against a pooled literal.
+    const std::string stringSource = R"(
+fun StringLoop(n: int): int
+{
+    var name: string = "world";
+    var hits: int = 0;
+    var i: int = 0;
+    while (i < n)
+    {
+        var line: string = "hello, " + name + "! " + name + ".";
+        if (line == "hello, world! world.")
+        {
+            hits = hits + 1;
+        }
+        i = i + 1;
+    }
+    return hits;
+}
+)";
+
+    // Per-frame particle update over packed float arrays; the loop shape
+    // lets the analyzer drop the bounds checks.
+    const std::string arraySource = R"(
+fun Integrate(x: [float], v: [float], dt: float)
+{
+    for (var i: uint = 0; i < x.size(); i = i + 1)
+    {
+        x[i] = x[i] + v[i] * dt;
+    }
+}
+
+fun ArrayLoop(frames: int): float
+{
+    var x: [float] = [];
+    var v: [float] = [];
+    var i: int = 0;
+    while (i < 1000)
+    {
+        x.push(0.0);
+        v.push(1.0);
+        i = i + 1;
+    }
+    var frame: int = 0;
+    while (frame < frames)
+    {
+        Integrate(x, v, 0.5);
+        frame = frame + 1;
+    }
+    return x[999];
+}
+)";
+
+    // The loop variable borrows each element from the array it walks.
+    const std::string elementSource = R"(
+class User
+{
+    var score: int = 1;
+}
+
+fun TotalScore(users: [User]): int
+{
+    var total: int = 0;
+    for (var i: uint = 0; i < users.size(); i = i + 1)
+    {
+        var user: User = users[i];
+        total = total + user.score;
+    }
+    return total;
+}
+
+fun ElementLoop(rounds: int): int
+{
+    var users: [User] = [];
+    var i: int = 0;
+    while (i < 1000)
+    {
+        users.push(User());
+        i = i + 1;
+    }
+    var total: int = 0;
+    var round: int = 0;
+    while (round < rounds)
+    {
+        total = total + TotalScore(users);
+        round = round + 1;
+    }
+    return total;
+}
+)";
+
+    // The same dot product through the builtin and as an interpreted loop.
+    const std::string kernelSource = R"(
+fun Fill(n: int): [float]
+{
+    var values: [float] = [];
+    var v: float = 0.0;
+    var i: int = 0;
+    while (i < n)
+    {
+        values.push(v);
+        v = v + 0.25;
+        i = i + 1;
+    }
+    return values;
+}
+
+fun LoopDot(a: [float], b: [float]): float
+{
+    var total: float = 0.0;
+    for (var i: uint = 0; i < a.size(); i = i + 1)
+    {
+        total = total + a[i] * b[i];
+    }
+    return total;
+}
+
+fun DotLoop(rounds: int): float
+{
+    var a: [float] = Fill(4096);
+    var total: float = 0.0;
+    var r: int = 0;
+    while (r < rounds)
+    {
+        total = total + LoopDot(a, a);
+        r = r + 1;
+    }
+    return total;
+}
+
+fun DotKernel(rounds: int): float
+{
+    var a: [float] = Fill(4096);
+    var total: float = 0.0;
+    var r: int = 0;
+    while (r < rounds)
+    {
+        total = total + dot(a, a);
+        r = r + 1;
+    }
+    return total;
+}
+)";
+
+    const std::string callSource = R"(
+fun Fib(n: int): int
+{
+    if (n < 2)
+    {
+        return n;
+    }
+    return Fib(n - 1) + Fib(n - 2);
+}
+)";
+}
+
+MANO_BENCHMARK(VMIntLoop)
+{
+    RunLoopBenchmark("VMIntLoop", intLoopSource, "IntLoop", 20'000'000);
+}
+
+MANO_BENCHMARK(VMFloatLoop)
+{
+    RunLoopBenchmark("VMFloatLoop", floatLoopSource, "FloatLoop", 20'000'000);
+}
+
+MANO_BENCHMARK(VMConstantLoop)
+{
+    const int64_t iterations = 20'000'000;
+    for (bool fold : { false, true })
+    {
+        auto module = CompileModule(constantLoopSource, fold);
+        if (!module)
+            return;
+
+        int32_t function = module->FindFunction("ConstantLoop");
+        VM vm;
+        vm.Load(*module);
+        Value argument = Value::Int(iterations);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+        });
+
+        std::string label = fold ? "folded " : "unfolded ";
+        Bench::Report("VMConstantLoop", label + "loop body", static_cast<double>(LoopBodyLength(module->functions[function])), "instr");
+        Bench::Report("VMConstantLoop", label + "time per iteration", seconds * 1e9 / static_cast<double>(iterations), "ns");
+    }
+}
+
+MANO_BENCHMARK(VMObjectCalls)
+{
+    auto module = CompileModule(objectSource);
+    if (!module)
+        return;
+
+    uint32_t emitted = 0;
+    uint32_t elided = 0;
+    for (const FunctionProto& function : module->functions)
+    {
+        emitted += function.refCountOps;
+        elided += function.elidedRefCountOps;
+    }
+
+    const int64_t iterations = 10'000'000;
+    int32_t function = module->FindFunction("ObjectLoop");
+    VM vm;
+    vm.Load(*module);
+    Value argument = Value::Int(iterations);
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+    });
+
+    Bench::Report("VMObjectCalls", "refcount ops emitted", emitted, "ops");
+    Bench::Report("VMObjectCalls", "refcount ops elided", elided, "ops");
+    Bench::Report("VMObjectCalls", "time per iteration", seconds * 1e9 / static_cast<double>(iterations), "ns");
+}
+
+MANO_BENCHMARK(VMStringConcat)
+{
+    auto module = CompileModule(stringSource);
+    if (!module)
+        return;
+
+    const int64_t iterations = 5'000'000;
+    int32_t function = module->FindFunction("StringLoop");
+    VM vm;
+    vm.Load(*module);
+    Value argument = Value::Int(iterations);
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+    });
+
+    Bench::Report("VMStringConcat", "string constants", static_cast<double>(module->strings.size()), "strings");
+    Bench::Report("VMStringConcat", "time per iteration", seconds * 1e9 / static_cast<double>(iterations), "ns");
+}
+
+MANO_BENCHMARK(VMArrayLoop)
+{
+    auto module = CompileModule(arraySource);
+    if (!module)
+        return;
+
+    const int64_t frames = 10'000;
+    int32_t function = module->FindFunction("ArrayLoop");
+    VM vm;
+    vm.Load(*module);
+    Value argument = Value::Int(frames);
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+    });
+
+    Bench::Report("VMArrayLoop", "time per element", seconds * 1e9 / static_cast<double>(frames * 1000), "ns");
+}
+
+MANO_BENCHMARK(VMArrayElements)
+{
+    auto module = CompileModule(elementSource);
+    if (!module)
+        return;
+
+    const int64_t rounds = 10'000;
+    int32_t function = module->FindFunction("ElementLoop");
+    VM vm;
+    vm.Load(*module);
+    Value argument = Value::Int(rounds);
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+    });
+
+    const FunctionProto& loop = module->functions[module->FindFunction("TotalScore")];
+    Bench::Report("VMArrayElements", "refcount ops in loop body", static_cast<double>(LoopRefCountOps(loop)), "ops");
+    Bench::Report("VMArrayElements", "time per element", seconds * 1e9 / static_cast<double>(rounds * 1000), "ns");
+}
+
+MANO_BENCHMARK(VMArrayKernels)
+{
+    auto module = CompileModule(kernelSource);
+    if (!module)
+        return;
+
+    VM vm;
+    vm.Load(*module);
+    auto measure = [&](const char* name, int64_t rounds)
+    {
+        int32_t function = module->FindFunction(name);
+        Value argument = Value::Int(rounds);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+        });
+        return seconds * 1e9 / static_cast<double>(rounds * 4096);
+    };
+    double loop = measure("DotLoop", 200);
+    double kernel = measure("DotKernel", 20'000);
+
+    Bench::Report("VMArrayKernels", "dot, interpreted loop", loop, "ns/elem");
+    Bench::Report("VMArrayKernels", "dot, " + std::string(Kernels::Active().name) + " kernel", kernel, "ns/elem");
+    Bench::Report("VMArrayKernels", "kernel speedup", loop / kernel, "x");
+}
+
+MANO_BENCHMARK(VMCalls)
+{
+    auto module = CompileModule(callSource);
+    if (!module)
+        return;
+
+    int32_t function = module->FindFunction("Fib");
+    VM vm;
+    vm.SetJitEnabled(false);
+    vm.Load(*module);
+    Value argument = Value::Int(27);
+    double seconds = Bench::MeasureBest(5, [&]
+    {
+        Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+    });
+
+    // fib(27) makes 2 * fib(28) - 1 calls.
+    double calls = 2.0 * 317811.0 - 1.0;
+    Bench::Report("VMCalls", "call throughput", calls / seconds / 1e6, "Mcalls/s");
+}
+
+// Sessions sharing one module: the cost of starting an isolate with a
+// small stack, and fib(22) throughput with one isolate per thread against
+// the same isolates taking turns on one thread.
+MANO_BENCHMARK(VMIsolates)
+{
+    std::unique_ptr<Module> compiled = CompileModule(callSource);
+    if (!compiled)
+        return;
+    auto module = std::make_shared<const SharedModule>(std::move(compiled));
+    int32_t function = module->FindFunction("Fib");
+
+    const size_t isolateCount = 1000;
+    std::vector<std::unique_ptr<VM>> isolates;
+    double start = Bench::MeasureBest(3, [&]
+    {
+        isolates.clear();
+        for (size_t i = 0; i < isolateCount; i++)
+        {
+            auto vm = std::make_unique<VM>(4096, 256);
+            vm->Load(module);
+            isolates.push_back(std::move(vm));
+        }
+    });
+
+    ThreadPool pool;
+    size_t sessions = pool.ThreadCount() * 4;
+    Value argument = Value::Int(22);
+    auto run = [&](size_t session) { Bench::DoNotOptimize(isolates[session]->Call(function, { &argument, 1 })); };
+    double serial = Bench::MeasureBest(3, [&]
+    {
+        for (size_t session = 0; session < sessions; session++)
+            run(session);
+    });
+    double parallel = Bench::MeasureBest(3, [&] { pool.ParallelFor(sessions, run); });
+
+    // fib(22) makes 2 * fib(23) - 1 calls.
+    double calls = static_cast<double>(sessions) * (2.0 * 28657.0 - 1.0);
+    Bench::Report("VMIsolates", "start isolate", start * 1e6 / isolateCount, "us");
+    Bench::Report("VMIsolates", "one thread", calls / serial / 1e6, "Mcalls/s");
+    Bench::Report("VMIsolates", std::to_string(pool.ThreadCount()) + " threads", calls / parallel / 1e6, "Mcalls/s");
+}
+
+// Cold start of a program of many small functions: compiling it from source
+// against mapping its cached image and binding a VM to it.
+MANO_BENCHMARK(VMModuleImage)
+{
+    std::string source;
+    for (int i = 0; i < 400; i++)
+    {
+        std::string name = "Step" + std::to_string(i);
+        source += "fun " + name + "(n: int): int\n{\n    var total: int = 0;\n"
+            "    for (var i: int = 0; i < n; i = i + 1)\n    {\n        total = total + i * " + std::to_string(i + 1) + ";\n    }\n"
+            "    if (total > 1000)\n    {\n        return total - n;\n    }\n    return total;\n}\n";
+    }
+
+    const std::string path = "VMModuleImage.img";
+    uint64_t sourceHash = ModuleImage::HashSource(source);
+    double compile = Bench::MeasureBest(5, [&]
+    {
+        auto module = CompileModule(source);
+        Bench::DoNotOptimize(module.get());
+        VM vm;
+        vm.Load(*module);
+    });
+
+    auto module = CompileModule(source);
+    if (!module || !ModuleImage::Write(*module, sourceHash, path))
+        return;
+    double load = Bench::MeasureBest(5, [&]
+    {
+        auto image = ModuleImage::Open(path, sourceHash);
+        Bench::DoNotOptimize(image.get());
+        VM vm;
+        vm.Load(*image);
+    });
+    std::remove(path.c_str());
+
+    Bench::Report("VMModuleImage", "compile from source", compile * 1e3, "ms");
+    Bench::Report("VMModuleImage", "map cached image", load * 1e3, "ms");
+    Bench::Report("VMModuleImage", "startup speedup", compile / load, "x");
+}
+
+namespace
+{
+    int64_t HostMix(int64_t a, int64_t b)
+    {
+        return a * 31 + b;
+    }
+
+    // The same call made to a script function and to a bound host function.
+    const std::string hostCallSource = R"(
+fun ScriptMix(a: int, b: int): int
+{
+    return a * 31 + b;
+}
+
+fun ScriptLoop(n: int): int
+{
+    var sum: int = 0;
+    for (var i: int = 0; i < n; i = i + 1)
+    {
+        sum = ScriptMix(sum, i);
+    }
+    return sum;
+}
+
+fun HostLoop(n: int): int
+{
+    var sum: int = 0;
+    for (var i: int = 0; i < n; i = i + 1)
+    {
+        sum = HostMix(sum, i);
+    }
+    return sum;
+}
+)";
+}
+
+MANO_BENCHMARK(VMHostCalls)
+{
+    Binding binding;
+    binding.Function<&HostMix>("HostMix");
+    auto module = CompileModule(hostCallSource, true, &binding);
+    if (!module)
+        return;
+
+    // Host calls are not compiled, so both loops stay interpreted.
+    const int64_t iterations = 10'000'000;
+    VM vm;
+    vm.SetJitEnabled(false);
+    vm.Bind(binding);
+    vm.Load(*module);
+    Value argument = Value::Int(iterations);
+    for (const char* entry : { "ScriptLoop", "HostLoop" })
+    {
+        int32_t function = module->FindFunction(entry);
+        double seconds = Bench::MeasureBest(5, [&]
+        {
+            Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+        });
+        std::string label = entry == std::string("HostLoop") ? "host" : "script";
+        Bench::Report("VMHostCalls", label + " call", seconds * 1e9 / static_cast<double>(iterations), "ns");
+    }
+}
+
+namespace
+{
+    // The while and switch loop from the README, on integers.
+    const std::string switchLoopSource = R"(
+fun SwitchLoop(n: int): int
+{
+    var total: int = 0;
+    var counter: int = 0;
+    while (counter < n)
+    {
+        switch (counter % 3)
+        {
+            case 0: { total = total + 1; }
+            case 1: { total = total + 10; }
+            default: { total = total - 3; }
+        }
+        counter = counter + 1;
+    }
+    return total;
+}
+)";
+}
+
+// The same functions interpreted and compiled; each call is hot from the
+// first measured run, so the compiled rows exclude compilation.
+MANO_BENCHMARK(VMJit)
+{
+    struct Case
+    {
+        const char* label;
+        const std::string& source;
+        const char* entry;
+        int64_t argument;
+        double work;            // Iterations or calls per run
+    };
+    const Case cases[] = {
+        { "int loop", intLoopSource, "IntLoop", 20'000'000, 20'000'000 },
+        { "float loop", floatLoopSource, "FloatLoop", 20'000'000, 20'000'000 },
+        { "switch loop", switchLoopSource, "SwitchLoop", 20'000'000, 20'000'000 },
+        { "fib(27)", callSource, "Fib", 27, 2.0 * 317811.0 - 1.0 },
+    };
+
+    for (const Case& benchmark : cases)
+    {
+        auto module = CompileModule(benchmark.source);
+        if (!module)
+            return;
+
+        int32_t function = module->FindFunction(benchmark.entry);
+        double interpreted = 0.0;
+        for (bool jit : { false, true })
+        {
+            VM vm;
+            vm.SetJitEnabled(jit);
+            vm.Load(*module);
+            Value argument = Value::Int(benchmark.argument);
+            double seconds = Bench::MeasureBest(5, [&]
+            {
+                Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+            });
+
+            double perUnit = seconds * 1e9 / benchmark.work;
+            Bench::Report("VMJit", std::string(benchmark.label) + (jit ? ", compiled" : ", interpreted"), perUnit, "ns");
+            if (!jit)
+                interpreted = perUnit;
+            else
+                Bench::Report("VMJit", std::string(benchmark.label) + " speedup", interpreted / perUnit, "x");
+        }
+    }
+}
+
+namespace
+{
+    // An AI state machine stepping through a 32-state enum, once with a
+    // switch and once as the compare chain a naive lowering would produce.
+    std::string StateMachineSource()
+    {
+        const int states = 32;
+        std::string source = "enum State\n{\n";
+        for (int i = 0; i < states; i++)
+            source += "    S" + std::to_string(i) + (i + 1 < states ? ",\n" : "\n");
+        source += "}\n";
+
+        for (bool chain : { false, true })
+        {
+            source += chain ? "fun ChainMachine(n: int): int\n" : "fun SwitchMachine(n: int): int\n";
+            source += "{\n    var state: State = State.S0;\n    var total: int = 0;\n"
+                "    for (var i: int = 0; i < n; i = i + 1)\n    {\n";
+            if (!chain)
+                source += "        switch (state)\n        {\n";
+            for (int i = 0; i < states; i++)
+            {
+                std::string next = "State.S" + std::to_string((i * 7 + 3) % states);
+                std::string body = "total = total + " + std::to_string(i) + "; state = " + next + ";";
+                if (chain)
+                    source += "        if (state == State.S" + std::to_string(i) + ") { " + body + " continue; }\n";
+                else
+                    source += "            case State.S" + std::to_string(i) + ": { " + body + " }\n";
+            }
+            if (!chain)
+                source += "        }\n";
+            source += "    }\n    return total;\n}\n";
+        }
+        return source;
+    }
+
+    // Labels too far apart for a table, dispatched by binary search.
+    const std::string sparseSwitchSource = R"(
+fun SparseSwitch(n: int): int
+{
+    var total: int = 0;
+    for (var i: int = 0; i < n; i = i + 1)
+    {
+        var k: int = i % 16;
+        switch (k * k * k)
+        {
+            case 0: { total = total + 1; }
+            case 8: { total = total + 2; }
+            case 64: { total = total + 3; }
+            case 216: { total = total + 4; }
+            case 512: { total = total + 5; }
+            case 1000: { total = total + 6; }
+            case 1728: { total = total + 7; }
+            case 2744: { total = total + 8; }
+            case 4096: { total = total - 1; }
+            case 5832: { total = total - 2; }
+            case 8000: { total = total - 3; }
+            case 10648: { total = total - 4; }
+            default: { total = total ^ 5; }
+        }
+    }
+    return total;
+}
+)";
+}
+
+MANO_BENCHMARK(VMSwitch)
+{
+    const std::string stateMachineSource = StateMachineSource();
+    struct Case
+    {
+        const char* label;
+        const std::string& source;
+        const char* entry;
+    };
+    const Case cases[] = {
+        { "enum jump table", stateMachineSource, "SwitchMachine" },
+        { "enum compare chain", stateMachineSource, "ChainMachine" },
+        { "sparse search", sparseSwitchSource, "SparseSwitch" },
+    };
+
+    const int64_t iterations = 10'000'000;
+    for (const Case& benchmark : cases)
+    {
+        auto module = CompileModule(benchmark.source);
+        if (!module)
+            return;
+
+        int32_t function = module->FindFunction(benchmark.entry);
+        for (bool jit : { false, true })
+        {
+            VM vm;
+            vm.SetJitEnabled(jit);
+            vm.Load(*module);
+            Value argument = Value::Int(iterations);
+            double seconds = Bench::MeasureBest(5, [&]
+            {
+                Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+            });
+            std::string label = std::string(benchmark.label) + (jit ? ", compiled" : ", interpreted");
+            Bench::Report("VMSwitch", label, seconds * 1e9 / static_cast<double>(iterations), "ns");
+        }
+    }
+}
+
+// Slowdown of calls and loops interpreted with a profiler attached but not
+// ticking, and sampling every millisecond and every 100 us.
+MANO_BENCHMARK(VMProfiler)
+{
+    struct Case
+    {
+        const char* label;
+        const std::string& source;
+        const char* entry;
+        int64_t argument;
+    };
+    const Case cases[] = {
+        { "calls", callSource, "Fib", 27 },
+        { "loop", intLoopSource, "IntLoop", 20'000'000 },
+    };
+
+    for (const Case& benchmark : cases)
+    {
+        auto module = CompileModule(benchmark.source);
+        if (!module)
+            return;
+
+        int32_t function = module->FindFunction(benchmark.entry);
+        double baseline = 0.0;
+        for (int interval : { -1, 0, 1000, 100 })
+        {
+            Profiler profiler;
+            VM vm;
+            vm.SetJitEnabled(false);
+            if (interval >= 0)
+                vm.SetProfiler(&profiler);
+            if (interval > 0)
+                profiler.Start(std::chrono::microseconds(interval));
+            vm.Load(*module);
+            Value argument = Value::Int(benchmark.argument);
+            double seconds = Bench::MeasureBest(5, [&]
+            {
+                Bench::DoNotOptimize(vm.Call(function, { &argument, 1 }));
+            });
+            profiler.Stop();
+
+            if (interval < 0)
+            {
+                baseline = seconds;
+                continue;
+            }
+            std::string label = std::string(benchmark.label) + (interval == 0 ? ", attached" : ", every " + std::to_string(interval) + " us");
+            Bench::Report("VMProfiler", label, (seconds / baseline - 1.0) * 100.0, "%");
+        }
+    }
+}
@@ -1,15 +1,17 @@
 #pragma once
 
-#include <memory>
-#include <string>
-#include <unordered_map>
-#include <vector>
+#include <Token.h>
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
 
 namespace Arcanelab::Mano
 {
     // Forward declarations
     struct Symbol;
-    struct Scope;
+    struct Type;
 
     enum class ASTType
     {
@@ -40,38 +42,46 @@ namespace Arcanelab::Mano
         ObjectInstantiation
     };
 
+    // Nodes live in an AstArena and are never destroyed individually. Names
+    // are views into the source text or into strings copied to the arena, so
+    // both must outlive the tree. Nodes carry no vtable; nodeType is the only
+    // way to recover the concrete type (see ASTVisitor.h). Names that the
+    // analyzer resolves also carry their IdentifierTable id.
     struct ASTNode
     {
         explicit ASTNode(ASTType type) : nodeType(type) {}
-        virtual ~ASTNode() = default;
         ASTType nodeType;
+        uint32_t line = 0;      // Source line of statements and declarations; 0 on other nodes
     };
 
-    using ASTNodePtr = std::unique_ptr<ASTNode>;
+    using ASTNodePtr = ASTNode*;
+
+    inline constexpr uint32_t NoMethod = UINT32_MAX;
 
     struct ProgramNode : public ASTNode
     {
         ProgramNode() : ASTNode(ASTType::Program) {}
-        std::vector<ASTNodePtr> declarations;
+        std::span<ASTNodePtr> declarations;
     };
 
     struct TypeNode : public ASTNode
     {
         TypeNode() : ASTNode(ASTType::Type) {}
-        TypeNode(std::string name, bool isArray = false, bool isConst = false)
+        TypeNode(std::string_view name, bool isArray = false, bool isConst = false)
             : ASTNode(ASTType::Type),
-            name(std::move(name)),
+            name(name),
             array(isArray),
             isConst(isConst)
         {
         }
 
-        std::string name;
+        std::string_view name;
         bool array = false;
         bool isConst = false;
+        const Type* resolved = nullptr;     // Interned type, set by the analyzer
     };
 
-    using TypeNodePtr = std::unique_ptr<TypeNode>;
+    using TypeNodePtr = TypeNode*;
 
     struct VariableDeclarationNode : public ASTNode
     {
@@ -81,66 +91,84 @@ namespace Arcanelab::Mano
         {
         }
 
-        std::string name;         // From source code
-        TypeNodePtr declaredType; // Type annotation
-        TypeNodePtr resolvedType;
-        ASTNodePtr initializer;   // Initial value
-        Symbol* symbol;           // Semantic link
+        std::string_view name;              // From source code
+        uint32_t nameId = NoIdentifier;
+        TypeNodePtr declaredType = nullptr; // Type annotation
+        const Type* resolvedType = nullptr;
+        ASTNodePtr initializer = nullptr;   // Initial value
+        Symbol* symbol;                     // Semantic link
 
         // SourceLocation nameLocation; // Line/column info
     };
 
+    struct Parameter
+    {
+        std::string_view name;
+        uint32_t nameId = NoIdentifier;
+        TypeNodePtr type = nullptr;
+        Symbol* symbol = nullptr;           // Set by the analyzer
+    };
+
     struct FunctionDeclarationNode : public ASTNode
     {
         FunctionDeclarationNode()
             : ASTNode(ASTType::FunctionDeclaration),
-            symbol(nullptr),
-            functionScope(nullptr)
+            symbol(nullptr)
         {
         }
 
-        std::string name;
-        std::vector<std::pair<std::string, TypeNodePtr>> parameters;
-        TypeNodePtr returnType;
-        ASTNodePtr body;
+        std::string_view name;
+        uint32_t nameId = NoIdentifier;
+        std::span<Parameter> parameters;
+        TypeNodePtr returnType = nullptr;
+        ASTNodePtr body = nullptr;
+        Symbol* symbol;
+        uint32_t slotCount = 0;             // Frame slots of parameters and locals, set by the analyzer
+        std::span<uint32_t> ownedSlots;     // Reference slots that hold a count, set by the analyzer
+    };
+
+    // A name bound in a scope. Class members are kept as a list of these so
+    // the analyzer can reopen the class scope when it resolves the methods.
+    struct ScopeEntry
+    {
+        uint32_t nameId;
         Symbol* symbol;
-        Scope* functionScope;
     };
 
     struct ClassDeclarationNode : public ASTNode
     {
         ClassDeclarationNode()
             : ASTNode(ASTType::ClassDeclaration),
-            symbol(nullptr),
-            classScope(nullptr)
+            symbol(nullptr)
         {
         }
 
-        std::string name;
-        ASTNodePtr body;
+        std::string_view name;
+        uint32_t nameId = NoIdentifier;
+        ASTNodePtr body = nullptr;
         Symbol* symbol;
-        Scope* classScope;
-        std::unordered_map<std::string, Symbol*> methods;
+        std::span<ScopeEntry> members;
+        std::span<Symbol*> methods;         // Indexed by Symbol::methodIndex
+        uint32_t instanceSize = 0;          // Bytes of field storage, set by the analyzer
     };
 
     struct EnumDeclarationNode : public ASTNode
     {
         EnumDeclarationNode() : ASTNode(ASTType::EnumDeclaration) {}
-        std::string name;
-        std::vector<std::string> values;
+        std::string_view name;
+        uint32_t nameId = NoIdentifier;
+        std::span<std::string_view> values;
     };
 
     struct BlockNode : public ASTNode
     {
         BlockNode()
             : ASTNode(ASTType::Block),
-            blockScope(nullptr),
             symbolsCollected(false)
         {
         }
 
-        std::vector<ASTNodePtr> statements;
-        Scope* blockScope;
+        std::span<ASTNodePtr> statements;
         bool symbolsCollected;
     };
 
@@ -148,20 +176,18 @@ namespace Arcanelab::Mano
     {
         ClassBlockNode()
             : ASTNode(ASTType::ClassBlock),
-            classScope(nullptr),
             membersProcessed(false)
         {
         }
 
-        std::vector<ASTNodePtr> declarations;
-        Scope* classScope;
+        std::span<ASTNodePtr> declarations;
         bool membersProcessed;
     };
 
     struct ExpressionStatementNode : public ASTNode
     {
         ExpressionStatementNode() : ASTNode(ASTType::ExpressionStatement) {}
-        ASTNodePtr expression;
+        ASTNodePtr expression = nullptr;
     };
 
     struct ReturnStatementNode : public ASTNode
@@ -173,7 +199,7 @@ namespace Arcanelab::Mano
         {
         }
 
-        ASTNodePtr expression;
+        ASTNodePtr expression = nullptr;
         FunctionDeclarationNode* enclosingFunction;
         bool hasValidReturnType;
     };
@@ -181,9 +207,9 @@ namespace Arcanelab::Mano
     struct IfStatementNode : public ASTNode
     {
         IfStatementNode() : ASTNode(ASTType::IfStatement) {}
-        ASTNodePtr condition;
-        ASTNodePtr thenBranch;
-        ASTNodePtr elseBranch;
+        ASTNodePtr condition = nullptr;
+        ASTNodePtr thenBranch = nullptr;
+        ASTNodePtr elseBranch = nullptr;
     };
 
     struct ForStatementNode : public ASTNode
@@ -191,25 +217,26 @@ namespace Arcanelab::Mano
         // Add explicit constructor for base class
         ForStatementNode() : ASTNode(ASTType::ForStatement) {}
 
-        ASTNodePtr init;       // Initializer (var decl or expr)
-        ASTNodePtr condition;  // Loop condition
-        ASTNodePtr update;     // Update expression (not 'increment')
-        ASTNodePtr body;       // Loop body
+        ASTNodePtr init = nullptr;       // Initializer (var decl or expr)
+        ASTNodePtr condition = nullptr;  // Loop condition
+        ASTNodePtr update = nullptr;     // Update expression (not 'increment')
+        ASTNodePtr body = nullptr;       // Loop body
     };
 
     struct WhileStatementNode : public ASTNode
     {
         WhileStatementNode() : ASTNode(ASTType::WhileStatement) {}
-        ASTNodePtr condition;
-        ASTNodePtr body;
+        ASTNodePtr condition = nullptr;
+        ASTNodePtr body = nullptr;
     };
 
     struct SwitchStatementNode : public ASTNode
     {
         SwitchStatementNode() : ASTNode(ASTType::SwitchStatement) {}
-        ASTNodePtr expression;
-        std::vector<std::pair<ASTNodePtr, ASTNodePtr>> cases;
-        ASTNodePtr defaultCase;
+        ASTNodePtr expression = nullptr;
+        std::span<std::pair<ASTNodePtr, ASTNodePtr>> cases;
+        ASTNodePtr defaultCase = nullptr;
+        bool isExhaustive = false;          // Cases name every member of the enum subject, set by the analyzer
     };
 
     struct MemberAccessNode : public ASTNode
@@ -220,17 +247,23 @@ namespace Arcanelab::Mano
         {
         }
 
-        ASTNodePtr object;
-        std::string memberName;
-        Symbol* memberSymbol;
-        TypeNodePtr objectType;
+        ASTNodePtr object = nullptr;
+        std::string_view memberName;
+        uint32_t memberNameId = NoIdentifier;
+        Symbol* memberSymbol;               // Enum, field or method
+        const Type* evaluatedType = nullptr;
+        uint32_t fieldOffset = 0;           // Byte offset into the instance, fields only
     };
 
     struct IndexAccessNode : public ASTNode
     {
         IndexAccessNode() : ASTNode(ASTType::IndexAccess) {}
-        ASTNodePtr object;
-        ASTNodePtr index;
+        ASTNodePtr object = nullptr;
+        ASTNodePtr index = nullptr;
+        const Type* evaluatedType = nullptr; // Element type, set by the analyzer
+        // Cleared by the analyzer when an enclosing loop condition already
+        // proves the index in range.
+        bool boundsChecked = true;
     };
 
     enum class BinaryOperator
@@ -247,23 +280,24 @@ namespace Arcanelab::Mano
         {
         }
 
-        ASTNodePtr left;
+        ASTNodePtr left = nullptr;
         BinaryOperator op;
-        ASTNodePtr right;
-        TypeNodePtr evaluatedType;
+        ASTNodePtr right = nullptr;
+        const Type* evaluatedType = nullptr;
     };
 
     struct UnaryExpressionNode : public ASTNode
     {
         UnaryExpressionNode() : ASTNode(ASTType::UnaryExpression) {}
-        std::string op;
-        ASTNodePtr operand;
+        std::string_view op;
+        ASTNodePtr operand = nullptr;
     };
 
     struct LiteralNode : public ASTNode
     {
         LiteralNode() : ASTNode(ASTType::Literal) {}
-        std::string value;
+        std::string_view value;
+        const Type* evaluatedType = nullptr; // Integer literals take the type of their context
     };
 
     struct IdentifierNode : public ASTNode
@@ -275,9 +309,10 @@ namespace Arcanelab::Mano
         {
         }
 
-        std::string name;
+        std::string_view name;
+        uint32_t nameId = NoIdentifier;
         Symbol* resolvedSymbol;
-        TypeNodePtr evaluatedType;
+        const Type* evaluatedType = nullptr;
     };
 
     struct BreakStatementNode : public ASTNode
@@ -309,10 +344,19 @@ namespace Arcanelab::Mano
         {
         }
 
-        std::vector<ASTNodePtr> elements;
-        TypeNodePtr evaluatedType;
+        std::span<ASTNodePtr> elements;
+        const Type* evaluatedType = nullptr;
     };
 
+    // Methods every array has; they have no symbol of their own.
+    enum class ArrayMethod { None, Size, Push };
+
+    // Builtin functions over primitive arrays: sum(a), min(a), max(a),
+    // dot(a, b), fill(a, value), copy(target, source), add(target, source),
+    // mul(target, source) and scale(a, factor). A declared function of the
+    // same name takes precedence.
+    enum class ArrayBuiltin { None, Sum, Min, Max, Dot, Fill, Copy, Add, Mul, Scale };
+
     struct FunctionCallNode : public ASTNode
     {
         FunctionCallNode()
@@ -321,11 +365,15 @@ namespace Arcanelab::Mano
         {
         }
 
-        std::string name;
-        std::vector<ASTNodePtr> arguments;
-        ASTNodePtr callTarget;
+        std::string_view name;              // Empty for method calls
+        uint32_t nameId = NoIdentifier;
+        std::span<ASTNodePtr> arguments;
+        ASTNodePtr callTarget = nullptr;
         Symbol* resolvedFunction;
-        std::vector<TypeNodePtr> argumentTypes;
+        std::span<const Type*> argumentTypes;
+        uint32_t methodIndex = NoMethod;    // Methods and constructors, set by the analyzer
+        ArrayMethod arrayMethod = ArrayMethod::None;
+        ArrayBuiltin arrayBuiltin = ArrayBuiltin::None;
     };
 
     struct ObjectInstantiationNode : public ASTNode
@@ -335,7 +383,36 @@ namespace Arcanelab::Mano
         {
         }
 
-        std::string name;
-        std::vector<ASTNodePtr> arguments;
+        std::string_view name;
+        std::span<ASTNodePtr> arguments;
     };
 } // namespace Arcanelab::Mano
+
+// Every concrete node as X(ASTType enumerator, node struct), in ASTType order.
+// The visitor dispatch in ASTVisitor.h is generated from this list.
+#define MANO_AST_NODES(X) \
+    X(Program, ProgramNode) \
+    X(Type, TypeNode) \
+    X(VariableDeclaration, VariableDeclarationNode) \
+    X(FunctionDeclaration, FunctionDeclarationNode) \
+    X(ClassDeclaration, ClassDeclarationNode) \
+    X(EnumDeclaration, EnumDeclarationNode) \
+    X(Block, BlockNode) \
+    X(ClassBlock, ClassBlockNode) \
+    X(ExpressionStatement, ExpressionStatementNode) \
+    X(ReturnStatement, ReturnStatementNode) \
+    X(IfStatement, IfStatementNode) \
+    X(ForStatement, ForStatementNode) \
+    X(WhileStatement, WhileStatementNode) \
+    X(SwitchStatement, SwitchStatementNode) \
+    X(MemberAccess, MemberAccessNode) \
+    X(IndexAccess, IndexAccessNode) \
+    X(BinaryExpression, BinaryExpressionNode) \
+    X(UnaryExpression, UnaryExpressionNode) \
+    X(Literal, LiteralNode) \
+    X(Identifier, IdentifierNode) \
+    X(BreakStatement, BreakStatementNode) \
+    X(ContinueStatement, ContinueStatementNode) \
+    X(ArrayLiteral, ArrayLiteralNode) \
+    X(FunctionCall, FunctionCallNode) \
+    X(ObjectInstantiation, ObjectInstantiationNode)
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <AST.h>
+
+namespace Arcanelab::Mano
+{
+    // Calls visit(child) for every non-null direct child of node in source
+    // order, type annotations included. Enum values and parameter names are
+    // not nodes and are not visited.
+    template<typename F>
+    void ForEachChild(ASTNode* node, F&& visit)
+    {
+        auto each = [&](ASTNode* child) { if (child) visit(child); };
+        switch (node->nodeType)
+        {
+            case ASTType::Program:
+                for (ASTNode* declaration : static_cast<ProgramNode*>(node)->declarations)
+                    each(declaration);
+                break;
+            case ASTType::VariableDeclaration:
+            {
+                auto* variable = static_cast<VariableDeclarationNode*>(node);
+                each(variable->declaredType);
+                each(variable->initializer);
+                break;
+            }
+            case ASTType::FunctionDeclaration:
+            {
+                auto* function = static_cast<FunctionDeclarationNode*>(node);
+                for (auto& parameter : function->parameters)
+                    each(parameter.type);
+                each(function->returnType);
+                each(function->body);
+                break;
+            }
+            case ASTType::ClassDeclaration:
+                each(static_cast<ClassDeclarationNode*>(node)->body);
+                break;
+            case ASTType::Block:
+                for (ASTNode* statement : static_cast<BlockNode*>(node)->statements)
+                    each(statement);
+                break;
+            case ASTType::ClassBlock:
+                for (ASTNode* declaration : static_cast<ClassBlockNode*>(node)->declarations)
+                    each(declaration);
+                break;
+            case ASTType::ExpressionStatement:
+                each(static_cast<ExpressionStatementNode*>(node)->expression);
+                break;
+            case ASTType::ReturnStatement:
+                each(static_cast<ReturnStatementNode*>(node)->expression);
+                break;
+            case ASTType::IfStatement:
+            {
+                auto* ifStatement = static_cast<IfStatementNode*>(node);
+                each(ifStatement->condition);
+                each(ifStatement->thenBranch);
+                each(ifStatement->elseBranch);
+                break;
+            }
+            case ASTType::ForStatement:
+            {
+                auto* forStatement = static_cast<ForStatementNode*>(node);
+                each(forStatement->init);
+                each(forStatement->condition);
+                each(forStatement->update);
+                each(forStatement->body);
+                break;
+            }
+            case ASTType::WhileStatement:
+            {
+                auto* whileStatement = static_cast<WhileStatementNode*>(node);
+                each(whileStatement->condition);
+                each(whileStatement->body);
+                break;
+            }
+            case ASTType::SwitchStatement:
+            {
+                auto* switchStatement = static_cast<SwitchStatementNode*>(node);
+                each(switchStatement->expression);
+                for (auto& [caseExpression, caseBlock] : switchStatement->cases)
+                {
+                    each(caseExpression);
+                    each(caseBlock);
+                }
+                each(switchStatement->defaultCase);
+                break;
+            }
+            case ASTType::MemberAccess:
+                each(static_cast<MemberAccessNode*>(node)->object);
+                break;
+            case ASTType::IndexAccess:
+            {
+                auto* access = static_cast<IndexAccessNode*>(node);
+                each(access->object);
+                each(access->index);
+                break;
+            }
+            case ASTType::BinaryExpression:
+            {
+                auto* binary = static_cast<BinaryExpressionNode*>(node);
+                each(binary->left);
+                each(binary->right);
+                break;
+            }
+            case ASTType::UnaryExpression:
+                each(static_cast<UnaryExpressionNode*>(node)->operand);
+                break;
+            case ASTType::ArrayLiteral:
+                for (ASTNode* element : static_cast<ArrayLiteralNode*>(node)->elements)
+                    each(element);
+                break;
+            case ASTType::FunctionCall:
+            {
+                auto* call = static_cast<FunctionCallNode*>(node);
+                each(call->callTarget);
+                for (ASTNode* argument : call->arguments)
+                    each(argument);
+                break;
+            }
+            case ASTType::ObjectInstantiation:
+                for (ASTNode* argument : static_cast<ObjectInstantiationNode*>(node)->arguments)
+                    each(argument);
+                break;
+            case ASTType::Type:
+            case ASTType::EnumDeclaration:
+            case ASTType::Literal:
+            case ASTType::Identifier:
+            case ASTType::BreakStatement:
+            case ASTType::ContinueStatement:
+                break;
+        }
+    }
+
+    // Statically dispatched visitor. Visit switches on nodeType and calls
+    // Derived::Visit<Name>(Node*) for the concrete node; a derived class only
+    // defines the handlers it cares about, the rest walk into the children.
+    template<typename Derived>
+    class ASTVisitor
+    {
+    public:
+        void Visit(ASTNode* node)
+        {
+            switch (node->nodeType)
+            {
+#define MANO_VISIT_CASE(Name, Node) \
+                case ASTType::Name: \
+                    static_cast<Derived*>(this)->Visit##Name(static_cast<Node*>(node)); \
+                    break;
+                MANO_AST_NODES(MANO_VISIT_CASE)
+#undef MANO_VISIT_CASE
+            }
+        }
+
+        void VisitChildren(ASTNode* node)
+        {
+            ForEachChild(node, [this](ASTNode* child) { Visit(child); });
+        }
+
+#define MANO_DEFAULT_VISIT(Name, Node) \
+        void Visit##Name(Node* node) { VisitChildren(node); }
+        MANO_AST_NODES(MANO_DEFAULT_VISIT)
+#undef MANO_DEFAULT_VISIT
+    };
+} // namespace Arcanelab::Mano
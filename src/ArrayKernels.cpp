@@ -0,0 +1,521 @@
+#include <ArrayKernels.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MANO_KERNELS_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define MANO_KERNELS_AVX2 1
+#define MANO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MANO_KERNELS_NEON 1
+#endif
+
+namespace Arcanelab::Mano::Kernels
+{
+    namespace
+    {
+        constexpr size_t Lanes = 4;
+
+        double CombineLanes(const double* lane)
+        {
+            return (lane[0] + lane[2]) + (lane[1] + lane[3]);
+        }
+
+        // The scalar tail continues the lane pattern of the vector body.
+        double SumTail(double* lane, const double* values, size_t start, size_t count)
+        {
+            for (size_t i = start; i < count; i++)
+                lane[i % Lanes] += values[i];
+            return CombineLanes(lane);
+        }
+
+        double DotTail(double* lane, const double* a, const double* b, size_t start, size_t count)
+        {
+            for (size_t i = start; i < count; i++)
+                lane[i % Lanes] += a[i] * b[i];
+            return CombineLanes(lane);
+        }
+
+        // `x < m ? x : m` skips NaNs unless the first element is one, which
+        // is also what MINPD and MAXPD do with the operands in this order.
+        template<typename T>
+        T MinTail(T m, const T* values, size_t start, size_t count)
+        {
+            for (size_t i = start; i < count; i++)
+                m = values[i] < m ? values[i] : m;
+            return m;
+        }
+
+        template<typename T>
+        T MaxTail(T m, const T* values, size_t start, size_t count)
+        {
+            for (size_t i = start; i < count; i++)
+                m = values[i] > m ? values[i] : m;
+            return m;
+        }
+
+        int64_t WrapAdd(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+        int64_t WrapMul(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+
+        // Portable loops. The integer ones are also used by the vector tables
+        // where the instruction set has no 64-bit multiply or compare.
+        int64_t SumI(const int64_t* values, size_t count)
+        {
+            int64_t sum = 0;
+            for (size_t i = 0; i < count; i++)
+                sum = WrapAdd(sum, values[i]);
+            return sum;
+        }
+
+        double SumF(const double* values, size_t count)
+        {
+            double lane[Lanes] = {};
+            return SumTail(lane, values, 0, count);
+        }
+
+        int64_t DotI(const int64_t* a, const int64_t* b, size_t count)
+        {
+            int64_t sum = 0;
+            for (size_t i = 0; i < count; i++)
+                sum = WrapAdd(sum, WrapMul(a[i], b[i]));
+            return sum;
+        }
+
+        double DotF(const double* a, const double* b, size_t count)
+        {
+            double lane[Lanes] = {};
+            return DotTail(lane, a, b, 0, count);
+        }
+
+        int64_t MinI(const int64_t* values, size_t count) { return MinTail(values[0], values, 1, count); }
+        uint64_t MinU(const uint64_t* values, size_t count) { return MinTail(values[0], values, 1, count); }
+        double MinF(const double* values, size_t count) { return MinTail(values[0], values, 1, count); }
+        int64_t MaxI(const int64_t* values, size_t count) { return MaxTail(values[0], values, 1, count); }
+        uint64_t MaxU(const uint64_t* values, size_t count) { return MaxTail(values[0], values, 1, count); }
+        double MaxF(const double* values, size_t count) { return MaxTail(values[0], values, 1, count); }
+
+        void AddI(int64_t* target, const int64_t* source, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] = WrapAdd(target[i], source[i]);
+        }
+
+        void AddF(double* target, const double* source, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] += source[i];
+        }
+
+        void MulI(int64_t* target, const int64_t* source, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] = WrapMul(target[i], source[i]);
+        }
+
+        void MulF(double* target, const double* source, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] *= source[i];
+        }
+
+        void ScaleI(int64_t* target, int64_t factor, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] = WrapMul(target[i], factor);
+        }
+
+        void ScaleF(double* target, double factor, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                target[i] *= factor;
+        }
+
+        const KernelSet portable =
+        {
+            "portable",
+            SumI, SumF, DotI, DotF,
+            MinI, MinU, MinF, MaxI, MaxU, MaxF,
+            AddI, AddF, MulI, MulF, ScaleI, ScaleF,
+        };
+
+#if MANO_KERNELS_SSE2
+        // Two vectors of two lanes hold lanes 0-1 and 2-3.
+        namespace Sse2
+        {
+            double SumF(const double* values, size_t count)
+            {
+                __m128d low = _mm_setzero_pd();
+                __m128d high = _mm_setzero_pd();
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    low = _mm_add_pd(low, _mm_loadu_pd(values + i));
+                    high = _mm_add_pd(high, _mm_loadu_pd(values + i + 2));
+                }
+                double lane[Lanes];
+                _mm_storeu_pd(lane, low);
+                _mm_storeu_pd(lane + 2, high);
+                return SumTail(lane, values, i, count);
+            }
+
+            double DotF(const double* a, const double* b, size_t count)
+            {
+                __m128d low = _mm_setzero_pd();
+                __m128d high = _mm_setzero_pd();
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    low = _mm_add_pd(low, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+                    high = _mm_add_pd(high, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+                }
+                double lane[Lanes];
+                _mm_storeu_pd(lane, low);
+                _mm_storeu_pd(lane + 2, high);
+                return DotTail(lane, a, b, i, count);
+            }
+
+            int64_t SumI(const int64_t* values, size_t count)
+            {
+                __m128i sum = _mm_setzero_si128();
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    sum = _mm_add_epi64(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)));
+                int64_t lane[2];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lane), sum);
+                int64_t total = WrapAdd(lane[0], lane[1]);
+                for (; i < count; i++)
+                    total = WrapAdd(total, values[i]);
+                return total;
+            }
+
+            double MinF(const double* values, size_t count)
+            {
+                __m128d m = _mm_set1_pd(values[0]);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    m = _mm_min_pd(_mm_loadu_pd(values + i), m);
+                double lane[2];
+                _mm_storeu_pd(lane, m);
+                return MinTail(MinTail(lane[0], lane, 1, 2), values, i, count);
+            }
+
+            double MaxF(const double* values, size_t count)
+            {
+                __m128d m = _mm_set1_pd(values[0]);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    m = _mm_max_pd(_mm_loadu_pd(values + i), m);
+                double lane[2];
+                _mm_storeu_pd(lane, m);
+                return MaxTail(MaxTail(lane[0], lane, 1, 2), values, i, count);
+            }
+
+            void AddI(int64_t* target, const int64_t* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                {
+                    auto* t = reinterpret_cast<__m128i*>(target + i);
+                    _mm_storeu_si128(t, _mm_add_epi64(_mm_loadu_si128(t), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i))));
+                }
+                Kernels::AddI(target + i, source + i, count - i);
+            }
+
+            void AddF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    _mm_storeu_pd(target + i, _mm_add_pd(_mm_loadu_pd(target + i), _mm_loadu_pd(source + i)));
+                Kernels::AddF(target + i, source + i, count - i);
+            }
+
+            void MulF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    _mm_storeu_pd(target + i, _mm_mul_pd(_mm_loadu_pd(target + i), _mm_loadu_pd(source + i)));
+                Kernels::MulF(target + i, source + i, count - i);
+            }
+
+            void ScaleF(double* target, double factor, size_t count)
+            {
+                __m128d f = _mm_set1_pd(factor);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    _mm_storeu_pd(target + i, _mm_mul_pd(_mm_loadu_pd(target + i), f));
+                Kernels::ScaleF(target + i, factor, count - i);
+            }
+        }
+
+        const KernelSet sse2 =
+        {
+            "sse2",
+            Sse2::SumI, Sse2::SumF, DotI, Sse2::DotF,
+            MinI, MinU, Sse2::MinF, MaxI, MaxU, Sse2::MaxF,
+            Sse2::AddI, Sse2::AddF, MulI, Sse2::MulF, ScaleI, Sse2::ScaleF,
+        };
+#endif
+
+#if MANO_KERNELS_AVX2
+        // One vector holds all four lanes.
+        namespace Avx2
+        {
+            MANO_TARGET_AVX2 double SumF(const double* values, size_t count)
+            {
+                __m256d sum = _mm256_setzero_pd();
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    sum = _mm256_add_pd(sum, _mm256_loadu_pd(values + i));
+                double lane[Lanes];
+                _mm256_storeu_pd(lane, sum);
+                return SumTail(lane, values, i, count);
+            }
+
+            MANO_TARGET_AVX2 double DotF(const double* a, const double* b, size_t count)
+            {
+                __m256d sum = _mm256_setzero_pd();
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+                double lane[Lanes];
+                _mm256_storeu_pd(lane, sum);
+                return DotTail(lane, a, b, i, count);
+            }
+
+            MANO_TARGET_AVX2 int64_t SumI(const int64_t* values, size_t count)
+            {
+                __m256i sum = _mm256_setzero_si256();
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+                int64_t lane[Lanes];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane), sum);
+                int64_t total = WrapAdd(WrapAdd(lane[0], lane[1]), WrapAdd(lane[2], lane[3]));
+                for (; i < count; i++)
+                    total = WrapAdd(total, values[i]);
+                return total;
+            }
+
+            MANO_TARGET_AVX2 double MinF(const double* values, size_t count)
+            {
+                __m256d m = _mm256_set1_pd(values[0]);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    m = _mm256_min_pd(_mm256_loadu_pd(values + i), m);
+                double lane[Lanes];
+                _mm256_storeu_pd(lane, m);
+                return MinTail(MinTail(lane[0], lane, 1, Lanes), values, i, count);
+            }
+
+            MANO_TARGET_AVX2 double MaxF(const double* values, size_t count)
+            {
+                __m256d m = _mm256_set1_pd(values[0]);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    m = _mm256_max_pd(_mm256_loadu_pd(values + i), m);
+                double lane[Lanes];
+                _mm256_storeu_pd(lane, m);
+                return MaxTail(MaxTail(lane[0], lane, 1, Lanes), values, i, count);
+            }
+
+            // AVX2 compares 64-bit lanes as signed; flipping the sign bit
+            // orders unsigned values the same way.
+            template<bool Unsigned, bool Maximum, typename T>
+            MANO_TARGET_AVX2 T Extreme(const T* values, size_t count)
+            {
+                const __m256i bias = _mm256_set1_epi64x(Unsigned ? INT64_MIN : 0);
+                __m256i m = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(values[0])), bias);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), bias);
+                    __m256i better = Maximum ? _mm256_cmpgt_epi64(v, m) : _mm256_cmpgt_epi64(m, v);
+                    m = _mm256_blendv_epi8(m, v, better);
+                }
+                T lane[Lanes];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane), _mm256_xor_si256(m, bias));
+                T result = Maximum ? MaxTail(lane[0], lane, 1, Lanes) : MinTail(lane[0], lane, 1, Lanes);
+                return Maximum ? MaxTail(result, values, i, count) : MinTail(result, values, i, count);
+            }
+
+            MANO_TARGET_AVX2 int64_t MinI(const int64_t* values, size_t count) { return Extreme<false, false>(values, count); }
+            MANO_TARGET_AVX2 uint64_t MinU(const uint64_t* values, size_t count) { return Extreme<true, false>(values, count); }
+            MANO_TARGET_AVX2 int64_t MaxI(const int64_t* values, size_t count) { return Extreme<false, true>(values, count); }
+            MANO_TARGET_AVX2 uint64_t MaxU(const uint64_t* values, size_t count) { return Extreme<true, true>(values, count); }
+
+            MANO_TARGET_AVX2 void AddI(int64_t* target, const int64_t* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    auto* t = reinterpret_cast<__m256i*>(target + i);
+                    _mm256_storeu_si256(t, _mm256_add_epi64(_mm256_loadu_si256(t), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i))));
+                }
+                Kernels::AddI(target + i, source + i, count - i);
+            }
+
+            MANO_TARGET_AVX2 void AddF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    _mm256_storeu_pd(target + i, _mm256_add_pd(_mm256_loadu_pd(target + i), _mm256_loadu_pd(source + i)));
+                Kernels::AddF(target + i, source + i, count - i);
+            }
+
+            MANO_TARGET_AVX2 void MulF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    _mm256_storeu_pd(target + i, _mm256_mul_pd(_mm256_loadu_pd(target + i), _mm256_loadu_pd(source + i)));
+                Kernels::MulF(target + i, source + i, count - i);
+            }
+
+            MANO_TARGET_AVX2 void ScaleF(double* target, double factor, size_t count)
+            {
+                __m256d f = _mm256_set1_pd(factor);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                    _mm256_storeu_pd(target + i, _mm256_mul_pd(_mm256_loadu_pd(target + i), f));
+                Kernels::ScaleF(target + i, factor, count - i);
+            }
+        }
+
+        const KernelSet avx2 =
+        {
+            "avx2",
+            Avx2::SumI, Avx2::SumF, DotI, Avx2::DotF,
+            Avx2::MinI, Avx2::MinU, Avx2::MinF, Avx2::MaxI, Avx2::MaxU, Avx2::MaxF,
+            Avx2::AddI, Avx2::AddF, MulI, Avx2::MulF, ScaleI, Avx2::ScaleF,
+        };
+#endif
+
+#if MANO_KERNELS_NEON
+        // Two vectors of two lanes hold lanes 0-1 and 2-3. vminq/vmaxq
+        // propagate NaNs, so min and max select explicitly instead.
+        namespace Neon
+        {
+            double SumF(const double* values, size_t count)
+            {
+                float64x2_t low = vdupq_n_f64(0.0);
+                float64x2_t high = vdupq_n_f64(0.0);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    low = vaddq_f64(low, vld1q_f64(values + i));
+                    high = vaddq_f64(high, vld1q_f64(values + i + 2));
+                }
+                double lane[Lanes];
+                vst1q_f64(lane, low);
+                vst1q_f64(lane + 2, high);
+                return SumTail(lane, values, i, count);
+            }
+
+            double DotF(const double* a, const double* b, size_t count)
+            {
+                float64x2_t low = vdupq_n_f64(0.0);
+                float64x2_t high = vdupq_n_f64(0.0);
+                size_t i = 0;
+                for (; i + Lanes <= count; i += Lanes)
+                {
+                    low = vaddq_f64(low, vmulq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+                    high = vaddq_f64(high, vmulq_f64(vld1q_f64(a + i + 2), vld1q_f64(b + i + 2)));
+                }
+                double lane[Lanes];
+                vst1q_f64(lane, low);
+                vst1q_f64(lane + 2, high);
+                return DotTail(lane, a, b, i, count);
+            }
+
+            double MinF(const double* values, size_t count)
+            {
+                float64x2_t m = vdupq_n_f64(values[0]);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                {
+                    float64x2_t v = vld1q_f64(values + i);
+                    m = vbslq_f64(vcltq_f64(v, m), v, m);
+                }
+                double lane[2];
+                vst1q_f64(lane, m);
+                return MinTail(MinTail(lane[0], lane, 1, 2), values, i, count);
+            }
+
+            double MaxF(const double* values, size_t count)
+            {
+                float64x2_t m = vdupq_n_f64(values[0]);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                {
+                    float64x2_t v = vld1q_f64(values + i);
+                    m = vbslq_f64(vcgtq_f64(v, m), v, m);
+                }
+                double lane[2];
+                vst1q_f64(lane, m);
+                return MaxTail(MaxTail(lane[0], lane, 1, 2), values, i, count);
+            }
+
+            void AddF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    vst1q_f64(target + i, vaddq_f64(vld1q_f64(target + i), vld1q_f64(source + i)));
+                Kernels::AddF(target + i, source + i, count - i);
+            }
+
+            void MulF(double* target, const double* source, size_t count)
+            {
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    vst1q_f64(target + i, vmulq_f64(vld1q_f64(target + i), vld1q_f64(source + i)));
+                Kernels::MulF(target + i, source + i, count - i);
+            }
+
+            void ScaleF(double* target, double factor, size_t count)
+            {
+                float64x2_t f = vdupq_n_f64(factor);
+                size_t i = 0;
+                for (; i + 2 <= count; i += 2)
+                    vst1q_f64(target + i, vmulq_f64(vld1q_f64(target + i), f));
+                Kernels::ScaleF(target + i, factor, count - i);
+            }
+        }
+
+        const KernelSet neon =
+        {
+            "neon",
+            SumI, Neon::SumF, DotI, Neon::DotF,
+            MinI, MinU, Neon::MinF, MaxI, MaxU, Neon::MaxF,
+            AddI, Neon::AddF, MulI, Neon::MulF, ScaleI, Neon::ScaleF,
+        };
+#endif
+
+        const KernelSet& Select()
+        {
+#if MANO_KERNELS_AVX2
+            if (__builtin_cpu_supports("avx2"))
+                return avx2;
+#endif
+#if MANO_KERNELS_SSE2
+            return sse2;
+#elif MANO_KERNELS_NEON
+            return neon;
+#else
+            return portable;
+#endif
+        }
+    }
+
+    const KernelSet& Active()
+    {
+        static const KernelSet& active = Select();
+        return active;
+    }
+
+    const KernelSet& Portable()
+    {
+        return portable;
+    }
+} // namespace Arcanelab::Mano::Kernels
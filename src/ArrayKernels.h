@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Bulk operations over packed array buffers, behind the KERNEL instruction.
+// Each instruction set gets its own table; Active() picks the widest one the
+// CPU supports the first time it is called. AVX2 is detected at run time on
+// x86-64 builds, NEON is part of every AArch64 target and SSE2 of every
+// x86-64 one.
+//
+// Floating-point sums and dot products accumulate in four interleaved lanes,
+// element i going to lane i % 4, and combine them as (l0 + l2) + (l1 + l3).
+// Every table, the portable one included, uses that order, so results do not
+// depend on the machine a script runs on.
+namespace Arcanelab::Mano::Kernels
+{
+    struct KernelSet
+    {
+        std::string_view name;
+
+        // Integer kernels wrap around, so int and uint share them except
+        // where ordering matters.
+        int64_t (*SumI)(const int64_t* values, size_t count);
+        double (*SumF)(const double* values, size_t count);
+        int64_t (*DotI)(const int64_t* a, const int64_t* b, size_t count);
+        double (*DotF)(const double* a, const double* b, size_t count);
+
+        // count must not be zero.
+        int64_t (*MinI)(const int64_t* values, size_t count);
+        uint64_t (*MinU)(const uint64_t* values, size_t count);
+        double (*MinF)(const double* values, size_t count);
+        int64_t (*MaxI)(const int64_t* values, size_t count);
+        uint64_t (*MaxU)(const uint64_t* values, size_t count);
+        double (*MaxF)(const double* values, size_t count);
+
+        // In place: target[i] op= source[i], or target[i] *= factor.
+        void (*AddI)(int64_t* target, const int64_t* source, size_t count);
+        void (*AddF)(double* target, const double* source, size_t count);
+        void (*MulI)(int64_t* target, const int64_t* source, size_t count);
+        void (*MulF)(double* target, const double* source, size_t count);
+        void (*ScaleI)(int64_t* target, int64_t factor, size_t count);
+        void (*ScaleF)(double* target, double factor, size_t count);
+    };
+
+    // The table used by the VM.
+    const KernelSet& Active();
+    // Plain loops in the same order as the vector tables.
+    const KernelSet& Portable();
+} // namespace Arcanelab::Mano::Kernels
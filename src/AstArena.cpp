@@ -0,0 +1,24 @@
+#include <AstArena.h>
+
+namespace Arcanelab::Mano
+{
+    void* AstArena::AllocateSlow(size_t size, size_t alignment)
+    {
+        // Oversized requests get a dedicated block so the current one keeps serving small nodes.
+        size_t required = size + alignment;
+        if (required > blockSize / 4)
+        {
+            blocks.push_back(std::unique_ptr<std::byte[]>(new std::byte[required]));
+            bytesReserved += required;
+            auto address = reinterpret_cast<uintptr_t>(blocks.back().get());
+            uintptr_t aligned = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        blocks.push_back(std::unique_ptr<std::byte[]>(new std::byte[blockSize]));
+        bytesReserved += blockSize;
+        cursor = blocks.back().get();
+        end = cursor + blockSize;
+        return Allocate(size, alignment);
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Bump allocator that owns every AST node of one compilation unit.
+    // Nodes are released all at once when the arena goes away; their
+    // destructors never run, so nodes only hold spans, string views and
+    // raw pointers into the arena or the source text.
+    class AstArena
+    {
+    public:
+        explicit AstArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+        AstArena(const AstArena&) = delete;
+        AstArena& operator=(const AstArena&) = delete;
+
+        void* Allocate(size_t size, size_t alignment)
+        {
+            auto address = reinterpret_cast<uintptr_t>(cursor);
+            uintptr_t aligned = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            if (aligned + size > reinterpret_cast<uintptr_t>(end))
+                return AllocateSlow(size, alignment);
+            cursor = reinterpret_cast<std::byte*>(aligned + size);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        template<typename T, typename... Args>
+        T* New(Args&&... args)
+        {
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        std::span<T> CopyArray(const std::vector<T>& items)
+        {
+            if (items.empty())
+                return {};
+            T* data = static_cast<T*>(Allocate(sizeof(T) * items.size(), alignof(T)));
+            std::uninitialized_copy(items.begin(), items.end(), data);
+            return { data, items.size() };
+        }
+
+        std::string_view CopyString(std::string_view text)
+        {
+            if (text.empty())
+                return {};
+            char* data = static_cast<char*>(Allocate(text.size(), 1));
+            std::memcpy(data, text.data(), text.size());
+            return { data, text.size() };
+        }
+
+        // Takes over the blocks of other, which keep their addresses, so that
+        // work done in an arena of its own can hand its nodes to this one.
+        void Adopt(AstArena& other)
+        {
+            for (auto& block : other.blocks)
+                blocks.push_back(std::move(block));
+            bytesReserved += other.bytesReserved;
+            other.blocks.clear();
+            other.cursor = other.end = nullptr;
+            other.bytesReserved = 0;
+        }
+
+        size_t BytesReserved() const { return bytesReserved; }
+
+    private:
+        size_t blockSize;
+        std::byte* cursor = nullptr;
+        std::byte* end = nullptr;
+        size_t bytesReserved = 0;
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+
+        void* AllocateSlow(size_t size, size_t alignment);
+    };
+} // namespace Arcanelab::Mano
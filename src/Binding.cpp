@@ -0,0 +1,37 @@
+#include <Binding.h>
+
+#include <stdexcept>
+
+namespace Arcanelab::Mano
+{
+    int32_t Binding::Find(std::string_view name) const
+    {
+        auto it = indices.find(std::string(name));
+        return it != indices.end() ? static_cast<int32_t>(it->second) : -1;
+    }
+
+    Binding& Binding::Add(std::string name, HostTrampoline trampoline, void* context,
+        std::vector<std::string_view> parameterTypes, std::string_view returnType)
+    {
+        if (Find(name) >= 0)
+            throw std::invalid_argument("Host function '" + name + "' is registered twice");
+        if (functions.size() > UINT16_MAX)
+            throw std::length_error("Too many host functions");
+
+        std::string signature = name + "(";
+        for (size_t i = 0; i < parameterTypes.size(); i++)
+        {
+            if (i > 0)
+                signature += ',';
+            signature += parameterTypes[i];
+        }
+        signature += "):";
+        signature += returnType;
+
+        uint32_t index = static_cast<uint32_t>(functions.size());
+        indices.emplace(name, index);
+        functions.push_back(HostFunction{ std::move(name), index, std::move(parameterTypes), returnType,
+            std::move(signature), trampoline, context });
+        return *this;
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <VM.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Reads arguments out of the caller's registers, starting at the first
+    // one, and writes the result over it.
+    using HostTrampoline = void (*)(Value* registers, void* context, VM& vm);
+
+    struct HostFunction
+    {
+        std::string name;
+        uint32_t index;                                 // In the binding, the Bx operand of CALLH
+        std::vector<std::string_view> parameterTypes;   // Mano type names
+        std::string_view returnType;
+        std::string signature;                          // name(int,string):float, matched when a module loads
+        HostTrampoline trampoline;
+        void* context;                                  // The instance of a bound method, null for functions
+    };
+
+    namespace Detail
+    {
+        // How a C++ parameter or result type travels in a register.
+        template<typename T>
+        struct HostValue
+        {
+            static_assert(sizeof(T) == 0, "Unsupported host parameter or result type");
+        };
+
+        template<typename T>
+        struct HostInteger
+        {
+            static constexpr std::string_view type = std::is_signed_v<T> ? "int" : "uint";
+            static T Read(Value value) { return static_cast<T>(std::is_signed_v<T> ? value.i : static_cast<int64_t>(value.u)); }
+            static Value Write(VM&, T value)
+            {
+                if constexpr (std::is_signed_v<T>)
+                    return Value::Int(value);
+                else
+                    return Value::UInt(value);
+            }
+        };
+
+        template<> struct HostValue<int64_t> : HostInteger<int64_t> {};
+        template<> struct HostValue<int32_t> : HostInteger<int32_t> {};
+        template<> struct HostValue<uint64_t> : HostInteger<uint64_t> {};
+        template<> struct HostValue<uint32_t> : HostInteger<uint32_t> {};
+
+        template<typename T>
+        struct HostFloat
+        {
+            static constexpr std::string_view type = "float";
+            static T Read(Value value) { return static_cast<T>(value.f); }
+            static Value Write(VM&, T value) { return Value::Float(value); }
+        };
+
+        template<> struct HostValue<double> : HostFloat<double> {};
+        template<> struct HostValue<float> : HostFloat<float> {};
+
+        template<>
+        struct HostValue<bool>
+        {
+            static constexpr std::string_view type = "bool";
+            static bool Read(Value value) { return value.AsBool(); }
+            static Value Write(VM&, bool value) { return Value::Bool(value); }
+        };
+
+        // String arguments are borrowed for the call; a returned string
+        // becomes a new script string.
+        template<>
+        struct HostValue<std::string_view>
+        {
+            static constexpr std::string_view type = "string";
+            static std::string_view Read(Value value) { return VM::StringOf(value); }
+            static Value Write(VM& vm, std::string_view value) { return vm.CreateString(value); }
+        };
+
+        template<>
+        struct HostValue<std::string>
+        {
+            static constexpr std::string_view type = "string";
+            static std::string Read(Value value) { return std::string(VM::StringOf(value)); }
+            static Value Write(VM& vm, const std::string& value) { return vm.CreateString(value); }
+        };
+
+        template<typename T>
+        using HostValueOf = HostValue<std::remove_cvref_t<T>>;
+
+        template<typename R, typename... A>
+        struct HostSignature
+        {
+            static constexpr std::string_view returnType = [] {
+                if constexpr (std::is_void_v<R>)
+                    return std::string_view("void");
+                else
+                    return HostValueOf<R>::type;
+            }();
+
+            static std::vector<std::string_view> Parameters() { return { HostValueOf<A>::type... }; }
+
+            template<typename Callee, size_t... I>
+            static void Invoke(Value* registers, [[maybe_unused]] VM& vm, Callee&& callee, std::index_sequence<I...>)
+            {
+                if constexpr (std::is_void_v<R>)
+                    callee(HostValueOf<A>::Read(registers[I])...);
+                else
+                    registers[0] = HostValueOf<R>::Write(vm, callee(HostValueOf<A>::Read(registers[I])...));
+            }
+
+            template<typename Callee>
+            static void Invoke(Value* registers, VM& vm, Callee&& callee)
+            {
+                Invoke(registers, vm, callee, std::index_sequence_for<A...>{});
+            }
+        };
+
+        // One trampoline per registered function or method; F is a constant,
+        // so the call inside is direct.
+        template<auto F, typename = decltype(F)>
+        struct HostTrampoline;
+
+        template<auto F, typename R, typename... A>
+        struct HostTrampoline<F, R (*)(A...)> : HostSignature<R, A...>
+        {
+            using Class = void;
+            static void Call(Value* registers, void*, VM& vm)
+            {
+                HostSignature<R, A...>::Invoke(registers, vm, [](auto&&... arguments) -> decltype(auto) { return F(std::forward<decltype(arguments)>(arguments)...); });
+            }
+        };
+
+        template<auto F, typename R, typename... A>
+        struct HostTrampoline<F, R (*)(A...) noexcept> : HostTrampoline<static_cast<R (*)(A...)>(F)> {};
+
+        template<auto M, typename C, typename R, typename... A>
+        struct HostMethodTrampoline : HostSignature<R, A...>
+        {
+            using Class = C;
+            static void Call(Value* registers, void* context, VM& vm)
+            {
+                C* instance = static_cast<C*>(context);
+                HostSignature<R, A...>::Invoke(registers, vm, [instance](auto&&... arguments) -> decltype(auto) { return (instance->*M)(std::forward<decltype(arguments)>(arguments)...); });
+            }
+        };
+
+        template<auto M, typename C, typename R, typename... A>
+        struct HostTrampoline<M, R (C::*)(A...)> : HostMethodTrampoline<M, C, R, A...> {};
+        template<auto M, typename C, typename R, typename... A>
+        struct HostTrampoline<M, R (C::*)(A...) const> : HostMethodTrampoline<M, const C, R, A...> {};
+        template<auto M, typename C, typename R, typename... A>
+        struct HostTrampoline<M, R (C::*)(A...) noexcept> : HostMethodTrampoline<M, C, R, A...> {};
+        template<auto M, typename C, typename R, typename... A>
+        struct HostTrampoline<M, R (C::*)(A...) const noexcept> : HostMethodTrampoline<M, const C, R, A...> {};
+    } // namespace Detail
+
+    // Host functions scripts can call by name. Each is registered with its
+    // C++ signature, from which a trampoline is generated at compile time:
+    // it reads the arguments straight out of the VM's registers, calls the
+    // function directly and writes the result back, with no boxing. The
+    // analyzer checks calls against the signature and binds them to the
+    // function's index, which the CALLH instruction carries; a script
+    // function of the same name takes precedence.
+    //
+    // int64_t and int32_t map to int, uint64_t and uint32_t to uint, double
+    // and float to float, bool to bool, and std::string_view, std::string
+    // and const std::string& to string. Results may also be void.
+    //
+    // Register everything before compiling. The analyzer and every VM using
+    // the binding keep pointers into it; it must outlive them and must not
+    // change while they are bound.
+    class Binding
+    {
+    public:
+        // A free function, or a captureless lambda converted to a function
+        // pointer at namespace scope: Function<&Foo>("Foo").
+        template<auto F>
+        Binding& Function(std::string name)
+        {
+            using Trampoline = Detail::HostTrampoline<F>;
+            static_assert(std::is_void_v<typename Trampoline::Class>, "Register methods with Method");
+            return Add(std::move(name), Trampoline::Call, nullptr, Trampoline::Parameters(), Trampoline::returnType);
+        }
+
+        // A method called on one host object: Method<&Player::Heal>("Heal", player).
+        template<auto M, typename T>
+        Binding& Method(std::string name, T& instance)
+        {
+            using Trampoline = Detail::HostTrampoline<M>;
+            static_assert(!std::is_void_v<typename Trampoline::Class>, "Register free functions with Function");
+            static_assert(std::is_convertible_v<T*, typename Trampoline::Class*>, "Instance does not match the method's class");
+            using Class = typename Trampoline::Class;
+            void* context = const_cast<std::remove_const_t<Class>*>(static_cast<Class*>(&instance));
+            return Add(std::move(name), Trampoline::Call, context, Trampoline::Parameters(), Trampoline::returnType);
+        }
+
+        const std::vector<HostFunction>& Functions() const { return functions; }
+        // -1 if no function of that name is registered.
+        int32_t Find(std::string_view name) const;
+
+    private:
+        std::vector<HostFunction> functions;
+        std::unordered_map<std::string, uint32_t> indices;
+
+        Binding& Add(std::string name, HostTrampoline trampoline, void* context,
+            std::vector<std::string_view> parameterTypes, std::string_view returnType);
+    };
+} // namespace Arcanelab::Mano
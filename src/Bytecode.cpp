@@ -0,0 +1,119 @@
+#include <Bytecode.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+namespace Arcanelab::Mano
+{
+    int32_t Module::FindFunction(std::string_view name) const
+    {
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            if (functions[i].name == name)
+                return static_cast<int32_t>(i);
+        }
+        return -1;
+    }
+
+    uint32_t LineAt(std::span<const LineStart> lines, uint32_t pc)
+    {
+        auto next = std::upper_bound(lines.begin(), lines.end(), pc,
+            [](uint32_t value, const LineStart& start) { return value < start.pc; });
+        return next == lines.begin() ? 0 : (next - 1)->line;
+    }
+
+    std::string_view OpCodeName(OpCode op)
+    {
+        static constexpr std::string_view names[] =
+        {
+#define MANO_OPCODE_NAME(name) #name,
+            MANO_OPCODES(MANO_OPCODE_NAME)
+#undef MANO_OPCODE_NAME
+        };
+        auto index = static_cast<size_t>(op);
+        return index < std::size(names) ? names[index] : "???";
+    }
+
+    std::string_view KernelName(KernelOp kernel)
+    {
+        static constexpr std::string_view names[] =
+        {
+#define MANO_KERNEL_NAME(name) #name,
+            MANO_KERNELS(MANO_KERNEL_NAME)
+#undef MANO_KERNEL_NAME
+        };
+        auto index = static_cast<size_t>(kernel);
+        return index < std::size(names) ? names[index] : "???";
+    }
+
+    void Disassemble(const FunctionProto& function, std::ostream& out)
+    {
+        out << "function " << function.name
+            << " (params: " << function.numParams
+            << ", registers: " << function.frameSize
+            << ", constants: " << function.constants.size() << ")\n";
+        if (function.refCountOps || function.elidedRefCountOps)
+        {
+            out << "  refcount ops: " << function.refCountOps << " emitted, "
+                << function.elidedRefCountOps << " elided\n";
+        }
+
+        auto line = function.lines.begin();
+        for (size_t pc = 0; pc < function.code.size(); pc++)
+        {
+            if (line != function.lines.end() && line->pc == pc)
+                out << "  ; line " << (line++)->line << "\n";
+            Instruction i = function.code[pc];
+            OpCode op = GetOp(i);
+            out << "  " << std::setw(4) << pc << "  " << std::left << std::setw(8) << OpCodeName(op) << std::right;
+            switch (op)
+            {
+                case OpCode::LOADK:
+                case OpCode::LOADS:
+                case OpCode::GETG:
+                case OpCode::SETG:
+                case OpCode::SETG_R:
+                case OpCode::NEW:
+                case OpCode::JTAB:
+                case OpCode::CALL:
+                case OpCode::CALLH:
+                    out << GetA(i) << ", " << GetBx(i);
+                    break;
+                case OpCode::LOADI:
+                    out << GetA(i) << ", " << GetSBx(i);
+                    break;
+                case OpCode::JMPF:
+                case OpCode::JMPT:
+                    out << GetA(i) << ", -> " << static_cast<int64_t>(pc) + 1 + GetSBx(i);
+                    break;
+                case OpCode::JMP:
+                    out << "-> " << static_cast<int64_t>(pc) + 1 + GetSJ(i);
+                    break;
+                case OpCode::MOVE:
+                case OpCode::LOADB:
+                case OpCode::NEG_I:
+                case OpCode::NEG_F:
+                case OpCode::NOT:
+                case OpCode::LEN:
+                case OpCode::PUSH:
+                    out << GetA(i) << ", " << GetB(i);
+                    break;
+                case OpCode::RET:
+                case OpCode::RETAIN:
+                case OpCode::RELEASE:
+                    out << GetA(i);
+                    break;
+                case OpCode::KERNEL:
+                    out << GetA(i) << ", " << GetB(i) << ", " << KernelName(static_cast<KernelOp>(GetC(i)));
+                    break;
+                case OpCode::RET0:
+                    break;
+                default:
+                    out << GetA(i) << ", " << GetB(i) << ", " << GetC(i);
+                    break;
+            }
+            out << "\n";
+        }
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Register-based instruction set. Every instruction is 32 bits wide:
+    //
+    //   [ op:8 | A:8 | B:8 | C:8 ]     ABC format
+    //   [ op:8 | A:8 | Bx:16     ]     ABx format (sBx when signed)
+    //   [ op:8 | sJ:24           ]     jump format
+    //
+    // Opcodes are typed: the analyzer has already proven the operand types,
+    // so the interpreter never inspects a runtime tag.
+#define MANO_OPCODES(X)                                             \
+    X(MOVE)     /* R[A] = R[B]                                  */  \
+    X(LOADK)    /* R[A] = K[Bx]                                 */  \
+    X(LOADI)    /* R[A].i = sBx                                 */  \
+    X(LOADB)    /* R[A] = bool(B)                               */  \
+    X(LOADS)    /* R[A] = S[Bx], borrowed from the VM           */  \
+    X(GETG)     /* R[A] = G[Bx]                                 */  \
+    X(SETG)     /* G[Bx] = R[A]                                 */  \
+    X(SETG_R)   /* G[Bx] = R[A], releasing the old reference    */  \
+    X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I) X(MOD_I)                    \
+    X(ADD_U) X(SUB_U) X(MUL_U) X(DIV_U) X(MOD_U)                    \
+    X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F) X(MOD_F)                    \
+    X(BAND) X(BOR) X(BXOR) X(SHL) X(SHR_I) X(SHR_U)                 \
+    X(NEG_I) X(NEG_F) X(NOT)                                        \
+    X(EQ_I) X(NE_I) X(LT_I) X(LE_I) X(LT_U) X(LE_U)                 \
+    X(EQ_F) X(NE_F) X(LT_F) X(LE_F) X(EQ_B) X(NE_B)                 \
+    X(EQ_S) X(NE_S)                                                 \
+    X(CONCAT)   /* R[A] = R[B] + R[B+1] + ... + R[B+C-1]        */  \
+    X(JMP)      /* ip += sJ                                     */  \
+    X(JMPF)     /* if (!R[A]) ip += sBx                         */  \
+    X(JMPT)     /* if (R[A]) ip += sBx                          */  \
+    X(JTAB)     /* ip += R[A].u < Bx ? R[A].u : Bx, then a JMP  */  \
+    X(NEW)      /* R[A] = new instance of class Bx              */  \
+    X(GETF)     /* R[A] = R[B].fields[8 * C]                    */  \
+    X(SETF)     /* R[A].fields[8 * C] = R[B]                    */  \
+    X(SETF_R)   /* SETF, releasing the old reference            */  \
+    X(GETF_B)   /* R[A] = R[B].fields[C], one byte              */  \
+    X(SETF_B)   /* R[A].fields[C] = R[B], one byte              */  \
+    X(NEWA)     /* R[A] = new array of element kind B, room C   */  \
+    X(LEN)      /* R[A].u = length of R[B], 0 if null           */  \
+    X(PUSH)     /* append R[B] to R[A], growing by doubling     */  \
+    X(GETA)     /* R[A] = R[B][R[C]], words                     */  \
+    X(GETA_B)   /* R[A] = R[B][R[C]], bytes                     */  \
+    X(GETA_N)   /* GETA with the bounds check proven away       */  \
+    X(SETA)     /* R[A][R[B]] = R[C], words                     */  \
+    X(SETA_B)   /* R[A][R[B]] = R[C], bytes                     */  \
+    X(SETA_R)   /* SETA, releasing the old reference            */  \
+    X(SETA_N)   /* SETA with the bounds check proven away       */  \
+    X(KERNEL)   /* R[A] = kernel C over R[B], R[B+1], ...       */  \
+    X(RETAIN)   /* R[A].refCount++, unless null                 */  \
+    X(RELEASE)  /* R[A].refCount--, freed at zero, unless null  */  \
+    X(CALL)     /* R[A] = F[Bx](R[A], R[A+1], ...)              */  \
+    X(CALLH)    /* R[A] = H[Bx](R[A], R[A+1], ...), host        */  \
+    X(RET)      /* return R[A]                                  */  \
+    X(RET0)     /* return                                       */
+
+    enum class OpCode : uint8_t
+    {
+#define MANO_OPCODE_ENUM(name) name,
+        MANO_OPCODES(MANO_OPCODE_ENUM)
+#undef MANO_OPCODE_ENUM
+        Count
+    };
+
+    // Builtin array kernels, the C operand of KERNEL, specialized by element
+    // type: _I for int and uint where wrapping makes them agree, _U and _F
+    // for uint and float, _W and _B for any word or byte element.
+#define MANO_KERNELS(X)                                             \
+    X(SUM_I) X(SUM_F) X(DOT_I) X(DOT_F)                             \
+    X(MIN_I) X(MIN_U) X(MIN_F) X(MAX_I) X(MAX_U) X(MAX_F)           \
+    X(ADD_I) X(ADD_F) X(MUL_I) X(MUL_F) X(SCALE_I) X(SCALE_F)       \
+    X(FILL_W) X(FILL_B) X(COPY_W) X(COPY_B)
+
+    enum class KernelOp : uint8_t
+    {
+#define MANO_KERNEL_ENUM(name) name,
+        MANO_KERNELS(MANO_KERNEL_ENUM)
+#undef MANO_KERNEL_ENUM
+        Count
+    };
+
+    using Instruction = uint32_t;
+
+    constexpr uint32_t MaxRegisters = 256;
+    constexpr int32_t MaxSBx = INT16_MAX;
+    constexpr int32_t MinSBx = INT16_MIN;
+    constexpr int32_t MaxSJ = (1 << 23) - 1;
+    constexpr int32_t MinSJ = -(1 << 23);
+
+    constexpr Instruction EncodeABC(OpCode op, uint32_t a, uint32_t b, uint32_t c)
+    {
+        return static_cast<uint32_t>(op) | (a << 8) | (b << 16) | (c << 24);
+    }
+
+    constexpr Instruction EncodeABx(OpCode op, uint32_t a, uint32_t bx)
+    {
+        return static_cast<uint32_t>(op) | (a << 8) | (bx << 16);
+    }
+
+    constexpr Instruction EncodeAsBx(OpCode op, uint32_t a, int32_t sbx)
+    {
+        return EncodeABx(op, a, static_cast<uint16_t>(static_cast<int16_t>(sbx)));
+    }
+
+    constexpr Instruction EncodesJ(OpCode op, int32_t sj)
+    {
+        return static_cast<uint32_t>(op) | (static_cast<uint32_t>(sj) << 8);
+    }
+
+    constexpr OpCode GetOp(Instruction i) { return static_cast<OpCode>(i & 0xFF); }
+    constexpr uint32_t GetA(Instruction i) { return (i >> 8) & 0xFF; }
+    constexpr uint32_t GetB(Instruction i) { return (i >> 16) & 0xFF; }
+    constexpr uint32_t GetC(Instruction i) { return i >> 24; }
+    constexpr uint32_t GetBx(Instruction i) { return i >> 16; }
+    constexpr int32_t GetSBx(Instruction i) { return static_cast<int16_t>(i >> 16); }
+    constexpr int32_t GetSJ(Instruction i) { return static_cast<int32_t>(i) >> 8; }
+
+    struct Object;
+
+    // Strings and arrays are objects of these pseudo class indices, so
+    // Module::classes never needs an entry for them. Only the elements of
+    // a ReferenceArrayClass array are released with it.
+    constexpr uint32_t StringClass = UINT32_MAX;
+    constexpr uint32_t ArrayClass = UINT32_MAX - 1;
+    constexpr uint32_t ReferenceArrayClass = UINT32_MAX - 2;
+
+    // Array element storage: bools take a byte, every other primitive a
+    // packed 8-byte word, and references an Object pointer.
+    enum class ArrayElement : uint8_t { Word, Byte, Reference };
+
+    // FNV-1a. Zero is reserved for a hash that has not been computed yet.
+    constexpr uint32_t HashString(std::string_view text)
+    {
+        uint32_t hash = 2166136261u;
+        for (char c : text)
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        return hash ? hash : 1;
+    }
+
+    // A register. Booleans are stored in `u` as 0 or 1; a null object
+    // reference is all zero bits.
+    union Value
+    {
+        int64_t i;
+        uint64_t u;
+        double f;
+        Object* o;
+
+        static Value Int(int64_t v) { Value r; r.i = v; return r; }
+        static Value UInt(uint64_t v) { Value r; r.u = v; return r; }
+        static Value Float(double v) { Value r; r.f = v; return r; }
+        static Value Bool(bool v) { Value r; r.u = v ? 1 : 0; return r; }
+        bool AsBool() const { return u != 0; }
+    };
+
+    static_assert(sizeof(Value) == 8);
+
+    // First instruction compiled from a source line. A function's line
+    // table lists them in code order, and each covers the instructions up to
+    // the next one.
+    struct LineStart
+    {
+        uint32_t pc;
+        uint32_t line;
+    };
+
+    // Source line of the instruction at pc, or 0 if the table has none.
+    uint32_t LineAt(std::span<const LineStart> lines, uint32_t pc);
+
+    struct FunctionProto
+    {
+        std::string name;
+        std::vector<Instruction> code;
+        std::vector<Value> constants;
+        std::vector<LineStart> lines;
+        uint32_t line = 0;        // Of the declaration; 0 for generated functions
+        uint32_t numParams = 0;
+        uint32_t frameSize = 0;   // Registers used by the function, parameters included
+        bool returnsValue = false;
+        // Reference count instructions in the code, and the ones a naive
+        // count on every copy would have needed on top of them.
+        uint32_t refCountOps = 0;
+        uint32_t elidedRefCountOps = 0;
+    };
+
+    // Field storage size and method table of a class. Methods are called
+    // directly by function index; the table maps the analyzer's method
+    // indices to functions for hosts that look methods up.
+    struct ClassInfo
+    {
+        std::string name;
+        uint32_t instanceSize = 0;
+        std::vector<uint32_t> methods;
+        std::vector<uint32_t> referenceFields;  // Word offsets of fields released with the instance
+    };
+
+    // String constant pool entry. Literals with the same text share one
+    // entry across the whole module.
+    struct StringConstant
+    {
+        std::string text;
+        uint32_t hash = 0;
+    };
+
+    // A host function the code calls, by its index in the Binding the
+    // module was compiled against. Loading checks the signature against
+    // the VM's binding.
+    struct HostImport
+    {
+        uint32_t index = 0;
+        std::string signature;
+    };
+
+    struct Module
+    {
+        std::vector<FunctionProto> functions;
+        std::vector<ClassInfo> classes;
+        std::vector<StringConstant> strings;
+        std::vector<HostImport> hostImports;
+        uint32_t globalCount = 0;
+        int32_t initFunction = -1; // Runs global initializers, -1 if there are none
+
+        int32_t FindFunction(std::string_view name) const;
+    };
+
+    std::string_view OpCodeName(OpCode op);
+    std::string_view KernelName(KernelOp kernel);
+    void Disassemble(const FunctionProto& function, std::ostream& out);
+} // namespace Arcanelab::Mano
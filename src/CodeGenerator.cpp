@@ -0,0 +1,1771 @@
+#include <CodeGenerator.h>
+#include <Binding.h>
+#include <SemanticAnalyzer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        struct CodeGenError : std::runtime_error
+        {
+            using std::runtime_error::runtime_error;
+        };
+
+        // Switch lowering: at least MinJumpTableLabels labels that fill half
+        // or more of their value range get a jump table, up to
+        // MaxLinearLabels are compared one by one, and anything else is
+        // split in two around its middle label.
+        constexpr size_t MinJumpTableLabels = 4;
+        constexpr size_t MaxLinearLabels = 3;
+    }
+
+    CodeGenerator::CodeGenerator(ErrorReporter& errorReporter)
+        : errorReporter(errorReporter)
+    {
+    }
+
+    std::unique_ptr<Module> CodeGenerator::Generate(ASTNode* root)
+    {
+        module = std::make_unique<Module>();
+        auto* program = static_cast<ProgramNode*>(root);
+        DeclareProgram(program);
+
+        try
+        {
+            CompileGlobalInitializers(program);
+        }
+        catch (const CodeGenError& error)
+        {
+            errorReporter.Report(0, 0, error.what());
+        }
+        CompilePending(nullptr);
+
+        if (errorReporter.HasErrors())
+            return nullptr;
+        return std::move(module);
+    }
+
+    std::unique_ptr<Module> CodeGenerator::Regenerate(ASTNode* root, const Module& previous, std::span<ASTNode* const> changed)
+    {
+        module = std::make_unique<Module>();
+        DeclareProgram(static_cast<ProgramNode*>(root));
+
+        // Declaring the same program numbers everything the same way; the
+        // global initializer came last.
+        size_t declared = module->functions.size();
+        bool sameLayout = module->globalCount == previous.globalCount
+            && module->classes.size() == previous.classes.size()
+            && previous.functions.size() == declared + (previous.initFunction >= 0 ? 1 : 0)
+            && (previous.initFunction < 0 || static_cast<size_t>(previous.initFunction) == declared);
+        for (size_t i = 0; sameLayout && i < declared; i++)
+            sameLayout = module->functions[i].name == previous.functions[i].name;
+        for (size_t i = 0; sameLayout && i < module->classes.size(); i++)
+            sameLayout = module->classes[i].instanceSize == previous.classes[i].instanceSize;
+        if (!sameLayout)
+        {
+            errorReporter.Report(0, 0, "Program layout differs from the previous module");
+            return nullptr;
+        }
+
+        module->functions = previous.functions;
+        module->strings = previous.strings;
+        module->hostImports = previous.hostImports;
+        module->initFunction = previous.initFunction;
+        for (size_t i = 0; i < module->strings.size(); i++)
+            stringIndices.emplace(module->strings[i].text, static_cast<uint32_t>(i));
+        for (const HostImport& import : module->hostImports)
+            hostImports.insert(import.index);
+
+        std::unordered_set<const ASTNode*> changedSet(changed.begin(), changed.end());
+        CompilePending(&changedSet);
+
+        if (errorReporter.HasErrors())
+            return nullptr;
+        return std::move(module);
+    }
+
+    // Assigns storage to every global and numbers every function and class
+    // up front, so declaration order does not matter.
+    void CodeGenerator::DeclareProgram(ProgramNode* program)
+    {
+        for (auto& declaration : program->declarations)
+        {
+            switch (declaration->nodeType)
+            {
+                case ASTType::VariableDeclaration:
+                {
+                    auto* variable = static_cast<VariableDeclarationNode*>(declaration);
+                    if (variable->symbol)
+                        globalIndices[variable->symbol] = module->globalCount++;
+                    break;
+                }
+                case ASTType::FunctionDeclaration:
+                    DeclareFunction(static_cast<FunctionDeclarationNode*>(declaration));
+                    break;
+                case ASTType::ClassDeclaration:
+                    DeclareClass(static_cast<ClassDeclarationNode*>(declaration));
+                    break;
+                case ASTType::EnumDeclaration:
+                    enumTypes.insert(static_cast<EnumDeclarationNode*>(declaration)->name);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        for (const auto& [name, cls] : classes)
+            CollectReferenceFields(cls);
+    }
+
+    // Compiles the declared functions and class initializers, or only the
+    // ones belonging to a changed declaration, replacing what was there.
+    void CodeGenerator::CompilePending(const std::unordered_set<const ASTNode*>* changed)
+    {
+        auto isChanged = [changed](const ASTNode* declaration, const ClassDeclarationNode* owner)
+        {
+            return !changed || changed->contains(declaration) || (owner && changed->contains(owner));
+        };
+        auto reset = [this](uint32_t index)
+        {
+            FunctionProto& proto = module->functions[index];
+            std::string name = std::move(proto.name);
+            proto = FunctionProto();
+            proto.name = std::move(name);
+        };
+        // A function kept from the previous module may have moved in its
+        // file; its lines move with the declaration. Blank lines added inside
+        // an unchanged body are not noticed.
+        auto move = [this](uint32_t index, uint32_t line)
+        {
+            FunctionProto& proto = module->functions[index];
+            if (!proto.line || !line)
+                return;
+            for (LineStart& start : proto.lines)
+                start.line = start.line + line - proto.line;
+            proto.line = line;
+        };
+
+        for (size_t i = 0; i < pendingFunctions.size(); i++)
+        {
+            FunctionDeclarationNode* function = pendingFunctions[i];
+            if (!isChanged(function, function->symbol->owner))
+            {
+                move(functionIndices.at(function->symbol), function->line);
+                continue;
+            }
+            try
+            {
+                reset(functionIndices.at(function->symbol));
+                CompileFunction(function);
+            }
+            catch (const CodeGenError& error)
+            {
+                errorReporter.Report(0, 0, error.what());
+            }
+            current = nullptr;
+        }
+        for (const ClassState* cls : pendingInitializers)
+        {
+            if (!isChanged(cls->declaration, nullptr))
+            {
+                move(static_cast<uint32_t>(cls->constructor), cls->declaration->line);
+                continue;
+            }
+            try
+            {
+                reset(static_cast<uint32_t>(cls->constructor));
+                CompileInitializerFunction(*cls);
+            }
+            catch (const CodeGenError& error)
+            {
+                errorReporter.Report(0, 0, error.what());
+            }
+            current = nullptr;
+        }
+    }
+
+    void CodeGenerator::DeclareFunction(FunctionDeclarationNode* function)
+    {
+        if (!function->symbol || functionIndices.contains(function->symbol))
+            return;
+
+        functionIndices[function->symbol] = static_cast<uint32_t>(module->functions.size());
+        std::string& name = module->functions.emplace_back().name;
+        if (const ClassDeclarationNode* owner = function->symbol->owner)
+            name = std::string(owner->name) + ".";
+        name += function->name;
+        pendingFunctions.push_back(function);
+    }
+
+    // Methods become ordinary functions that take the instance first. A
+    // class without a constructor still gets a function for its field
+    // initializers if it has any.
+    void CodeGenerator::DeclareClass(ClassDeclarationNode* cls)
+    {
+        if (!cls->symbol || classes.contains(cls->name))
+            return;
+
+        ClassState& state = classes[cls->name];
+        state.declaration = cls;
+        state.classIndex = static_cast<uint32_t>(module->classes.size());
+        ClassInfo& info = module->classes.emplace_back();
+        info.name = cls->name;
+        info.instanceSize = cls->instanceSize;
+
+        for (Symbol* method : cls->methods)
+        {
+            auto* function = static_cast<FunctionDeclarationNode*>(method->declarationSite);
+            DeclareFunction(function);
+            uint32_t index = functionIndices.at(method);
+            module->classes[state.classIndex].methods.push_back(index);
+            if (method->name == cls->name)
+                state.constructor = static_cast<int32_t>(index);
+        }
+
+        if (state.constructor >= 0 || !cls->body || cls->body->nodeType != ASTType::ClassBlock)
+            return;
+        for (ASTNode* declaration : static_cast<ClassBlockNode*>(cls->body)->declarations)
+        {
+            if (declaration->nodeType == ASTType::VariableDeclaration && static_cast<VariableDeclarationNode*>(declaration)->initializer)
+            {
+                state.constructor = static_cast<int32_t>(module->functions.size());
+                module->functions.emplace_back().name = std::string(cls->name) + ".<init>";
+                pendingInitializers.push_back(&state);
+                return;
+            }
+        }
+    }
+
+    void CodeGenerator::CompileFunction(FunctionDeclarationNode* function)
+    {
+        FunctionState state;
+        state.function = function;
+        state.self = function->symbol->owner;
+        state.functionIndex = functionIndices.at(function->symbol);
+        current = &state;
+        Proto().line = function->line;
+        MarkLine(function->line);
+
+        ValueKind returnKind = KindOf(function->returnType->resolved);
+        if (returnKind == ValueKind::Unsupported)
+            Fail("Return type '" + std::string(function->returnType->name) + "' of function '" + std::string(function->name) +
+                "' is not supported by the bytecode backend yet");
+        Proto().returnsValue = returnKind != ValueKind::Void;
+        Proto().numParams = static_cast<uint32_t>(function->parameters.size()) + (state.self ? 1 : 0);
+
+        for (const Parameter& parameter : function->parameters)
+        {
+            if (KindOf(parameter.type->resolved) == ValueKind::Unsupported)
+                Fail("Parameter type '" + std::string(parameter.type->name) + "' in function '" + std::string(function->name) +
+                    "' is not supported by the bytecode backend yet");
+        }
+        if (function->slotCount > MaxRegisters)
+            Fail("Function '" + Proto().name + "' needs more than 256 registers");
+        state.freeRegister = function->slotCount;
+        state.activeLocals = function->slotCount;
+        Proto().frameSize = function->slotCount;
+
+        // Owned parameters take a count of their own; owned locals start null
+        // so every exit can release all of them. Borrowed parameters save the
+        // pair of operations a count per copy would need.
+        uint32_t parameterCount = Proto().numParams;
+        for (uint32_t slot : function->ownedSlots)
+        {
+            if (slot < parameterCount)
+                EmitRefCount(OpCode::RETAIN, slot);
+            else
+                EmitLoadInt(slot, 0);
+        }
+        for (const Parameter& parameter : function->parameters)
+        {
+            if (parameter.symbol && parameter.symbol->isBorrowed)
+                Elide(2);
+        }
+
+        // Constructors run the field initializers before their body.
+        if (state.self && function->name == state.self->name)
+            CompileFieldInitializers(state.self);
+        if (function->body)
+            CompileStatement(function->body);
+        EmitReleaseLocals();
+        Emit(EncodeABC(OpCode::RET0, 0, 0, 0));
+    }
+
+    void CodeGenerator::CollectReferenceFields(const ClassState& cls)
+    {
+        const ClassDeclarationNode* declaration = cls.declaration;
+        if (!declaration->body || declaration->body->nodeType != ASTType::ClassBlock)
+            return;
+        for (ASTNode* member : static_cast<ClassBlockNode*>(declaration->body)->declarations)
+        {
+            if (member->nodeType != ASTType::VariableDeclaration)
+                continue;
+            const Symbol* field = static_cast<VariableDeclarationNode*>(member)->symbol;
+            if (field && IsReference(field->type))
+                module->classes[cls.classIndex].referenceFields.push_back(field->fieldOffset / 8);
+        }
+    }
+
+    void CodeGenerator::CompileFieldInitializers(const ClassDeclarationNode* cls)
+    {
+        if (!cls->body || cls->body->nodeType != ASTType::ClassBlock)
+            return;
+        for (ASTNode* declaration : static_cast<ClassBlockNode*>(cls->body)->declarations)
+        {
+            if (declaration->nodeType != ASTType::VariableDeclaration)
+                continue;
+            auto* field = static_cast<VariableDeclarationNode*>(declaration);
+            if (!field->symbol || !field->initializer)
+                continue;
+            MarkLine(field->line);
+            uint32_t saved = current->freeRegister;
+            uint32_t value = IsReference(field->symbol->type)
+                ? CompileOwned(field->initializer)
+                : CompileExpression(field->initializer);
+            EmitFieldAccess(true, value, 0, field->symbol);
+            current->freeRegister = saved;
+        }
+    }
+
+    void CodeGenerator::CompileInitializerFunction(const ClassState& cls)
+    {
+        FunctionState state;
+        state.self = cls.declaration;
+        state.functionIndex = static_cast<uint32_t>(cls.constructor);
+        state.freeRegister = 1;
+        state.activeLocals = 1;
+        current = &state;
+
+        Proto().line = cls.declaration->line;
+        Proto().numParams = 1;
+        Proto().frameSize = 1;
+        MarkLine(cls.declaration->line);
+        CompileFieldInitializers(cls.declaration);
+        Emit(EncodeABC(OpCode::RET0, 0, 0, 0));
+    }
+
+    void CodeGenerator::CompileGlobalInitializers(ProgramNode* program)
+    {
+        FunctionState state;
+        bool hasInitializers = false;
+
+        for (auto& declaration : program->declarations)
+        {
+            if (declaration->nodeType != ASTType::VariableDeclaration)
+                continue;
+
+            auto* variable = static_cast<VariableDeclarationNode*>(declaration);
+            if (KindOf(variable->resolvedType) == ValueKind::Unsupported)
+                Fail("Type '" + std::string(variable->declaredType->name) + "' of global '" + std::string(variable->name) +
+                    "' is not supported by the bytecode backend yet");
+            if (!variable->initializer)
+                continue;
+
+            if (!hasInitializers)
+            {
+                state.functionIndex = static_cast<uint32_t>(module->functions.size());
+                module->functions.emplace_back().name = "<init>";
+                module->initFunction = static_cast<int32_t>(state.functionIndex);
+                current = &state;
+                hasInitializers = true;
+            }
+            MarkLine(variable->line);
+
+            // Globals start out null, so there is nothing to release yet.
+            uint32_t value = IsReference(variable->resolvedType)
+                ? CompileOwned(variable->initializer)
+                : CompileExpression(variable->initializer);
+            Emit(EncodeABx(OpCode::SETG, value, globalIndices.at(variable->symbol)));
+            state.freeRegister = 0;
+        }
+
+        if (hasInitializers)
+            Emit(EncodeABC(OpCode::RET0, 0, 0, 0));
+        current = nullptr;
+    }
+
+    void CodeGenerator::CompileStatement(ASTNode* node)
+    {
+        // Code a compound statement emits after a nested one, like a loop's
+        // back edge, belongs to the compound statement's line again.
+        uint32_t outer = current->line;
+        MarkLine(node->line);
+        switch (node->nodeType)
+        {
+            case ASTType::Block:
+                CompileBlock(static_cast<BlockNode*>(node));
+                break;
+            case ASTType::VariableDeclaration:
+                CompileLocalVariable(static_cast<VariableDeclarationNode*>(node));
+                break;
+            case ASTType::FunctionDeclaration:
+                DeclareFunction(static_cast<FunctionDeclarationNode*>(node));
+                break;
+            case ASTType::ClassDeclaration:
+            case ASTType::EnumDeclaration:
+                break;
+            case ASTType::ExpressionStatement:
+            {
+                uint32_t saved = current->freeRegister;
+                ASTNode* expression = static_cast<ExpressionStatementNode*>(node)->expression;
+                if (expression->nodeType == ASTType::FunctionCall)
+                    CompileCall(static_cast<FunctionCallNode*>(expression), 0, false);
+                else if (expression->nodeType == ASTType::BinaryExpression &&
+                    static_cast<BinaryExpressionNode*>(expression)->op == BinaryOperator::Assign)
+                    CompileAssignment(static_cast<BinaryExpressionNode*>(expression));
+                else
+                    CompileExpression(expression);
+                current->freeRegister = saved;
+                break;
+            }
+            case ASTType::IfStatement:
+                CompileIf(static_cast<IfStatementNode*>(node));
+                break;
+            case ASTType::WhileStatement:
+                CompileWhile(static_cast<WhileStatementNode*>(node));
+                break;
+            case ASTType::ForStatement:
+                CompileFor(static_cast<ForStatementNode*>(node));
+                break;
+            case ASTType::SwitchStatement:
+                CompileSwitch(static_cast<SwitchStatementNode*>(node));
+                break;
+            case ASTType::ReturnStatement:
+                CompileReturn(static_cast<ReturnStatementNode*>(node));
+                break;
+            case ASTType::BreakStatement:
+            case ASTType::ContinueStatement:
+                CompileLoopExit(node);
+                break;
+            default:
+                Fail("Unsupported statement in function '" + Proto().name + "'");
+        }
+        MarkLine(outer);
+    }
+
+    void CodeGenerator::CompileBlock(BlockNode* block)
+    {
+        for (auto& statement : block->statements)
+        {
+            CompileStatement(statement);
+        }
+    }
+
+    void CodeGenerator::CompileLocalVariable(VariableDeclarationNode* variable)
+    {
+        if (KindOf(variable->resolvedType) == ValueKind::Unsupported)
+            Fail("Type '" + std::string(variable->declaredType->name) + "' of variable '" + std::string(variable->name) +
+                "' is not supported by the bytecode backend yet");
+
+        const Symbol* symbol = variable->symbol;
+        if (IsReference(variable->resolvedType))
+        {
+            if (variable->initializer)
+            {
+                CompileLocalStore(symbol, variable->initializer);
+            }
+            else
+            {
+                // A loop may run the declaration again; the previous value goes first.
+                EmitRefCount(OpCode::RELEASE, symbol->slot);
+                EmitLoadInt(symbol->slot, 0);
+            }
+            return;
+        }
+
+        // The slot may have held a local of an earlier sibling scope, so it is always written.
+        uint32_t reg = symbol->slot;
+        if (variable->initializer)
+            CompileExpressionInto(variable->initializer, reg);
+        else
+            EmitLoadInt(reg, 0);
+    }
+
+    void CodeGenerator::CompileIf(IfStatementNode* node)
+    {
+        uint32_t saved = current->freeRegister;
+        uint32_t condition = CompileExpression(node->condition);
+        size_t skipThen = EmitJump(OpCode::JMPF, condition);
+        current->freeRegister = saved;
+
+        CompileStatement(node->thenBranch);
+        if (node->elseBranch)
+        {
+            size_t skipElse = EmitJump(OpCode::JMP);
+            PatchJumpHere(skipThen);
+            CompileStatement(node->elseBranch);
+            PatchJumpHere(skipElse);
+        }
+        else
+        {
+            PatchJumpHere(skipThen);
+        }
+    }
+
+    void CodeGenerator::CompileWhile(WhileStatementNode* node)
+    {
+        size_t loopStart = Proto().code.size();
+        uint32_t saved = current->freeRegister;
+        uint32_t condition = CompileExpression(node->condition);
+        size_t exitJump = EmitJump(OpCode::JMPF, condition);
+        current->freeRegister = saved;
+
+        current->loops.emplace_back();
+        CompileStatement(node->body);
+        PatchJump(EmitJump(OpCode::JMP), loopStart);
+        PatchJumpHere(exitJump);
+
+        LoopContext loop = std::move(current->loops.back());
+        current->loops.pop_back();
+        for (size_t jump : loop.breakJumps)
+            PatchJumpHere(jump);
+        for (size_t jump : loop.continueJumps)
+            PatchJump(jump, loopStart);
+    }
+
+    void CodeGenerator::CompileFor(ForStatementNode* node)
+    {
+        if (node->init)
+            CompileStatement(node->init);
+
+        size_t loopStart = Proto().code.size();
+        size_t exitJump = 0;
+        bool hasCondition = node->condition != nullptr;
+        if (hasCondition)
+        {
+            uint32_t saved = current->freeRegister;
+            uint32_t condition = CompileExpression(node->condition);
+            exitJump = EmitJump(OpCode::JMPF, condition);
+            current->freeRegister = saved;
+        }
+
+        current->loops.emplace_back();
+        CompileStatement(node->body);
+
+        size_t continueTarget = Proto().code.size();
+        if (node->update)
+        {
+            uint32_t saved = current->freeRegister;
+            if (node->update->nodeType == ASTType::BinaryExpression &&
+                static_cast<BinaryExpressionNode*>(node->update)->op == BinaryOperator::Assign)
+                CompileAssignment(static_cast<BinaryExpressionNode*>(node->update));
+            else
+                CompileExpression(node->update);
+            current->freeRegister = saved;
+        }
+        PatchJump(EmitJump(OpCode::JMP), loopStart);
+        if (hasCondition)
+            PatchJumpHere(exitJump);
+
+        LoopContext loop = std::move(current->loops.back());
+        current->loops.pop_back();
+        for (size_t jump : loop.breakJumps)
+            PatchJumpHere(jump);
+        for (size_t jump : loop.continueJumps)
+            PatchJump(jump, continueTarget);
+    }
+
+    void CodeGenerator::CompileSwitch(SwitchStatementNode* node)
+    {
+        uint32_t saved = current->freeRegister;
+        uint32_t subject = CompileExpression(node->expression);
+
+        // Int, uint and enum switches whose labels are all constant dispatch
+        // on the sorted labels. Equal labels were rejected by the analyzer or
+        // the folder, so the order the cases are tested in does not matter.
+        ValueKind kind = KindOf(node->expression);
+        std::vector<SwitchLabel> labels;
+        if (kind == ValueKind::Int || kind == ValueKind::UInt || kind == ValueKind::Enum)
+        {
+            for (size_t i = 0; i < node->cases.size(); i++)
+            {
+                int64_t value = 0;
+                if (!ReadCaseLabel(node->cases[i].first, value))
+                {
+                    labels.clear();
+                    break;
+                }
+                labels.push_back({ value, static_cast<uint32_t>(i) });
+            }
+        }
+        if (labels.empty())
+        {
+            CompileSwitchChain(node, subject);
+            current->freeRegister = saved;
+            return;
+        }
+
+        const bool isUnsigned = kind == ValueKind::UInt;
+        std::stable_sort(labels.begin(), labels.end(), [isUnsigned](const SwitchLabel& a, const SwitchLabel& b)
+        {
+            return isUnsigned ? static_cast<uint64_t>(a.value) < static_cast<uint64_t>(b.value) : a.value < b.value;
+        });
+        assert(std::adjacent_find(labels.begin(), labels.end(),
+            [](const SwitchLabel& a, const SwitchLabel& b) { return a.value == b.value; }) == labels.end());
+
+        // An exhaustive enum switch holds one of its labels, so the dispatch
+        // never needs to rule the others out.
+        SwitchDispatch dispatch{ subject, isUnsigned, std::vector<std::vector<size_t>>(node->cases.size()), {} };
+        EmitSwitchDispatch(dispatch, labels, node->isExhaustive, labels.front().value, labels.back().value);
+        current->freeRegister = saved;
+
+        // Cases never fall through: each one jumps to the end after its block.
+        std::vector<size_t> endJumps;
+        for (size_t i = 0; i < node->cases.size(); i++)
+        {
+            for (size_t jump : dispatch.caseJumps[i])
+                PatchJumpHere(jump);
+            CompileStatement(node->cases[i].second);
+            if (i + 1 < node->cases.size() || node->defaultCase)
+                endJumps.push_back(EmitJump(OpCode::JMP));
+        }
+        for (size_t jump : dispatch.defaultJumps)
+            PatchJumpHere(jump);
+        if (node->defaultCase)
+            CompileStatement(node->defaultCase);
+        for (size_t jump : endJumps)
+            PatchJumpHere(jump);
+    }
+
+    // Tests the cases in source order, for float and bool subjects and for
+    // labels that are not constant.
+    void CodeGenerator::CompileSwitchChain(SwitchStatementNode* node, uint32_t subject)
+    {
+        OpCode equal;
+        switch (KindOf(node->expression))
+        {
+            case ValueKind::Int:
+            case ValueKind::UInt:
+            case ValueKind::Enum:
+                equal = OpCode::EQ_I;
+                break;
+            case ValueKind::Float:
+                equal = OpCode::EQ_F;
+                break;
+            case ValueKind::Bool:
+                equal = OpCode::EQ_B;
+                break;
+            default:
+                Fail("Unsupported switch subject type in function '" + Proto().name + "'");
+        }
+
+        std::vector<size_t> endJumps;
+        uint32_t caseBase = current->freeRegister;
+        for (auto& [caseExpression, caseBlock] : node->cases)
+        {
+            uint32_t value = CompileExpression(caseExpression);
+            uint32_t test = value < caseBase ? AllocateRegister() : value;
+            Emit(EncodeABC(equal, test, subject, value));
+            size_t nextCase = EmitJump(OpCode::JMPF, test);
+            current->freeRegister = caseBase;
+
+            CompileStatement(caseBlock);
+            endJumps.push_back(EmitJump(OpCode::JMP));
+            PatchJumpHere(nextCase);
+        }
+        if (node->defaultCase)
+            CompileStatement(node->defaultCase);
+        for (size_t jump : endJumps)
+            PatchJumpHere(jump);
+    }
+
+    // Dispatches over labels sorted in the subject's order. When bounded,
+    // the subject is known to lie in [low, high]; labels that cover that
+    // range leave nothing for the last test to rule out.
+    void CodeGenerator::EmitSwitchDispatch(SwitchDispatch& dispatch, std::span<const SwitchLabel> labels, bool bounded, int64_t low, int64_t high)
+    {
+        uint64_t range = static_cast<uint64_t>(labels.back().value) - static_cast<uint64_t>(labels.front().value);
+        if (labels.size() >= MinJumpTableLabels && range < 2 * labels.size() && range < UINT16_MAX)
+        {
+            EmitJumpTable(dispatch, labels);
+            return;
+        }
+
+        uint32_t base = current->freeRegister;
+        if (labels.size() <= MaxLinearLabels)
+        {
+            bool covered = bounded && static_cast<uint64_t>(high) - static_cast<uint64_t>(low) == labels.size() - 1;
+            size_t tested = covered ? labels.size() - 1 : labels.size();
+            for (size_t i = 0; i < tested; i++)
+            {
+                uint32_t test = AllocateRegister();
+                EmitLoadInt(test, labels[i].value);
+                Emit(EncodeABC(OpCode::EQ_I, test, dispatch.subject, test));
+                dispatch.caseJumps[labels[i].caseIndex].push_back(EmitJump(OpCode::JMPT, test));
+                current->freeRegister = base;
+            }
+            size_t miss = EmitJump(OpCode::JMP);
+            (covered ? dispatch.caseJumps[labels.back().caseIndex] : dispatch.defaultJumps).push_back(miss);
+            return;
+        }
+
+        size_t middle = labels.size() / 2;
+        int64_t pivot = labels[middle].value;
+        uint32_t test = AllocateRegister();
+        EmitLoadInt(test, pivot);
+        Emit(EncodeABC(dispatch.isUnsigned ? OpCode::LT_U : OpCode::LT_I, test, dispatch.subject, test));
+        current->freeRegister = base;
+        size_t upperHalf = EmitJump(OpCode::JMPF, test);
+        EmitSwitchDispatch(dispatch, labels.first(middle), bounded, low, static_cast<int64_t>(static_cast<uint64_t>(pivot) - 1));
+        PatchJumpHere(upperHalf);
+        EmitSwitchDispatch(dispatch, labels.subspan(middle), bounded, pivot, high);
+    }
+
+    // The table is indexed from the lowest label. Values in between that no
+    // case names go to the default, and so does anything out of range.
+    void CodeGenerator::EmitJumpTable(SwitchDispatch& dispatch, std::span<const SwitchLabel> labels)
+    {
+        uint32_t base = current->freeRegister;
+        int64_t low = labels.front().value;
+        uint32_t index = dispatch.subject;
+        if (low != 0)
+        {
+            index = AllocateRegister();
+            EmitLoadInt(index, low);
+            Emit(EncodeABC(OpCode::SUB_I, index, dispatch.subject, index));
+        }
+        uint64_t size = static_cast<uint64_t>(labels.back().value) - static_cast<uint64_t>(low) + 1;
+        Emit(EncodeABx(OpCode::JTAB, index, static_cast<uint32_t>(size)));
+        current->freeRegister = base;
+
+        auto label = labels.begin();
+        for (uint64_t entry = 0; entry < size; entry++)
+        {
+            size_t jump = EmitJump(OpCode::JMP);
+            if (static_cast<uint64_t>(label->value) - static_cast<uint64_t>(low) == entry)
+                dispatch.caseJumps[(label++)->caseIndex].push_back(jump);
+            else
+                dispatch.defaultJumps.push_back(jump);
+        }
+        dispatch.defaultJumps.push_back(EmitJump(OpCode::JMP));
+    }
+
+    // Folded labels are literals; enum members stay member accesses.
+    bool CodeGenerator::ReadCaseLabel(ASTNode* label, int64_t& value) const
+    {
+        if (label->nodeType == ASTType::MemberAccess)
+        {
+            auto* access = static_cast<MemberAccessNode*>(label);
+            if (!access->memberSymbol || access->memberSymbol->kind != Symbol::Kind::Enum)
+                return false;
+            auto* enumeration = static_cast<EnumDeclarationNode*>(access->memberSymbol->declarationSite);
+            value = EnumOrdinal(access);
+            return value < static_cast<int64_t>(enumeration->values.size());
+        }
+        if (label->nodeType != ASTType::Literal)
+            return false;
+
+        std::string_view text = static_cast<LiteralNode*>(label)->value;
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+        switch (KindOf(label))
+        {
+            case ValueKind::Int:
+                return std::from_chars(first, last, value).ec == std::errc();
+            case ValueKind::UInt:
+            {
+                uint64_t bits = 0;
+                if (std::from_chars(first, last, bits).ec != std::errc())
+                    return false;
+                value = static_cast<int64_t>(bits);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void CodeGenerator::CompileReturn(ReturnStatementNode* node)
+    {
+        if (!node->expression)
+        {
+            EmitReleaseLocals();
+            Emit(EncodeABC(OpCode::RET0, 0, 0, 0));
+            return;
+        }
+
+        // The caller receives an owned reference. Returning an owned local
+        // hands its count over instead of taking a new one and dropping the old.
+        uint32_t saved = current->freeRegister;
+        uint32_t value;
+        uint32_t keptSlot = MaxRegisters;
+        if (!IsReference(node->expression))
+        {
+            value = CompileExpression(node->expression);
+        }
+        else if (node->expression->nodeType == ASTType::Identifier &&
+            IsLocal(static_cast<IdentifierNode*>(node->expression)->resolvedSymbol) &&
+            !static_cast<IdentifierNode*>(node->expression)->resolvedSymbol->isBorrowed)
+        {
+            value = keptSlot = static_cast<IdentifierNode*>(node->expression)->resolvedSymbol->slot;
+            Elide(2);
+        }
+        else
+        {
+            value = CompileOwned(node->expression);
+        }
+        EmitReleaseLocals(keptSlot);
+        Emit(EncodeABC(OpCode::RET, value, 0, 0));
+        current->freeRegister = saved;
+    }
+
+    void CodeGenerator::CompileLoopExit(ASTNode* node)
+    {
+        if (current->loops.empty())
+            Fail("Loop control statement outside loop");
+
+        size_t jump = EmitJump(OpCode::JMP);
+        if (node->nodeType == ASTType::BreakStatement)
+            current->loops.back().breakJumps.push_back(jump);
+        else
+            current->loops.back().continueJumps.push_back(jump);
+    }
+
+    uint32_t CodeGenerator::CompileExpression(ASTNode* node)
+    {
+        // Locals are read in place.
+        if (node->nodeType == ASTType::Identifier)
+        {
+            const Symbol* symbol = static_cast<IdentifierNode*>(node)->resolvedSymbol;
+            if (IsLocal(symbol))
+                return symbol->slot;
+        }
+
+        uint32_t target = AllocateRegister();
+        CompileExpressionInto(node, target);
+        return target;
+    }
+
+    void CodeGenerator::CompileExpressionInto(ASTNode* node, uint32_t target)
+    {
+        uint32_t saved = current->freeRegister;
+        switch (node->nodeType)
+        {
+            case ASTType::Literal:
+                CompileLiteral(static_cast<LiteralNode*>(node), target);
+                break;
+            case ASTType::Identifier:
+                CompileIdentifier(static_cast<IdentifierNode*>(node), target);
+                break;
+            case ASTType::BinaryExpression:
+            {
+                auto* binary = static_cast<BinaryExpressionNode*>(node);
+                if (binary->op == BinaryOperator::Assign)
+                {
+                    uint32_t value = CompileAssignment(binary);
+                    if (value != target)
+                        Emit(EncodeABC(OpCode::MOVE, target, value, 0));
+                }
+                else
+                {
+                    CompileBinary(binary, target);
+                }
+                break;
+            }
+            case ASTType::UnaryExpression:
+                CompileUnary(static_cast<UnaryExpressionNode*>(node), target);
+                break;
+            case ASTType::FunctionCall:
+                CompileCall(static_cast<FunctionCallNode*>(node), target, true);
+                break;
+            case ASTType::MemberAccess:
+                CompileMemberAccess(static_cast<MemberAccessNode*>(node), target);
+                break;
+            case ASTType::IndexAccess:
+                CompileIndexAccess(static_cast<IndexAccessNode*>(node), target);
+                break;
+            case ASTType::ArrayLiteral:
+                CompileArrayLiteral(static_cast<ArrayLiteralNode*>(node), target);
+                break;
+            default:
+                Fail("Unsupported expression in function '" + Proto().name + "'");
+        }
+        current->freeRegister = saved;
+    }
+
+    void CodeGenerator::CompileLiteral(LiteralNode* literal, uint32_t target)
+    {
+        std::string_view text = literal->value;
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+
+        switch (KindOf(literal))
+        {
+            case ValueKind::Bool:
+                Emit(EncodeABC(OpCode::LOADB, target, text == "true" ? 1 : 0, 0));
+                break;
+            case ValueKind::Int:
+            {
+                int64_t value = 0;
+                if (std::from_chars(first, last, value).ec != std::errc())
+                    Fail("Integer literal out of range: " + std::string(text));
+                EmitLoadInt(target, value);
+                break;
+            }
+            case ValueKind::UInt:
+            {
+                uint64_t value = 0;
+                if (std::from_chars(first, last, value).ec != std::errc())
+                    Fail("Integer literal out of range: " + std::string(text));
+                if (value <= static_cast<uint64_t>(MaxSBx))
+                    EmitLoadInt(target, static_cast<int64_t>(value));
+                else
+                    Emit(EncodeABx(OpCode::LOADK, target, AddConstant(Value::UInt(value))));
+                break;
+            }
+            case ValueKind::Float:
+            {
+                // The text is a view into the source buffer, so it is not null terminated.
+                double value = 0.0;
+                std::from_chars(first, last, value);
+                Emit(EncodeABx(OpCode::LOADK, target, AddConstant(Value::Float(value))));
+                break;
+            }
+            case ValueKind::String:
+                Emit(EncodeABx(OpCode::LOADS, target, AddString(text.substr(1, text.size() - 2))));
+                break;
+            default:
+                Fail("Literal " + std::string(text) + " is not supported by the bytecode backend yet");
+        }
+    }
+
+    void CodeGenerator::CompileIdentifier(IdentifierNode* identifier, uint32_t target)
+    {
+        const Symbol* symbol = identifier->resolvedSymbol;
+        if (IsLocal(symbol))
+        {
+            if (symbol->slot != target)
+                Emit(EncodeABC(OpCode::MOVE, target, symbol->slot, 0));
+            return;
+        }
+        if (auto it = globalIndices.find(symbol); it != globalIndices.end())
+        {
+            Emit(EncodeABx(OpCode::GETG, target, it->second));
+            return;
+        }
+        if (IsSelfField(symbol))
+        {
+            EmitFieldAccess(false, target, 0, symbol);
+            return;
+        }
+        Fail("Identifier '" + std::string(identifier->name) + "' cannot be accessed from function '" + Proto().name + "'");
+    }
+
+    void CodeGenerator::CompileBinary(BinaryExpressionNode* expression, uint32_t target)
+    {
+        if (expression->op == BinaryOperator::LogicalAnd || expression->op == BinaryOperator::LogicalOr)
+        {
+            // The left operand is evaluated into the target before the right one
+            // runs, so never use a live local as scratch space.
+            uint32_t result = target < current->activeLocals ? AllocateRegister() : target;
+            CompileExpressionInto(expression->left, result);
+            size_t shortCircuit = EmitJump(expression->op == BinaryOperator::LogicalAnd ? OpCode::JMPF : OpCode::JMPT, result);
+            CompileExpressionInto(expression->right, result);
+            PatchJumpHere(shortCircuit);
+            if (result != target)
+                Emit(EncodeABC(OpCode::MOVE, target, result, 0));
+            return;
+        }
+
+        ValueKind kind = KindOf(expression->left);
+        if (kind == ValueKind::String && expression->op == BinaryOperator::Add)
+        {
+            CompileConcat(expression, target);
+            return;
+        }
+        uint32_t left = CompileExpression(expression->left);
+        uint32_t right = CompileExpression(expression->right);
+
+        auto pick = [&](OpCode i, OpCode u, OpCode f) -> OpCode
+        {
+            switch (kind)
+            {
+                case ValueKind::Int: return i;
+                case ValueKind::UInt: return u;
+                case ValueKind::Float: return f;
+                default: Fail("Operator is not supported for this operand type in function '" + Proto().name + "'");
+            }
+        };
+        auto pickInteger = [&](OpCode op) -> OpCode
+        {
+            if (kind != ValueKind::Int && kind != ValueKind::UInt && kind != ValueKind::Bool)
+                Fail("Bitwise operators require integer operands in function '" + Proto().name + "'");
+            return op;
+        };
+        auto pickEquality = [&](OpCode i, OpCode f, OpCode b, OpCode s) -> OpCode
+        {
+            switch (kind)
+            {
+                case ValueKind::Int:
+                case ValueKind::UInt:
+                case ValueKind::Enum:
+                case ValueKind::Object:
+                case ValueKind::Array: return i;
+                case ValueKind::Float: return f;
+                case ValueKind::Bool: return b;
+                case ValueKind::String: return s;
+                default: Fail("Equality is not supported for this operand type in function '" + Proto().name + "'");
+            }
+        };
+
+        OpCode op;
+        bool swap = false;
+        switch (expression->op)
+        {
+            case BinaryOperator::Add:          op = pick(OpCode::ADD_I, OpCode::ADD_U, OpCode::ADD_F); break;
+            case BinaryOperator::Subtract:     op = pick(OpCode::SUB_I, OpCode::SUB_U, OpCode::SUB_F); break;
+            case BinaryOperator::Multiply:     op = pick(OpCode::MUL_I, OpCode::MUL_U, OpCode::MUL_F); break;
+            case BinaryOperator::Divide:       op = pick(OpCode::DIV_I, OpCode::DIV_U, OpCode::DIV_F); break;
+            case BinaryOperator::Modulo:       op = pick(OpCode::MOD_I, OpCode::MOD_U, OpCode::MOD_F); break;
+            case BinaryOperator::BitwiseAnd:   op = pickInteger(OpCode::BAND); break;
+            case BinaryOperator::BitwiseOr:    op = pickInteger(OpCode::BOR); break;
+            case BinaryOperator::BitwiseXor:   op = pickInteger(OpCode::BXOR); break;
+            case BinaryOperator::LeftShift:    op = pickInteger(OpCode::SHL); break;
+            case BinaryOperator::RightShift:   op = pickInteger(kind == ValueKind::UInt ? OpCode::SHR_U : OpCode::SHR_I); break;
+            case BinaryOperator::Equal:        op = pickEquality(OpCode::EQ_I, OpCode::EQ_F, OpCode::EQ_B, OpCode::EQ_S); break;
+            case BinaryOperator::NotEqual:     op = pickEquality(OpCode::NE_I, OpCode::NE_F, OpCode::NE_B, OpCode::NE_S); break;
+            case BinaryOperator::Less:         op = pick(OpCode::LT_I, OpCode::LT_U, OpCode::LT_F); break;
+            case BinaryOperator::LessEqual:    op = pick(OpCode::LE_I, OpCode::LE_U, OpCode::LE_F); break;
+            case BinaryOperator::Greater:      op = pick(OpCode::LT_I, OpCode::LT_U, OpCode::LT_F); swap = true; break;
+            case BinaryOperator::GreaterEqual: op = pick(OpCode::LE_I, OpCode::LE_U, OpCode::LE_F); swap = true; break;
+            default:
+                Fail("Unsupported binary operator in function '" + Proto().name + "'");
+        }
+
+        if (swap)
+            std::swap(left, right);
+        Emit(EncodeABC(op, target, left, right));
+
+        if (ProducesOwned(expression->left))
+            EmitRefCount(OpCode::RELEASE, swap ? right : left);
+        if (ProducesOwned(expression->right))
+            EmitRefCount(OpCode::RELEASE, swap ? left : right);
+    }
+
+    // A chain like a + b + c + d becomes one CONCAT over consecutive
+    // registers, which sizes the result once instead of building N-1
+    // intermediate strings.
+    void CodeGenerator::CompileConcat(BinaryExpressionNode* expression, uint32_t target)
+    {
+        std::vector<ASTNode*> parts;
+        std::vector<ASTNode*> pending{ expression };
+        while (!pending.empty())
+        {
+            ASTNode* node = pending.back();
+            pending.pop_back();
+            auto* binary = node->nodeType == ASTType::BinaryExpression ? static_cast<BinaryExpressionNode*>(node) : nullptr;
+            if (binary && binary->op == BinaryOperator::Add && KindOf(binary->left) == ValueKind::String)
+            {
+                pending.push_back(binary->right);
+                pending.push_back(binary->left);
+            }
+            else
+            {
+                parts.push_back(node);
+            }
+        }
+        if (parts.size() > 0xFF)
+            Fail("String concatenation with more than 255 parts in function '" + Proto().name + "'");
+
+        uint32_t first = current->freeRegister;
+        for (ASTNode* part : parts)
+            CompileExpressionInto(part, AllocateRegister());
+        Emit(EncodeABC(OpCode::CONCAT, target, first, static_cast<uint32_t>(parts.size())));
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (ProducesOwned(parts[i]))
+                EmitRefCount(OpCode::RELEASE, first + static_cast<uint32_t>(i));
+        }
+    }
+
+    uint32_t CodeGenerator::CompileAssignment(BinaryExpressionNode* expression)
+    {
+        if (expression->left->nodeType == ASTType::MemberAccess)
+        {
+            auto* access = static_cast<MemberAccessNode*>(expression->left);
+            const Symbol* field = access->memberSymbol;
+            if (!field || field->kind != Symbol::Kind::Variable || !field->owner)
+                Fail("Unsupported assignment target in function '" + Proto().name + "'");
+            uint32_t object = CompileExpression(access->object);
+            uint32_t value = IsReference(field->type)
+                ? CompileOwned(expression->right)
+                : CompileExpression(expression->right);
+            EmitFieldAccess(true, value, object, field);
+            if (ProducesOwned(access->object))
+                EmitRefCount(OpCode::RELEASE, object);
+            return value;
+        }
+        if (expression->left->nodeType == ASTType::IndexAccess)
+        {
+            auto* access = static_cast<IndexAccessNode*>(expression->left);
+            uint32_t array = CompileExpression(access->object);
+            uint32_t index = CompileExpression(access->index);
+            ArrayElement element = ElementOf(access->object);
+            uint32_t value = element == ArrayElement::Reference
+                ? CompileOwned(expression->right)
+                : CompileExpression(expression->right);
+            if (element == ArrayElement::Reference)
+                EmitRefCount(OpCode::SETA_R, array, index, value);
+            else if (element == ArrayElement::Byte)
+                Emit(EncodeABC(OpCode::SETA_B, array, index, value));
+            else
+                Emit(EncodeABC(access->boundsChecked ? OpCode::SETA : OpCode::SETA_N, array, index, value));
+            if (ProducesOwned(access->object))
+                EmitRefCount(OpCode::RELEASE, array);
+            return value;
+        }
+        if (expression->left->nodeType != ASTType::Identifier)
+            Fail("Unsupported assignment target in function '" + Proto().name + "'");
+
+        auto* identifier = static_cast<IdentifierNode*>(expression->left);
+        const Symbol* symbol = identifier->resolvedSymbol;
+        bool reference = symbol && IsReference(symbol->type);
+        if (IsLocal(symbol))
+        {
+            if (reference)
+                CompileLocalStore(symbol, expression->right);
+            else
+                CompileExpressionInto(expression->right, symbol->slot);
+            return symbol->slot;
+        }
+        if (auto it = globalIndices.find(symbol); it != globalIndices.end())
+        {
+            if (!reference)
+            {
+                uint32_t value = CompileExpression(expression->right);
+                Emit(EncodeABx(OpCode::SETG, value, it->second));
+                return value;
+            }
+            uint32_t value = CompileOwned(expression->right);
+            Emit(EncodeABx(OpCode::SETG_R, value, it->second));
+            Proto().refCountOps++;
+            return value;
+        }
+        if (IsSelfField(symbol))
+        {
+            uint32_t value = reference ? CompileOwned(expression->right) : CompileExpression(expression->right);
+            EmitFieldAccess(true, value, 0, symbol);
+            return value;
+        }
+        Fail("Identifier '" + std::string(identifier->name) + "' cannot be assigned from function '" + Proto().name + "'");
+    }
+
+    void CodeGenerator::CompileUnary(UnaryExpressionNode* expression, uint32_t target)
+    {
+        uint32_t operand = CompileExpression(expression->operand);
+        if (expression->op == "!")
+        {
+            Emit(EncodeABC(OpCode::NOT, target, operand, 0));
+            return;
+        }
+
+        switch (KindOf(expression->operand))
+        {
+            case ValueKind::Int:
+            case ValueKind::UInt:
+                Emit(EncodeABC(OpCode::NEG_I, target, operand, 0));
+                break;
+            case ValueKind::Float:
+                Emit(EncodeABC(OpCode::NEG_F, target, operand, 0));
+                break;
+            default:
+                Fail("Unary '-' requires a numeric operand in function '" + Proto().name + "'");
+        }
+    }
+
+    void CodeGenerator::CompileCall(FunctionCallNode* call, uint32_t target, bool wantResult)
+    {
+        if (call->arrayMethod != ArrayMethod::None)
+        {
+            CompileArrayMethod(call, target, wantResult);
+            return;
+        }
+        if (call->arrayBuiltin != ArrayBuiltin::None)
+        {
+            CompileArrayBuiltin(call, target, wantResult);
+            return;
+        }
+
+        const Symbol* callee = call->resolvedFunction;
+        if (!callee || (callee->kind != Symbol::Kind::Function && callee->kind != Symbol::Kind::Class))
+            Fail("Call to '" + std::string(call->name) + "' is not supported by the bytecode backend yet");
+
+        // The instance of a method call is passed like a first argument.
+        std::vector<ASTNode*> passed;
+        if (call->callTarget && callee->kind == Symbol::Kind::Function)
+            passed.push_back(static_cast<MemberAccessNode*>(call->callTarget)->object);
+        passed.insert(passed.end(), call->arguments.begin(), call->arguments.end());
+
+        // Callees borrow their reference arguments, so each must outlive the
+        // call. Locals do by themselves. Owned temporaries, and references
+        // read from fields or globals that the callee could overwrite, are
+        // also kept below the callee's window and released after it returns.
+        uint32_t firstHold = current->freeRegister;
+        for (ASTNode* argument : passed)
+        {
+            if (IsReference(argument) && !IsStable(argument))
+                AllocateRegister();
+        }
+
+        // Arguments go to consecutive registers at the top of the frame;
+        // the callee's register window starts at the first one. Methods and
+        // constructors take the instance there, and a constructor leaves it
+        // in place as the result.
+        uint32_t base = current->freeRegister;
+        int64_t function = -1;
+        const HostFunction* host = callee->hostFunction;
+        if (host)
+        {
+            if (hostImports.insert(host->index).second)
+                module->hostImports.push_back({ host->index, host->signature });
+        }
+        else if (callee->kind == Symbol::Kind::Class)
+        {
+            const ClassState& cls = ClassOf(callee);
+            Emit(EncodeABx(OpCode::NEW, AllocateRegister(), cls.classIndex));
+            function = cls.constructor;
+        }
+        else
+        {
+            auto it = functionIndices.find(callee);
+            if (it == functionIndices.end())
+                Fail("Call to '" + std::string(callee->name) + "' refers to a function that is not compiled");
+            function = it->second;
+
+            if (!call->callTarget && callee->owner)
+            {
+                if (callee->owner != current->self)
+                    Fail("Method '" + std::string(callee->name) + "' cannot be called from function '" + Proto().name + "'");
+                Emit(EncodeABC(OpCode::MOVE, AllocateRegister(), 0, 0));
+                Elide(2);
+            }
+        }
+        if (function > UINT16_MAX)
+            Fail("Too many functions in module");
+
+        uint32_t hold = firstHold;
+        for (ASTNode* argument : passed)
+        {
+            uint32_t reg = AllocateRegister();
+            CompileExpressionInto(argument, reg);
+            if (!IsReference(argument))
+                continue;
+            if (IsStable(argument))
+            {
+                Elide(2);
+                continue;
+            }
+            Emit(EncodeABC(OpCode::MOVE, hold, reg, 0));
+            if (ProducesOwned(argument))
+                Elide(2);
+            else
+                EmitRefCount(OpCode::RETAIN, hold);
+            hold++;
+        }
+        if (current->freeRegister == base)
+            AllocateRegister();
+
+        if (host)
+            Emit(EncodeABx(OpCode::CALLH, base, host->index));
+        else if (function >= 0)
+            Emit(EncodeABx(OpCode::CALL, base, static_cast<uint32_t>(function)));
+        for (uint32_t reg = firstHold; reg < hold; reg++)
+            EmitRefCount(OpCode::RELEASE, reg);
+        if (!wantResult && IsReference(callee->type))
+            EmitRefCount(OpCode::RELEASE, base);
+        if (wantResult && target != base)
+            Emit(EncodeABC(OpCode::MOVE, target, base, 0));
+    }
+
+    void CodeGenerator::CompileMemberAccess(MemberAccessNode* access, uint32_t target)
+    {
+        const Symbol* member = access->memberSymbol;
+        if (member && member->kind == Symbol::Kind::Variable && member->owner)
+        {
+            // A reference read out of a temporary must survive releasing it.
+            uint32_t object = CompileExpression(access->object);
+            EmitFieldAccess(false, target, object, member);
+            if (ProducesOwned(access->object))
+            {
+                if (IsReference(member->type))
+                    EmitRefCount(OpCode::RETAIN, target);
+                EmitRefCount(OpCode::RELEASE, object);
+            }
+            return;
+        }
+
+        // Enum members compile to their ordinal.
+        if (!member || member->kind != Symbol::Kind::Enum)
+            Fail("Member access is not supported by the bytecode backend yet");
+
+        auto* enumeration = static_cast<EnumDeclarationNode*>(access->memberSymbol->declarationSite);
+        uint32_t ordinal = EnumOrdinal(access);
+        if (ordinal == enumeration->values.size())
+            Fail("Unknown enum member: " + std::string(access->memberName));
+        EmitLoadInt(target, ordinal);
+    }
+
+    // Elements are read like fields: a reference read out of a temporary
+    // array must survive releasing it.
+    void CodeGenerator::CompileIndexAccess(IndexAccessNode* access, uint32_t target)
+    {
+        uint32_t array = CompileExpression(access->object);
+        uint32_t index = CompileExpression(access->index);
+        ArrayElement element = ElementOf(access->object);
+        if (element == ArrayElement::Byte)
+            Emit(EncodeABC(OpCode::GETA_B, target, array, index));
+        else
+            Emit(EncodeABC(access->boundsChecked ? OpCode::GETA : OpCode::GETA_N, target, array, index));
+        if (ProducesOwned(access->object))
+        {
+            if (element == ArrayElement::Reference)
+                EmitRefCount(OpCode::RETAIN, target);
+            EmitRefCount(OpCode::RELEASE, array);
+        }
+    }
+
+    // The array takes over the count of each reference element.
+    void CodeGenerator::CompileArrayLiteral(ArrayLiteralNode* array, uint32_t target)
+    {
+        if (!array->evaluatedType)
+            Fail("Array literal without an element type in function '" + Proto().name + "'");
+        uint32_t capacity = static_cast<uint32_t>(std::min<size_t>(array->elements.size(), 0xFF));
+        ArrayElement element = ElementOf(array);
+        Emit(EncodeABC(OpCode::NEWA, target, static_cast<uint32_t>(element), capacity));
+        for (ASTNode* value : array->elements)
+        {
+            uint32_t saved = current->freeRegister;
+            uint32_t reg = element == ArrayElement::Reference ? CompileOwned(value) : CompileExpression(value);
+            Emit(EncodeABC(OpCode::PUSH, target, reg, 0));
+            current->freeRegister = saved;
+        }
+    }
+
+    void CodeGenerator::CompileArrayMethod(FunctionCallNode* call, uint32_t target, bool wantResult)
+    {
+        ASTNode* object = static_cast<MemberAccessNode*>(call->callTarget)->object;
+        uint32_t array = CompileExpression(object);
+        if (call->arrayMethod == ArrayMethod::Size)
+        {
+            if (wantResult)
+                Emit(EncodeABC(OpCode::LEN, target, array, 0));
+        }
+        else
+        {
+            uint32_t value = ElementOf(object) == ArrayElement::Reference
+                ? CompileOwned(call->arguments[0])
+                : CompileExpression(call->arguments[0]);
+            Emit(EncodeABC(OpCode::PUSH, array, value, 0));
+        }
+        if (ProducesOwned(object))
+            EmitRefCount(OpCode::RELEASE, array);
+    }
+
+    // The builtin is specialized here, by the element type the analyzer
+    // checked; the VM only picks the instruction set.
+    void CodeGenerator::CompileArrayBuiltin(FunctionCallNode* call, uint32_t target, bool wantResult)
+    {
+        ValueKind element = KindOf(ElementTypeOf(call->arguments[0]));
+        bool isFloat = element == ValueKind::Float;
+        bool isUInt = element == ValueKind::UInt;
+        bool isByte = element == ValueKind::Bool;
+        KernelOp kernel;
+        switch (call->arrayBuiltin)
+        {
+            case ArrayBuiltin::Sum:   kernel = isFloat ? KernelOp::SUM_F : KernelOp::SUM_I; break;
+            case ArrayBuiltin::Dot:   kernel = isFloat ? KernelOp::DOT_F : KernelOp::DOT_I; break;
+            case ArrayBuiltin::Min:   kernel = isFloat ? KernelOp::MIN_F : isUInt ? KernelOp::MIN_U : KernelOp::MIN_I; break;
+            case ArrayBuiltin::Max:   kernel = isFloat ? KernelOp::MAX_F : isUInt ? KernelOp::MAX_U : KernelOp::MAX_I; break;
+            case ArrayBuiltin::Add:   kernel = isFloat ? KernelOp::ADD_F : KernelOp::ADD_I; break;
+            case ArrayBuiltin::Mul:   kernel = isFloat ? KernelOp::MUL_F : KernelOp::MUL_I; break;
+            case ArrayBuiltin::Scale: kernel = isFloat ? KernelOp::SCALE_F : KernelOp::SCALE_I; break;
+            case ArrayBuiltin::Fill:  kernel = isByte ? KernelOp::FILL_B : KernelOp::FILL_W; break;
+            case ArrayBuiltin::Copy:  kernel = isByte ? KernelOp::COPY_B : KernelOp::COPY_W; break;
+            default: Fail("Unknown array builtin in function '" + Proto().name + "'");
+        }
+
+        uint32_t base = current->freeRegister;
+        for (ASTNode* argument : call->arguments)
+            CompileExpressionInto(argument, AllocateRegister());
+        uint32_t result = wantResult ? target : AllocateRegister();
+        Emit(EncodeABC(OpCode::KERNEL, result, base, static_cast<uint32_t>(kernel)));
+        for (size_t i = 0; i < call->arguments.size(); i++)
+        {
+            if (ProducesOwned(call->arguments[i]))
+                EmitRefCount(OpCode::RELEASE, base + static_cast<uint32_t>(i));
+        }
+    }
+
+    const Type* CodeGenerator::ElementTypeOf(ASTNode* array) const
+    {
+        const Type* type = nullptr;
+        if (array->nodeType == ASTType::ArrayLiteral)
+            type = static_cast<ArrayLiteralNode*>(array)->evaluatedType;
+        else if (array->nodeType == ASTType::Identifier)
+            type = static_cast<IdentifierNode*>(array)->evaluatedType;
+        else if (array->nodeType == ASTType::MemberAccess)
+            type = static_cast<MemberAccessNode*>(array)->evaluatedType;
+        else if (array->nodeType == ASTType::FunctionCall && static_cast<FunctionCallNode*>(array)->resolvedFunction)
+            type = static_cast<FunctionCallNode*>(array)->resolvedFunction->type;
+        return type ? type->unqualified->element : nullptr;
+    }
+
+    ArrayElement CodeGenerator::ElementOf(ASTNode* array)
+    {
+        const Type* elementType = ElementTypeOf(array);
+        ValueKind kind = elementType ? KindOf(elementType) : ValueKind::Unsupported;
+        if (kind == ValueKind::Unsupported || kind == ValueKind::Void)
+            Fail("Array element type is not supported by the bytecode backend yet");
+        if (IsReferenceKind(kind))
+            return ArrayElement::Reference;
+        return kind == ValueKind::Bool ? ArrayElement::Byte : ArrayElement::Word;
+    }
+
+    // Locals of other functions are not reachable; nested functions do not capture.
+    bool CodeGenerator::IsLocal(const Symbol* symbol) const
+    {
+        return symbol && symbol->function && symbol->function == current->function;
+    }
+
+    bool CodeGenerator::IsReferenceKind(ValueKind kind)
+    {
+        return kind == ValueKind::Object || kind == ValueKind::String || kind == ValueKind::Array;
+    }
+
+    bool CodeGenerator::IsReference(ASTNode* expression) const
+    {
+        return IsReferenceKind(KindOf(expression));
+    }
+
+    bool CodeGenerator::IsReference(const Type* type) const
+    {
+        return IsReferenceKind(KindOf(type));
+    }
+
+    // Calls, concatenations and array literals return owned references, and
+    // so does a reference field or element read out of one.
+    bool CodeGenerator::ProducesOwned(ASTNode* expression) const
+    {
+        if (!IsReference(expression))
+            return false;
+        if (expression->nodeType == ASTType::FunctionCall)
+            return true;
+        if (expression->nodeType == ASTType::BinaryExpression)
+            return static_cast<BinaryExpressionNode*>(expression)->op == BinaryOperator::Add;
+        if (expression->nodeType == ASTType::ArrayLiteral)
+            return true;
+        if (expression->nodeType == ASTType::MemberAccess)
+            return ProducesOwned(static_cast<MemberAccessNode*>(expression)->object);
+        if (expression->nodeType == ASTType::IndexAccess)
+            return ProducesOwned(static_cast<IndexAccessNode*>(expression)->object);
+        return false;
+    }
+
+    // Callees cannot reach the caller's locals, so a local keeps its object
+    // alive across any call.
+    bool CodeGenerator::IsStable(ASTNode* expression) const
+    {
+        return expression->nodeType == ASTType::Identifier && IsLocal(static_cast<IdentifierNode*>(expression)->resolvedSymbol);
+    }
+
+    uint32_t CodeGenerator::CompileOwned(ASTNode* expression)
+    {
+        uint32_t value = CompileExpression(expression);
+        if (ProducesOwned(expression))
+            Elide(2);
+        else
+            EmitRefCount(OpCode::RETAIN, value);
+        return value;
+    }
+
+    // The new value is counted before the old one is released, which keeps
+    // `x = x` and `x = x.next` safe.
+    void CodeGenerator::CompileLocalStore(const Symbol* local, ASTNode* value)
+    {
+        if (local->isBorrowed)
+        {
+            CompileExpressionInto(value, local->slot);
+            Elide(2);
+            return;
+        }
+
+        uint32_t saved = current->freeRegister;
+        uint32_t reg = CompileOwned(value);
+        EmitRefCount(OpCode::RELEASE, local->slot);
+        if (reg != local->slot)
+            Emit(EncodeABC(OpCode::MOVE, local->slot, reg, 0));
+        current->freeRegister = saved;
+    }
+
+    void CodeGenerator::EmitReleaseLocals(uint32_t keptSlot)
+    {
+        if (!current->function)
+            return;
+        for (uint32_t slot : current->function->ownedSlots)
+        {
+            if (slot != keptSlot)
+                EmitRefCount(OpCode::RELEASE, slot);
+        }
+    }
+
+    void CodeGenerator::EmitRefCount(OpCode op, uint32_t a, uint32_t b, uint32_t c)
+    {
+        Emit(EncodeABC(op, a, b, c));
+        Proto().refCountOps++;
+    }
+
+    void CodeGenerator::Elide(uint32_t count)
+    {
+        Proto().elidedRefCountOps += count;
+    }
+
+    // Fields of the instance a method runs on are reached through register 0.
+    bool CodeGenerator::IsSelfField(const Symbol* symbol) const
+    {
+        return symbol && symbol->kind == Symbol::Kind::Variable && symbol->owner && symbol->owner == current->self;
+    }
+
+    const CodeGenerator::ClassState& CodeGenerator::ClassOf(const Symbol* classSymbol)
+    {
+        auto it = classes.find(classSymbol->name);
+        if (it == classes.end())
+            Fail("Class '" + std::string(classSymbol->name) + "' is not supported by the bytecode backend yet");
+        return it->second;
+    }
+
+    CodeGenerator::ValueKind CodeGenerator::KindOf(ASTNode* expression) const
+    {
+        switch (expression->nodeType)
+        {
+            case ASTType::Literal:
+                return KindOf(static_cast<LiteralNode*>(expression)->evaluatedType);
+            case ASTType::Identifier:
+                return KindOf(static_cast<IdentifierNode*>(expression)->evaluatedType);
+            case ASTType::BinaryExpression:
+                return KindOf(static_cast<BinaryExpressionNode*>(expression)->evaluatedType);
+            case ASTType::UnaryExpression:
+            {
+                auto* unary = static_cast<UnaryExpressionNode*>(expression);
+                return unary->op == "!" ? ValueKind::Bool : KindOf(unary->operand);
+            }
+            case ASTType::FunctionCall:
+            {
+                auto* call = static_cast<FunctionCallNode*>(expression);
+                if (call->arrayMethod == ArrayMethod::Size)
+                    return ValueKind::UInt;
+                if (call->arrayMethod == ArrayMethod::Push)
+                    return ValueKind::Void;
+                if (call->arrayBuiltin != ArrayBuiltin::None)
+                {
+                    ArrayBuiltin builtin = call->arrayBuiltin;
+                    if (builtin != ArrayBuiltin::Sum && builtin != ArrayBuiltin::Min && builtin != ArrayBuiltin::Max && builtin != ArrayBuiltin::Dot)
+                        return ValueKind::Void;
+                    return KindOf(ElementTypeOf(call->arguments[0]));
+                }
+                return call->resolvedFunction ? KindOf(call->resolvedFunction->type) : ValueKind::Unsupported;
+            }
+            case ASTType::MemberAccess:
+                return KindOf(static_cast<MemberAccessNode*>(expression)->evaluatedType);
+            case ASTType::IndexAccess:
+                return KindOf(static_cast<IndexAccessNode*>(expression)->evaluatedType);
+            case ASTType::ArrayLiteral:
+                return KindOf(static_cast<ArrayLiteralNode*>(expression)->evaluatedType);
+            default:
+                return ValueKind::Unsupported;
+        }
+    }
+
+    CodeGenerator::ValueKind CodeGenerator::KindOf(const Type* type) const
+    {
+        if (!type)
+            return ValueKind::Unsupported;
+        switch (type->kind)
+        {
+            case Type::Kind::Int:
+                return ValueKind::Int;
+            case Type::Kind::UInt:
+                return ValueKind::UInt;
+            case Type::Kind::Float:
+                return ValueKind::Float;
+            case Type::Kind::Bool:
+                return ValueKind::Bool;
+            case Type::Kind::Void:
+                return ValueKind::Void;
+            case Type::Kind::String:
+                return ValueKind::String;
+            case Type::Kind::Array:
+                return ValueKind::Array;
+            case Type::Kind::Named:
+                if (enumTypes.contains(type->name))
+                    return ValueKind::Enum;
+                return classes.contains(type->name) ? ValueKind::Object : ValueKind::Unsupported;
+            default:
+                return ValueKind::Unsupported;
+        }
+    }
+
+    FunctionProto& CodeGenerator::Proto()
+    {
+        return module->functions[current->functionIndex];
+    }
+
+    // Instructions emitted from here on come from line. A line nothing was
+    // emitted for is dropped from the table.
+    void CodeGenerator::MarkLine(uint32_t line)
+    {
+        if (!line || line == current->line)
+            return;
+        current->line = line;
+        std::vector<LineStart>& lines = Proto().lines;
+        auto pc = static_cast<uint32_t>(Proto().code.size());
+        if (!lines.empty() && lines.back().pc == pc)
+            lines.pop_back();
+        if (lines.empty() || lines.back().line != line)
+            lines.push_back({ pc, line });
+    }
+
+    size_t CodeGenerator::Emit(Instruction instruction)
+    {
+        auto& code = Proto().code;
+        code.push_back(instruction);
+        return code.size() - 1;
+    }
+
+    size_t CodeGenerator::EmitJump(OpCode op, uint32_t reg)
+    {
+        return op == OpCode::JMP ? Emit(EncodesJ(op, 0)) : Emit(EncodeAsBx(op, reg, 0));
+    }
+
+    void CodeGenerator::PatchJump(size_t jump, size_t target)
+    {
+        auto& code = Proto().code;
+        int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(jump + 1);
+        Instruction instruction = code[jump];
+        OpCode op = GetOp(instruction);
+        if (op == OpCode::JMP)
+        {
+            if (offset < MinSJ || offset > MaxSJ)
+                Fail("Function '" + Proto().name + "' is too large");
+            code[jump] = EncodesJ(op, static_cast<int32_t>(offset));
+        }
+        else
+        {
+            if (offset < MinSBx || offset > MaxSBx)
+                Fail("Branch too far in function '" + Proto().name + "'");
+            code[jump] = EncodeAsBx(op, GetA(instruction), static_cast<int32_t>(offset));
+        }
+    }
+
+    void CodeGenerator::PatchJumpHere(size_t jump)
+    {
+        PatchJump(jump, Proto().code.size());
+    }
+
+    void CodeGenerator::EmitLoadInt(uint32_t target, int64_t value)
+    {
+        if (value >= MinSBx && value <= MaxSBx)
+            Emit(EncodeAsBx(OpCode::LOADI, target, static_cast<int32_t>(value)));
+        else
+            Emit(EncodeABx(OpCode::LOADK, target, AddConstant(Value::Int(value))));
+    }
+
+    // Position of the member in its enum's declaration, or the number of
+    // members if there is none by that name.
+    uint32_t CodeGenerator::EnumOrdinal(const MemberAccessNode* access)
+    {
+        auto* enumeration = static_cast<const EnumDeclarationNode*>(access->memberSymbol->declarationSite);
+        auto member = std::find(enumeration->values.begin(), enumeration->values.end(), access->memberName);
+        return static_cast<uint32_t>(member - enumeration->values.begin());
+    }
+
+    // 8-byte fields are addressed in words, bools in bytes; both fit the C operand.
+    void CodeGenerator::EmitFieldAccess(bool store, uint32_t value, uint32_t object, const Symbol* field)
+    {
+        ValueKind kind = KindOf(field->type);
+        if (kind == ValueKind::Unsupported)
+            Fail("Type of field '" + std::string(field->name) + "' is not supported by the bytecode backend yet");
+
+        bool narrow = kind == ValueKind::Bool;
+        uint32_t operand = narrow ? field->fieldOffset : field->fieldOffset / 8;
+        if (operand > 0xFF)
+            Fail("Field '" + std::string(field->name) + "' of class '" + std::string(field->owner->name) + "' is out of range");
+
+        if (store && IsReferenceKind(kind))
+            EmitRefCount(OpCode::SETF_R, object, value, operand);
+        else if (store)
+            Emit(EncodeABC(narrow ? OpCode::SETF_B : OpCode::SETF, object, value, operand));
+        else
+            Emit(EncodeABC(narrow ? OpCode::GETF_B : OpCode::GETF, value, object, operand));
+    }
+
+    uint32_t CodeGenerator::AddConstant(Value value)
+    {
+        auto& constants = Proto().constants;
+        for (size_t i = 0; i < constants.size(); i++)
+        {
+            if (constants[i].u == value.u)
+                return static_cast<uint32_t>(i);
+        }
+        if (constants.size() > UINT16_MAX)
+            Fail("Too many constants in function '" + Proto().name + "'");
+        constants.push_back(value);
+        return static_cast<uint32_t>(constants.size() - 1);
+    }
+
+    // Literals keep their quotes and escapes in the tree. The pool is shared
+    // by the whole module, so equal literals load the same string.
+    uint32_t CodeGenerator::AddString(std::string_view literal)
+    {
+        std::string text;
+        text.reserve(literal.size());
+        for (size_t i = 0; i < literal.size(); i++)
+        {
+            char c = literal[i];
+            if (c != '\\' || i + 1 == literal.size())
+            {
+                text += c;
+                continue;
+            }
+            switch (char escaped = literal[++i])
+            {
+                case 'n': text += '\n'; break;
+                case 't': text += '\t'; break;
+                case 'r': text += '\r'; break;
+                case '0': text += '\0'; break;
+                default: text += escaped; break;
+            }
+        }
+
+        auto [it, inserted] = stringIndices.try_emplace(text, static_cast<uint32_t>(module->strings.size()));
+        if (inserted)
+        {
+            if (module->strings.size() > UINT16_MAX)
+                Fail("Too many string constants in module");
+            uint32_t hash = HashString(text);
+            module->strings.push_back({ std::move(text), hash });
+        }
+        return it->second;
+    }
+
+    uint32_t CodeGenerator::AllocateRegister()
+    {
+        if (current->freeRegister >= MaxRegisters)
+            Fail("Function '" + Proto().name + "' needs more than 256 registers");
+        uint32_t reg = current->freeRegister++;
+        auto& proto = Proto();
+        if (current->freeRegister > proto.frameSize)
+            proto.frameSize = current->freeRegister;
+        return reg;
+    }
+
+    void CodeGenerator::Fail(const std::string& message)
+    {
+        throw CodeGenError(message);
+    }
+} // namespace Arcanelab::Mano
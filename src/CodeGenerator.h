@@ -0,0 +1,167 @@
+#pragma once
+
+#include <AST.h>
+#include <Bytecode.h>
+#include <ErrorReporter.h>
+
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Lowers the analyzed AST to register bytecode. Operand types come
+    // from the analyzer (evaluatedType, resolvedSymbol), so every
+    // arithmetic and comparison instruction is emitted in its typed form.
+    class CodeGenerator
+    {
+    public:
+        explicit CodeGenerator(ErrorReporter& errorReporter);
+        std::unique_ptr<Module> Generate(ASTNode* root);
+        // Compiles only the functions of the given top-level declarations,
+        // methods and field initializers of classes included, and takes
+        // every other function, the global initializer and the string pool
+        // from previous. The program must declare the same globals, classes
+        // and functions in the same order as the one previous came from.
+        std::unique_ptr<Module> Regenerate(ASTNode* root, const Module& previous, std::span<ASTNode* const> changed);
+
+    private:
+        enum class ValueKind { Int, UInt, Float, Bool, Enum, String, Object, Array, Void, Unsupported };
+
+        struct LoopContext
+        {
+            std::vector<size_t> breakJumps;
+            std::vector<size_t> continueJumps;
+        };
+
+        // A constant label of an integer or enum switch and the case it
+        // selects. Dispatch jumps to a case, or to the default when nothing
+        // matches, are collected and patched once the case bodies are laid out.
+        struct SwitchLabel
+        {
+            int64_t value;
+            uint32_t caseIndex;
+        };
+
+        struct SwitchDispatch
+        {
+            uint32_t subject;
+            bool isUnsigned;
+            std::vector<std::vector<size_t>> caseJumps;
+            std::vector<size_t> defaultJumps;
+        };
+
+        // Parameters and locals sit in the frame slots the analyzer assigned
+        // them; temporaries are allocated above the last slot.
+        struct FunctionState
+        {
+            const FunctionDeclarationNode* function = nullptr;
+            const ClassDeclarationNode* self = nullptr; // Class of the instance in register 0, methods only
+            uint32_t functionIndex = 0;
+            uint32_t freeRegister = 0;
+            uint32_t activeLocals = 0; // Registers below this hold named locals
+            std::vector<LoopContext> loops;
+            uint32_t line = 0;         // Source line of the statement being compiled
+        };
+
+        ErrorReporter& errorReporter;
+        std::unique_ptr<Module> module;
+        FunctionState* current = nullptr;
+        std::unordered_map<const Symbol*, uint32_t> functionIndices;
+        std::unordered_map<const Symbol*, uint32_t> globalIndices;
+        std::vector<FunctionDeclarationNode*> pendingFunctions;
+        std::unordered_set<std::string_view> enumTypes;
+        std::unordered_map<std::string, uint32_t> stringIndices;
+        std::unordered_set<uint32_t> hostImports;  // Binding indices already in module->hostImports
+        // Classes by name, with the function that initializes a new instance:
+        // the constructor, a generated field initializer, or none.
+        struct ClassState
+        {
+            const ClassDeclarationNode* declaration;
+            uint32_t classIndex;
+            int32_t constructor = -1;
+        };
+        std::unordered_map<std::string_view, ClassState> classes;
+        std::vector<const ClassState*> pendingInitializers;
+
+        // Declarations
+        void DeclareProgram(ProgramNode* program);
+        void CompilePending(const std::unordered_set<const ASTNode*>* changed);
+        void DeclareFunction(FunctionDeclarationNode* function);
+        void DeclareClass(ClassDeclarationNode* cls);
+        void CompileFunction(FunctionDeclarationNode* function);
+        void CompileFieldInitializers(const ClassDeclarationNode* cls);
+        void CompileInitializerFunction(const ClassState& cls);
+        void CollectReferenceFields(const ClassState& cls);
+        void CompileGlobalInitializers(ProgramNode* program);
+
+        // Statements
+        void CompileStatement(ASTNode* node);
+        void CompileBlock(BlockNode* block);
+        void CompileLocalVariable(VariableDeclarationNode* variable);
+        void CompileIf(IfStatementNode* node);
+        void CompileWhile(WhileStatementNode* node);
+        void CompileFor(ForStatementNode* node);
+        void CompileSwitch(SwitchStatementNode* node);
+        void CompileSwitchChain(SwitchStatementNode* node, uint32_t subject);
+        void EmitSwitchDispatch(SwitchDispatch& dispatch, std::span<const SwitchLabel> labels, bool bounded, int64_t low, int64_t high);
+        void EmitJumpTable(SwitchDispatch& dispatch, std::span<const SwitchLabel> labels);
+        bool ReadCaseLabel(ASTNode* label, int64_t& value) const;
+        void CompileReturn(ReturnStatementNode* node);
+        void CompileLoopExit(ASTNode* node);
+
+        // Expressions
+        uint32_t CompileExpression(ASTNode* node);
+        void CompileExpressionInto(ASTNode* node, uint32_t target);
+        void CompileLiteral(LiteralNode* literal, uint32_t target);
+        void CompileIdentifier(IdentifierNode* identifier, uint32_t target);
+        void CompileBinary(BinaryExpressionNode* expression, uint32_t target);
+        void CompileConcat(BinaryExpressionNode* expression, uint32_t target);
+        uint32_t CompileAssignment(BinaryExpressionNode* expression);
+        void CompileUnary(UnaryExpressionNode* expression, uint32_t target);
+        void CompileCall(FunctionCallNode* call, uint32_t target, bool wantResult);
+        void CompileIndexAccess(IndexAccessNode* access, uint32_t target);
+        void CompileArrayLiteral(ArrayLiteralNode* array, uint32_t target);
+        void CompileArrayMethod(FunctionCallNode* call, uint32_t target, bool wantResult);
+        void CompileArrayBuiltin(FunctionCallNode* call, uint32_t target, bool wantResult);
+        void CompileMemberAccess(MemberAccessNode* access, uint32_t target);
+
+        // Reference counting. An owned value carries a count the consumer
+        // takes over; a borrowed one is kept alive by whatever it was read from.
+        static bool IsReferenceKind(ValueKind kind);
+        bool IsReference(ASTNode* expression) const;
+        bool IsReference(const Type* type) const;
+        bool ProducesOwned(ASTNode* expression) const;
+        bool IsStable(ASTNode* expression) const;
+        uint32_t CompileOwned(ASTNode* expression);
+        void CompileLocalStore(const Symbol* local, ASTNode* value);
+        void EmitReleaseLocals(uint32_t keptSlot = MaxRegisters);
+        void EmitRefCount(OpCode op, uint32_t a, uint32_t b = 0, uint32_t c = 0);
+        void Elide(uint32_t count);
+
+        // Helpers
+        bool IsLocal(const Symbol* symbol) const;
+        bool IsSelfField(const Symbol* symbol) const;
+        const ClassState& ClassOf(const Symbol* classSymbol);
+        ValueKind KindOf(ASTNode* expression) const;
+        ValueKind KindOf(const Type* type) const;
+        const Type* ElementTypeOf(ASTNode* array) const;
+        ArrayElement ElementOf(ASTNode* array);
+        FunctionProto& Proto();
+        void MarkLine(uint32_t line);
+        size_t Emit(Instruction instruction);
+        size_t EmitJump(OpCode op, uint32_t reg = 0);
+        void PatchJump(size_t jump, size_t target);
+        void PatchJumpHere(size_t jump);
+        void EmitLoadInt(uint32_t target, int64_t value);
+        static uint32_t EnumOrdinal(const MemberAccessNode* access);
+        void EmitFieldAccess(bool store, uint32_t value, uint32_t object, const Symbol* field);
+        uint32_t AddConstant(Value value);
+        uint32_t AddString(std::string_view literal);
+        uint32_t AllocateRegister();
+        [[noreturn]] void Fail(const std::string& message);
+    };
+} // namespace Arcanelab::Mano
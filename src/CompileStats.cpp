@@ -0,0 +1,131 @@
+#include <CompileStats.h>
+#include <ASTVisitor.h>
+
+#include <ostream>
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        constexpr std::string_view NodeNames[] =
+        {
+#define MANO_AST_NAME(type, node) #type,
+            MANO_AST_NODES(MANO_AST_NAME)
+#undef MANO_AST_NAME
+        };
+
+        constexpr ErrorReporter::Phase Phases[] =
+        {
+            ErrorReporter::Phase::Lexer,
+            ErrorReporter::Phase::Parser,
+            ErrorReporter::Phase::Semantic,
+            ErrorReporter::Phase::CodeGen,
+        };
+
+        std::string_view PhaseName(ErrorReporter::Phase phase)
+        {
+            switch (phase)
+            {
+                case ErrorReporter::Phase::Lexer:       return "lexer";
+                case ErrorReporter::Phase::Parser:      return "parser";
+                case ErrorReporter::Phase::Semantic:    return "semantic";
+                case ErrorReporter::Phase::CodeGen:     return "codegen";
+            }
+            return "unknown";
+        }
+    }
+
+    void CompileStats::Add(std::string_view pass, ErrorReporter::Phase phase, double seconds)
+    {
+        for (Pass& existing : passes)
+        {
+            if (existing.name == pass && existing.phase == phase)
+            {
+                existing.seconds += seconds;
+                return;
+            }
+        }
+        passes.push_back({ pass, phase, seconds });
+    }
+
+    void CompileStats::CountNodes(ASTNode* root)
+    {
+        std::vector<ASTNode*> pending{ root };
+        while (!pending.empty())
+        {
+            ASTNode* node = pending.back();
+            pending.pop_back();
+            nodes[static_cast<size_t>(node->nodeType)]++;
+            ForEachChild(node, [&](ASTNode* child) { pending.push_back(child); });
+        }
+    }
+
+    // Names are fixed identifiers, so nothing needs escaping.
+    void CompileStats::WriteJson(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "  \"fromImage\": " << (fromImage ? "true" : "false") << ",\n";
+        out << "  \"totalSeconds\": " << totalSeconds << ",\n";
+
+        out << "  \"phases\": {";
+        const char* phaseSeparator = "\n";
+        for (ErrorReporter::Phase phase : Phases)
+        {
+            double phaseSeconds = 0.0;
+            bool ran = false;
+            for (const Pass& pass : passes)
+            {
+                if (pass.phase == phase)
+                {
+                    phaseSeconds += pass.seconds;
+                    ran = true;
+                }
+            }
+            if (!ran)
+                continue;
+
+            out << phaseSeparator << "    \"" << PhaseName(phase) << "\": { \"seconds\": " << phaseSeconds << ", \"passes\": {";
+            const char* passSeparator = " ";
+            for (const Pass& pass : passes)
+            {
+                if (pass.phase != phase)
+                    continue;
+                out << passSeparator << "\"" << pass.name << "\": " << pass.seconds;
+                passSeparator = ", ";
+            }
+            out << " } }";
+            phaseSeparator = ",\n";
+        }
+        out << "\n  },\n";
+
+        out << "  \"counts\": {\n";
+        out << "    \"files\": " << files << ",\n";
+        out << "    \"sourceBytes\": " << sourceBytes << ",\n";
+        out << "    \"tokens\": " << tokens << ",\n";
+        out << "    \"symbols\": " << symbols << ",\n";
+        out << "    \"scopes\": " << scopes << ",\n";
+        out << "    \"functions\": " << functions << ",\n";
+        out << "    \"instructions\": " << instructions << "\n";
+        out << "  },\n";
+
+        out << "  \"nodes\": {";
+        for (size_t i = 0; i < ASTTypeCount; i++)
+            out << (i ? ",\n" : "\n") << "    \"" << NodeNames[i] << "\": " << nodes[i];
+        out << "\n  },\n";
+
+        out << "  \"memory\": {\n";
+        out << "    \"arenaBytes\": " << arenaBytes << ",\n";
+        if (heapCounted)
+        {
+            out << "    \"heapAllocations\": " << heapAllocations << ",\n";
+            out << "    \"heapPeakBytes\": " << heapPeakBytes << "\n";
+        }
+        else
+        {
+            out << "    \"heapAllocations\": null,\n";
+            out << "    \"heapPeakBytes\": null\n";
+        }
+        out << "  }\n";
+        out << "}\n";
+    }
+} // namespace Arcanelab::Mano
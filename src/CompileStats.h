@@ -0,0 +1,126 @@
+#pragma once
+
+#include <AST.h>
+#include <ErrorReporter.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+#define MANO_AST_COUNT(type, node) + 1
+    constexpr size_t ASTTypeCount = 0 MANO_AST_NODES(MANO_AST_COUNT);
+#undef MANO_AST_COUNT
+
+    // Heap traffic as seen by a counting allocator. The library never
+    // replaces operator new itself: a program that wants heap figures in its
+    // stats does, reports every block here and sets enabled. The compiler
+    // command line does. Blocks are only counted while enabled, and only
+    // counted blocks may be reported freed, so the allocator must remember
+    // which ones Allocated took. Constant initialized, so it is usable
+    // before main.
+    struct HeapCounters
+    {
+        std::atomic<bool> enabled{ false };
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> liveBytes{ 0 };
+        std::atomic<uint64_t> peakBytes{ 0 };
+
+        // False, and nothing counted, unless enabled.
+        bool Allocated(size_t bytes)
+        {
+            if (!enabled.load(std::memory_order_relaxed))
+                return false;
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            uint64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+            while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+            return true;
+        }
+
+        void Freed(size_t bytes) { liveBytes.fetch_sub(bytes, std::memory_order_relaxed); }
+    };
+
+    inline constinit HeapCounters heapCounters;
+
+    class Stopwatch
+    {
+    public:
+        double Seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+    private:
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    // Where the time and memory of one compilation went, filled in by
+    // Compiler::Compile when it is given one. Passes are listed in the order
+    // they ran and grouped by the phase whose diagnostics they produce.
+    // Times are work summed over threads, so files parsed in parallel can
+    // add up to more than the wall clock time in totalSeconds.
+    struct CompileStats
+    {
+        struct Pass
+        {
+            std::string_view name;
+            ErrorReporter::Phase phase;
+            double seconds = 0.0;
+        };
+
+        std::vector<Pass> passes;
+        double totalSeconds = 0.0;
+        bool fromImage = false;             // Mapped from the image cache; nothing was compiled
+
+        size_t files = 0;
+        size_t sourceBytes = 0;
+        size_t tokens = 0;
+        std::array<size_t, ASTTypeCount> nodes{};  // Indexed by ASTType, as parsed
+        size_t symbols = 0;
+        size_t scopes = 0;
+        size_t functions = 0;
+        size_t instructions = 0;
+
+        size_t arenaBytes = 0;              // Reserved by the AST and symbol arenas
+        bool heapCounted = false;           // heapCounters was enabled during the compilation
+        uint64_t heapAllocations = 0;
+        uint64_t heapPeakBytes = 0;
+
+        // Adds to the pass, creating it on first use.
+        void Add(std::string_view pass, ErrorReporter::Phase phase, double seconds);
+        void CountNodes(ASTNode* root);
+        // One object; phases and node types are keyed by name, and phases
+        // that did not run are left out.
+        void WriteJson(std::ostream& out) const;
+    };
+
+    // Charges the time until it goes out of scope to a pass; does nothing
+    // without stats.
+    class PassTimer
+    {
+    public:
+        PassTimer(CompileStats* stats, std::string_view pass, ErrorReporter::Phase phase)
+            : stats(stats), pass(pass), phase(phase)
+        {
+        }
+        ~PassTimer()
+        {
+            if (stats)
+                stats->Add(pass, phase, stopwatch.Seconds());
+        }
+        PassTimer(const PassTimer&) = delete;
+        PassTimer& operator=(const PassTimer&) = delete;
+
+    private:
+        CompileStats* stats;
+        std::string_view pass;
+        ErrorReporter::Phase phase;
+        Stopwatch stopwatch;
+    };
+} // namespace Arcanelab::Mano
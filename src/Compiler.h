@@ -1,391 +1,339 @@
 #pragma once
 
+#include <ASTVisitor.h>
+#include <Binding.h>
+#include <CodeGenerator.h>
+#include <CompileStats.h>
+#include <ConstantFolder.h>
+#include <DebugDump.h>
 #include <ErrorReporter.h>
 #include <Lexer.h>
+#include <ModuleImage.h>
 #include <Parser.h>
+#include <Profiler.h>
 #include <SemanticAnalyzer.h>
+#include <ThreadPool.h>
+#include <VM.h>
 
-#include <fstream>
-#include <iomanip>
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
-// Helper function to convert TokenType to string.
-std::string tokenTypeToString(Arcanelab::Mano::TokenType type)
+namespace Arcanelab::Mano
 {
-    switch (type)
+    struct SourceFile
     {
-        case Arcanelab::Mano::TokenType::Identifier:    return "Identifier";
-        case Arcanelab::Mano::TokenType::Keyword:       return "Keyword";
-        case Arcanelab::Mano::TokenType::Number:        return "Number";
-        case Arcanelab::Mano::TokenType::String:        return "String";
-        case Arcanelab::Mano::TokenType::Operator:      return "Operator";
-        case Arcanelab::Mano::TokenType::Punctuation:   return "Punctuation";
-        case Arcanelab::Mano::TokenType::EndOfFile:     return "EndOfFile";
-        case Arcanelab::Mano::TokenType::Unknown:       return "Unknown";
-        default:                                        return "Unknown";
-    }
-}
+        std::string name;
+        std::string text;
+    };
 
-namespace Arcanelab::Mano
-{
     class Compiler
     {
     public:
-        void Run(const std::string& source)
+        // Caches the compiled program as a module image at path. Runs with the
+        // same sources map the image and skip compilation, debug dumps
+        // included; any change to the sources rebuilds it.
+        void SetImageCache(std::string path) { imagePath = std::move(path); }
+        // Host functions the program may call; the binding must outlive the compiler.
+        void SetBinding(const Binding& hostBinding) { binding = &hostBinding; }
+        // Collects timings and counts of every Compile into stats, which must
+        // outlive the compiler; null turns collection off. Lexing is streamed
+        // into parsing, so stats time the parser's calls into the lexer to
+        // tell the two apart.
+        void SetStats(CompileStats* compileStats) { stats = compileStats; }
+        // Writes the tokens and the AST of single-file compilations to the
+        // paths set in options; nothing is written by default.
+        void SetDumps(DumpOptions options) { dumps = std::move(options); }
+        // Samples the program Run executes into profiler, which must outlive
+        // the compiler; null turns sampling off.
+        void SetProfiler(Profiler* runProfiler) { profiler = runProfiler; }
+
+        bool Run(const std::string& source)
+        {
+            return Run({ SourceFile{ "<source>", source } });
+        }
+
+        // Compiles the files and runs main, or Main, in a fresh VM. False if
+        // the program has errors or stopped with a runtime error.
+        bool Run(const std::vector<SourceFile>& files)
+        {
+            std::shared_ptr<const SharedModule> module = Compile(files);
+            return module && Execute(module);
+        }
+
+        // Lexes and parses every file in parallel, then analyzes them as one
+        // program whose modules share the global scope. Diagnostics are
+        // printed in file order no matter which thread produced them. The
+        // result is immutable and can be loaded into any number of VMs, on
+        // any threads; null if the program has errors.
+        std::shared_ptr<const SharedModule> Compile(const std::vector<SourceFile>& files)
         {
-            ErrorReporter lexErrors(ErrorReporter::Phase::Lexer);
-            Lexer lexer(source, lexErrors);
-            auto tokens = lexer.Tokenize();
+            if (files.empty())
+                return nullptr;
+
+            Stopwatch total;
+            StatsScope statsScope(stats, total);
+            uint64_t sourceHash = 0;
+            if (!imagePath.empty())
+            {
+                sourceHash = HashSources(files);
+                if (std::shared_ptr<const ModuleImage> image = ModuleImage::Open(imagePath, sourceHash))
+                {
+                    if (stats)
+                        stats->fromImage = true;
+                    return std::make_shared<const SharedModule>(std::move(image));
+                }
+            }
 
-            if (tokens.empty())
-                return;
+            // The debug dumps only describe single-file runs.
+            const bool dump = files.size() == 1;
+            if (dump && !dumps.tokensPath.empty() && !DumpTokens(files[0].text, dumps.tokensPath))
+                std::cerr << "Failed to write token dump: " << dumps.tokensPath << "\n";
 
-            PrintTokens(tokens);
+            // Modules share one identifier table so their names resolve against each other.
+            ThreadPool pool;
+            IdentifierTable identifiers;
+            std::vector<ParsedModule> modules(files.size());
+            pool.ParallelFor(files.size(), [&](size_t index)
+            {
+                Stopwatch stopwatch;
+                ParseModule(files[index], identifiers, modules[index], stats != nullptr);
+                modules[index].seconds = stopwatch.Seconds();
+            });
+            if (stats)
+                CollectSyntaxStats(files, modules);
 
-            Parser parser(tokens);
-            ASTNodePtr ast = parser.ParseProgram();
-            PrintASTTree(ast.get());
+            std::vector<ASTNode*> roots;
+            bool syntaxErrors = false;
+            for (size_t i = 0; i < modules.size(); i++)
+            {
+                PrintErrors("Lexer error", files[i], modules[i].lexErrors);
+                PrintErrors("Parse error", files[i], modules[i].parseErrors);
+                syntaxErrors |= modules[i].lexErrors.HasErrors() || modules[i].parseErrors.HasErrors();
+                roots.push_back(modules[i].ast);
+            }
+            // A broken file leaves the host with whatever it loaded last.
+            if (syntaxErrors)
+                return nullptr;
+            if (dump && !dumps.astPath.empty() && !DumpAst(roots[0], dumps.astPath, dumps.astFormat))
+                std::cerr << "Failed to write AST dump: " << dumps.astPath << "\n";
 
-            SemanticAnalyzer semanticAnalyzer(ast);
-            semanticAnalyzer.Analyze();
+            // Symbols, types and the merged program live here; the trees stay in the module arenas.
+            AstArena arena;
+            SemanticAnalyzer semanticAnalyzer(roots, arena);
+            if (binding)
+                semanticAnalyzer.Bind(*binding);
+            semanticAnalyzer.SetStats(stats);
+            semanticAnalyzer.SetThreadPool(&pool);
+            bool analyzed = semanticAnalyzer.Analyze();
+            if (stats)
+                stats->arenaBytes += arena.BytesReserved();
+            if (!analyzed)
+            {
+                for (size_t i = 0; i < files.size(); i++)
+                    PrintErrors("Semantic error", files[i], semanticAnalyzer.GetErrors()[i]);
+                return nullptr;
+            }
+            ConstantFolder folder(arena);
+            bool folded;
+            {
+                PassTimer timer(stats, "fold", ErrorReporter::Phase::Semantic);
+                folded = folder.Fold(roots);
+            }
+            if (!folded)
+            {
+                for (size_t i = 0; i < files.size(); i++)
+                    PrintErrors("Semantic error", files[i], folder.GetErrors()[i]);
+                return nullptr;
+            }
+            ASTNodePtr ast = MergeModules(roots, arena);
+
+            ErrorReporter codeGenErrors(ErrorReporter::Phase::CodeGen);
+            CodeGenerator codeGenerator(codeGenErrors);
+            std::unique_ptr<Module> module;
+            {
+                PassTimer timer(stats, "generate", ErrorReporter::Phase::CodeGen);
+                module = codeGenerator.Generate(ast);
+            }
+            if (module && stats)
+            {
+                stats->functions += module->functions.size();
+                for (const FunctionProto& function : module->functions)
+                    stats->instructions += function.code.size();
+            }
+            if (!module)
+            {
+                for (const auto& error : codeGenErrors.GetErrors())
+                    std::cerr << "Code generation error: " << error.message << "\n";
+                return nullptr;
+            }
+
+            if (!imagePath.empty() && !ModuleImage::Write(*module, sourceHash, imagePath))
+                std::cerr << "Failed to write module image: " << imagePath << "\n";
+            return std::make_shared<const SharedModule>(std::move(module));
         }
 
     private:
-        void PrintTokens(const std::vector<Token>& tokens)
+        friend class IncrementalCompiler;   // Shares the parsing and merging stages
+
+        std::string imagePath;
+        const Binding* binding = nullptr;
+        CompileStats* stats = nullptr;
+        DumpOptions dumps;
+        Profiler* profiler = nullptr;
+
+        // Finishes the stats of a compilation however it ends: the total
+        // time and the heap traffic since it started.
+        class StatsScope
         {
-            std::ofstream outFile("../test.tokens");
-            if (!outFile.is_open())
+        public:
+            StatsScope(CompileStats* stats, const Stopwatch& total)
+                : stats(stats), total(total)
             {
-                std::cerr << "Failed to open file: ../test.tokens" << std::endl;
-                return;
+                if (!stats || !heapCounters.enabled.load(std::memory_order_relaxed))
+                    return;
+                startAllocations = heapCounters.allocations.load(std::memory_order_relaxed);
+                heapCounters.peakBytes.store(heapCounters.liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                stats->heapCounted = true;
             }
-            // Print header for clarity.
-            outFile << std::left
-                << std::setw(5) << "Index"      // Add column for index
-                << std::setw(10) << "Lexeme"
-                << std::setw(10) << "Coordinates"
-                << "Token Type" << "\n";
-                outFile << std::string(8 + 20 + 16 + 12, '-') << "\n";
-
-            int index = 0; // Initialize index counter
-            for (auto&& token : tokens)
+            ~StatsScope()
             {
-                // Construct a coordinate string of the form "(line, column)"
-                std::string coord = "(" + std::to_string(token.line) + ", " + std::to_string(token.column) + ")";
+                if (!stats)
+                    return;
+                stats->totalSeconds += total.Seconds();
+                if (stats->heapCounted)
+                {
+                    stats->heapAllocations += heapCounters.allocations.load(std::memory_order_relaxed) - startAllocations;
+                    stats->heapPeakBytes = std::max<uint64_t>(stats->heapPeakBytes, heapCounters.peakBytes.load(std::memory_order_relaxed));
+                }
+            }
+            StatsScope(const StatsScope&) = delete;
+            StatsScope& operator=(const StatsScope&) = delete;
+
+        private:
+            CompileStats* stats;
+            const Stopwatch& total;
+            uint64_t startAllocations = 0;
+        };
 
-                // Print index, lexeme, coordinates, and token type with fixed-width formatting.
-                outFile << std::left
-                    << std::setw(5) << index++  // Print and increment index
-                    << std::setw(10) << token.lexeme
-                    << std::setw(10) << coord
-                    << tokenTypeToString(token.type) << "\n";
+        // File names take part so that reordering or renaming files rebuilds
+        // the image, and so do host signatures, which calls resolve against.
+        uint64_t HashSources(const std::vector<SourceFile>& files) const
+        {
+            uint64_t hash = ModuleImage::HashSource({});
+            for (const SourceFile& file : files)
+                hash = ModuleImage::HashSource(file.text, ModuleImage::HashSource(file.name, hash));
+            if (binding)
+            {
+                for (const HostFunction& host : binding->Functions())
+                    hash = ModuleImage::HashSource(host.signature, hash);
             }
-            outFile.close();
+            return hash;
         }
 
-        void PrintASTTree(const ASTNode* root)
+        bool Execute(const std::shared_ptr<const SharedModule>& module) const
         {
-            // Open the file for writing.
-            std::ofstream outFile("../test.ast");
-            if (!outFile.is_open())
+            int32_t entryPoint = module->FindFunction("main");
+            if (entryPoint < 0)
+                entryPoint = module->FindFunction("Main");
+
+            try
             {
-                std::cerr << "Failed to open file: ../test.ast" << std::endl;
-                return;
+                VM vm;
+                if (binding)
+                    vm.Bind(*binding);
+                vm.SetProfiler(profiler);
+                vm.Load(module);
+                if (entryPoint >= 0)
+                    vm.Call(entryPoint);
             }
+            catch (const RuntimeError& error)
+            {
+                std::cerr << "Runtime error: " << error.what() << "\n";
+                return false;
+            }
+            return true;
+        }
 
-            // Recursive lambda function to print an AST node.
-            auto printNode = [&](auto&& self, const ASTNode* node, const std::string& prefix, bool isLast) -> void {
-                if (!node)
-                    return;
-
-                // Prepare the branch string for the current node.
-                std::string branch = prefix;
-                branch += (isLast ? "└── " : "├── ");
+        struct ParsedModule
+        {
+            std::unique_ptr<AstArena> arena;
+            ErrorReporter lexErrors{ ErrorReporter::Phase::Lexer };
+            ErrorReporter parseErrors{ ErrorReporter::Phase::Parser };
+            ASTNodePtr ast = nullptr;
+            double seconds = 0.0;   // Lexing and parsing together
+            TokenStream::LexTiming lexing;  // Only filled in for --stats
+        };
 
-                // Determine a label based on the concrete node type.
-                std::string nodeLabel;
-                if (auto prog = dynamic_cast<const ProgramNode*>(node))
-                {
-                    nodeLabel = "ProgramNode";
-                }
-                else if (auto typeNode = dynamic_cast<const TypeNode*>(node))
-                {
-                    nodeLabel = "TypeNode (" + std::string(typeNode->isConst ? "const " : "") + typeNode->name + ")";
-                }
-                else if (auto varDecl = dynamic_cast<const VariableDeclarationNode*>(node))
-                {
-                    nodeLabel = "VariableDeclarationNode (" + varDecl->name + ")";
-                }
-                else if (auto funDecl = dynamic_cast<const FunctionDeclarationNode*>(node))
-                {
-                    nodeLabel = "FunctionDeclarationNode (" + funDecl->name + ")";
-                }
-                else if (auto classDecl = dynamic_cast<const ClassDeclarationNode*>(node))
-                {
-                    nodeLabel = "ClassDeclarationNode (" + classDecl->name + ")";
-                }
-                else if (auto enumDecl = dynamic_cast<const EnumDeclarationNode*>(node))
-                {
-                    nodeLabel = "EnumDeclarationNode (" + enumDecl->name + ")";
-                }
-                else if (auto block = dynamic_cast<const BlockNode*>(node))
-                {
-                    nodeLabel = "BlockNode";
-                }
-                else if (auto block = dynamic_cast<const ClassBlockNode*>(node))
-                {
-                    nodeLabel = "ClassBlockNode";
-                }
-                else if (auto exprStmt = dynamic_cast<const ExpressionStatementNode*>(node))
-                {
-                    nodeLabel = "ExpressionStatementNode";
-                }
-                else if (auto retStmt = dynamic_cast<const ReturnStatementNode*>(node))
-                {
-                    nodeLabel = "ReturnStatementNode";
-                }
-                else if (auto ifStmt = dynamic_cast<const IfStatementNode*>(node))
-                {
-                    nodeLabel = "IfStatementNode";
-                }
-                else if (auto forStmt = dynamic_cast<const ForStatementNode*>(node))
-                {
-                    nodeLabel = "ForStatementNode";
-                }
-                else if (auto whileStmt = dynamic_cast<const WhileStatementNode*>(node))
-                {
-                    nodeLabel = "WhileStatementNode";
-                }
-                else if (auto switchStmt = dynamic_cast<const SwitchStatementNode*>(node))
-                {
-                    nodeLabel = "SwitchStatementNode";
-                }
-                else if (auto memberAccess = dynamic_cast<const MemberAccessNode*>(node))
-                {
-                    nodeLabel = "MemberAccessNode (." + memberAccess->memberName + ")";
-                }
-                else if (auto binaryExpr = dynamic_cast<const BinaryExpressionNode*>(node))
-                {
-                    std::string opStr;
-                    switch (binaryExpr->op)
-                    {
-                        case BinaryOperator::Assign:         opStr = "="; break;
-                        case BinaryOperator::LogicalOr:      opStr = "||"; break;
-                        case BinaryOperator::LogicalAnd:     opStr = "&&"; break;
-                        case BinaryOperator::Equal:          opStr = "=="; break;
-                        case BinaryOperator::NotEqual:       opStr = "!="; break;
-                        case BinaryOperator::Less:           opStr = "<"; break;
-                        case BinaryOperator::Greater:        opStr = ">"; break;
-                        case BinaryOperator::LessEqual:      opStr = "<="; break;
-                        case BinaryOperator::GreaterEqual:   opStr = ">="; break;
-                        case BinaryOperator::Add:            opStr = "+"; break;
-                        case BinaryOperator::Subtract:       opStr = "-"; break;
-                        case BinaryOperator::Multiply:       opStr = "*"; break;
-                        case BinaryOperator::Divide:         opStr = "/"; break;
-                        case BinaryOperator::Modulo:         opStr = "%"; break;
-                        case BinaryOperator::BitwiseOr:      opStr = "|"; break;
-                        case BinaryOperator::BitwiseXor:     opStr = "^"; break;
-                        case BinaryOperator::BitwiseAnd:     opStr = "&"; break;
-                        case BinaryOperator::LeftShift:      opStr = "<<"; break;
-                        case BinaryOperator::RightShift:     opStr = ">>"; break;
-                        default:                             opStr = "op"; break;
-                    }
-                    nodeLabel = "BinaryExpressionNode (" + opStr + ")";
-                }
-                else if (auto unaryExpr = dynamic_cast<const UnaryExpressionNode*>(node))
-                {
-                    nodeLabel = "UnaryExpressionNode (" + unaryExpr->op + ")";
-                }
-                else if (auto literal = dynamic_cast<const LiteralNode*>(node))
-                {
-                    nodeLabel = "LiteralNode (" + literal->value + ")";
-                }
-                else if (auto ident = dynamic_cast<const IdentifierNode*>(node))
-                {
-                    nodeLabel = "IdentifierNode (" + ident->name + ")";
-                }
-                else if (dynamic_cast<const BreakStatementNode*>(node))
-                {
-                    nodeLabel = "BreakStatementNode";
-                }
-                else if (dynamic_cast<const ContinueStatementNode*>(node))
-                {
-                    nodeLabel = "ContinueStatementNode";
-                }
-                else if (auto arrayLiteral = dynamic_cast<const ArrayLiteralNode*>(node))
-                {
-                    nodeLabel = "ArrayLiteralNode";
-                }
-                else if (auto funcCall = dynamic_cast<const FunctionCallNode*>(node))
-                {
-                    nodeLabel = "FunctionCallNode (" + funcCall->name + ")";
-                }
-                else if (auto objInst = dynamic_cast<const ObjectInstantiationNode*>(node))
-                {
-                    nodeLabel = "ObjectInstantiationNode (" + objInst->name + ")";
-                }
-                else
-                {
-                    nodeLabel = "Unknown ASTNode";
-                }
-                outFile << branch << nodeLabel << std::endl;
+        // The lexer runs inside the parser's pass, which times the calls
+        // into it; the parser is charged with the rest of that pass.
+        void CollectSyntaxStats(const std::vector<SourceFile>& files, const std::vector<ParsedModule>& modules)
+        {
+            double lexSeconds = 0.0;
+            double parseSeconds = 0.0;
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                double seconds = std::chrono::duration<double>(modules[i].lexing.time).count();
+                lexSeconds += seconds;
+                parseSeconds += modules[i].seconds - seconds;
+                stats->files++;
+                stats->sourceBytes += files[i].text.size();
+                stats->tokens += modules[i].lexing.tokens;
+                stats->arenaBytes += modules[i].arena->BytesReserved();
+                if (modules[i].ast)
+                    stats->CountNodes(modules[i].ast);
+            }
+            stats->Add("lex", ErrorReporter::Phase::Lexer, lexSeconds);
+            stats->Add("parse", ErrorReporter::Phase::Parser, parseSeconds);
+        }
 
-                // Container for child nodes.
-                std::vector<const ASTNode*> children;
+        static void ParseModule(const SourceFile& file, IdentifierTable& identifiers, ParsedModule& module, bool timeLexing = false)
+        {
+            module.arena = std::make_unique<AstArena>();
+            Lexer lexer(file.text, module.lexErrors, identifiers);
+            TokenStream tokens(lexer, timeLexing ? &module.lexing : nullptr);
+            Parser parser(tokens, module.parseErrors, *module.arena);
+            module.ast = parser.ParseProgram();
+        }
 
-                if (auto prog = dynamic_cast<const ProgramNode*>(node))
-                {
-                    for (const auto& decl : prog->declarations)
-                        children.push_back(decl.get());
-                }
-                else if (auto varDecl = dynamic_cast<const VariableDeclarationNode*>(node))
-                {
-                    if (varDecl->declaredType) children.push_back(varDecl->declaredType.get());
-                    if (varDecl->initializer) children.push_back(varDecl->initializer.get());
-                }
-                else if (auto funDecl = dynamic_cast<const FunctionDeclarationNode*>(node))
-                {
-                    // Print parameters as pseudo‐nodes.
-                    for (size_t i = 0; i < funDecl->parameters.size(); ++i)
-                    {
-                        bool lastParam = (i == funDecl->parameters.size() - 1);
-                        std::string paramLabel = "Param: " + funDecl->parameters[i].first;
-                        std::string paramBranch = prefix + (isLast ? "    " : "│   ");
-                        paramBranch += (lastParam ? "└── " : "├── ");
-                        outFile << paramBranch << paramLabel << std::endl;
-                        // Print the parameter’s type node with an extended prefix.
-                        if (funDecl->parameters[i].second)
-                        {
-                            std::string typePrefix = prefix + (isLast ? "    " : "│   ");
-                            typePrefix += (lastParam ? "    " : "│   ");
-                            self(self, funDecl->parameters[i].second.get(), typePrefix, true);
-                        }
-                    }
-                    if (funDecl->returnType)
-                        children.push_back(funDecl->returnType.get());
-                    if (funDecl->body)
-                        children.push_back(funDecl->body.get());
-                }
-                else if (auto classDecl = dynamic_cast<const ClassDeclarationNode*>(node))
-                {
-                    if (classDecl->body) children.push_back(classDecl->body.get());
-                }
-                else if (auto enumDecl = dynamic_cast<const EnumDeclarationNode*>(node))
-                {
-                    // Print each enum value as a pseudo‐child.
-                    for (size_t i = 0; i < enumDecl->values.size(); i++)
-                    {
-                        std::string valueLabel = "EnumValue: " + enumDecl->values[i];
-                        std::string valueBranch = prefix + (isLast ? "    " : "│   ") + "├── ";
-                        outFile << valueBranch << valueLabel << std::endl;
-                    }
-                }
-                else if (auto block = dynamic_cast<const BlockNode*>(node))
-                {
-                    for (const auto& stmt : block->statements)
-                        children.push_back(stmt.get());
-                }
-                else if (auto block = dynamic_cast<const ClassBlockNode*>(node))
-                {
-                    for (const auto& stmt : block->declarations)
-                        children.push_back(stmt.get());
-                }
-                else if (auto exprStmt = dynamic_cast<const ExpressionStatementNode*>(node))
-                {
-                    if (exprStmt->expression) children.push_back(exprStmt->expression.get());
-                }
-                else if (auto retStmt = dynamic_cast<const ReturnStatementNode*>(node))
-                {
-                    if (retStmt->expression) children.push_back(retStmt->expression.get());
-                }
-                else if (auto ifStmt = dynamic_cast<const IfStatementNode*>(node))
-                {
-                    if (ifStmt->condition) children.push_back(ifStmt->condition.get());
-                    if (ifStmt->thenBranch) children.push_back(ifStmt->thenBranch.get());
-                    if (ifStmt->elseBranch) children.push_back(ifStmt->elseBranch.get());
-                }
-                else if (auto forStmt = dynamic_cast<const ForStatementNode*>(node))
-                {
-                    if (forStmt->init) children.push_back(forStmt->init.get());
-                    if (forStmt->condition) children.push_back(forStmt->condition.get());
-                    if (forStmt->update) children.push_back(forStmt->update.get());
-                    if (forStmt->body) children.push_back(forStmt->body.get());
-                }
-                else if (auto whileStmt = dynamic_cast<const WhileStatementNode*>(node))
-                {
-                    if (whileStmt->condition) children.push_back(whileStmt->condition.get());
-                    if (whileStmt->body) children.push_back(whileStmt->body.get());
-                }
-                else if (auto switchStmt = dynamic_cast<const SwitchStatementNode*>(node))
-                {
-                    if (switchStmt->expression)
-                        children.push_back(switchStmt->expression.get());
-                    // Process each switch case as a pseudo‐node.
-                    for (size_t i = 0; i < switchStmt->cases.size(); i++)
-                    {
-                        bool isLastCase = (i == switchStmt->cases.size() - 1 && switchStmt->defaultCase == nullptr);
-                        std::string caseBranch = prefix + (isLast ? "    " : "│   ");
-                        caseBranch += (isLastCase ? "└── " : "├── ");
-                        outFile << caseBranch << "Case:" << std::endl;
-                        std::string casePrefix = prefix + (isLast ? "    " : "│   ");
-                        casePrefix += (isLastCase ? "    " : "│   ");
-                        // Print the case expression and block.
-                        self(self, switchStmt->cases[i].first.get(), casePrefix, false);
-                        self(self, switchStmt->cases[i].second.get(), casePrefix, true);
-                    }
-                    if (switchStmt->defaultCase)
-                    {
-                        // Print Default: as a pseudo‐node.
-                        std::string defaultBranch = prefix + (isLast ? "    " : "│   ") + "└── ";
-                        outFile << defaultBranch << "Default:" << std::endl;
-                        std::string defPrefix = prefix + (isLast ? "    " : "│   ") + "│   ";
-                        self(self, switchStmt->defaultCase.get(), defPrefix, true);
-                    }
-                }
-                else if (auto memberAccess = dynamic_cast<const MemberAccessNode*>(node))
-                {
-                    if (memberAccess->object) children.push_back(memberAccess->object.get());
-                }
-                else if (auto binaryExpr = dynamic_cast<const BinaryExpressionNode*>(node))
-                {
-                    if (binaryExpr->left) children.push_back(binaryExpr->left.get());
-                    if (binaryExpr->right) children.push_back(binaryExpr->right.get());
-                }
-                else if (auto unaryExpr = dynamic_cast<const UnaryExpressionNode*>(node))
-                {
-                    if (unaryExpr->operand) children.push_back(unaryExpr->operand.get());
-                }
-                else if (auto arrayLiteral = dynamic_cast<const ArrayLiteralNode*>(node))
-                {
-                    for (const auto& elem : arrayLiteral->elements)
-                        children.push_back(elem.get());
-                }
-                else if (auto funcCall = dynamic_cast<const FunctionCallNode*>(node))
-                {
-                    if (funcCall->callTarget) children.push_back(funcCall->callTarget.get());
-                    for (const auto& arg : funcCall->arguments)
-                        children.push_back(arg.get());
-                }
-                else if (auto objInst = dynamic_cast<const ObjectInstantiationNode*>(node))
-                {
-                    for (const auto& arg : objInst->arguments)
-                        children.push_back(arg.get());
-                }
+        // A line or column of 0 means the error has none.
+        static std::string FormatError(const char* label, const SourceFile& file, size_t line, size_t column, const std::string& message)
+        {
+            std::string text = std::string(label) + ": " + file.name;
+            if (line)
+            {
+                text += ":" + std::to_string(line);
+                if (column)
+                    text += ":" + std::to_string(column);
+            }
+            return text + ": " + message;
+        }
 
-                // Recursively print any gathered children.
-                for (size_t i = 0; i < children.size(); i++)
-                {
-                    bool lastChild = (i == children.size() - 1);
-                    std::string newPrefix = prefix + (isLast ? "    " : "│   ");
-                    self(self, children[i], newPrefix, lastChild);
-                }
-                }; // lambda
+        static void PrintErrors(const char* label, const SourceFile& file, const ErrorReporter& errors)
+        {
+            for (const auto& error : errors.GetErrors())
+                std::cerr << FormatError(label, file, error.line, error.column, error.message) << "\n";
+        }
 
-            printNode(printNode, root, "", true);
+        // Code generation takes one program; concatenate the modules'
+        // top-level declarations in file order.
+        static ASTNodePtr MergeModules(const std::vector<ASTNode*>& roots, AstArena& arena)
+        {
+            if (roots.size() == 1)
+                return roots[0];
 
-            // Close the file after writing.
-            outFile.close();
+            std::vector<ASTNodePtr> declarations;
+            for (ASTNode* root : roots)
+            {
+                auto* program = static_cast<ProgramNode*>(root);
+                declarations.insert(declarations.end(), program->declarations.begin(), program->declarations.end());
+            }
+            auto* merged = arena.New<ProgramNode>();
+            merged->declarations = arena.CopyArray(declarations);
+            return merged;
         }
     };
 } // namespace Arcanelab::Mano
@@ -0,0 +1,499 @@
+#include <ConstantFolder.h>
+#include <SemanticAnalyzer.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace Arcanelab::Mano
+{
+    ConstantFolder::ConstantFolder(AstArena& arena)
+        : arena(arena)
+    {
+    }
+
+    bool ConstantFolder::Fold(std::span<ASTNode* const> modules)
+    {
+        FoldGlobals(modules);
+        // Top-level nodes are all declarations, which are folded in place.
+        for (currentModule = 0; currentModule < modules.size(); currentModule++)
+        {
+            for (ASTNode* declaration : static_cast<ProgramNode*>(modules[currentModule])->declarations)
+            {
+                if (declaration->nodeType != ASTType::VariableDeclaration)
+                    FoldStatement(declaration);
+            }
+        }
+        return !HasErrors();
+    }
+
+    bool ConstantFolder::Fold(std::span<ASTNode* const> modules, std::span<ASTNode* const> declarations)
+    {
+        FoldGlobals(modules);
+        std::unordered_map<const ASTNode*, size_t> moduleOf;
+        for (size_t i = 0; i < modules.size(); i++)
+        {
+            for (const ASTNode* declaration : static_cast<ProgramNode*>(modules[i])->declarations)
+                moduleOf.emplace(declaration, i);
+        }
+        for (ASTNode* declaration : declarations)
+        {
+            currentModule = moduleOf.at(declaration);
+            if (declaration->nodeType != ASTType::VariableDeclaration)
+                FoldStatement(declaration);
+        }
+        return !HasErrors();
+    }
+
+    // Globals first, so functions anywhere see every foldable `let`.
+    void ConstantFolder::FoldGlobals(std::span<ASTNode* const> modules)
+    {
+        errors.assign(modules.size(), ErrorReporter(ErrorReporter::Phase::Semantic));
+        for (ASTNode* module : modules)
+        {
+            for (ASTNode* declaration : static_cast<ProgramNode*>(module)->declarations)
+            {
+                if (declaration->nodeType == ASTType::VariableDeclaration)
+                    FoldVariable(static_cast<VariableDeclarationNode*>(declaration));
+            }
+        }
+    }
+
+    bool ConstantFolder::HasErrors() const
+    {
+        return std::any_of(errors.begin(), errors.end(), [](const ErrorReporter& reporter) { return reporter.HasErrors(); });
+    }
+
+    ASTNode* ConstantFolder::FoldStatement(ASTNode* statement)
+    {
+        switch (statement->nodeType)
+        {
+            case ASTType::Block:
+            {
+                auto* block = static_cast<BlockNode*>(statement);
+                block->statements = FoldStatements(block->statements);
+                return block;
+            }
+            case ASTType::VariableDeclaration:
+                FoldVariable(static_cast<VariableDeclarationNode*>(statement));
+                return statement;
+            case ASTType::FunctionDeclaration:
+            {
+                auto* function = static_cast<FunctionDeclarationNode*>(statement);
+                if (function->body)
+                    FoldBody(function->body);
+                return statement;
+            }
+            case ASTType::ClassDeclaration:
+            {
+                auto* classDeclaration = static_cast<ClassDeclarationNode*>(statement);
+                if (classDeclaration->body)
+                    FoldStatement(classDeclaration->body);
+                return statement;
+            }
+            case ASTType::ClassBlock:
+                for (ASTNode* declaration : static_cast<ClassBlockNode*>(statement)->declarations)
+                    FoldStatement(declaration);
+                return statement;
+            case ASTType::ExpressionStatement:
+            {
+                auto* expressionStatement = static_cast<ExpressionStatementNode*>(statement);
+                expressionStatement->expression = FoldExpression(expressionStatement->expression);
+                return statement;
+            }
+            case ASTType::ReturnStatement:
+            {
+                auto* returnStatement = static_cast<ReturnStatementNode*>(statement);
+                if (returnStatement->expression)
+                    returnStatement->expression = FoldExpression(returnStatement->expression);
+                return statement;
+            }
+            case ASTType::IfStatement:
+                return FoldIf(static_cast<IfStatementNode*>(statement));
+            case ASTType::SwitchStatement:
+                return FoldSwitch(static_cast<SwitchStatementNode*>(statement));
+            case ASTType::WhileStatement:
+            {
+                auto* whileStatement = static_cast<WhileStatementNode*>(statement);
+                whileStatement->condition = FoldExpression(whileStatement->condition);
+                Constant condition;
+                if (ReadConstant(whileStatement->condition, condition) && !condition.value.AsBool())
+                    return nullptr;
+                FoldBody(whileStatement->body);
+                return statement;
+            }
+            case ASTType::ForStatement:
+            {
+                // The initializer runs even when the condition is false, so
+                // the loop itself is kept.
+                auto* forStatement = static_cast<ForStatementNode*>(statement);
+                if (forStatement->init)
+                    FoldStatement(forStatement->init);
+                if (forStatement->condition)
+                    forStatement->condition = FoldExpression(forStatement->condition);
+                if (forStatement->update)
+                    forStatement->update = FoldExpression(forStatement->update);
+                FoldBody(forStatement->body);
+                return statement;
+            }
+            default:
+                return statement;
+        }
+    }
+
+    // Folds in place; the span only ever shrinks, so no new storage is needed.
+    std::span<ASTNodePtr> ConstantFolder::FoldStatements(std::span<ASTNodePtr> statements)
+    {
+        size_t count = 0;
+        for (ASTNodePtr statement : statements)
+        {
+            ASTNode* folded = FoldStatement(statement);
+            if (!folded)
+                continue;
+            statements[count++] = folded;
+
+            // Nothing after these is reachable. Declarations in the dead tail
+            // cannot be referenced either, since names resolve in source order.
+            ASTType type = folded->nodeType;
+            if (type == ASTType::ReturnStatement || type == ASTType::BreakStatement || type == ASTType::ContinueStatement)
+                break;
+        }
+        return statements.first(count);
+    }
+
+    // Loop and branch bodies must stay non-null for the code generator.
+    void ConstantFolder::FoldBody(ASTNodePtr& body)
+    {
+        ASTNode* folded = FoldStatement(body);
+        body = folded ? folded : arena.New<BlockNode>();
+    }
+
+    void ConstantFolder::FoldVariable(VariableDeclarationNode* variable)
+    {
+        if (!variable->initializer)
+            return;
+        variable->initializer = FoldExpression(variable->initializer);
+
+        Constant value;
+        bool isLet = variable->declaredType && variable->declaredType->isConst;
+        if (isLet && variable->symbol && !variable->symbol->isAssigned && ReadConstant(variable->initializer, value))
+            constants[variable->symbol] = static_cast<const LiteralNode*>(variable->initializer);
+    }
+
+    ASTNode* ConstantFolder::FoldIf(IfStatementNode* ifStatement)
+    {
+        ifStatement->condition = FoldExpression(ifStatement->condition);
+        Constant condition;
+        if (ReadConstant(ifStatement->condition, condition))
+        {
+            ASTNode* taken = condition.value.AsBool() ? ifStatement->thenBranch : ifStatement->elseBranch;
+            return taken ? FoldStatement(taken) : nullptr;
+        }
+
+        FoldBody(ifStatement->thenBranch);
+        if (ifStatement->elseBranch)
+            ifStatement->elseBranch = FoldStatement(ifStatement->elseBranch);
+        return ifStatement;
+    }
+
+    ASTNode* ConstantFolder::FoldSwitch(SwitchStatementNode* switchStatement)
+    {
+        switchStatement->expression = FoldExpression(switchStatement->expression);
+        for (auto& [caseExpression, caseBlock] : switchStatement->cases)
+        {
+            caseExpression = FoldExpression(caseExpression);
+            FoldBody(caseBlock);
+        }
+        if (switchStatement->defaultCase)
+            FoldBody(switchStatement->defaultCase);
+
+        // The analyzer rejects labels that are the same literal or enum
+        // member; labels only equal once folded are caught here.
+        for (size_t i = 0; i < switchStatement->cases.size(); i++)
+        {
+            Constant label;
+            if (!ReadConstant(switchStatement->cases[i].first, label))
+                continue;
+            for (size_t j = 0; j < i; j++)
+            {
+                Constant earlier;
+                Constant equal;
+                if (ReadConstant(switchStatement->cases[j].first, earlier) &&
+                    Evaluate(BinaryOperator::Equal, earlier, label, equal) && equal.value.AsBool())
+                {
+                    errors[currentModule].Report(switchStatement->line, 0, "Duplicate case in switch statement");
+                    break;
+                }
+            }
+        }
+
+        // Cases are tested in order and never fall through, so a constant
+        // subject selects the first constant case equal to it. A case that
+        // is not constant before the match keeps the whole switch.
+        Constant subject;
+        if (ReadConstant(switchStatement->expression, subject))
+        {
+            for (auto& [caseExpression, caseBlock] : switchStatement->cases)
+            {
+                Constant label;
+                Constant equal;
+                if (!ReadConstant(caseExpression, label) || !Evaluate(BinaryOperator::Equal, subject, label, equal))
+                    return switchStatement;
+                if (equal.value.AsBool())
+                    return caseBlock;
+            }
+            return switchStatement->defaultCase;
+        }
+        return switchStatement;
+    }
+
+    ASTNode* ConstantFolder::FoldExpression(ASTNode* expression)
+    {
+        switch (expression->nodeType)
+        {
+            case ASTType::Identifier:
+                return FoldIdentifier(static_cast<IdentifierNode*>(expression));
+            case ASTType::BinaryExpression:
+                return FoldBinary(static_cast<BinaryExpressionNode*>(expression));
+            case ASTType::UnaryExpression:
+                return FoldUnary(static_cast<UnaryExpressionNode*>(expression));
+            case ASTType::FunctionCall:
+            {
+                auto* call = static_cast<FunctionCallNode*>(expression);
+                if (call->callTarget)
+                    call->callTarget = FoldExpression(call->callTarget);
+                for (auto& argument : call->arguments)
+                    argument = FoldExpression(argument);
+                return expression;
+            }
+            case ASTType::IndexAccess:
+            {
+                auto* access = static_cast<IndexAccessNode*>(expression);
+                access->object = FoldExpression(access->object);
+                access->index = FoldExpression(access->index);
+                return expression;
+            }
+            case ASTType::ArrayLiteral:
+                for (auto& element : static_cast<ArrayLiteralNode*>(expression)->elements)
+                    element = FoldExpression(element);
+                return expression;
+            case ASTType::ObjectInstantiation:
+                for (auto& argument : static_cast<ObjectInstantiationNode*>(expression)->arguments)
+                    argument = FoldExpression(argument);
+                return expression;
+            default:
+                return expression;
+        }
+    }
+
+    ASTNode* ConstantFolder::FoldIdentifier(IdentifierNode* identifier)
+    {
+        auto it = constants.find(identifier->resolvedSymbol);
+        if (it == constants.end())
+            return identifier;
+        return arena.New<LiteralNode>(*it->second);
+    }
+
+    ASTNode* ConstantFolder::FoldBinary(BinaryExpressionNode* expression)
+    {
+        if (expression->op == BinaryOperator::Assign)
+        {
+            expression->right = FoldExpression(expression->right);
+            return expression;
+        }
+
+        expression->left = FoldExpression(expression->left);
+        Constant left;
+        bool leftIsConstant = ReadConstant(expression->left, left);
+
+        // A constant left operand decides && and || on its own; the right
+        // operand would not be evaluated, or is the result as it stands.
+        if (expression->op == BinaryOperator::LogicalAnd || expression->op == BinaryOperator::LogicalOr)
+        {
+            if (leftIsConstant && left.kind == Type::Kind::Bool)
+            {
+                bool decided = left.value.AsBool() == (expression->op == BinaryOperator::LogicalOr);
+                return decided ? expression->left : FoldExpression(expression->right);
+            }
+            // `x && true` and `x || false` are just x; the other two constants
+            // still need x evaluated for its side effects.
+            expression->right = FoldExpression(expression->right);
+            Constant right;
+            if (ReadConstant(expression->right, right) && right.kind == Type::Kind::Bool &&
+                right.value.AsBool() == (expression->op == BinaryOperator::LogicalAnd))
+                return expression->left;
+            return expression;
+        }
+
+        expression->right = FoldExpression(expression->right);
+        Constant right;
+        Constant result;
+        if (!leftIsConstant || !ReadConstant(expression->right, right) || !expression->evaluatedType)
+            return expression;
+        if (!Evaluate(expression->op, left, right, result))
+            return expression;
+        if (result.kind == Type::Kind::Float && !std::isfinite(result.value.f))
+            return expression;
+        return MakeLiteral(result, expression->evaluatedType->unqualified);
+    }
+
+    ASTNode* ConstantFolder::FoldUnary(UnaryExpressionNode* expression)
+    {
+        expression->operand = FoldExpression(expression->operand);
+        Constant operand;
+        if (!ReadConstant(expression->operand, operand))
+            return expression;
+
+        Value value = operand.value;
+        if (expression->op == "!" && operand.kind == Type::Kind::Bool)
+            value.u ^= 1;
+        else if (expression->op == "-" && (operand.kind == Type::Kind::Int || operand.kind == Type::Kind::UInt))
+            value.u = 0 - value.u;
+        else if (expression->op == "-" && operand.kind == Type::Kind::Float)
+            value.f = -value.f;
+        else
+            return expression;
+
+        auto* literal = static_cast<LiteralNode*>(expression->operand);
+        return MakeLiteral({ operand.kind, value }, literal->evaluatedType->unqualified);
+    }
+
+    bool ConstantFolder::ReadConstant(const ASTNode* node, Constant& constant)
+    {
+        if (node->nodeType != ASTType::Literal)
+            return false;
+        auto* literal = static_cast<const LiteralNode*>(node);
+        if (!literal->evaluatedType)
+            return false;
+
+        std::string_view text = literal->value;
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+        constant.kind = literal->evaluatedType->kind;
+        switch (constant.kind)
+        {
+            case Type::Kind::Bool:
+                constant.value = Value::Bool(text == "true");
+                return true;
+            case Type::Kind::Int:
+                return std::from_chars(first, last, constant.value.i).ec == std::errc();
+            case Type::Kind::UInt:
+                return std::from_chars(first, last, constant.value.u).ec == std::errc();
+            case Type::Kind::Float:
+                return std::from_chars(first, last, constant.value.f).ec == std::errc();
+            default:
+                return false;
+        }
+    }
+
+    // Mirrors the VM's typed instructions: integer arithmetic wraps around
+    // at 64 bits, shift counts are taken modulo 64, and the operand kind is
+    // that of the left operand. Returns false when the result is not a
+    // compile-time constant, including every case that traps at run time.
+    bool ConstantFolder::Evaluate(BinaryOperator op, const Constant& left, const Constant& right, Constant& result)
+    {
+        using Kind = Type::Kind;
+        const Value a = left.value;
+        const Value b = right.value;
+        const Kind kind = left.kind;
+        const bool isInteger = kind == Kind::Int || kind == Kind::UInt;
+
+        auto number = [&](Value value) { result = { kind, value }; return true; };
+        auto truth = [&](bool value) { result = { Kind::Bool, Value::Bool(value) }; return true; };
+
+        switch (op)
+        {
+            case BinaryOperator::Add:
+                if (kind == Kind::Float) return number(Value::Float(a.f + b.f));
+                return isInteger && number(Value::UInt(a.u + b.u));
+            case BinaryOperator::Subtract:
+                if (kind == Kind::Float) return number(Value::Float(a.f - b.f));
+                return isInteger && number(Value::UInt(a.u - b.u));
+            case BinaryOperator::Multiply:
+                if (kind == Kind::Float) return number(Value::Float(a.f * b.f));
+                return isInteger && number(Value::UInt(a.u * b.u));
+            case BinaryOperator::Divide:
+                if (kind == Kind::Float) return number(Value::Float(a.f / b.f));
+                if (!isInteger || b.u == 0) return false;
+                if (kind == Kind::UInt) return number(Value::UInt(a.u / b.u));
+                return number(b.i == -1 ? Value::UInt(0 - a.u) : Value::Int(a.i / b.i));
+            case BinaryOperator::Modulo:
+                if (kind == Kind::Float) return number(Value::Float(std::fmod(a.f, b.f)));
+                if (!isInteger || b.u == 0) return false;
+                if (kind == Kind::UInt) return number(Value::UInt(a.u % b.u));
+                return number(b.i == -1 ? Value::Int(0) : Value::Int(a.i % b.i));
+            case BinaryOperator::BitwiseAnd:
+                return (isInteger || kind == Kind::Bool) && number(Value::UInt(a.u & b.u));
+            case BinaryOperator::BitwiseOr:
+                return (isInteger || kind == Kind::Bool) && number(Value::UInt(a.u | b.u));
+            case BinaryOperator::BitwiseXor:
+                return (isInteger || kind == Kind::Bool) && number(Value::UInt(a.u ^ b.u));
+            case BinaryOperator::LeftShift:
+                return isInteger && number(Value::UInt(a.u << (b.u & 63)));
+            case BinaryOperator::RightShift:
+                if (kind == Kind::UInt) return number(Value::UInt(a.u >> (b.u & 63)));
+                return kind == Kind::Int && number(Value::Int(a.i >> (b.u & 63)));
+            case BinaryOperator::Equal:
+            case BinaryOperator::NotEqual:
+            {
+                bool equal;
+                if (kind == Kind::Float)
+                    equal = a.f == b.f;
+                else if (isInteger || kind == Kind::Bool)
+                    equal = a.u == b.u;
+                else
+                    return false;
+                return truth(equal == (op == BinaryOperator::Equal));
+            }
+            case BinaryOperator::Less:
+            case BinaryOperator::Greater:
+            case BinaryOperator::LessEqual:
+            case BinaryOperator::GreaterEqual:
+            {
+                // Greater* are Less* with the operands swapped, as in the VM.
+                bool swap = op == BinaryOperator::Greater || op == BinaryOperator::GreaterEqual;
+                bool orEqual = op == BinaryOperator::LessEqual || op == BinaryOperator::GreaterEqual;
+                Value x = swap ? b : a;
+                Value y = swap ? a : b;
+                switch (kind)
+                {
+                    case Kind::Int: return truth(orEqual ? x.i <= y.i : x.i < y.i);
+                    case Kind::UInt: return truth(orEqual ? x.u <= y.u : x.u < y.u);
+                    case Kind::Float: return truth(orEqual ? x.f <= y.f : x.f < y.f);
+                    default: return false;
+                }
+            }
+            default:
+                return false;
+        }
+    }
+
+    LiteralNode* ConstantFolder::MakeLiteral(const Constant& constant, const Type* type)
+    {
+        char buffer[32];
+        std::to_chars_result written{ buffer, std::errc() };
+        switch (constant.kind)
+        {
+            case Type::Kind::Int:
+                written = std::to_chars(buffer, buffer + sizeof(buffer), constant.value.i);
+                break;
+            case Type::Kind::UInt:
+                written = std::to_chars(buffer, buffer + sizeof(buffer), constant.value.u);
+                break;
+            case Type::Kind::Float:
+                // Shortest form that reads back as the same double.
+                written = std::to_chars(buffer, buffer + sizeof(buffer), constant.value.f);
+                break;
+            default:
+                break;
+        }
+
+        auto* literal = arena.New<LiteralNode>();
+        if (constant.kind == Type::Kind::Bool)
+            literal->value = constant.value.AsBool() ? "true" : "false";
+        else
+            literal->value = arena.CopyString({ buffer, static_cast<size_t>(written.ptr - buffer) });
+        literal->evaluatedType = type;
+        return literal;
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <AST.h>
+#include <AstArena.h>
+#include <Bytecode.h>
+#include <ErrorReporter.h>
+#include <TypeTable.h>
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // AST-level optimization pass that runs on analyzed trees. It folds
+    // constant int, uint, float and bool expressions with the VM's
+    // semantics, substitutes `let` constants whose initializer folded to
+    // a literal, drops if/switch branches that a constant condition rules
+    // out and removes statements that follow a return, break or continue.
+    // Anything the VM would trap on at run time, such as a division by
+    // zero, is left alone.
+    class ConstantFolder
+    {
+    public:
+        // New nodes are allocated from arena, which must outlive the trees.
+        explicit ConstantFolder(AstArena& arena);
+
+        // Modules share one constant table, so a global `let` in one module
+        // folds into the others. Global initializers are folded first. False
+        // if two case labels of a switch folded to the same value, which the
+        // analyzer cannot see for labels such as `case 1 + 1:` or a `let`.
+        bool Fold(std::span<ASTNode* const> modules);
+        // Folds the global initializers of every module but only the given
+        // top-level functions and classes.
+        bool Fold(std::span<ASTNode* const> modules, std::span<ASTNode* const> declarations);
+        // One reporter per module, in module order, like the analyzer's.
+        const std::vector<ErrorReporter>& GetErrors() const { return errors; }
+
+    private:
+        struct Constant
+        {
+            Type::Kind kind;
+            Value value;
+        };
+
+        AstArena& arena;
+        std::unordered_map<const Symbol*, const LiteralNode*> constants;
+        std::vector<ErrorReporter> errors;
+        size_t currentModule = 0;
+
+        void FoldGlobals(std::span<ASTNode* const> modules);
+        bool HasErrors() const;
+
+        // Statements return their replacement, or nullptr when they can go.
+        ASTNode* FoldStatement(ASTNode* statement);
+        std::span<ASTNodePtr> FoldStatements(std::span<ASTNodePtr> statements);
+        void FoldBody(ASTNodePtr& body);
+        void FoldVariable(VariableDeclarationNode* variable);
+        ASTNode* FoldIf(IfStatementNode* ifStatement);
+        ASTNode* FoldSwitch(SwitchStatementNode* switchStatement);
+
+        // Expressions return their replacement, which may be the node itself.
+        ASTNode* FoldExpression(ASTNode* expression);
+        ASTNode* FoldIdentifier(IdentifierNode* identifier);
+        ASTNode* FoldBinary(BinaryExpressionNode* expression);
+        ASTNode* FoldUnary(UnaryExpressionNode* expression);
+
+        static bool ReadConstant(const ASTNode* node, Constant& constant);
+        static bool Evaluate(BinaryOperator op, const Constant& left, const Constant& right, Constant& result);
+        LiteralNode* MakeLiteral(const Constant& constant, const Type* type);
+    };
+} // namespace Arcanelab::Mano
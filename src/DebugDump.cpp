@@ -0,0 +1,588 @@
+#include <DebugDump.h>
+#include <ASTVisitor.h>
+#include <ErrorReporter.h>
+#include <Lexer.h>
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        // Output collected in a large buffer and handed to stdio in few
+        // writes. A failed write is remembered and reported by Close.
+        class DumpWriter
+        {
+        public:
+            explicit DumpWriter(const std::string& path)
+                : file(std::fopen(path.c_str(), "wb")),
+                buffer(std::make_unique<char[]>(BufferSize))
+            {
+            }
+            ~DumpWriter() { Close(); }
+            DumpWriter(const DumpWriter&) = delete;
+            DumpWriter& operator=(const DumpWriter&) = delete;
+
+            bool IsOpen() const { return file != nullptr; }
+
+            // The writers return how many bytes they wrote, for Pad.
+            size_t Write(std::string_view text)
+            {
+                if (text.size() > BufferSize - used)
+                {
+                    Flush();
+                    if (text.size() > BufferSize)
+                    {
+                        failed |= std::fwrite(text.data(), 1, text.size(), file) != text.size();
+                        return text.size();
+                    }
+                }
+                std::memcpy(buffer.get() + used, text.data(), text.size());
+                used += text.size();
+                return text.size();
+            }
+
+            size_t Put(char c)
+            {
+                if (used == BufferSize)
+                    Flush();
+                buffer[used++] = c;
+                return 1;
+            }
+
+            size_t Number(uint64_t value)
+            {
+                char digits[20];
+                auto result = std::to_chars(digits, digits + sizeof(digits), value);
+                return Write({ digits, static_cast<size_t>(result.ptr - digits) });
+            }
+
+            void Varint(uint64_t value)
+            {
+                while (value >= 0x80)
+                {
+                    Put(static_cast<char>(value | 0x80));
+                    value >>= 7;
+                }
+                Put(static_cast<char>(value));
+            }
+
+            // Spaces after a field of the given length up to width, like a
+            // left aligned setw.
+            void Pad(size_t length, size_t width)
+            {
+                for (size_t i = length; i < width; i++)
+                    Put(' ');
+            }
+
+            void Column(std::string_view text, size_t width) { Pad(Write(text), width); }
+
+            bool Close()
+            {
+                if (!file)
+                    return false;
+                Flush();
+                failed |= std::fclose(file) != 0;
+                file = nullptr;
+                return !failed;
+            }
+
+        private:
+            static constexpr size_t BufferSize = 64 * 1024;
+
+            std::FILE* file;
+            std::unique_ptr<char[]> buffer;
+            size_t used = 0;
+            bool failed = false;
+
+            void Flush()
+            {
+                if (used)
+                    failed |= std::fwrite(buffer.get(), 1, used, file) != used;
+                used = 0;
+            }
+        };
+
+        constexpr std::string_view NodeTypeNames[] =
+        {
+#define MANO_AST_TYPE_NAME(type, node) #type,
+            MANO_AST_NODES(MANO_AST_TYPE_NAME)
+#undef MANO_AST_TYPE_NAME
+        };
+
+        constexpr std::string_view NodeNames[] =
+        {
+#define MANO_AST_NODE_NAME(type, node) #node,
+            MANO_AST_NODES(MANO_AST_NODE_NAME)
+#undef MANO_AST_NODE_NAME
+        };
+
+        std::string_view TokenTypeName(TokenType type)
+        {
+            switch (type)
+            {
+                case TokenType::Identifier:     return "Identifier";
+                case TokenType::Keyword:        return "Keyword";
+                case TokenType::Number:         return "Number";
+                case TokenType::String:         return "String";
+                case TokenType::Operator:       return "Operator";
+                case TokenType::Punctuation:    return "Punctuation";
+                case TokenType::EndOfFile:      return "EndOfFile";
+                case TokenType::Unknown:        return "Unknown";
+            }
+            return "Unknown";
+        }
+
+        std::string_view OperatorText(BinaryOperator op)
+        {
+            switch (op)
+            {
+                case BinaryOperator::Assign:        return "=";
+                case BinaryOperator::LogicalOr:     return "||";
+                case BinaryOperator::LogicalAnd:    return "&&";
+                case BinaryOperator::BitwiseOr:     return "|";
+                case BinaryOperator::BitwiseXor:    return "^";
+                case BinaryOperator::BitwiseAnd:    return "&";
+                case BinaryOperator::Equal:         return "==";
+                case BinaryOperator::NotEqual:      return "!=";
+                case BinaryOperator::Less:          return "<";
+                case BinaryOperator::Greater:       return ">";
+                case BinaryOperator::LessEqual:     return "<=";
+                case BinaryOperator::GreaterEqual:  return ">=";
+                case BinaryOperator::LeftShift:     return "<<";
+                case BinaryOperator::RightShift:    return ">>";
+                case BinaryOperator::Add:           return "+";
+                case BinaryOperator::Subtract:      return "-";
+                case BinaryOperator::Multiply:      return "*";
+                case BinaryOperator::Divide:        return "/";
+                case BinaryOperator::Modulo:        return "%";
+            }
+            return "op";
+        }
+
+        // The name, operator, member or literal text a node is labeled
+        // with; empty for nodes that have none.
+        std::string_view NodeText(const ASTNode* node)
+        {
+            switch (node->nodeType)
+            {
+                case ASTType::Type:                 return static_cast<const TypeNode*>(node)->name;
+                case ASTType::VariableDeclaration:  return static_cast<const VariableDeclarationNode*>(node)->name;
+                case ASTType::FunctionDeclaration:  return static_cast<const FunctionDeclarationNode*>(node)->name;
+                case ASTType::ClassDeclaration:     return static_cast<const ClassDeclarationNode*>(node)->name;
+                case ASTType::EnumDeclaration:      return static_cast<const EnumDeclarationNode*>(node)->name;
+                case ASTType::MemberAccess:         return static_cast<const MemberAccessNode*>(node)->memberName;
+                case ASTType::BinaryExpression:     return OperatorText(static_cast<const BinaryExpressionNode*>(node)->op);
+                case ASTType::UnaryExpression:      return static_cast<const UnaryExpressionNode*>(node)->op;
+                case ASTType::Literal:              return static_cast<const LiteralNode*>(node)->value;
+                case ASTType::Identifier:           return static_cast<const IdentifierNode*>(node)->name;
+                case ASTType::FunctionCall:         return static_cast<const FunctionCallNode*>(node)->name;
+                case ASTType::ObjectInstantiation:  return static_cast<const ObjectInstantiationNode*>(node)->name;
+                default:                            return {};
+            }
+        }
+
+        size_t ChildCount(const ASTNode* node)
+        {
+            size_t count = 0;
+            ForEachChild(const_cast<ASTNode*>(node), [&](ASTNode*) { count++; });
+            return count;
+        }
+
+        // The indented listing. Parameters, enum values and switch cases are
+        // printed as pseudo-nodes. The prefix of a line is rebuilt from one
+        // flag per enclosing level, whether that level still has a sibling
+        // below it, so no line allocates.
+        class TreeDump
+        {
+        public:
+            explicit TreeDump(DumpWriter& out) : out(out) {}
+
+            void Node(const ASTNode* node, bool isLast)
+            {
+                if (!node)
+                    return;
+                Branch(isLast);
+                Label(node);
+                out.Put('\n');
+
+                rails.push_back(!isLast);
+                switch (node->nodeType)
+                {
+                    case ASTType::FunctionDeclaration:
+                    {
+                        auto* function = static_cast<const FunctionDeclarationNode*>(node);
+                        for (size_t i = 0; i < function->parameters.size(); i++)
+                        {
+                            bool lastParameter = i == function->parameters.size() - 1;
+                            Branch(lastParameter);
+                            out.Write("Param: ");
+                            out.Write(function->parameters[i].name);
+                            out.Put('\n');
+                            rails.push_back(!lastParameter);
+                            Node(function->parameters[i].type, true);
+                            rails.pop_back();
+                        }
+                        Node(function->returnType, !function->body);
+                        Node(function->body, true);
+                        break;
+                    }
+                    case ASTType::EnumDeclaration:
+                        for (std::string_view value : static_cast<const EnumDeclarationNode*>(node)->values)
+                        {
+                            Branch(false);
+                            out.Write("EnumValue: ");
+                            out.Write(value);
+                            out.Put('\n');
+                        }
+                        break;
+                    case ASTType::SwitchStatement:
+                    {
+                        auto* switchStatement = static_cast<const SwitchStatementNode*>(node);
+                        for (size_t i = 0; i < switchStatement->cases.size(); i++)
+                        {
+                            bool lastCase = i == switchStatement->cases.size() - 1 && !switchStatement->defaultCase;
+                            Branch(lastCase);
+                            out.Write("Case:\n");
+                            rails.push_back(!lastCase);
+                            Node(switchStatement->cases[i].first, false);
+                            Node(switchStatement->cases[i].second, true);
+                            rails.pop_back();
+                        }
+                        if (switchStatement->defaultCase)
+                        {
+                            Branch(true);
+                            out.Write("Default:\n");
+                            rails.push_back(true);
+                            Node(switchStatement->defaultCase, true);
+                            rails.pop_back();
+                        }
+                        Node(switchStatement->expression, true);
+                        break;
+                    }
+                    default:
+                    {
+                        size_t remaining = ChildCount(node);
+                        ForEachChild(const_cast<ASTNode*>(node), [&](ASTNode* child) { Node(child, --remaining == 0); });
+                        break;
+                    }
+                }
+                rails.pop_back();
+            }
+
+        private:
+            DumpWriter& out;
+            std::vector<bool> rails;
+
+            void Branch(bool isLast)
+            {
+                for (bool rail : rails)
+                    out.Write(rail ? "│   " : "    ");
+                out.Write(isLast ? "└── " : "├── ");
+            }
+
+            void Label(const ASTNode* node)
+            {
+                out.Write(NodeNames[static_cast<size_t>(node->nodeType)]);
+                switch (node->nodeType)
+                {
+                    case ASTType::Program:
+                    case ASTType::Block:
+                    case ASTType::ClassBlock:
+                    case ASTType::ExpressionStatement:
+                    case ASTType::ReturnStatement:
+                    case ASTType::IfStatement:
+                    case ASTType::ForStatement:
+                    case ASTType::WhileStatement:
+                    case ASTType::SwitchStatement:
+                    case ASTType::IndexAccess:
+                    case ASTType::BreakStatement:
+                    case ASTType::ContinueStatement:
+                    case ASTType::ArrayLiteral:
+                        return;
+                    case ASTType::Type:
+                        out.Write(static_cast<const TypeNode*>(node)->isConst ? " (const " : " (");
+                        break;
+                    case ASTType::MemberAccess:
+                        out.Write(" (.");
+                        break;
+                    default:
+                        out.Write(" (");
+                        break;
+                }
+                out.Write(NodeText(node));
+                out.Put(')');
+            }
+        };
+
+        // Compact, one line; see AstDumpFormat.
+        class JsonDump
+        {
+        public:
+            explicit JsonDump(DumpWriter& out) : out(out) {}
+
+            void Node(const ASTNode* node)
+            {
+                out.Write("{\"node\":\"");
+                out.Write(NodeTypeNames[static_cast<size_t>(node->nodeType)]);
+                out.Put('"');
+                switch (node->nodeType)
+                {
+                    case ASTType::Type:
+                    {
+                        auto* type = static_cast<const TypeNode*>(node);
+                        Field("name", type->name);
+                        if (type->array)
+                            out.Write(",\"array\":true");
+                        if (type->isConst)
+                            out.Write(",\"const\":true");
+                        break;
+                    }
+                    case ASTType::FunctionDeclaration:
+                    {
+                        auto* function = static_cast<const FunctionDeclarationNode*>(node);
+                        Field("name", function->name);
+                        out.Write(",\"parameters\":[");
+                        for (size_t i = 0; i < function->parameters.size(); i++)
+                        {
+                            if (i)
+                                out.Put(',');
+                            String(function->parameters[i].name);
+                        }
+                        out.Put(']');
+                        break;
+                    }
+                    case ASTType::EnumDeclaration:
+                    {
+                        auto* enumeration = static_cast<const EnumDeclarationNode*>(node);
+                        Field("name", enumeration->name);
+                        out.Write(",\"values\":[");
+                        for (size_t i = 0; i < enumeration->values.size(); i++)
+                        {
+                            if (i)
+                                out.Put(',');
+                            String(enumeration->values[i]);
+                        }
+                        out.Put(']');
+                        break;
+                    }
+                    case ASTType::SwitchStatement:
+                    {
+                        auto* switchStatement = static_cast<const SwitchStatementNode*>(node);
+                        out.Write(",\"cases\":");
+                        out.Number(switchStatement->cases.size());
+                        out.Write(switchStatement->defaultCase ? ",\"default\":true" : ",\"default\":false");
+                        break;
+                    }
+                    case ASTType::BinaryExpression:
+                    case ASTType::UnaryExpression:
+                        Field("op", NodeText(node));
+                        break;
+                    case ASTType::Literal:
+                        Field("value", NodeText(node));
+                        break;
+                    case ASTType::MemberAccess:
+                        Field("member", NodeText(node));
+                        break;
+                    case ASTType::VariableDeclaration:
+                    case ASTType::ClassDeclaration:
+                    case ASTType::Identifier:
+                    case ASTType::FunctionCall:
+                    case ASTType::ObjectInstantiation:
+                        Field("name", NodeText(node));
+                        break;
+                    default:
+                        break;
+                }
+
+                bool hasChildren = false;
+                ForEachChild(const_cast<ASTNode*>(node), [&](ASTNode* child)
+                {
+                    out.Write(hasChildren ? "," : ",\"children\":[");
+                    hasChildren = true;
+                    Node(child);
+                });
+                if (hasChildren)
+                    out.Put(']');
+                out.Put('}');
+            }
+
+        private:
+            DumpWriter& out;
+
+            void Field(std::string_view key, std::string_view value)
+            {
+                out.Write(",\"");
+                out.Write(key);
+                out.Write("\":");
+                String(value);
+            }
+
+            void String(std::string_view text)
+            {
+                static constexpr char Hex[] = "0123456789abcdef";
+                out.Put('"');
+                for (char c : text)
+                {
+                    switch (c)
+                    {
+                        case '"':   out.Write("\\\""); break;
+                        case '\\':  out.Write("\\\\"); break;
+                        case '\n':  out.Write("\\n"); break;
+                        case '\r':  out.Write("\\r"); break;
+                        case '\t':  out.Write("\\t"); break;
+                        default:
+                            if (static_cast<unsigned char>(c) < 0x20)
+                            {
+                                out.Write("\\u00");
+                                out.Put(Hex[c >> 4]);
+                                out.Put(Hex[c & 15]);
+                            }
+                            else
+                            {
+                                out.Put(c);
+                            }
+                            break;
+                    }
+                }
+                out.Put('"');
+            }
+        };
+
+        // Preorder, see AstDumpFormat.
+        class BinaryDump
+        {
+        public:
+            explicit BinaryDump(DumpWriter& out) : out(out) {}
+
+            void Node(const ASTNode* node)
+            {
+                out.Put(static_cast<char>(node->nodeType));
+                switch (node->nodeType)
+                {
+                    case ASTType::Type:
+                    {
+                        auto* type = static_cast<const TypeNode*>(node);
+                        out.Put(static_cast<char>((type->array ? 1 : 0) | (type->isConst ? 2 : 0)));
+                        String(type->name);
+                        break;
+                    }
+                    case ASTType::FunctionDeclaration:
+                    {
+                        auto* function = static_cast<const FunctionDeclarationNode*>(node);
+                        String(function->name);
+                        out.Varint(function->parameters.size());
+                        for (const Parameter& parameter : function->parameters)
+                            String(parameter.name);
+                        break;
+                    }
+                    case ASTType::EnumDeclaration:
+                    {
+                        auto* enumeration = static_cast<const EnumDeclarationNode*>(node);
+                        String(enumeration->name);
+                        out.Varint(enumeration->values.size());
+                        for (std::string_view value : enumeration->values)
+                            String(value);
+                        break;
+                    }
+                    case ASTType::SwitchStatement:
+                    {
+                        auto* switchStatement = static_cast<const SwitchStatementNode*>(node);
+                        out.Varint(switchStatement->cases.size());
+                        out.Put(switchStatement->defaultCase ? '\1' : '\0');
+                        break;
+                    }
+                    case ASTType::BinaryExpression:
+                        out.Put(static_cast<char>(static_cast<const BinaryExpressionNode*>(node)->op));
+                        break;
+                    case ASTType::VariableDeclaration:
+                    case ASTType::ClassDeclaration:
+                    case ASTType::MemberAccess:
+                    case ASTType::UnaryExpression:
+                    case ASTType::Literal:
+                    case ASTType::Identifier:
+                    case ASTType::FunctionCall:
+                    case ASTType::ObjectInstantiation:
+                        String(NodeText(node));
+                        break;
+                    default:
+                        break;
+                }
+
+                out.Varint(ChildCount(node));
+                ForEachChild(const_cast<ASTNode*>(node), [&](ASTNode* child) { Node(child); });
+            }
+
+        private:
+            DumpWriter& out;
+
+            void String(std::string_view text)
+            {
+                out.Varint(text.size());
+                out.Write(text);
+            }
+        };
+    }
+
+    bool DumpTokens(std::string_view source, const std::string& path)
+    {
+        DumpWriter out(path);
+        if (!out.IsOpen())
+            return false;
+
+        out.Column("Index", 5);
+        out.Column("Lexeme", 10);
+        out.Column("Coordinates", 10);
+        out.Write("Token Type\n");
+        for (size_t i = 0; i < 8 + 20 + 16 + 12; i++)
+            out.Put('-');
+        out.Put('\n');
+
+        ErrorReporter errors(ErrorReporter::Phase::Lexer);
+        Lexer lexer(source, errors);
+        const SourceMap& sourceMap = lexer.GetSourceMap();
+        uint64_t index = 0;
+        Token token;
+        do
+        {
+            token = lexer.NextToken();
+            SourceMap::Location location = sourceMap.Resolve(token);
+
+            out.Pad(out.Number(index++), 5);
+            out.Column(sourceMap.Text(token), 10);
+            size_t coordinates = out.Put('(') + out.Number(location.line) + out.Write(", ") + out.Number(location.column) + out.Put(')');
+            out.Pad(coordinates, 10);
+            out.Write(TokenTypeName(token.type));
+            out.Put('\n');
+        } while (token.type != TokenType::EndOfFile);
+        return out.Close();
+    }
+
+    bool DumpAst(const ASTNode* root, const std::string& path, AstDumpFormat format)
+    {
+        DumpWriter out(path);
+        if (!out.IsOpen())
+            return false;
+
+        switch (format)
+        {
+            case AstDumpFormat::Tree:
+                TreeDump(out).Node(root, true);
+                break;
+            case AstDumpFormat::Json:
+                JsonDump(out).Node(root);
+                out.Put('\n');
+                break;
+            case AstDumpFormat::Binary:
+                out.Write("MAST");
+                out.Put(static_cast<char>(AstDumpVersion));
+                BinaryDump(out).Node(root);
+                break;
+        }
+        return out.Close();
+    }
+} // namespace Arcanelab::Mano
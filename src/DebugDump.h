@@ -0,0 +1,50 @@
+#pragma once
+
+#include <AST.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Arcanelab::Mano
+{
+    // Layouts of the AST dump. Tree is the indented listing meant for
+    // reading. Json is one object per node:
+    //
+    //   { "node": "Literal", "value": "\"Hi\"", "children": [ ... ] }
+    //
+    // with the node's name, operator or value where it has one and its
+    // children, if any, in ForEachChild order. Parameter names, enum values
+    // and switch case counts, which are not nodes, are listed as
+    // "parameters", "values", "cases" and "default". Binary holds the same
+    // in preorder: the bytes "MAST" and a version byte, then per node its
+    // ASTType as a byte, its attributes and a child count, then the
+    // children. Counts and string lengths are LEB128 varints; strings are
+    // not terminated.
+    //
+    //   Type                   flags byte (1: array, 2: const), name
+    //   Binary                 BinaryOperator as a byte
+    //   Unary, Member access   operator or member name
+    //   Literal                value as written, quotes included
+    //   FunctionDeclaration    name, parameter count, parameter names
+    //   EnumDeclaration        name, value count, values
+    //   SwitchStatement        case count, default byte (0 or 1)
+    //   other named nodes      name
+    enum class AstDumpFormat { Tree, Json, Binary };
+
+    // Debug dumps of what the front end saw. Every dump is off until given
+    // a path.
+    struct DumpOptions
+    {
+        std::string tokensPath;
+        std::string astPath;
+        AstDumpFormat astFormat = AstDumpFormat::Tree;
+    };
+
+    inline constexpr uint8_t AstDumpVersion = 1;
+
+    // Both return false if the file cannot be written. The token dump lexes
+    // the source a second time, so the parser can keep streaming its tokens.
+    bool DumpTokens(std::string_view source, const std::string& path);
+    bool DumpAst(const ASTNode* root, const std::string& path, AstDumpFormat format);
+} // namespace Arcanelab::Mano
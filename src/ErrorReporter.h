@@ -8,7 +8,7 @@ namespace Arcanelab::Mano
     class ErrorReporter
     {
     public:
-        enum class Phase { Lexer, Parser, Semantic };
+        enum class Phase { Lexer, Parser, Semantic, CodeGen };
         enum class Severity { Error, Warning };
 
         // Constructor binds to specific phase
@@ -0,0 +1,78 @@
+#include <IdentifierTable.h>
+#include <Token.h>
+
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace Arcanelab::Mano
+{
+    IdentifierTable::IdentifierTable()
+        : slots(256, Slot{ 0, NoIdentifier })
+    {
+    }
+
+    namespace
+    {
+        uint32_t HashName(std::string_view name)
+        {
+            return static_cast<uint32_t>(std::hash<std::string_view>{}(name));
+        }
+    }
+
+    uint32_t IdentifierTable::Intern(std::string_view name)
+    {
+        return Intern(name, HashName(name));
+    }
+
+    uint32_t IdentifierTable::Intern(std::string_view name, uint32_t hash)
+    {
+        std::lock_guard lock(mutex);
+        size_t mask = slots.size() - 1;
+        size_t index = hash & mask;
+        while (slots[index].id != NoIdentifier)
+        {
+            const Slot& slot = slots[index];
+            if (slot.hash == hash && spellings[slot.id] == name)
+                return slot.id;
+            index = (index + 1) & mask;
+        }
+
+        // The last value is reserved for NoIdentifier.
+        if (spellings.size() >= std::numeric_limits<uint32_t>::max())
+            throw std::length_error("Too many distinct identifiers");
+        auto id = static_cast<uint32_t>(spellings.size());
+        spellings.push_back(storage.CopyString(name));
+        slots[index] = Slot{ hash, id };
+        if (spellings.size() * 2 > slots.size())
+            Grow();
+        return id;
+    }
+
+    void IdentifierTable::Grow()
+    {
+        std::vector<Slot> grown(slots.size() * 2, Slot{ 0, NoIdentifier });
+        size_t mask = grown.size() - 1;
+        for (const Slot& slot : slots)
+        {
+            if (slot.id == NoIdentifier)
+                continue;
+            size_t index = slot.hash & mask;
+            while (grown[index].id != NoIdentifier)
+                index = (index + 1) & mask;
+            grown[index] = slot;
+        }
+        slots = std::move(grown);
+    }
+
+    // Identifiers are never empty, so an unused entry never matches.
+    uint32_t IdentifierCache::Intern(std::string_view name)
+    {
+        uint32_t hash = HashName(name);
+        Entry& entry = entries[hash & (Size - 1)];
+        if (entry.hash == hash && entry.name == name)
+            return entry.id;
+        entry = Entry{ name, hash, table.Intern(name, hash) };
+        return entry.id;
+    }
+} // namespace Arcanelab::Mano
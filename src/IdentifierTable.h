@@ -0,0 +1,74 @@
+#pragma once
+
+#include <AstArena.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Maps every distinct identifier spelling to a dense 32-bit id, so the
+    // analyzer compares and indexes names by id instead of hashing strings.
+    // One table is shared by all modules of a compilation; lexers intern
+    // from several threads at once, each through an IdentifierCache.
+    class IdentifierTable
+    {
+    public:
+        IdentifierTable();
+        IdentifierTable(const IdentifierTable&) = delete;
+        IdentifierTable& operator=(const IdentifierTable&) = delete;
+
+        // Returns the id of name, assigning the next free one on first sight.
+        uint32_t Intern(std::string_view name);
+
+    private:
+        friend class IdentifierCache;
+
+        // Open-addressed; an empty slot has id NoIdentifier. The low hash bits
+        // are kept next to the id so most mismatches skip the string compare.
+        struct Slot
+        {
+            uint32_t hash;
+            uint32_t id;
+        };
+
+        std::mutex mutex;
+        AstArena storage{ 16 * 1024 };              // Owns the spellings, so sources may go away first
+        std::vector<std::string_view> spellings;   // Indexed by id
+        std::vector<Slot> slots;                   // Size is a power of two
+
+        uint32_t Intern(std::string_view name, uint32_t hash);
+        void Grow();
+    };
+
+    // A lexer's front to a shared table. It remembers the ids of the names
+    // it saw last, so a name repeated within a file, which most are, is
+    // resolved without taking the table's lock. Names are kept as views
+    // into the source, which must outlive the cache.
+    class IdentifierCache
+    {
+    public:
+        explicit IdentifierCache(IdentifierTable& table) : table(table) {}
+        IdentifierCache(const IdentifierCache&) = delete;
+        IdentifierCache& operator=(const IdentifierCache&) = delete;
+
+        uint32_t Intern(std::string_view name);
+
+    private:
+        // Direct-mapped by hash; a newer name evicts whatever shared its slot.
+        struct Entry
+        {
+            std::string_view name;
+            uint32_t hash = 0;
+            uint32_t id = 0;
+        };
+        static constexpr size_t Size = 256;
+
+        IdentifierTable& table;
+        std::array<Entry, Size> entries{};
+    };
+} // namespace Arcanelab::Mano
@@ -0,0 +1,399 @@
+#include <IncrementalCompiler.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        uint64_t MixWord(uint64_t hash, uint64_t word)
+        {
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+            return hash ^ (hash >> 29);
+        }
+
+        uint64_t HashName(std::string_view name)
+        {
+            uint64_t hash = MixWord(0, name.size());
+            for (size_t i = 0; i < name.size(); i += 8)
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, name.data() + i, std::min<size_t>(8, name.size() - i));
+                hash = MixWord(hash, word);
+            }
+            return hash;
+        }
+
+        // Hashes a tree a word at a time. Every node is framed by its type
+        // and an end marker and a missing child hashes as a marker of its
+        // own, so trees of different shape hash differently. The names the
+        // tree calls or reads are collected, hashed, on the way.
+        class TreeHasher
+        {
+        public:
+            explicit TreeHasher(std::vector<uint64_t>& references) : references(references) {}
+
+            uint64_t Hash() const { return hash; }
+
+            void Mix(uint64_t value) { hash = MixWord(hash, value); }
+            void Mix(std::string_view text) { Mix(HashName(text)); }
+
+            // What callers depend on: parameter and return types.
+            void Signature(const FunctionDeclarationNode* function)
+            {
+                Mix(static_cast<uint64_t>(function->parameters.size()));
+                for (const Parameter& parameter : function->parameters)
+                    Node(parameter.type);
+                Node(function->returnType);
+            }
+
+            void Body(const FunctionDeclarationNode* function)
+            {
+                for (const Parameter& parameter : function->parameters)
+                    Mix(parameter.name);
+                Node(function->body);
+            }
+
+            void Node(ASTNode* node)
+            {
+                if (!node)
+                {
+                    Mix(MissingMarker);
+                    return;
+                }
+
+                Mix(static_cast<uint64_t>(node->nodeType));
+                switch (node->nodeType)
+                {
+                    case ASTType::Type:
+                    {
+                        auto* type = static_cast<TypeNode*>(node);
+                        Mix(type->name);
+                        Mix(static_cast<uint64_t>(type->array) << 1 | static_cast<uint64_t>(type->isConst));
+                        break;
+                    }
+                    case ASTType::VariableDeclaration:
+                    {
+                        auto* variable = static_cast<VariableDeclarationNode*>(node);
+                        Mix(variable->name);
+                        Node(variable->declaredType);
+                        Node(variable->initializer);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::FunctionDeclaration:
+                    {
+                        auto* function = static_cast<FunctionDeclarationNode*>(node);
+                        Mix(function->name);
+                        Signature(function);
+                        Body(function);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::ClassDeclaration:
+                        Mix(static_cast<ClassDeclarationNode*>(node)->name);
+                        break;
+                    case ASTType::EnumDeclaration:
+                    {
+                        auto* enumeration = static_cast<EnumDeclarationNode*>(node);
+                        Mix(enumeration->name);
+                        for (std::string_view value : enumeration->values)
+                            Mix(value);
+                        break;
+                    }
+                    case ASTType::ReturnStatement:
+                        Node(static_cast<ReturnStatementNode*>(node)->expression);
+                        Mix(EndMarker);
+                        return;
+                    case ASTType::IfStatement:
+                    {
+                        auto* ifStatement = static_cast<IfStatementNode*>(node);
+                        Node(ifStatement->condition);
+                        Node(ifStatement->thenBranch);
+                        Node(ifStatement->elseBranch);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::ForStatement:
+                    {
+                        auto* forStatement = static_cast<ForStatementNode*>(node);
+                        Node(forStatement->init);
+                        Node(forStatement->condition);
+                        Node(forStatement->update);
+                        Node(forStatement->body);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::SwitchStatement:
+                    {
+                        auto* switchStatement = static_cast<SwitchStatementNode*>(node);
+                        Node(switchStatement->expression);
+                        for (auto& [caseExpression, caseBlock] : switchStatement->cases)
+                        {
+                            Node(caseExpression);
+                            Node(caseBlock);
+                        }
+                        Node(switchStatement->defaultCase);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::MemberAccess:
+                        Mix(static_cast<MemberAccessNode*>(node)->memberName);
+                        break;
+                    case ASTType::BinaryExpression:
+                        Mix(static_cast<uint64_t>(static_cast<BinaryExpressionNode*>(node)->op));
+                        break;
+                    case ASTType::UnaryExpression:
+                        Mix(static_cast<UnaryExpressionNode*>(node)->op);
+                        break;
+                    case ASTType::Literal:
+                        Mix(static_cast<LiteralNode*>(node)->value);
+                        break;
+                    case ASTType::Identifier:
+                        Mix(static_cast<IdentifierNode*>(node)->name);
+                        Reference(static_cast<IdentifierNode*>(node)->name);
+                        break;
+                    case ASTType::FunctionCall:
+                    {
+                        auto* call = static_cast<FunctionCallNode*>(node);
+                        Mix(call->name);
+                        Reference(call->name);
+                        Node(call->callTarget);
+                        for (ASTNode* argument : call->arguments)
+                            Node(argument);
+                        Mix(EndMarker);
+                        return;
+                    }
+                    case ASTType::ObjectInstantiation:
+                        Mix(static_cast<ObjectInstantiationNode*>(node)->name);
+                        Reference(static_cast<ObjectInstantiationNode*>(node)->name);
+                        break;
+                    default:
+                        break;
+                }
+                ForEachChild(node, [this](ASTNode* child) { Node(child); });
+                Mix(EndMarker);
+            }
+
+        private:
+            static constexpr uint64_t EndMarker = ~0ull;
+            static constexpr uint64_t MissingMarker = ~1ull;
+
+            uint64_t hash = 0xCBF29CE484222325ull;
+            std::vector<uint64_t>& references;
+
+            void Reference(std::string_view name)
+            {
+                if (!name.empty())
+                    references.push_back(HashName(name));
+            }
+        };
+    } // namespace
+
+    IncrementalCompiler::Outcome IncrementalCompiler::Compile(const std::vector<SourceFile>& files)
+    {
+        errors.clear();
+        recompiled = 0;
+
+        IdentifierTable identifiers;
+        std::vector<Compiler::ParsedModule> modules(files.size());
+        pool.ParallelFor(files.size(), [&](size_t index) { Compiler::ParseModule(files[index], identifiers, modules[index]); });
+
+        std::vector<ASTNode*> roots;
+        auto collect = [this](const char* label, const SourceFile& file, const ErrorReporter& reporter)
+        {
+            for (const auto& error : reporter.GetErrors())
+                errors.push_back(Compiler::FormatError(label, file, error.line, error.column, error.message));
+        };
+        for (size_t i = 0; i < modules.size(); i++)
+        {
+            collect("Lexer error", files[i], modules[i].lexErrors);
+            collect("Parse error", files[i], modules[i].parseErrors);
+            roots.push_back(modules[i].ast);
+        }
+        for (size_t i = 0; i < modules.size(); i++)
+        {
+            if (modules[i].lexErrors.HasErrors() || modules[i].parseErrors.HasErrors())
+                return Outcome::Failed;
+        }
+
+        std::vector<Declaration> next;
+        std::vector<ASTNode*> nodes;
+        for (ASTNode* root : roots)
+        {
+            for (ASTNode* declaration : static_cast<ProgramNode*>(root)->declarations)
+            {
+                next.push_back(Describe(declaration));
+                nodes.push_back(declaration);
+            }
+        }
+
+        std::vector<ASTNode*> changed;
+        bool patch = module && FindChanges(next, nodes, changed);
+        if (patch && changed.empty())
+        {
+            declarations = std::move(next);
+            return Outcome::Unchanged;
+        }
+
+        // Globals are resolved every time so their constants fold into the
+        // recompiled functions as they would in a full build.
+        AstArena arena;
+        SemanticAnalyzer analyzer(roots, arena);
+        if (binding)
+            analyzer.Bind(*binding);
+        analyzer.SetThreadPool(&pool);
+        std::vector<ASTNode*> resolved;
+        if (patch)
+        {
+            for (ASTNode* node : nodes)
+            {
+                if (node->nodeType == ASTType::VariableDeclaration)
+                    resolved.push_back(node);
+            }
+            resolved.insert(resolved.end(), changed.begin(), changed.end());
+        }
+        if (!(patch ? analyzer.Analyze(resolved) : analyzer.Analyze()))
+        {
+            for (size_t i = 0; i < files.size(); i++)
+                collect("Semantic error", files[i], analyzer.GetErrors()[i]);
+            return Outcome::Failed;
+        }
+        ConstantFolder folder(arena);
+        if (!(patch ? folder.Fold(roots, changed) : folder.Fold(roots)))
+        {
+            for (size_t i = 0; i < files.size(); i++)
+                collect("Semantic error", files[i], folder.GetErrors()[i]);
+            return Outcome::Failed;
+        }
+        ASTNodePtr ast = Compiler::MergeModules(roots, arena);
+
+        ErrorReporter codeGenErrors(ErrorReporter::Phase::CodeGen);
+        CodeGenerator codeGenerator(codeGenErrors);
+        std::unique_ptr<Module> generated = patch ? codeGenerator.Regenerate(ast, *module, changed) : codeGenerator.Generate(ast);
+        if (!generated)
+        {
+            for (const auto& error : codeGenErrors.GetErrors())
+                errors.push_back("Code generation error: " + error.message);
+            return Outcome::Failed;
+        }
+
+        module = std::move(generated);
+        recompiled = patch ? changed.size() : next.size();
+        declarations = std::move(next);
+        return patch ? Outcome::Patched : Outcome::Rebuilt;
+    }
+
+    IncrementalCompiler::Declaration IncrementalCompiler::Describe(ASTNode* node)
+    {
+        Declaration declaration{ node->nodeType, {}, 0, 0, {} };
+        TreeHasher interface(declaration.references);
+        TreeHasher body(declaration.references);
+        switch (node->nodeType)
+        {
+            case ASTType::FunctionDeclaration:
+            {
+                auto* function = static_cast<FunctionDeclarationNode*>(node);
+                declaration.name = function->name;
+                interface.Mix(function->name);
+                interface.Signature(function);
+                body.Body(function);
+                break;
+            }
+            case ASTType::ClassDeclaration:
+            {
+                // Fields and method signatures make up the layout; only the
+                // method bodies can change without a rebuild.
+                auto* cls = static_cast<ClassDeclarationNode*>(node);
+                declaration.name = cls->name;
+                interface.Mix(cls->name);
+                if (!cls->body || cls->body->nodeType != ASTType::ClassBlock)
+                {
+                    interface.Node(cls->body);
+                    break;
+                }
+                for (ASTNode* member : static_cast<ClassBlockNode*>(cls->body)->declarations)
+                {
+                    if (member->nodeType != ASTType::FunctionDeclaration)
+                    {
+                        interface.Node(member);
+                        continue;
+                    }
+                    auto* method = static_cast<FunctionDeclarationNode*>(member);
+                    interface.Mix(method->name);
+                    interface.Signature(method);
+                    body.Body(method);
+                }
+                break;
+            }
+            case ASTType::VariableDeclaration:
+                declaration.name = static_cast<VariableDeclarationNode*>(node)->name;
+                interface.Node(node);
+                break;
+            case ASTType::EnumDeclaration:
+                declaration.name = static_cast<EnumDeclarationNode*>(node)->name;
+                interface.Node(node);
+                break;
+            default:
+                interface.Node(node);
+                break;
+        }
+        declaration.interfaceHash = interface.Hash();
+        declaration.bodyHash = body.Hash();
+
+        std::sort(declaration.references.begin(), declaration.references.end());
+        declaration.references.erase(std::unique(declaration.references.begin(), declaration.references.end()), declaration.references.end());
+        return declaration;
+    }
+
+    // False when the edit needs a full rebuild; otherwise changed receives
+    // the declarations to resolve and compile again, in program order.
+    bool IncrementalCompiler::FindChanges(const std::vector<Declaration>& next, const std::vector<ASTNode*>& nodes,
+        std::vector<ASTNode*>& changed) const
+    {
+        if (next.size() != declarations.size())
+            return false;
+
+        std::unordered_set<uint64_t> signatures;            // Names of functions whose signature changed
+        std::vector<bool> dirty(next.size());
+        for (size_t i = 0; i < next.size(); i++)
+        {
+            const Declaration& before = declarations[i];
+            const Declaration& after = next[i];
+            if (before.kind != after.kind || before.name != after.name)
+                return false;
+            if (before.interfaceHash != after.interfaceHash)
+            {
+                if (after.kind != ASTType::FunctionDeclaration)
+                    return false;
+                signatures.insert(HashName(after.name));
+            }
+            dirty[i] = before.interfaceHash != after.interfaceHash || before.bodyHash != after.bodyHash;
+        }
+
+        // Callers of a changed signature are checked and compiled again.
+        // Global initializers are not recompiled, so a global that calls one
+        // forces a rebuild.
+        if (!signatures.empty())
+        {
+            for (size_t i = 0; i < next.size(); i++)
+            {
+                bool calls = std::any_of(next[i].references.begin(), next[i].references.end(),
+                    [&](uint64_t name) { return signatures.contains(name); });
+                if (calls && next[i].kind != ASTType::FunctionDeclaration && next[i].kind != ASTType::ClassDeclaration)
+                    return false;
+                dirty[i] = dirty[i] || calls;
+            }
+        }
+
+        for (size_t i = 0; i < next.size(); i++)
+        {
+            if (dirty[i])
+                changed.push_back(nodes[i]);
+        }
+        return true;
+    }
+} // namespace Arcanelab::Mano
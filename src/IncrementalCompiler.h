@@ -0,0 +1,73 @@
+#pragma once
+
+#include <AST.h>
+#include <Bytecode.h>
+#include <Compiler.h>
+#include <ThreadPool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Recompiles a program after edits, keeping the bytecode of top-level
+    // declarations that did not change. Each declaration is hashed over its
+    // tree, so formatting and comments do not count as changes, in two
+    // parts: the interface other declarations see (a function's signature,
+    // a class's fields and method signatures) and the bodies behind it.
+    //
+    // When the program declares the same globals, classes, enums and
+    // functions in the same order as last time, and only function bodies,
+    // method bodies or function signatures differ, every declaration is
+    // declared again but only the changed ones, plus those that call a
+    // function whose signature changed, are resolved and compiled. The new
+    // code is spliced into a copy of the previous module, which keeps its
+    // layout. Any other edit rebuilds the program from scratch.
+    class IncrementalCompiler
+    {
+    public:
+        enum class Outcome
+        {
+            Failed,     // Errors are in GetErrors(); the previous module stays current
+            Unchanged,  // No declaration changed
+            Patched,    // Same layout, so running VMs can switch with VM::Reload
+            Rebuilt,    // New layout, VMs need VM::Load
+        };
+
+        // Host functions the program may call, set before the first compile;
+        // the binding must outlive the compiler.
+        void SetBinding(const Binding& hostBinding) { binding = &hostBinding; }
+        Outcome Compile(const std::vector<SourceFile>& files);
+
+        // The last program that compiled, valid until the next Patched or
+        // Rebuilt outcome.
+        const Module* GetModule() const { return module.get(); }
+        const std::vector<std::string>& GetErrors() const { return errors; }
+        // Top-level declarations the last compile resolved and generated.
+        size_t GetRecompiledCount() const { return recompiled; }
+
+    private:
+        struct Declaration
+        {
+            ASTType kind;
+            std::string name;
+            uint64_t interfaceHash;
+            uint64_t bodyHash;
+            std::vector<uint64_t> references;       // Hashed names of everything it calls or reads, sorted
+        };
+
+        ThreadPool pool;
+        const Binding* binding = nullptr;
+        std::unique_ptr<Module> module;
+        std::vector<Declaration> declarations;      // Of the current module, in program order
+        std::vector<std::string> errors;
+        size_t recompiled = 0;
+
+        static Declaration Describe(ASTNode* node);
+        bool FindChanges(const std::vector<Declaration>& next, const std::vector<ASTNode*>& nodes,
+            std::vector<ASTNode*>& changed) const;
+    };
+} // namespace Arcanelab::Mano
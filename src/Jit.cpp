@@ -0,0 +1,323 @@
+#include <Jit.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#if MANO_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Arcanelab::Mano
+{
+#if MANO_JIT
+    namespace
+    {
+        static_assert(offsetof(JitContext, globals) == 0 && offsetof(JitContext, call) == 16);
+
+        // Operands a stencil is patched with. In a stencil's spec each hole
+        // stands for the bytes it is later filled with.
+        enum Hole : int
+        {
+            A = 0x100,      // disp32, byte offset of R[A] from rbx
+            B,              // disp32, R[B]
+            C,              // disp32, R[C]
+            Constant,       // imm64, the bits of K[Bx]
+            SignedBx,       // imm32, sBx
+            ImmediateB,     // imm32, B
+            GlobalBx,       // disp32, byte offset of G[Bx]
+            IndexBx,        // imm32, Bx
+            Target,         // rel32 to the jump target
+            DivisionError,  // rel32 to the division by zero exit
+            Exit,           // rel32 to the exit, with the status in eax
+        };
+
+        struct Stencil
+        {
+            std::vector<uint8_t> code;
+            std::vector<std::pair<uint32_t, Hole>> holes;
+        };
+
+        Stencil MakeStencil(const std::vector<int>& spec)
+        {
+            Stencil stencil;
+            for (int item : spec)
+            {
+                if (item < 0x100)
+                {
+                    stencil.code.push_back(static_cast<uint8_t>(item));
+                    continue;
+                }
+                stencil.holes.push_back({ static_cast<uint32_t>(stencil.code.size()), static_cast<Hole>(item) });
+                stencil.code.resize(stencil.code.size() + (item == Constant ? 8 : 4));
+            }
+            return stencil;
+        }
+
+        // Machine code for the System V calling convention. Compiled code
+        // keeps the register file in rbx and the context in r12; rax, rcx,
+        // rdx and xmm0 are scratch.
+        std::array<Stencil, static_cast<size_t>(OpCode::Count)> MakeStencils()
+        {
+            std::array<Stencil, static_cast<size_t>(OpCode::Count)> stencils;
+            auto set = [&](OpCode op, const std::vector<int>& spec) { stencils[static_cast<size_t>(op)] = MakeStencil(spec); };
+
+            // mov rax, R[B]; <op> rax, R[C]; mov R[A], rax
+            auto binary = [&](OpCode op, std::initializer_list<int> operation)
+            {
+                std::vector<int> spec = { 0x48, 0x8B, 0x83, B };
+                spec.insert(spec.end(), operation.begin(), operation.end());
+                spec.insert(spec.end(), { C, 0x48, 0x89, 0x83, A });
+                set(op, spec);
+            };
+            // mov rax, R[B]; cmp rax, R[C]; set<cc> al; movzx eax, al; mov R[A], rax
+            auto compare = [&](OpCode op, int condition)
+            {
+                set(op, { 0x48, 0x8B, 0x83, B, 0x48, 0x3B, 0x83, C, 0x0F, condition, 0xC0, 0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83, A });
+            };
+            // movsd xmm0, R[B]; <op>sd xmm0, R[C]; movsd R[A], xmm0
+            auto floating = [&](OpCode op, int operation)
+            {
+                set(op, { 0xF2, 0x0F, 0x10, 0x83, B, 0xF2, 0x0F, operation, 0x83, C, 0xF2, 0x0F, 0x11, 0x83, A });
+            };
+            // mov rax, R[B]; mov rcx, R[C]; <shift> rax, cl; mov R[A], rax
+            auto shift = [&](OpCode op, int operation)
+            {
+                set(op, { 0x48, 0x8B, 0x83, B, 0x48, 0x8B, 0x8B, C, 0x48, 0xD3, operation, 0x48, 0x89, 0x83, A });
+            };
+
+            set(OpCode::MOVE,  { 0x48, 0x8B, 0x83, B, 0x48, 0x89, 0x83, A });
+            set(OpCode::LOADK, { 0x48, 0xB8, Constant, 0x48, 0x89, 0x83, A });
+            set(OpCode::LOADI, { 0x48, 0xC7, 0x83, A, SignedBx });
+            set(OpCode::LOADB, { 0x48, 0xC7, 0x83, A, ImmediateB });
+            // mov rax, [r12]; mov rax, G[Bx]; mov R[A], rax
+            set(OpCode::GETG,  { 0x49, 0x8B, 0x04, 0x24, 0x48, 0x8B, 0x80, GlobalBx, 0x48, 0x89, 0x83, A });
+            // mov rax, [r12]; mov rcx, R[A]; mov G[Bx], rcx
+            set(OpCode::SETG,  { 0x49, 0x8B, 0x04, 0x24, 0x48, 0x8B, 0x8B, A, 0x48, 0x89, 0x88, GlobalBx });
+
+            for (OpCode op : { OpCode::ADD_I, OpCode::ADD_U })
+                binary(op, { 0x48, 0x03, 0x83 });
+            for (OpCode op : { OpCode::SUB_I, OpCode::SUB_U })
+                binary(op, { 0x48, 0x2B, 0x83 });
+            for (OpCode op : { OpCode::MUL_I, OpCode::MUL_U })
+                binary(op, { 0x48, 0x0F, 0xAF, 0x83 });
+            binary(OpCode::BAND, { 0x48, 0x23, 0x83 });
+            binary(OpCode::BOR,  { 0x48, 0x0B, 0x83 });
+            binary(OpCode::BXOR, { 0x48, 0x33, 0x83 });
+            shift(OpCode::SHL,   0xE0);
+            shift(OpCode::SHR_I, 0xF8);
+            shift(OpCode::SHR_U, 0xE8);
+
+            // Division checks for zero, and for -1, which would trap on
+            // INT64_MIN: the quotient is then the wrapped negation and the
+            // remainder zero, as in the interpreter.
+            //   mov rcx, R[C]; test rcx, rcx; jz error; mov rax, R[B]; cmp rcx, -1; jne divide
+            //   neg rax / xor edx, edx; jmp store; divide: cqo; idiv rcx; store: mov R[A], rax / rdx
+            set(OpCode::DIV_I, { 0x48, 0x8B, 0x8B, C, 0x48, 0x85, 0xC9, 0x0F, 0x84, DivisionError, 0x48, 0x8B, 0x83, B,
+                0x48, 0x83, 0xF9, 0xFF, 0x75, 0x05, 0x48, 0xF7, 0xD8, 0xEB, 0x05, 0x48, 0x99, 0x48, 0xF7, 0xF9, 0x48, 0x89, 0x83, A });
+            set(OpCode::MOD_I, { 0x48, 0x8B, 0x8B, C, 0x48, 0x85, 0xC9, 0x0F, 0x84, DivisionError, 0x48, 0x8B, 0x83, B,
+                0x48, 0x83, 0xF9, 0xFF, 0x75, 0x04, 0x31, 0xD2, 0xEB, 0x05, 0x48, 0x99, 0x48, 0xF7, 0xF9, 0x48, 0x89, 0x93, A });
+            //   mov rcx, R[C]; test rcx, rcx; jz error; mov rax, R[B]; xor edx, edx; div rcx; mov R[A], rax / rdx
+            set(OpCode::DIV_U, { 0x48, 0x8B, 0x8B, C, 0x48, 0x85, 0xC9, 0x0F, 0x84, DivisionError, 0x48, 0x8B, 0x83, B,
+                0x31, 0xD2, 0x48, 0xF7, 0xF1, 0x48, 0x89, 0x83, A });
+            set(OpCode::MOD_U, { 0x48, 0x8B, 0x8B, C, 0x48, 0x85, 0xC9, 0x0F, 0x84, DivisionError, 0x48, 0x8B, 0x83, B,
+                0x31, 0xD2, 0x48, 0xF7, 0xF1, 0x48, 0x89, 0x93, A });
+
+            floating(OpCode::ADD_F, 0x58);
+            floating(OpCode::SUB_F, 0x5C);
+            floating(OpCode::MUL_F, 0x59);
+            floating(OpCode::DIV_F, 0x5E);
+
+            // mov rax, R[B]; neg rax / btc rax, 63 / xor rax, 1; mov R[A], rax
+            set(OpCode::NEG_I, { 0x48, 0x8B, 0x83, B, 0x48, 0xF7, 0xD8, 0x48, 0x89, 0x83, A });
+            set(OpCode::NEG_F, { 0x48, 0x8B, 0x83, B, 0x48, 0x0F, 0xBA, 0xF8, 0x3F, 0x48, 0x89, 0x83, A });
+            set(OpCode::NOT,   { 0x48, 0x8B, 0x83, B, 0x48, 0x83, 0xF0, 0x01, 0x48, 0x89, 0x83, A });
+
+            compare(OpCode::EQ_I, 0x94);
+            compare(OpCode::NE_I, 0x95);
+            compare(OpCode::LT_I, 0x9C);
+            compare(OpCode::LE_I, 0x9E);
+            compare(OpCode::LT_U, 0x92);
+            compare(OpCode::LE_U, 0x96);
+            compare(OpCode::EQ_B, 0x94);
+            compare(OpCode::NE_B, 0x95);
+
+            // Unordered operands compare unequal and neither less nor equal.
+            //   movsd xmm0, R[B]; ucomisd xmm0, R[C]; sete al; setnp cl; and al, cl
+            //   movsd xmm0, R[B]; ucomisd xmm0, R[C]; setne al; setp cl; or al, cl
+            //   movsd xmm0, R[C]; ucomisd xmm0, R[B]; seta al / setae al
+            set(OpCode::EQ_F, { 0xF2, 0x0F, 0x10, 0x83, B, 0x66, 0x0F, 0x2E, 0x83, C, 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8,
+                0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83, A });
+            set(OpCode::NE_F, { 0xF2, 0x0F, 0x10, 0x83, B, 0x66, 0x0F, 0x2E, 0x83, C, 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8,
+                0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83, A });
+            set(OpCode::LT_F, { 0xF2, 0x0F, 0x10, 0x83, C, 0x66, 0x0F, 0x2E, 0x83, B, 0x0F, 0x97, 0xC0, 0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83, A });
+            set(OpCode::LE_F, { 0xF2, 0x0F, 0x10, 0x83, C, 0x66, 0x0F, 0x2E, 0x83, B, 0x0F, 0x93, 0xC0, 0x0F, 0xB6, 0xC0, 0x48, 0x89, 0x83, A });
+
+            // jmp; cmp qword R[A], 0; je / jne
+            set(OpCode::JMP,  { 0xE9, Target });
+            set(OpCode::JMPF, { 0x48, 0x83, 0xBB, A, 0x00, 0x0F, 0x84, Target });
+            set(OpCode::JMPT, { 0x48, 0x83, 0xBB, A, 0x00, 0x0F, 0x85, Target });
+            // The table's JMPs compile to 5 bytes each and follow right after,
+            // so the entry for an index is found by arithmetic, not a lookup.
+            //   mov rax, R[A]; cmp rax, Bx; jae past the table; lea rax, [rax + rax * 4]
+            //   lea rcx, [rip + 5]; add rcx, rax; jmp rcx
+            set(OpCode::JTAB, { 0x48, 0x8B, 0x83, A, 0x48, 0x3D, IndexBx, 0x0F, 0x83, Target, 0x48, 0x8D, 0x04, 0x80,
+                0x48, 0x8D, 0x0D, 0x05, 0x00, 0x00, 0x00, 0x48, 0x01, 0xC1, 0xFF, 0xE1 });
+
+            // Calls go through the context, which runs the callee compiled or
+            // interpreted; a failure status is passed on as it is.
+            //   lea rdx, R[A]; mov esi, Bx; mov rdi, r12; call [r12 + 16]; test eax, eax; jnz exit
+            set(OpCode::CALL, { 0x48, 0x8D, 0x93, A, 0xBE, IndexBx, 0x4C, 0x89, 0xE7, 0x41, 0xFF, 0x54, 0x24, 0x10,
+                0x85, 0xC0, 0x0F, 0x85, Exit });
+            //   mov rax, R[A]; mov [rbx], rax; xor eax, eax; jmp exit
+            set(OpCode::RET,  { 0x48, 0x8B, 0x83, A, 0x48, 0x89, 0x03, 0x31, 0xC0, 0xE9, Exit });
+            //   mov eax, ReturnedVoid; jmp exit
+            set(OpCode::RET0, { 0xB8, 0x01, 0x00, 0x00, 0x00, 0xE9, Exit });
+            return stencils;
+        }
+
+        const std::array<Stencil, static_cast<size_t>(OpCode::Count)>& Stencils()
+        {
+            static const auto stencils = MakeStencils();
+            return stencils;
+        }
+
+        // push rbx; push r12; push rbp; mov rbx, rdi; mov r12, rsi; jmp rdx
+        // The third push keeps the stack 16-byte aligned for calls.
+        constexpr uint8_t Prologue[] = { 0x53, 0x41, 0x54, 0x55, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0xFF, 0xE2 };
+        // mov eax, DivisionByZero, falling through to the exit
+        constexpr uint8_t DivisionStub[] = { 0xB8, static_cast<uint8_t>(JitStatus::DivisionByZero), 0x00, 0x00, 0x00 };
+        // pop rbp; pop r12; pop rbx; ret
+        constexpr uint8_t Epilogue[] = { 0x5D, 0x41, 0x5C, 0x5B, 0xC3 };
+
+        void Write32(uint8_t* at, uint32_t value) { std::memcpy(at, &value, sizeof(value)); }
+    }
+
+    const JitCompiler::CompiledFunction* JitCompiler::Compile(const SharedModule::Function& function)
+    {
+        const auto& stencils = Stencils();
+        for (uint32_t pc = 0; pc < function.codeSize; pc++)
+        {
+            if (stencils[static_cast<size_t>(GetOp(function.code[pc]))].code.empty())
+                return nullptr;
+            if (GetOp(function.code[pc]) == OpCode::JTAB)
+            {
+                uint32_t entries = GetBx(function.code[pc]);
+                if (function.codeSize - pc - 1 < entries)
+                    return nullptr;
+                for (uint32_t entry = 1; entry <= entries; entry++)
+                {
+                    if (GetOp(function.code[pc + entry]) != OpCode::JMP)
+                        return nullptr;
+                }
+            }
+        }
+
+        std::vector<uint8_t> code(std::begin(Prologue), std::end(Prologue));
+        std::vector<uint32_t> offsets(function.codeSize);
+        struct Fixup
+        {
+            uint32_t at;
+            Hole kind;
+            uint32_t targetPc;
+        };
+        std::vector<Fixup> fixups;
+        for (uint32_t pc = 0; pc < function.codeSize; pc++)
+        {
+            Instruction i = function.code[pc];
+            OpCode op = GetOp(i);
+            const Stencil& stencil = stencils[static_cast<size_t>(op)];
+            uint32_t start = static_cast<uint32_t>(code.size());
+            offsets[pc] = start;
+            code.insert(code.end(), stencil.code.begin(), stencil.code.end());
+            for (auto [offset, hole] : stencil.holes)
+            {
+                uint8_t* at = code.data() + start + offset;
+                switch (hole)
+                {
+                    case A: Write32(at, GetA(i) * sizeof(Value)); break;
+                    case B: Write32(at, GetB(i) * sizeof(Value)); break;
+                    case C: Write32(at, GetC(i) * sizeof(Value)); break;
+                    case Constant: std::memcpy(at, &function.constants[GetBx(i)], sizeof(Value)); break;
+                    case SignedBx: Write32(at, static_cast<uint32_t>(GetSBx(i))); break;
+                    case ImmediateB: Write32(at, GetB(i)); break;
+                    case GlobalBx: Write32(at, GetBx(i) * sizeof(Value)); break;
+                    case IndexBx: Write32(at, GetBx(i)); break;
+                    case Target:
+                    {
+                        int32_t jump = op == OpCode::JMP ? GetSJ(i) : op == OpCode::JTAB ? static_cast<int32_t>(GetBx(i)) : GetSBx(i);
+                        int64_t target = static_cast<int64_t>(pc) + 1 + jump;
+                        if (target < 0 || target >= static_cast<int64_t>(function.codeSize))
+                            return nullptr;
+                        fixups.push_back({ start + offset, hole, static_cast<uint32_t>(target) });
+                        break;
+                    }
+                    case DivisionError:
+                    case Exit:
+                        fixups.push_back({ start + offset, hole, 0 });
+                        break;
+                }
+            }
+        }
+        uint32_t divisionStub = static_cast<uint32_t>(code.size());
+        code.insert(code.end(), std::begin(DivisionStub), std::end(DivisionStub));
+        uint32_t exit = static_cast<uint32_t>(code.size());
+        code.insert(code.end(), std::begin(Epilogue), std::end(Epilogue));
+        for (const Fixup& fixup : fixups)
+        {
+            uint32_t target = fixup.kind == Target ? offsets[fixup.targetPc] : fixup.kind == DivisionError ? divisionStub : exit;
+            Write32(code.data() + fixup.at, target - (fixup.at + 4));
+        }
+
+        // Written while writable, then made executable; never both.
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t size = (code.size() + page - 1) / page * page;
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return nullptr;
+        std::memcpy(memory, code.data(), code.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory, size);
+            return nullptr;
+        }
+        regions.push_back({ memory, size });
+
+        auto result = std::make_unique<CompiledFunction>();
+        auto* base = static_cast<const uint8_t*>(memory);
+        result->entry = reinterpret_cast<Entry>(const_cast<uint8_t*>(base));
+        result->targets.reserve(function.codeSize);
+        for (uint32_t offset : offsets)
+            result->targets.push_back(base + offset);
+        compiled.push_back(std::move(result));
+        return compiled.back().get();
+    }
+
+    void JitCompiler::Clear()
+    {
+        for (const Region& region : regions)
+            munmap(region.memory, region.size);
+        regions.clear();
+        compiled.clear();
+    }
+#else
+    const JitCompiler::CompiledFunction* JitCompiler::Compile(const SharedModule::Function&)
+    {
+        return nullptr;
+    }
+
+    void JitCompiler::Clear()
+    {
+        compiled.clear();
+    }
+#endif
+
+    JitCompiler::~JitCompiler()
+    {
+        Clear();
+    }
+} // namespace Arcanelab::Mano
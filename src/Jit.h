@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Bytecode.h>
+#include <SharedModule.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && __has_include(<sys/mman.h>)
+#define MANO_JIT 1
+#else
+#define MANO_JIT 0
+#endif
+
+namespace Arcanelab::Mano
+{
+    // How compiled code hands control back. Errors other than division by
+    // zero come from calls and are held by the VM until the interpreter
+    // rethrows them, so no exception unwinds through machine code.
+    enum class JitStatus : uint32_t
+    {
+        Returned,       // RET, with the result in the first register
+        ReturnedVoid,   // RET0
+        DivisionByZero,
+        Failed,
+    };
+
+    // What compiled code needs of the VM running it, passed in a register.
+    // The layout is part of the generated code.
+    struct JitContext
+    {
+        Value* globals;
+        void* vm;
+        JitStatus (*call)(JitContext* context, uint32_t function, Value* base);
+    };
+
+    // Baseline compiler from bytecode to x86-64 machine code. Every
+    // instruction has a stencil, a fixed sequence of machine code with
+    // holes for its operands, which is copied out and patched with the
+    // register offsets, constants and jump targets. Registers stay in the
+    // VM's register file between instructions, so compiled code can be
+    // entered at any instruction boundary, in particular at a loop header
+    // while the function is running, and leaves its state where the
+    // interpreter expects it.
+    //
+    // Only functions whose every instruction has a stencil are compiled:
+    // numeric code, globals, branches and calls. Anything touching objects,
+    // strings, arrays, reference counts or the host stays interpreted, so
+    // compiled code never needs to fall back partway through.
+    class JitCompiler
+    {
+    public:
+        // Runs from the instruction at target, which must be an entry of the
+        // same function, with registers pointing at the function's frame.
+        using Entry = JitStatus (*)(Value* registers, JitContext* context, const void* target);
+
+        struct CompiledFunction
+        {
+            Entry entry;
+            std::vector<const void*> targets;   // Machine code address of every instruction
+        };
+
+        JitCompiler() = default;
+        ~JitCompiler();
+        JitCompiler(const JitCompiler&) = delete;
+        JitCompiler& operator=(const JitCompiler&) = delete;
+
+        static constexpr bool Available = MANO_JIT;
+
+        // Null if the function uses an instruction without a stencil, or
+        // there is no JIT for this machine. The code lives until Clear.
+        const CompiledFunction* Compile(const SharedModule::Function& function);
+        void Clear();
+
+    private:
+        struct Region
+        {
+            void* memory;
+            size_t size;
+        };
+
+        std::vector<std::unique_ptr<CompiledFunction>> compiled;
+        std::vector<Region> regions;
+    };
+} // namespace Arcanelab::Mano
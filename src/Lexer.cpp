@@ -1,15 +1,162 @@
 #include <Lexer.h>
+#include <SimdScan.h>
 
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <string>
 
 namespace Arcanelab::Mano
 {
+    namespace
+    {
+        // Character classes for the scanning loops. A table lookup is cheaper
+        // than the locale-aware <cctype> predicates and treats bytes >= 0x80
+        // as unrecognized instead of depending on the C locale.
+        enum CharClass : uint8_t
+        {
+            Space = 1 << 0,
+            Alpha = 1 << 1,         // Letters and '_'
+            Digit = 1 << 2,
+            OperatorChar = 1 << 3,
+            PunctuationChar = 1 << 4,
+            IdentifierChar = Alpha | Digit
+        };
+
+        constexpr std::array<uint8_t, 256> charClasses = []
+        {
+            std::array<uint8_t, 256> table{};
+            for (char c : std::string_view(" \t\n\v\f\r"))
+                table[static_cast<uint8_t>(c)] |= Space;
+            for (int c = 'a'; c <= 'z'; c++)
+                table[c] |= Alpha;
+            for (int c = 'A'; c <= 'Z'; c++)
+                table[c] |= Alpha;
+            table['_'] |= Alpha;
+            for (int c = '0'; c <= '9'; c++)
+                table[c] |= Digit;
+            for (char c : std::string_view("+-*/=!<>&|^%"))
+                table[static_cast<uint8_t>(c)] |= OperatorChar;
+            for (char c : std::string_view("(){}[],:;."))
+                table[static_cast<uint8_t>(c)] |= PunctuationChar;
+            return table;
+        }();
+
+        constexpr bool Is(char c, uint8_t charClass)
+        {
+            return (charClasses[static_cast<uint8_t>(c)] & charClass) != 0;
+        }
+
+        // Kind of every operator and punctuation character on its own.
+        constexpr std::array<TokenKind, 256> singleCharKinds = []
+        {
+            std::array<TokenKind, 256> table{};
+            table.fill(TokenKind::Unknown);
+            table['+'] = TokenKind::Plus;
+            table['-'] = TokenKind::Minus;
+            table['*'] = TokenKind::Star;
+            table['/'] = TokenKind::Slash;
+            table['%'] = TokenKind::Percent;
+            table['='] = TokenKind::Assign;
+            table['!'] = TokenKind::Bang;
+            table['<'] = TokenKind::Less;
+            table['>'] = TokenKind::Greater;
+            table['&'] = TokenKind::Ampersand;
+            table['|'] = TokenKind::Pipe;
+            table['^'] = TokenKind::Caret;
+            table['('] = TokenKind::LeftParen;
+            table[')'] = TokenKind::RightParen;
+            table['{'] = TokenKind::LeftBrace;
+            table['}'] = TokenKind::RightBrace;
+            table['['] = TokenKind::LeftBracket;
+            table[']'] = TokenKind::RightBracket;
+            table[','] = TokenKind::Comma;
+            table[':'] = TokenKind::Colon;
+            table[';'] = TokenKind::Semicolon;
+            table['.'] = TokenKind::Dot;
+            return table;
+        }();
+
+        struct KeywordEntry
+        {
+            std::string_view text;
+            TokenKind kind = TokenKind::Identifier;
+        };
+
+        constexpr KeywordEntry keywords[] =
+        {
+            { "var", TokenKind::Var }, { "fun", TokenKind::Fun }, { "class", TokenKind::Class },
+            { "enum", TokenKind::Enum }, { "if", TokenKind::If }, { "else", TokenKind::Else },
+            { "for", TokenKind::For }, { "while", TokenKind::While }, { "break", TokenKind::Break },
+            { "continue", TokenKind::Continue }, { "return", TokenKind::Return }, { "let", TokenKind::Let },
+            { "int", TokenKind::Int }, { "uint", TokenKind::UInt }, { "float", TokenKind::Float },
+            { "bool", TokenKind::Bool }, { "string", TokenKind::StringType }, { "switch", TokenKind::Switch },
+            { "case", TokenKind::Case }, { "default", TokenKind::Default }, { "const", TokenKind::Const },
+            { "true", TokenKind::True }, { "false", TokenKind::False },
+        };
+
+        constexpr size_t KeywordTableSize = 64;
+        constexpr size_t MinKeywordLength = 2;
+        constexpr size_t MaxKeywordLength = 8;
+
+        // Perfect hash over the keyword set: first char, last char and length
+        // give every keyword its own slot, so a lookup is one string compare.
+        constexpr size_t KeywordHash(std::string_view text)
+        {
+            return (static_cast<uint8_t>(text.front()) * 6u +
+                static_cast<uint8_t>(text.back()) * 18u +
+                text.size()) & (KeywordTableSize - 1);
+        }
+
+        constexpr std::array<KeywordEntry, KeywordTableSize> keywordTable = []
+        {
+            std::array<KeywordEntry, KeywordTableSize> table{};
+            for (const auto& keyword : keywords)
+                table[KeywordHash(keyword.text)] = keyword;
+            return table;
+        }();
+
+        constexpr bool KeywordHashIsPerfect()
+        {
+            for (const auto& keyword : keywords)
+            {
+                if (keywordTable[KeywordHash(keyword.text)].text != keyword.text)
+                    return false;
+                if (keyword.text.size() < MinKeywordLength || keyword.text.size() > MaxKeywordLength)
+                    return false;
+            }
+            return true;
+        }
+        static_assert(KeywordHashIsPerfect(), "Keyword hash collides; pick new multipliers");
+    }
+
+    Lexer::Lexer(std::string_view source, ErrorReporter& errorReporter)
+        : Lexer(source, errorReporter, std::make_unique<IdentifierTable>())
+    {
+    }
+
+    Lexer::Lexer(std::string_view source, ErrorReporter& errorReporter, std::unique_ptr<IdentifierTable> identifiers)
+        : Lexer(source, errorReporter, *identifiers)
+    {
+        ownIdentifiers = std::move(identifiers);
+    }
+
+    Lexer::Lexer(std::string_view source, ErrorReporter& errorReporter, IdentifierTable& identifiers)
+        : source(source), sourceMap(source), errorReporter(errorReporter),
+        identifiers(identifiers), offset(0)
+    {
+        // Token offsets are 32 bits wide; an oversized file lexes as empty.
+        if (source.size() > std::numeric_limits<uint32_t>::max())
+        {
+            errorReporter.Report(0, 0, "Source file is too large");
+            this->source = {};
+        }
+    }
+
     std::vector<Token> Lexer::Tokenize()
     {
         Token token;
         std::vector<Token> tokens;
-
         do
         {
             token = NextToken();
@@ -23,15 +170,13 @@ namespace Arcanelab::Mano
     {
         SkipWhitespace();
         if (IsAtEnd())
-            return Token{ TokenType::EndOfFile, "", line, column };
+            return MakeToken(TokenType::EndOfFile, TokenKind::EndOfFile, offset);
 
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
         char current = Peek();
 
-        if (std::isalpha(current) || current == '_')
+        if (Is(current, Alpha))
             return ScanIdentifier();
-        if (std::isdigit(current))
+        if (Is(current, Digit))
             return ScanNumber();
         if (current == '"')
             return ScanString();
@@ -41,12 +186,21 @@ namespace Arcanelab::Mano
             return ScanPunctuation();
 
         // Report unrecognized character
-        tokenLine = line;
-        tokenColumn = column;
+        size_t start = offset;
         char unknown = Advance();
-        errorReporter.Report(tokenLine, tokenColumn,
-            "Unrecognized character: '" + std::string(1, unknown) + "'");
-        return Token{ TokenType::Unknown, "", tokenLine, tokenColumn };
+        ReportAt(start, "Unrecognized character: '" + std::string(1, unknown) + "'");
+        return Token{ static_cast<uint32_t>(start), 0, TokenType::Unknown, TokenKind::Unknown };
+    }
+
+    Token Lexer::MakeToken(TokenType type, TokenKind kind, size_t start) const
+    {
+        return Token{ static_cast<uint32_t>(start), static_cast<uint32_t>(offset - start), type, kind };
+    }
+
+    void Lexer::ReportAt(size_t position, const std::string& message)
+    {
+        SourceMap::Location location = sourceMap.Resolve(static_cast<uint32_t>(position));
+        errorReporter.Report(location.line, location.column, message);
     }
 
     bool Lexer::IsAtEnd() const
@@ -61,37 +215,22 @@ namespace Arcanelab::Mano
 
     char Lexer::Advance()
     {
-        char c = source[offset++];
-        if (c == '\n')
-        {
-            ++line;
-            column = 1;
-        }
-        else
-        {
-            ++column;
-        }
-        return c;
+        return source[offset++];
     }
 
     void Lexer::SkipWhitespace()
     {
+        const char* data = source.data();
+        const char* end = data + source.size();
         while (!IsAtEnd())
         {
-            char c = Peek();
-            if (std::isspace(c))
-            {
-                Advance();
-            }
+            offset = Simd::SkipSpaces(data + offset, end) - data;
+
             // Check for single-line comment starting with "//"
-            else if (c == '/' && (offset + 1 < source.size()) && source[offset + 1] == '/')
+            if (offset + 1 < source.size() && source[offset] == '/' && source[offset + 1] == '/')
             {
-                // Consume the two slashes
-                Advance();
-                Advance();
                 // Skip until the end of the line or source
-                while (!IsAtEnd() && Peek() != '\n')
-                    Advance();
+                offset = Simd::Find(data + offset + 2, end, '\n') - data;
             }
             else
             {
@@ -100,129 +239,120 @@ namespace Arcanelab::Mano
         }
     }
 
-    // The helper function is now local to each scan routine (using token start positions).
     Token Lexer::ScanIdentifier()
     {
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
         size_t start = offset;
-        while (!IsAtEnd() && (std::isalnum(Peek()) || Peek() == '_'))
-            Advance();
+        while (offset < source.size() && Is(source[offset], IdentifierChar))
+            offset++;
         std::string_view text = source.substr(start, offset - start);
-        TokenType tokenType = IsKeyword(text) ? TokenType::Keyword : TokenType::Identifier;
-        return Token{ tokenType, text, tokenLine, tokenColumn };
+        TokenKind kind = KeywordKind(text);
+        if (kind != TokenKind::Identifier)
+            return MakeToken(TokenType::Keyword, kind, start);
+
+        Token token = MakeToken(TokenType::Identifier, kind, start);
+        token.nameId = identifiers.Intern(text);
+        return token;
     }
 
-    bool Lexer::IsKeyword(std::string_view text) const
+    TokenKind Lexer::KeywordKind(std::string_view text)
     {
-        return (text == "var" || text == "fun" || text == "class" || text == "enum" ||
-            text == "if" || text == "else" || text == "for" || text == "while" ||
-            text == "break" || text == "continue" || text == "return" || text == "let" ||
-            text == "int" || text == "uint" || text == "float" || text == "bool" ||
-            text == "string" || text == "switch" || text == "case" || text == "default" ||
-            text == "const");
+        if (text.size() < MinKeywordLength || text.size() > MaxKeywordLength)
+            return TokenKind::Identifier;
+        const KeywordEntry& entry = keywordTable[KeywordHash(text)];
+        return entry.text == text ? entry.kind : TokenKind::Identifier;
     }
 
     Token Lexer::ScanNumber()
     {
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
         size_t start = offset;
-        while (!IsAtEnd() && std::isdigit(Peek()))
+        while (!IsAtEnd() && Is(Peek(), Digit))
             Advance();
 
         // Check for a fractional part.
         if (!IsAtEnd() && Peek() == '.')
         {
             Advance();
-            while (!IsAtEnd() && std::isdigit(Peek()))
+            while (!IsAtEnd() && Is(Peek(), Digit))
                 Advance();
         }
-        std::string_view text = source.substr(start, offset - start);
-        return Token{ TokenType::Number, text, tokenLine, tokenColumn };
+        return MakeToken(TokenType::Number, TokenKind::Number, start);
     }
 
     Token Lexer::ScanString()
     {
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
+        size_t quoteOffset = offset;
         char quote = Advance();
         size_t start = offset;
-        bool valid = true;
 
-        while (!IsAtEnd() && Peek() != quote)
+        // Jump from one quote or backslash to the next; an escape skips the
+        // character after the backslash.
+        const char* data = source.data();
+        const char* end = data + source.size();
+        size_t stop = offset;
+        while (true)
         {
-            if (Peek() == '\\')
-            {
-                Advance();
-                if (!IsAtEnd())
-                    Advance();
-            }
-            else
-            {
-                Advance();
-            }
+            stop = Simd::FindEither(data + stop, end, quote, '\\') - data;
+            if (stop >= source.size() || source[stop] == quote)
+                break;
+            stop = std::min(stop + 2, source.size());
         }
+        offset = stop;
 
-        if (!IsAtEnd())
-            Advance();
-        else
+        if (IsAtEnd())
         {
-            valid = false;
-            errorReporter.Report(tokenLine, tokenColumn, "Unterminated string literal");
+            ReportAt(quoteOffset, "Unterminated string literal");
+            return MakeToken(TokenType::Unknown, TokenKind::Unknown, start);
         }
 
-        std::string_view text = source.substr(start, offset - start - (valid ? 1 : 0));
-        return Token{ valid ? TokenType::String : TokenType::Unknown, text, tokenLine, tokenColumn };
+        // The lexeme excludes both quotes.
+        Token token = MakeToken(TokenType::String, TokenKind::String, start);
+        Advance();
+        return token;
     }
 
     bool Lexer::IsOperator(char c) const
     {
-        return (c == '+' || c == '-' || c == '*' || c == '/' ||
-            c == '=' || c == '!' || c == '<' || c == '>' ||
-            c == '&' || c == '|' || c == '^' || c == '%');
+        return Is(c, OperatorChar);
     }
 
     Token Lexer::ScanOperator()
     {
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
         size_t start = offset;
         char first = Advance(); // Consume the first operator character.
+        TokenKind kind = singleCharKinds[static_cast<uint8_t>(first)];
         if (!IsAtEnd())
         {
-            char next = Peek();
             // Handle double-character operators.
-            if ((first == '=' && next == '=') ||
-                (first == '!' && next == '=') ||
-                (first == '<' && next == '=') ||
-                (first == '>' && next == '=') ||
-                (first == '&' && next == '&') ||
-                (first == '|' && next == '|') ||
-                (first == '<' && next == '<') ||
-                (first == '>' && next == '>'))
+            TokenKind doubleKind = TokenKind::Unknown;
+            switch (first << 8 | Peek())
+            {
+                case '=' << 8 | '=': doubleKind = TokenKind::EqualEqual; break;
+                case '!' << 8 | '=': doubleKind = TokenKind::BangEqual; break;
+                case '<' << 8 | '=': doubleKind = TokenKind::LessEqual; break;
+                case '>' << 8 | '=': doubleKind = TokenKind::GreaterEqual; break;
+                case '&' << 8 | '&': doubleKind = TokenKind::AmpersandAmpersand; break;
+                case '|' << 8 | '|': doubleKind = TokenKind::PipePipe; break;
+                case '<' << 8 | '<': doubleKind = TokenKind::LessLess; break;
+                case '>' << 8 | '>': doubleKind = TokenKind::GreaterGreater; break;
+            }
+            if (doubleKind != TokenKind::Unknown)
             {
                 Advance();
+                kind = doubleKind;
             }
         }
-        std::string_view text = source.substr(start, offset - start);
-        return Token{ TokenType::Operator, text, tokenLine, tokenColumn };
+        return MakeToken(TokenType::Operator, kind, start);
     }
 
     bool Lexer::IsPunctuation(char c) const
     {
-        return (c == '(' || c == ')' || c == '{' || c == '}' ||
-            c == '[' || c == ']' || c == ',' || c == ':' ||
-            c == ';' || c == '.');
+        return Is(c, PunctuationChar);
     }
 
     Token Lexer::ScanPunctuation()
     {
-        size_t tokenLine = line;
-        size_t tokenColumn = column;
         size_t start = offset;
-        Advance();
-        std::string_view text = source.substr(start, offset - start);
-        return Token{ TokenType::Punctuation, text, tokenLine, tokenColumn };
+        TokenKind kind = singleCharKinds[static_cast<uint8_t>(Advance())];
+        return MakeToken(TokenType::Punctuation, kind, start);
     }
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <ErrorReporter.h>
+#include <IdentifierTable.h>
+#include <SourceMap.h>
 #include <Token.h>
 
+#include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -11,28 +15,35 @@ namespace Arcanelab::Mano
     class Lexer
     {
     public:
-        Lexer(std::string_view source, ErrorReporter& errorReporter)
-            : source(source), errorReporter(errorReporter),
-            offset(0), line(1), column(1)
-        {
-        }
+        // Identifier ids are only meaningful within one table; modules that
+        // are analyzed together must be lexed against the same one. Without
+        // a table the lexer interns into a private one.
+        Lexer(std::string_view source, ErrorReporter& errorReporter);
+        Lexer(std::string_view source, ErrorReporter& errorReporter, IdentifierTable& identifiers);
 
+        // Scans the whole source at once.
         std::vector<Token> Tokenize();
+        // Scans one token; returns EndOfFile forever once the source is exhausted.
+        Token NextToken();
+        const SourceMap& GetSourceMap() const { return sourceMap; }
 
     private:
         std::string_view source;
+        SourceMap sourceMap;
         ErrorReporter& errorReporter;
+        std::unique_ptr<IdentifierTable> ownIdentifiers;   // Only without a shared table
+        IdentifierCache identifiers;
         size_t offset;
-        size_t line;
-        size_t column;
 
+        Lexer(std::string_view source, ErrorReporter& errorReporter, std::unique_ptr<IdentifierTable> identifiers);
         bool IsAtEnd() const;
-        bool IsKeyword(std::string_view text) const;
+        static TokenKind KeywordKind(std::string_view text);
         bool IsOperator(char c) const;
         bool IsPunctuation(char c) const;
         char Advance();
         char Peek() const;
-        Token NextToken();
+        Token MakeToken(TokenType type, TokenKind kind, size_t start) const;
+        void ReportAt(size_t position, const std::string& message);
         Token ScanIdentifier();
         Token ScanNumber();
         Token ScanOperator();
@@ -0,0 +1,415 @@
+#include <ModuleImage.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MANO_MMAP 1
+#else
+#define MANO_MMAP 0
+#endif
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        constexpr char Magic[8] = { 'M', 'A', 'N', 'O', 'I', 'M', 'G', '\0' };
+        constexpr uint32_t ByteOrderMark = 0x01020304;
+
+        // File layout: the header, the function, class, string and host
+        // import tables, then the payloads the records point at, line tables
+        // included. Offsets are from the start of the file and every section
+        // starts on an 8-byte boundary.
+        struct ImageHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrder;
+            uint64_t sourceHash;
+            uint64_t fileSize;
+            uint16_t opcodeCount;       // Fingerprint of the instruction set
+            uint16_t kernelCount;
+            uint32_t globalCount;
+            int32_t initFunction;
+            uint32_t functionCount;
+            uint32_t classCount;
+            uint32_t stringCount;
+            uint32_t hostImportCount;
+            uint32_t reserved;
+            uint64_t functions;
+            uint64_t classes;
+            uint64_t strings;
+            uint64_t hostImports;
+        };
+
+        struct FunctionRecord
+        {
+            uint64_t name;
+            uint64_t code;
+            uint64_t constants;
+            uint64_t lines;
+            uint32_t nameLength;
+            uint32_t codeCount;
+            uint32_t constantCount;
+            uint32_t lineCount;
+            uint32_t numParams;
+            uint32_t frameSize;
+            uint32_t returnsValue;
+            uint32_t reserved;
+        };
+
+        struct ClassRecord
+        {
+            uint64_t name;
+            uint64_t methods;
+            uint64_t referenceFields;
+            uint32_t nameLength;
+            uint32_t instanceSize;
+            uint32_t methodCount;
+            uint32_t referenceFieldCount;
+        };
+
+        struct StringRecord
+        {
+            uint64_t text;
+            uint32_t length;
+            uint32_t hash;
+        };
+
+        struct HostImportRecord
+        {
+            uint64_t signature;
+            uint32_t signatureLength;
+            uint32_t index;
+        };
+
+        static_assert(std::is_trivially_copyable_v<ImageHeader> && sizeof(ImageHeader) % 8 == 0);
+        static_assert(sizeof(FunctionRecord) % 8 == 0 && sizeof(ClassRecord) % 8 == 0 && sizeof(StringRecord) % 8 == 0
+            && sizeof(HostImportRecord) % 8 == 0);
+        // Constants are plain numbers; strings are loaded by index, so no
+        // constant holds a pointer that would need relocating.
+        static_assert(sizeof(Value) == 8 && sizeof(Instruction) == 4 && sizeof(LineStart) == 8);
+
+        // Appends sections to a growing file image.
+        class ImageWriter
+        {
+        public:
+            uint64_t Reserve(size_t length)
+            {
+                size_t offset = (bytes.size() + 7) & ~size_t(7);
+                bytes.resize(offset + length);
+                return offset;
+            }
+
+            uint64_t Append(const void* source, size_t length)
+            {
+                uint64_t offset = Reserve(length);
+                if (length)
+                    std::memcpy(bytes.data() + offset, source, length);
+                return offset;
+            }
+
+            template<typename T>
+            void Store(uint64_t offset, const T& record)
+            {
+                std::memcpy(bytes.data() + offset, &record, sizeof(T));
+            }
+
+            std::vector<std::byte> bytes;
+        };
+
+        template<typename T>
+        uint32_t CountOf(const T& container)
+        {
+            return static_cast<uint32_t>(container.size());
+        }
+    } // namespace
+
+    ModuleImage::~ModuleImage()
+    {
+#if MANO_MMAP
+        if (mapped)
+            munmap(const_cast<std::byte*>(data), size);
+#endif
+    }
+
+    uint64_t ModuleImage::HashSource(std::string_view text, uint64_t hash)
+    {
+        auto mix = [&hash](const void* bytes, size_t length)
+        {
+            const auto* p = static_cast<const unsigned char*>(bytes);
+            for (size_t i = 0; i < length; i++)
+            {
+                hash ^= p[i];
+                hash *= 0x100000001B3ull;
+            }
+        };
+        uint64_t length = text.size();
+        mix(&length, sizeof(length));
+        mix(text.data(), text.size());
+        return hash;
+    }
+
+    bool ModuleImage::Write(const Module& module, uint64_t sourceHash, const std::string& path)
+    {
+        ImageWriter writer;
+        uint64_t headerOffset = writer.Reserve(sizeof(ImageHeader));
+        uint64_t functionTable = writer.Reserve(module.functions.size() * sizeof(FunctionRecord));
+        uint64_t classTable = writer.Reserve(module.classes.size() * sizeof(ClassRecord));
+        uint64_t stringTable = writer.Reserve(module.strings.size() * sizeof(StringRecord));
+        uint64_t hostImportTable = writer.Reserve(module.hostImports.size() * sizeof(HostImportRecord));
+
+        for (size_t i = 0; i < module.functions.size(); i++)
+        {
+            const FunctionProto& function = module.functions[i];
+            FunctionRecord record{};
+            record.code = writer.Append(function.code.data(), function.code.size() * sizeof(Instruction));
+            record.constants = writer.Append(function.constants.data(), function.constants.size() * sizeof(Value));
+            record.lines = writer.Append(function.lines.data(), function.lines.size() * sizeof(LineStart));
+            record.name = writer.Append(function.name.data(), function.name.size());
+            record.nameLength = CountOf(function.name);
+            record.codeCount = CountOf(function.code);
+            record.constantCount = CountOf(function.constants);
+            record.lineCount = CountOf(function.lines);
+            record.numParams = function.numParams;
+            record.frameSize = function.frameSize;
+            record.returnsValue = function.returnsValue;
+            writer.Store(functionTable + i * sizeof(FunctionRecord), record);
+        }
+        for (size_t i = 0; i < module.classes.size(); i++)
+        {
+            const ClassInfo& info = module.classes[i];
+            ClassRecord record{};
+            record.methods = writer.Append(info.methods.data(), info.methods.size() * sizeof(uint32_t));
+            record.referenceFields = writer.Append(info.referenceFields.data(), info.referenceFields.size() * sizeof(uint32_t));
+            record.name = writer.Append(info.name.data(), info.name.size());
+            record.nameLength = CountOf(info.name);
+            record.instanceSize = info.instanceSize;
+            record.methodCount = CountOf(info.methods);
+            record.referenceFieldCount = CountOf(info.referenceFields);
+            writer.Store(classTable + i * sizeof(ClassRecord), record);
+        }
+        for (size_t i = 0; i < module.strings.size(); i++)
+        {
+            const StringConstant& constant = module.strings[i];
+            StringRecord record{};
+            record.text = writer.Append(constant.text.data(), constant.text.size());
+            record.length = CountOf(constant.text);
+            record.hash = constant.hash;
+            writer.Store(stringTable + i * sizeof(StringRecord), record);
+        }
+        for (size_t i = 0; i < module.hostImports.size(); i++)
+        {
+            const Mano::HostImport& import = module.hostImports[i];
+            HostImportRecord record{};
+            record.signature = writer.Append(import.signature.data(), import.signature.size());
+            record.signatureLength = CountOf(import.signature);
+            record.index = import.index;
+            writer.Store(hostImportTable + i * sizeof(HostImportRecord), record);
+        }
+
+        ImageHeader header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.byteOrder = ByteOrderMark;
+        header.sourceHash = sourceHash;
+        header.fileSize = writer.bytes.size();
+        header.opcodeCount = static_cast<uint16_t>(OpCode::Count);
+        header.kernelCount = static_cast<uint16_t>(KernelOp::Count);
+        header.globalCount = module.globalCount;
+        header.initFunction = module.initFunction;
+        header.functionCount = CountOf(module.functions);
+        header.classCount = CountOf(module.classes);
+        header.stringCount = CountOf(module.strings);
+        header.hostImportCount = CountOf(module.hostImports);
+        header.functions = functionTable;
+        header.classes = classTable;
+        header.strings = stringTable;
+        header.hostImports = hostImportTable;
+        writer.Store(headerOffset, header);
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+            file.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+            if (!file.flush())
+            {
+                file.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<ModuleImage> ModuleImage::Open(const std::string& path, uint64_t sourceHash)
+    {
+        std::unique_ptr<ModuleImage> image(new ModuleImage());
+#if MANO_MMAP
+        int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            return nullptr;
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ImageHeader)))
+        {
+            close(descriptor);
+            return nullptr;
+        }
+        size_t length = static_cast<size_t>(info.st_size);
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+        if (address == MAP_FAILED)
+            return nullptr;
+        image->data = static_cast<const std::byte*>(address);
+        image->size = length;
+        image->mapped = true;
+#else
+        // Without mmap the file is read once into an 8-byte aligned buffer.
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return nullptr;
+        std::streamoff length = file.tellg();
+        if (length < static_cast<std::streamoff>(sizeof(ImageHeader)))
+            return nullptr;
+        image->buffer = std::make_unique<uint64_t[]>((static_cast<size_t>(length) + 7) / 8);
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(image->buffer.get()), length))
+            return nullptr;
+        image->data = reinterpret_cast<const std::byte*>(image->buffer.get());
+        image->size = static_cast<size_t>(length);
+#endif
+        if (!image->Validate(sourceHash))
+            return nullptr;
+        return image;
+    }
+
+    // Checks the header and that every record points inside the file. This
+    // reads the tables but none of the code, so it costs a few pages however
+    // large the module is.
+    bool ModuleImage::Validate(uint64_t sourceHash) const
+    {
+        auto inside = [this](uint64_t offset, uint64_t count, size_t elementSize)
+        {
+            return offset % alignof(uint64_t) == 0 && offset <= size && count <= (size - offset) / elementSize;
+        };
+
+        const ImageHeader& header = *At<ImageHeader>(0);
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+            || header.version != Version
+            || header.byteOrder != ByteOrderMark
+            || header.opcodeCount != static_cast<uint16_t>(OpCode::Count)
+            || header.kernelCount != static_cast<uint16_t>(KernelOp::Count)
+            || header.fileSize != size
+            || header.sourceHash != sourceHash)
+            return false;
+        if (!inside(header.functions, header.functionCount, sizeof(FunctionRecord))
+            || !inside(header.classes, header.classCount, sizeof(ClassRecord))
+            || !inside(header.strings, header.stringCount, sizeof(StringRecord))
+            || !inside(header.hostImports, header.hostImportCount, sizeof(HostImportRecord)))
+            return false;
+        if (header.initFunction < -1 || (header.initFunction >= 0 && static_cast<uint32_t>(header.initFunction) >= header.functionCount))
+            return false;
+
+        const auto* functions = At<FunctionRecord>(header.functions);
+        for (uint32_t i = 0; i < header.functionCount; i++)
+        {
+            const FunctionRecord& record = functions[i];
+            if (!inside(record.code, record.codeCount, sizeof(Instruction))
+                || !inside(record.constants, record.constantCount, sizeof(Value))
+                || !inside(record.lines, record.lineCount, sizeof(LineStart))
+                || !inside(record.name, record.nameLength, 1)
+                || record.numParams > record.frameSize)
+                return false;
+        }
+        const auto* classes = At<ClassRecord>(header.classes);
+        for (uint32_t i = 0; i < header.classCount; i++)
+        {
+            const ClassRecord& record = classes[i];
+            if (!inside(record.methods, record.methodCount, sizeof(uint32_t))
+                || !inside(record.referenceFields, record.referenceFieldCount, sizeof(uint32_t))
+                || !inside(record.name, record.nameLength, 1))
+                return false;
+        }
+        const auto* strings = At<StringRecord>(header.strings);
+        for (uint32_t i = 0; i < header.stringCount; i++)
+        {
+            if (!inside(strings[i].text, strings[i].length, 1))
+                return false;
+        }
+        const auto* hostImports = At<HostImportRecord>(header.hostImports);
+        for (uint32_t i = 0; i < header.hostImportCount; i++)
+        {
+            if (!inside(hostImports[i].signature, hostImports[i].signatureLength, 1))
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t ModuleImage::GetFunctionCount() const { return At<ImageHeader>(0)->functionCount; }
+    uint32_t ModuleImage::GetClassCount() const { return At<ImageHeader>(0)->classCount; }
+    uint32_t ModuleImage::GetStringCount() const { return At<ImageHeader>(0)->stringCount; }
+    uint32_t ModuleImage::GetHostImportCount() const { return At<ImageHeader>(0)->hostImportCount; }
+    uint32_t ModuleImage::GetGlobalCount() const { return At<ImageHeader>(0)->globalCount; }
+    int32_t ModuleImage::GetInitFunction() const { return At<ImageHeader>(0)->initFunction; }
+
+    ModuleImage::Function ModuleImage::GetFunction(uint32_t index) const
+    {
+        const FunctionRecord& record = At<FunctionRecord>(At<ImageHeader>(0)->functions)[index];
+        return {
+            { At<char>(record.name), record.nameLength },
+            { At<Instruction>(record.code), record.codeCount },
+            { At<Value>(record.constants), record.constantCount },
+            { At<LineStart>(record.lines), record.lineCount },
+            record.numParams,
+            record.frameSize,
+            record.returnsValue != 0,
+        };
+    }
+
+    ModuleImage::Class ModuleImage::GetClass(uint32_t index) const
+    {
+        const ClassRecord& record = At<ClassRecord>(At<ImageHeader>(0)->classes)[index];
+        return {
+            { At<char>(record.name), record.nameLength },
+            record.instanceSize,
+            { At<uint32_t>(record.methods), record.methodCount },
+            { At<uint32_t>(record.referenceFields), record.referenceFieldCount },
+        };
+    }
+
+    ModuleImage::String ModuleImage::GetString(uint32_t index) const
+    {
+        const StringRecord& record = At<StringRecord>(At<ImageHeader>(0)->strings)[index];
+        return { { At<char>(record.text), record.length }, record.hash };
+    }
+
+    ModuleImage::HostImport ModuleImage::GetHostImport(uint32_t index) const
+    {
+        const HostImportRecord& record = At<HostImportRecord>(At<ImageHeader>(0)->hostImports)[index];
+        return { record.index, { At<char>(record.signature), record.signatureLength } };
+    }
+
+    int32_t ModuleImage::FindFunction(std::string_view name) const
+    {
+        for (uint32_t i = 0; i < GetFunctionCount(); i++)
+        {
+            if (GetFunction(i).name == name)
+                return static_cast<int32_t>(i);
+        }
+        return -1;
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Bytecode.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Arcanelab::Mano
+{
+    // Precompiled module file. The file is the module laid out for
+    // execution: code, constants and tables sit in 8-byte aligned sections
+    // that the VM reads in place, so opening an image maps the file and
+    // checks the header and section bounds without touching the bytecode.
+    //
+    // Everything is stored in host byte order. An image written on a machine
+    // of the other byte order, by another format version or instruction set,
+    // or from sources whose hash differs from the caller's is rejected, and
+    // the caller compiles from source instead. Images are trusted like the
+    // compiler's own output; the bytecode is not verified.
+    class ModuleImage
+    {
+    public:
+        static constexpr uint32_t Version = 3;
+
+        struct Function
+        {
+            std::string_view name;
+            std::span<const Instruction> code;
+            std::span<const Value> constants;
+            std::span<const LineStart> lines;
+            uint32_t numParams;
+            uint32_t frameSize;
+            bool returnsValue;
+        };
+
+        struct Class
+        {
+            std::string_view name;
+            uint32_t instanceSize;
+            std::span<const uint32_t> methods;
+            std::span<const uint32_t> referenceFields;
+        };
+
+        struct String
+        {
+            std::string_view text;
+            uint32_t hash;
+        };
+
+        struct HostImport
+        {
+            uint32_t index;
+            std::string_view signature;
+        };
+
+        ~ModuleImage();
+        ModuleImage(const ModuleImage&) = delete;
+        ModuleImage& operator=(const ModuleImage&) = delete;
+
+        // 64-bit FNV-1a over the length and characters of a source text.
+        // Chain the calls to hash a program made of several files.
+        static uint64_t HashSource(std::string_view text, uint64_t hash = 0xCBF29CE484222325ull);
+
+        // Writes the image next to path and renames it into place, so a
+        // reader never maps a partly written file. False if it cannot be
+        // written.
+        static bool Write(const Module& module, uint64_t sourceHash, const std::string& path);
+        // Null if the file is missing, malformed, or stale for sourceHash.
+        static std::unique_ptr<ModuleImage> Open(const std::string& path, uint64_t sourceHash);
+
+        uint32_t GetFunctionCount() const;
+        uint32_t GetClassCount() const;
+        uint32_t GetStringCount() const;
+        uint32_t GetHostImportCount() const;
+        Function GetFunction(uint32_t index) const;
+        Class GetClass(uint32_t index) const;
+        String GetString(uint32_t index) const;
+        HostImport GetHostImport(uint32_t index) const;
+        uint32_t GetGlobalCount() const;
+        int32_t GetInitFunction() const;
+        int32_t FindFunction(std::string_view name) const;
+
+    private:
+        ModuleImage() = default;
+
+        const std::byte* data = nullptr;
+        size_t size = 0;
+        bool mapped = false;                    // Otherwise data points into buffer
+        std::unique_ptr<uint64_t[]> buffer;
+
+        bool Validate(uint64_t sourceHash) const;
+        template<typename T>
+        const T* At(uint64_t offset) const { return reinterpret_cast<const T*>(data + offset); }
+    };
+} // namespace Arcanelab::Mano
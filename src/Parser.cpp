@@ -1,62 +1,54 @@
 #include <Parser.h>
-#include <Lexer.h>
 
 #include <cassert>
-#include <cstdlib>
-#include <iostream>
 
 namespace Arcanelab::Mano
 {
-    Parser::Parser(const std::vector<Token>& tokens)
-        : m_tokens(tokens), m_current(0)
+    Parser::Parser(TokenStream& tokens, ErrorReporter& errorReporter, AstArena& arena)
+        : m_tokens(tokens), m_sourceMap(tokens.GetSourceMap()), m_errorReporter(errorReporter), m_arena(arena)
     {
     }
 
+    std::string_view Parser::Text(const Token& token) const
+    {
+        return m_sourceMap.Text(token);
+    }
+
     bool Parser::IsAtEnd() const
     {
-        return m_tokens[m_current].type == TokenType::EndOfFile;
+        return m_tokens.IsAtEnd();
     }
 
     const Token& Parser::Peek() const
     {
-        return m_tokens[m_current];
+        return m_tokens.Peek();
+    }
+
+    // Statements are parsed in source order, so the cursor only moves forward.
+    uint32_t Parser::CurrentLine()
+    {
+        return m_sourceMap.Line(Peek().offset, m_lineCursor);
     }
 
     const Token& Parser::Previous() const
     {
-        return m_tokens[m_current - 1];
+        return m_tokens.Previous();
     }
 
     const Token& Parser::Advance()
     {
-        if (!IsAtEnd())
-            m_current++;
+        m_tokens.Advance();
         return Previous();
     }
 
-    bool Parser::CheckType(TokenType type) const
+    bool Parser::Check(TokenKind kind) const
     {
-        if (IsAtEnd())
-            return false;
-        return Peek().type == type;
+        return Peek().kind == kind;
     }
 
-    bool Parser::Match(const std::initializer_list<TokenType>& types)
+    bool Parser::Match(TokenKind kind)
     {
-        for (TokenType type : types)
-        {
-            if (CheckType(type))
-            {
-                Advance();
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool Parser::MatchKeyword(const std::string& expected)
-    {
-        if (CheckType(TokenType::Keyword) && Peek().lexeme == expected)
+        if (Check(kind))
         {
             Advance();
             return true;
@@ -64,88 +56,130 @@ namespace Arcanelab::Mano
         return false;
     }
 
-    const Token& Parser::Consume(TokenType type, const std::string& message)
+    const Token& Parser::Consume(TokenKind kind, std::string_view message)
     {
-        if (CheckType(type))
+        if (Check(kind))
             return Advance();
         ErrorAtCurrent(message);
-        return Peek(); // Unreachable, but required for compilation.
     }
 
-    bool Parser::MatchPunctuation(const std::string& expected)
+    void Parser::ErrorAtCurrent(std::string_view message)
     {
-        if (CheckType(TokenType::Punctuation) && Peek().lexeme == expected)
+        // Unwinding out of nested constructs often fails again on the same
+        // token (typically EndOfFile); only the first error there is useful.
+        const Token& token = Peek();
+        if (!m_hasErrorOffset || token.offset != m_lastErrorOffset)
         {
-            Advance();
-            return true;
+            SourceMap::Location location = m_sourceMap.Resolve(token);
+            m_errorReporter.Report(location.line, location.column, std::string(message));
+            m_lastErrorOffset = token.offset;
+            m_hasErrorOffset = true;
         }
-        return false;
+        throw ParseError{};
     }
 
-    const Token& Parser::ConsumePunctuation(const std::string& expected, const std::string& message)
+    void Parser::Synchronize()
     {
-        if (!IsAtEnd() && Peek().type == TokenType::Punctuation && Peek().lexeme == expected)
-            return Advance();
-        ErrorAtCurrent(message);
-        return Peek(); // Unreachable.
+        // Panic mode: drop tokens until the end of the broken statement, the
+        // end of the enclosing block, or the start of the next declaration.
+        while (!IsAtEnd())
+        {
+            if (Match(TokenKind::Semicolon) || Check(TokenKind::RightBrace) || AtDeclaration())
+                return;
+            Advance();
+        }
     }
 
-    void Parser::ErrorAtCurrent(const std::string& message)
+    bool Parser::AtDeclaration() const
     {
-        const Token& token = Peek();
-        std::cerr << "[Line " << token.line << ", Column " << token.column
-            << "] Error: " << message << "\n";
-        std::exit(1);
+        switch (Peek().kind)
+        {
+            case TokenKind::Let:
+            case TokenKind::Var:
+            case TokenKind::Fun:
+            case TokenKind::Class:
+            case TokenKind::Enum:
+                return true;
+            default:
+                return false;
+        }
     }
 
     ASTNodePtr Parser::ParseProgram()
     {
-        auto program = std::make_unique<ProgramNode>();
+        auto program = m_arena.New<ProgramNode>();
+        std::vector<ASTNodePtr> declarations;
         while (!IsAtEnd())
         {
-            auto decl = ParseDeclaration();
-            if (decl)
-                program->declarations.push_back(std::move(decl));
+            try
+            {
+                uint32_t line = CurrentLine();
+                auto decl = ParseDeclaration();
+                if (decl)
+                {
+                    decl->line = line;
+                    declarations.push_back(decl);
+                }
+            }
+            catch (const ParseError&)
+            {
+                Synchronize();
+                // There is no block to close at the top level.
+                Match(TokenKind::RightBrace);
+            }
         }
+        program->declarations = m_arena.CopyArray(declarations);
         return program;
     }
 
     ASTNodePtr Parser::ParseDeclaration()
     {
-        if (MatchKeyword("let"))
-            return ParseVariableDeclaration(true);
-        if (MatchKeyword("var"))
-            return ParseVariableDeclaration(false);
-        if (MatchKeyword("fun"))
-            return ParseFunctionDeclaration();
-        if (MatchKeyword("class"))
-            return ParseClassDeclaration();
-        if (MatchKeyword("enum"))
-            return ParseEnumDeclaration();
+        switch (Peek().kind)
+        {
+            case TokenKind::Let:
+                Advance();
+                return ParseVariableDeclaration(true);
+            case TokenKind::Var:
+                Advance();
+                return ParseVariableDeclaration(false);
+            case TokenKind::Fun:
+                Advance();
+                return ParseFunctionDeclaration();
+            case TokenKind::Class:
+                Advance();
+                return ParseClassDeclaration();
+            case TokenKind::Enum:
+                Advance();
+                return ParseEnumDeclaration();
+            default:
+                break;
+        }
 
         ErrorAtCurrent("Expected declaration.");
-        return nullptr;
     }
 
     TypeNodePtr Parser::ParseType(const bool isConst, const bool allowArrayType = true)
     {
-        if (Match({ TokenType::Keyword }))
+        TokenKind kind = Peek().kind;
+        if (kind == TokenKind::Int || kind == TokenKind::UInt || kind == TokenKind::Float ||
+            kind == TokenKind::Bool || kind == TokenKind::StringType)
         {
             // Handle primitive types (int, uint, float, bool, string).
-            auto typeNode = std::make_unique<TypeNode>();
-            typeNode->name = std::string(Previous().lexeme);
+            Advance();
+            auto typeNode = m_arena.New<TypeNode>();
+            typeNode->name = Text(Previous());
             typeNode->isConst = isConst;
             return typeNode;
         }
-        else if (Match({ TokenType::Identifier }))
+        else if (Match(TokenKind::Identifier))
         {
             // Handle user defined types (Identifier)
-            auto typeNode = std::make_unique<TypeNode>();
-            typeNode->name = std::string(Previous().lexeme);
+            auto typeNode = m_arena.New<TypeNode>();
+            typeNode->name = Text(Previous());
             typeNode->isConst = isConst;
             return typeNode;
         }
-        else if (Match({ TokenType::Punctuation }) && std::string(Previous().lexeme) == "[") // Check for '['
+        else if (Match(TokenKind::LeftBracket))
         {
             if (!allowArrayType)
             {
@@ -153,52 +187,57 @@ namespace Arcanelab::Mano
             }
             // Handle array type.
             auto arrayType = ParseType(false, false); // Recursively parse element type to the 1st order, disallow array types.
-            ConsumePunctuation("]", "Expected ']' after array element type.");
+            Consume(TokenKind::RightBracket, "Expected ']' after array element type.");
             // Construct the type name to be, for instance, "[int]".
-            auto typeNode = std::make_unique<TypeNode>();
-            typeNode->name = "[" + arrayType->name + "]";
+            auto typeNode = m_arena.New<TypeNode>();
+            typeNode->name = m_arena.CopyString("[" + std::string(arrayType->name) + "]");
+            typeNode->array = true;
             typeNode->isConst = isConst;
 
             return typeNode;
         }
         ErrorAtCurrent("Expected type name.");
-        return nullptr;
     }
 
     ASTNodePtr Parser::ParseVariableDeclaration(const bool isConst)
     {
-        auto varDecl = std::make_unique<VariableDeclarationNode>();
+        auto varDecl = m_arena.New<VariableDeclarationNode>();
 
         // Capture variable name from token
-        const Token& nameToken = Consume(TokenType::Identifier,
+        const Token& nameToken = Consume(TokenKind::Identifier,
             "Expected variable name.");
-        varDecl->name = nameToken.lexeme;
+        varDecl->name = Text(nameToken);
+        varDecl->nameId = nameToken.nameId;
 
-        ConsumePunctuation(":", "Expected ':' after variable name.");
+        Consume(TokenKind::Colon, "Expected ':' after variable name.");
         varDecl->declaredType = ParseType(isConst);
 
-        if (Match({ TokenType::Operator }) && Previous().lexeme == "=")
+        if (Match(TokenKind::Assign))
         {
             varDecl->initializer = ParseExpression();
         }
 
-        ConsumePunctuation(";", "Expected ';' after variable declaration.");
+        Consume(TokenKind::Semicolon, "Expected ';' after variable declaration.");
         return varDecl;
     }
 
     ASTNodePtr Parser::ParseFunctionDeclaration()
     {
-        auto funDecl = std::make_unique<FunctionDeclarationNode>();
-        funDecl->name = std::string(Consume(TokenType::Identifier, "Expected function name.").lexeme);
-        ConsumePunctuation("(", "Expected '(' after function name.");
+        auto funDecl = m_arena.New<FunctionDeclarationNode>();
+        const Token& nameToken = Consume(TokenKind::Identifier, "Expected function name.");
+        funDecl->name = Text(nameToken);
+        funDecl->nameId = nameToken.nameId;
+        Consume(TokenKind::LeftParen, "Expected '(' after function name.");
         // Only parse parameters if the next token is not a closing parenthesis.
-        if (CheckType(TokenType::Identifier)) // we now check if it's an identifier
+        if (Check(TokenKind::Identifier)) // we now check if it's an identifier
         {
-            ParseParameterList(funDecl->parameters);
+            std::vector<Parameter> parameters;
+            ParseParameterList(parameters);
+            funDecl->parameters = m_arena.CopyArray(parameters);
         }
-        ConsumePunctuation(")", "Expected ')' after parameters.");
+        Consume(TokenKind::RightParen, "Expected ')' after parameters.");
         // Check for an optional return type.
-        if (CheckType(TokenType::Punctuation) && Peek().lexeme == ":")
+        if (Check(TokenKind::Colon))
         {
             Advance();
             funDecl->returnType = ParseType(false);
@@ -206,79 +245,85 @@ namespace Arcanelab::Mano
         else
         {
             // Add default void return type
-            funDecl->returnType = std::make_unique<TypeNode>("void", false);
+            funDecl->returnType = m_arena.New<TypeNode>("void", false);
         }
 
         funDecl->body = ParseBlock();
         return funDecl;
     }
 
-    void Parser::ParseParameterList(std::vector<std::pair<std::string, TypeNodePtr>>& parameters)
+    void Parser::ParseParameterList(std::vector<Parameter>& parameters)
     {
         // At least one parameter is expected.
-        if (CheckType(TokenType::Identifier))
+        if (Check(TokenKind::Identifier))
         {
-            std::string paramName = std::string(Consume(TokenType::Identifier, "Expected parameter name.").lexeme);
-            ConsumePunctuation(":", "Expected ':' after parameter name.");
-            bool isConst = CheckType(TokenType::Keyword) && Peek().lexeme == "const";
+            const Token& nameToken = Consume(TokenKind::Identifier, "Expected parameter name.");
+            Parameter parameter{ Text(nameToken), nameToken.nameId };
+            Consume(TokenKind::Colon, "Expected ':' after parameter name.");
+            bool isConst = Check(TokenKind::Const);
             if (isConst)
                 Advance();
-            TypeNodePtr paramType = ParseType(isConst);
-            parameters.push_back({ paramName, std::move(paramType) });
+            parameter.type = ParseType(isConst);
+            parameters.push_back(parameter);
         }
 
-        while (CheckType(TokenType::Punctuation) && Peek().lexeme == ",")
+        while (Check(TokenKind::Comma))
         {
             Advance(); // Consume the comma.
-            std::string paramName = std::string(Consume(TokenType::Identifier, "Expected parameter name after comma.").lexeme);
-            ConsumePunctuation(":", "Expected ':' after parameter name.");
-            bool isConst = CheckType(TokenType::Keyword) && Peek().lexeme == "const";
+            const Token& nameToken = Consume(TokenKind::Identifier, "Expected parameter name after comma.");
+            Parameter parameter{ Text(nameToken), nameToken.nameId };
+            Consume(TokenKind::Colon, "Expected ':' after parameter name.");
+            bool isConst = Check(TokenKind::Const);
             if (isConst)
                 Advance();
-            TypeNodePtr paramType = ParseType(isConst);
-            parameters.push_back({ paramName, std::move(paramType) });
+            parameter.type = ParseType(isConst);
+            parameters.push_back(parameter);
         }
     }
 
     ASTNodePtr Parser::ParseClassDeclaration()
     {
-        auto classDecl = std::make_unique<ClassDeclarationNode>();
-        classDecl->name = std::string(Consume(TokenType::Identifier, "Expected class name.").lexeme);
+        auto classDecl = m_arena.New<ClassDeclarationNode>();
+        const Token& nameToken = Consume(TokenKind::Identifier, "Expected class name.");
+        classDecl->name = Text(nameToken);
+        classDecl->nameId = nameToken.nameId;
         classDecl->body = ParseClassBlock();
         return classDecl;
     }
 
     ASTNodePtr Parser::ParseEnumDeclaration()
     {
-        auto enumDecl = std::make_unique<EnumDeclarationNode>();
-        enumDecl->name = std::string(Consume(TokenType::Identifier, "Expected enum name.").lexeme);
+        auto enumDecl = m_arena.New<EnumDeclarationNode>();
+        const Token& nameToken = Consume(TokenKind::Identifier, "Expected enum name.");
+        enumDecl->name = Text(nameToken);
+        enumDecl->nameId = nameToken.nameId;
         enumDecl->values = ParseEnumBlock();
         return enumDecl;
     }
 
-    std::vector<std::string> Parser::ParseEnumBlock()
+    std::span<std::string_view> Parser::ParseEnumBlock()
     {
-        std::vector<std::string> values;
-        ConsumePunctuation("{", "Expected '{' to start enum body.");
+        std::vector<std::string_view> values;
+        Consume(TokenKind::LeftBrace, "Expected '{' to start enum body.");
 
         // Empty enum.
-        if (CheckType(TokenType::Punctuation) && Peek().lexeme == "}")
+        if (Check(TokenKind::RightBrace))
         {
             Advance(); // consume "}"
-            return values;
+            return {};
         }
 
         do
         {
             // Each enum case should be an identifier.
-            std::string enumName = std::string(Consume(TokenType::Identifier, "Expected enum name.").lexeme);
+            std::string_view enumName = Text(Consume(TokenKind::Identifier, "Expected enum name."));
             values.push_back(enumName);
 
             // If there's a comma, consume it and continue.
-            if (CheckType(TokenType::Punctuation) && Peek().lexeme == ",")
+            if (Check(TokenKind::Comma))
             {
                 Advance(); // consume comma
-                if (CheckType(TokenType::Punctuation) && Peek().lexeme == "}") // optional last comma
+                if (Check(TokenKind::RightBrace)) // optional last comma
                 {
                     break;
                 }
@@ -290,173 +335,177 @@ namespace Arcanelab::Mano
         } while (true);
 
         // Expect a closing brace.
-        ConsumePunctuation("}", "Expected '}' to close enum body.");
-        return values;
+        Consume(TokenKind::RightBrace, "Expected '}' to close enum body.");
+        return m_arena.CopyArray(values);
     }
 
     ASTNodePtr Parser::ParseBlock()
     {
-        ConsumePunctuation("{", "Expected '{' to start a block.");
-        auto block = std::make_unique<BlockNode>();
-        while (!CheckType(TokenType::Punctuation) || Peek().lexeme != "}")
-        {
-            // Check for declaration keywords first.
-            if (CheckType(TokenType::Keyword) &&
-                (Peek().lexeme == "let" ||
-                    Peek().lexeme == "var" ||
-                    Peek().lexeme == "fun" ||
-                    Peek().lexeme == "class" ||
-                    Peek().lexeme == "enum"))
+        Consume(TokenKind::LeftBrace, "Expected '{' to start a block.");
+        auto block = m_arena.New<BlockNode>();
+        std::vector<ASTNodePtr> statements;
+        while (!Check(TokenKind::RightBrace) && !IsAtEnd())
+        {
+            try
             {
-                block->statements.push_back(ParseDeclaration());
+                uint32_t line = CurrentLine();
+                // Check for declaration keywords first.
+                if (AtDeclaration())
+                {
+                    statements.push_back(ParseDeclaration());
+                }
+                else // It must be a statement
+                {
+                    statements.push_back(ParseStatement());
+                }
+                statements.back()->line = line;
             }
-            else // It must be a statement
+            catch (const ParseError&)
             {
-                block->statements.push_back(ParseStatement());
+                Synchronize();
             }
         }
-        ConsumePunctuation("}", "Expected '}' to close block.");
+        Consume(TokenKind::RightBrace, "Expected '}' to close block.");
+        block->statements = m_arena.CopyArray(statements);
         return block;
     }
 
     ASTNodePtr Parser::ParseClassBlock()
     {
-        ConsumePunctuation("{", "Expected '{' to start a class block.");
-        auto block = std::make_unique<ClassBlockNode>();
-        while (!CheckType(TokenType::Punctuation) || Peek().lexeme != "}")
+        Consume(TokenKind::LeftBrace, "Expected '{' to start a class block.");
+        auto block = m_arena.New<ClassBlockNode>();
+        std::vector<ASTNodePtr> declarations;
+        while (!Check(TokenKind::RightBrace) && !IsAtEnd())
         {
-            if (CheckType(TokenType::Keyword) &&
-                (Peek().lexeme == "let" ||
-                    Peek().lexeme == "var" ||
-                    Peek().lexeme == "fun" ||
-                    Peek().lexeme == "class" ||
-                    Peek().lexeme == "enum"))
+            try
             {
-                block->declarations.push_back(ParseDeclaration());
+                if (AtDeclaration())
+                {
+                    uint32_t line = CurrentLine();
+                    declarations.push_back(ParseDeclaration());
+                    declarations.back()->line = line;
+                }
+                else
+                {
+                    ErrorAtCurrent("Expected declaration.");
+                }
             }
-            else
+            catch (const ParseError&)
             {
-                ErrorAtCurrent("Expected declaration.");
-                break;
+                Synchronize();
             }
         }
-        ConsumePunctuation("}", "Expected '}' to close class block.");
+        Consume(TokenKind::RightBrace, "Expected '}' to close class block.");
+        block->declarations = m_arena.CopyArray(declarations);
         return block;
     }
 
     ASTNodePtr Parser::ParseStatement()
     {
-        if (MatchKeyword("if"))
+        if (Match(TokenKind::If))
             return ParseIfStatement();
-        if (MatchKeyword("for"))
+        if (Match(TokenKind::For))
             return ParseForStatement();
-        if (MatchKeyword("while"))
+        if (Match(TokenKind::While))
             return ParseWhileStatement();
-        if (MatchKeyword("return"))
+        if (Match(TokenKind::Return))
             return ParseReturnStatement();
-        if (MatchKeyword("break"))
+        if (Match(TokenKind::Break))
             return ParseBreakStatement();
-        if (MatchKeyword("continue"))
+        if (Match(TokenKind::Continue))
             return ParseContinueStatement();
-        if (MatchKeyword("switch"))
+        if (Match(TokenKind::Switch))
             return ParseSwitchStatement();
 
         // If none of the above, it must be an expression statement.
         auto expression = ParseExpression();
 
-        bool isAssignmentNode = false;
-        if (BinaryExpressionNode* binaryExpressionNode = dynamic_cast<BinaryExpressionNode*>(expression.get()))
-        {
-            isAssignmentNode = (binaryExpressionNode->op == BinaryOperator::Assign);
-        }
+        bool isAssignmentNode = expression->nodeType == ASTType::BinaryExpression &&
+            static_cast<BinaryExpressionNode*>(expression)->op == BinaryOperator::Assign;
 
-        if (isAssignmentNode || dynamic_cast<FunctionCallNode*>(expression.get())) // assignment or function call
+        if (isAssignmentNode || expression->nodeType == ASTType::FunctionCall) // assignment or function call
         {
-            ConsumePunctuation(";", "Expected ';' after expression statement.");
-            auto expressionNode = std::make_unique<ExpressionStatementNode>();
-            expressionNode->expression = std::move(expression);
+            Consume(TokenKind::Semicolon, "Expected ';' after expression statement.");
+            auto expressionNode = m_arena.New<ExpressionStatementNode>();
+            expressionNode->expression = expression;
             return expressionNode;
         }
-        else
-        {
-            ErrorAtCurrent("Expected statement.");
-        }
-        return nullptr;
+        ErrorAtCurrent("Expected statement.");
     }
 
     ASTNodePtr Parser::ParseBreakStatement()
     {
-        ConsumePunctuation(";", "Expected ';' after 'break'.");
-        return std::make_unique<BreakStatementNode>();
+        Consume(TokenKind::Semicolon, "Expected ';' after 'break'.");
+        return m_arena.New<BreakStatementNode>();
     }
 
     ASTNodePtr Parser::ParseContinueStatement()
     {
-        ConsumePunctuation(";", "Expected ';' after 'break'.");
-        return std::make_unique<ContinueStatementNode>();
+        Consume(TokenKind::Semicolon, "Expected ';' after 'break'.");
+        return m_arena.New<ContinueStatementNode>();
     }
 
     ASTNodePtr Parser::ParseIfStatement()
     {
-        ConsumePunctuation("(", "Expected '(' after 'if'.");
+        Consume(TokenKind::LeftParen, "Expected '(' after 'if'.");
         auto condition = ParseExpression();
-        ConsumePunctuation(")", "Expected ')' after if condition.");
+        Consume(TokenKind::RightParen, "Expected ')' after if condition.");
         auto thenBranch = ParseBlock();
         ASTNodePtr elseBranch = nullptr;
-        if (MatchKeyword("else"))
+        if (Match(TokenKind::Else))
         {
             elseBranch = ParseBlock();
         }
-        auto ifStmt = std::make_unique<IfStatementNode>();
-        ifStmt->condition = std::move(condition);
-        ifStmt->thenBranch = std::move(thenBranch);
-        ifStmt->elseBranch = std::move(elseBranch);
+        auto ifStmt = m_arena.New<IfStatementNode>();
+        ifStmt->condition = condition;
+        ifStmt->thenBranch = thenBranch;
+        ifStmt->elseBranch = elseBranch;
         return ifStmt;
     }
 
     ASTNodePtr Parser::ParseForStatement()
     {
-        ConsumePunctuation("(", "Expected '(' after 'for'.");
+        Consume(TokenKind::LeftParen, "Expected '(' after 'for'.");
         ASTNodePtr init = nullptr;
 
-        if (MatchKeyword("var"))
+        if (Match(TokenKind::Var))
             init = ParseVariableDeclaration(false);
 
         auto condition = ParseExpression();
-        ConsumePunctuation(";", "Expected ';' after for condition.");
+        Consume(TokenKind::Semicolon, "Expected ';' after for condition.");
         auto increment = ParseExpression();
-        ConsumePunctuation(")", "Expected ')' after for clauses.");
+        Consume(TokenKind::RightParen, "Expected ')' after for clauses.");
         auto body = ParseBlock();
 
-        auto forStmt = std::make_unique<ForStatementNode>();
-        forStmt->init = std::move(init);
-        forStmt->condition = std::move(condition);
-        forStmt->update = std::move(increment);
-        forStmt->body = std::move(body);
+        auto forStmt = m_arena.New<ForStatementNode>();
+        forStmt->init = init;
+        forStmt->condition = condition;
+        forStmt->update = increment;
+        forStmt->body = body;
 
         return forStmt;
     }
 
     ASTNodePtr Parser::ParseWhileStatement()
     {
-        ConsumePunctuation("(", "Expected '(' after 'while'.");
+        Consume(TokenKind::LeftParen, "Expected '(' after 'while'.");
         auto condition = ParseExpression();
-        ConsumePunctuation(")", "Expected ')' after while condition.");
+        Consume(TokenKind::RightParen, "Expected ')' after while condition.");
         auto body = ParseBlock();
-        auto whileStmt = std::make_unique<WhileStatementNode>();
-        whileStmt->condition = std::move(condition);
-        whileStmt->body = std::move(body);
+        auto whileStmt = m_arena.New<WhileStatementNode>();
+        whileStmt->condition = condition;
+        whileStmt->body = body;
         return whileStmt;
     }
 
     ASTNodePtr Parser::ParseReturnStatement()
     {
-        auto retStmt = std::make_unique<ReturnStatementNode>();
-        if (!CheckType(TokenType::Punctuation) || Peek().lexeme != ";")
+        auto retStmt = m_arena.New<ReturnStatementNode>();
+        if (!Check(TokenKind::Semicolon))
         {
             retStmt->expression = ParseExpression();
         }
-        ConsumePunctuation(";", "Expected ';' after return statement.");
+        Consume(TokenKind::Semicolon, "Expected ';' after return statement.");
         return retStmt;
     }
 
@@ -468,11 +517,11 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseAssignmentExpression()
     {
         auto left = ParseLogicalOrExpression();
-        if (CheckType(TokenType::Operator) && Peek().lexeme == "=")
+        if (Check(TokenKind::Assign))
         {
             Advance(); // consume the "=" operator.
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(left);
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = left;
             binary->op = BinaryOperator::Assign;
             binary->right = ParseAssignmentExpression();
             return binary;
@@ -484,14 +533,14 @@ namespace Arcanelab::Mano
     {
         auto expr = ParseLogicalAndExpression();
         // Only consume "||" operators.
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "||")
+        while (Check(TokenKind::PipePipe))
         {
             Advance(); // consume the "||" token
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(expr);
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = expr;
             binary->op = BinaryOperator::LogicalOr;
             binary->right = ParseLogicalAndExpression();
-            expr = std::move(binary);
+            expr = binary;
         }
         return expr;
     }
@@ -500,14 +549,14 @@ namespace Arcanelab::Mano
     {
         auto expr = ParseBitwiseOrExpression();
         // Only consume "&&" operators.
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "&&")
+        while (Check(TokenKind::AmpersandAmpersand))
         {
             Advance(); // consume the "&&" token
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(expr);
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = expr;
             binary->op = BinaryOperator::LogicalAnd;
             binary->right = ParseEqualityExpression();
-            expr = std::move(binary);
+            expr = binary;
         }
         return expr;
     }
@@ -515,16 +564,16 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseBitwiseOrExpression()
     {
         auto left = ParseBitwiseXorExpression();
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "|")
+        while (Check(TokenKind::Pipe))
         {
             Advance();
             auto op = BinaryOperator::BitwiseOr;
             auto right = ParseBitwiseXorExpression();
-            auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-            binaryExpr->left = std::move(left);
+            auto binaryExpr = m_arena.New<BinaryExpressionNode>();
+            binaryExpr->left = left;
             binaryExpr->op = op;
-            binaryExpr->right = std::move(right);
-            left = std::move(binaryExpr);
+            binaryExpr->right = right;
+            left = binaryExpr;
         }
         return left;
     }
@@ -532,16 +581,16 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseBitwiseXorExpression()
     {
         auto left = ParseBitwiseAndExpression();
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "^")
+        while (Check(TokenKind::Caret))
         {
             Advance();
             auto op = BinaryOperator::BitwiseXor;
             auto right = ParseBitwiseAndExpression();
-            auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-            binaryExpr->left = std::move(left);
+            auto binaryExpr = m_arena.New<BinaryExpressionNode>();
+            binaryExpr->left = left;
             binaryExpr->op = op;
-            binaryExpr->right = std::move(right);
-            left = std::move(binaryExpr);
+            binaryExpr->right = right;
+            left = binaryExpr;
         }
         return left;
     }
@@ -549,16 +598,16 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseBitwiseAndExpression()
     {
         auto left = ParseEqualityExpression();
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "&")
+        while (Check(TokenKind::Ampersand))
         {
             Advance();
             auto op = BinaryOperator::BitwiseAnd;
             auto right = ParseEqualityExpression();
-            auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-            binaryExpr->left = std::move(left);
+            auto binaryExpr = m_arena.New<BinaryExpressionNode>();
+            binaryExpr->left = left;
             binaryExpr->op = op;
-            binaryExpr->right = std::move(right);
-            left = std::move(binaryExpr);
+            binaryExpr->right = right;
+            left = binaryExpr;
         }
         return left;
     }
@@ -566,16 +615,15 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseEqualityExpression()
     {
         auto expr = ParseRelationalExpression();
-        while (CheckType(TokenType::Operator) &&
-            (Peek().lexeme == "==" || Peek().lexeme == "!="))
+        while (Check(TokenKind::EqualEqual) || Check(TokenKind::BangEqual))
         {
             // Now that we know the operator is one we want, consume it.
-            std::string op = std::string(Advance().lexeme);
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(expr);
-            binary->op = (op == "==") ? BinaryOperator::Equal : BinaryOperator::NotEqual;
+            TokenKind op = Advance().kind;
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = expr;
+            binary->op = (op == TokenKind::EqualEqual) ? BinaryOperator::Equal : BinaryOperator::NotEqual;
             binary->right = ParseRelationalExpression();
-            expr = std::move(binary);
+            expr = binary;
         }
         return expr;
     }
@@ -584,42 +632,37 @@ namespace Arcanelab::Mano
     {
         auto expr = ParseShiftExpression();
         // Use lookahead to check if the next token is a relational operator.
-        if (CheckType(TokenType::Operator))
-        {
-            std::string op = std::string(Peek().lexeme);
-            if (op == "<" || op == ">" || op == "<=" || op == ">=")
-            {
-                Advance(); // consume the relational operator
-                auto binary = std::make_unique<BinaryExpressionNode>();
-                binary->left = std::move(expr);
-                if (op == "<")
-                    binary->op = BinaryOperator::Less;
-                else if (op == ">")
-                    binary->op = BinaryOperator::Greater;
-                else if (op == "<=")
-                    binary->op = BinaryOperator::LessEqual;
-                else
-                    binary->op = BinaryOperator::GreaterEqual;
-                binary->right = ParseAdditiveExpression();
-                expr = std::move(binary);
-            }
-        }
+        BinaryOperator op;
+        switch (Peek().kind)
+        {
+            case TokenKind::Less: op = BinaryOperator::Less; break;
+            case TokenKind::Greater: op = BinaryOperator::Greater; break;
+            case TokenKind::LessEqual: op = BinaryOperator::LessEqual; break;
+            case TokenKind::GreaterEqual: op = BinaryOperator::GreaterEqual; break;
+            default: return expr;
+        }
+        Advance(); // consume the relational operator
+        auto binary = m_arena.New<BinaryExpressionNode>();
+        binary->left = expr;
+        binary->op = op;
+        binary->right = ParseAdditiveExpression();
+        expr = binary;
         return expr;
     }
 
     ASTNodePtr Parser::ParseShiftExpression()
     {
         auto left = ParseAdditiveExpression();
-        while (CheckType(TokenType::Operator) && Peek().lexeme == "<<" || Peek().lexeme == ">>")
+        while (Check(TokenKind::LessLess) || Check(TokenKind::GreaterGreater))
         {
             Advance();
-            auto op = (std::string(Previous().lexeme) == "<<") ? BinaryOperator::LeftShift : BinaryOperator::RightShift;
+            auto op = (Previous().kind == TokenKind::LessLess) ? BinaryOperator::LeftShift : BinaryOperator::RightShift;
             auto right = ParseAdditiveExpression();
-            auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-            binaryExpr->left = std::move(left);
+            auto binaryExpr = m_arena.New<BinaryExpressionNode>();
+            binaryExpr->left = left;
             binaryExpr->op = op;
-            binaryExpr->right = std::move(right);
-            left = std::move(binaryExpr);
+            binaryExpr->right = right;
+            left = binaryExpr;
         }
         return left;
     }
@@ -627,15 +670,14 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseAdditiveExpression()
     {
         auto expr = ParseMultiplicativeExpression();
-        while (CheckType(TokenType::Operator) &&
-            (Peek().lexeme == "+" || Peek().lexeme == "-"))
+        while (Check(TokenKind::Plus) || Check(TokenKind::Minus))
         {
-            std::string op = std::string(Advance().lexeme);
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(expr);
-            binary->op = (op == "+") ? BinaryOperator::Add : BinaryOperator::Subtract;
+            TokenKind op = Advance().kind;
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = expr;
+            binary->op = (op == TokenKind::Plus) ? BinaryOperator::Add : BinaryOperator::Subtract;
             binary->right = ParseMultiplicativeExpression();
-            expr = std::move(binary);
+            expr = binary;
         }
         return expr;
     }
@@ -643,112 +685,114 @@ namespace Arcanelab::Mano
     ASTNodePtr Parser::ParseMultiplicativeExpression()
     {
         auto expr = ParseUnaryExpression();
-        while (CheckType(TokenType::Operator) &&
-            (Peek().lexeme == "*" ||
-                Peek().lexeme == "/" ||
-                Peek().lexeme == "%"))
+        while (Check(TokenKind::Star) || Check(TokenKind::Slash) || Check(TokenKind::Percent))
         {
             // Now that we know the operator is one we want, consume it.
-            std::string op = std::string(Advance().lexeme);
-            auto binary = std::make_unique<BinaryExpressionNode>();
-            binary->left = std::move(expr);
-            if (op == "*")
+            TokenKind op = Advance().kind;
+            auto binary = m_arena.New<BinaryExpressionNode>();
+            binary->left = expr;
+            if (op == TokenKind::Star)
                 binary->op = BinaryOperator::Multiply;
-            else if (op == "/")
+            else if (op == TokenKind::Slash)
                 binary->op = BinaryOperator::Divide;
-            else // op == "%"
+            else // op == TokenKind::Percent
                 binary->op = BinaryOperator::Modulo;
             binary->right = ParseUnaryExpression();
-            expr = std::move(binary);
+            expr = binary;
         }
         return expr;
     }
 
     ASTNodePtr Parser::ParseUnaryExpression()
     {
-        if (Match({ TokenType::Operator }) &&
-            (std::string(Previous().lexeme) == "-" || std::string(Previous().lexeme) == "!"))
+        if (Match(TokenKind::Minus) || Match(TokenKind::Bang))
         {
-            auto unary = std::make_unique<UnaryExpressionNode>();
-            unary->op = std::string(Previous().lexeme);
+            auto unary = m_arena.New<UnaryExpressionNode>();
+            unary->op = Text(Previous());
             unary->operand = ParseUnaryExpression();
             return unary;
         }
         return ParsePrimaryExpression();
     }
 
-    std::vector<ASTNodePtr> Parser::ParseArgumentList()
+    std::span<ASTNodePtr> Parser::ParseArgumentList()
     {
         std::vector<ASTNodePtr> arguments;
-        if (!CheckType(TokenType::Punctuation) || Peek().lexeme != ")") // check it's not an empty list.
+        if (!Check(TokenKind::RightParen)) // check it's not an empty list.
         {
             arguments.push_back(ParseExpression());
-            while (CheckType(TokenType::Punctuation) && Peek().lexeme == ",")
+            while (Check(TokenKind::Comma))
             {
                 Advance(); // Consume ","
                 arguments.push_back(ParseExpression());
             }
         }
-        return arguments;
+        return m_arena.CopyArray(arguments);
     }
 
     ASTNodePtr Parser::ParsePrimaryExpression()
     {
-        if (Match({ TokenType::Identifier }))
+        if (Match(TokenKind::Identifier))
         {
-            std::string name = std::string(Previous().lexeme);
+            std::string_view name = Text(Previous());
+            uint32_t nameId = Previous().nameId;
             // Handle direct function calls like foo()
-            if (CheckType(TokenType::Punctuation) && Peek().lexeme == "(")
+            if (Check(TokenKind::LeftParen))
             {
                 Advance(); // consume "("
                 auto args = ParseArgumentList();
-                ConsumePunctuation(")", "Expected ')' after arguments");
-                auto functionCallNode = std::make_unique<FunctionCallNode>();
+                Consume(TokenKind::RightParen, "Expected ')' after arguments");
+                auto functionCallNode = m_arena.New<FunctionCallNode>();
                 functionCallNode->name = name;
-                functionCallNode->arguments = std::move(args);
+                functionCallNode->nameId = nameId;
+                functionCallNode->arguments = args;
                 return functionCallNode;
             }
 
-            ASTNodePtr expr = std::make_unique<IdentifierNode>();
-            static_cast<IdentifierNode*>(expr.get())->name = name;
+            auto identifier = m_arena.New<IdentifierNode>();
+            identifier->name = name;
+            identifier->nameId = nameId;
+            ASTNodePtr expr = identifier;
 
             bool allowMethodCall = true; // Controls whether () is allowed
 
             while (true)
             {
                 // Member access (x.y)
-                if (MatchPunctuation("."))
+                if (Match(TokenKind::Dot))
                 {
-                    auto memberAccess = std::make_unique<MemberAccessNode>();
-                    memberAccess->object = std::move(expr);
-                    memberAccess->memberName = std::string(Consume(TokenType::Identifier, "Expected member name after '.'").lexeme);
-                    expr = std::move(memberAccess);
+                    auto memberAccess = m_arena.New<MemberAccessNode>();
+                    memberAccess->object = expr;
+                    const Token& member = Consume(TokenKind::Identifier, "Expected member name after '.'");
+                    memberAccess->memberName = Text(member);
+                    memberAccess->memberNameId = member.nameId;
+                    expr = memberAccess;
 
                     allowMethodCall = true; // Reset flag for new member access
                 }
                 // Array index access (x[y])
-                else if (MatchPunctuation("["))
+                else if (Match(TokenKind::LeftBracket))
                 {
                     auto index = ParseExpression();
-                    ConsumePunctuation("]", "Expected ']' after index expression.");
-                    auto indexAccess = std::make_unique<IndexAccessNode>();
-                    indexAccess->object = std::move(expr);
-                    indexAccess->index = std::move(index);
-                    expr = std::move(indexAccess);
+                    Consume(TokenKind::RightBracket, "Expected ']' after index expression.");
+                    auto indexAccess = m_arena.New<IndexAccessNode>();
+                    indexAccess->object = expr;
+                    indexAccess->index = index;
+                    expr = indexAccess;
 
                     allowMethodCall = false; // Disable method calls after []
                 }
                 // Method call (x.y() - allowed, x[0]() - blocked)
-                else if (allowMethodCall && CheckType(TokenType::Punctuation) && Peek().lexeme == "(")
+                else if (allowMethodCall && Check(TokenKind::LeftParen))
                 {
                     Advance(); // consume "("
                     auto args = ParseArgumentList();
-                    ConsumePunctuation(")", "Expected ')' after arguments");
+                    Consume(TokenKind::RightParen, "Expected ')' after arguments");
 
-                    auto methodCall = std::make_unique<FunctionCallNode>();
-                    methodCall->callTarget = std::move(expr);
-                    methodCall->arguments = std::move(args);
-                    expr = std::move(methodCall);
+                    auto methodCall = m_arena.New<FunctionCallNode>();
+                    methodCall->callTarget = expr;
+                    methodCall->arguments = args;
+                    expr = methodCall;
 
                     allowMethodCall = false; // Disallow chained calls like foo()()
                 }
@@ -761,79 +805,84 @@ namespace Arcanelab::Mano
         }
 
         // Handle literals (numbers, strings, bools)
-        if (Match({ TokenType::Number, TokenType::String, TokenType::Keyword }))
-        {
-            auto lit = std::make_unique<LiteralNode>();
-            lit->value = std::string(Previous().lexeme);
+        if (Match(TokenKind::Number) || Match(TokenKind::String) ||
+            Match(TokenKind::True) || Match(TokenKind::False))
+        {
+            auto lit = m_arena.New<LiteralNode>();
+            const Token& token = Previous();
+            lit->value = Text(token);
+            // The lexer strips the quotes; widen the view so the literal stays recognizable as a string.
+            if (token.kind == TokenKind::String)
+                lit->value = m_sourceMap.Source().substr(token.offset - 1, token.length + 2);
             return lit;
         }
 
         // Handle parenthesized expressions
-        if (MatchPunctuation("("))
+        if (Match(TokenKind::LeftParen))
         {
             auto expr = ParseExpression();
-            ConsumePunctuation(")", "Expected ')' after expression.");
+            Consume(TokenKind::RightParen, "Expected ')' after expression.");
             return expr;
         }
 
         // Handle array literals
-        if (MatchPunctuation("["))
+        if (Match(TokenKind::LeftBracket))
         {
-            auto arrayLiteral = std::make_unique<ArrayLiteralNode>();
-            if (CheckType(TokenType::Punctuation) && Peek().lexeme == "]")
+            auto arrayLiteral = m_arena.New<ArrayLiteralNode>();
+            if (Check(TokenKind::RightBracket))
             {
                 Advance();
                 return arrayLiteral;
             }
             arrayLiteral->elements = ParseExpressionList();
-            ConsumePunctuation("]", "Expected ']' after array elements.");
+            Consume(TokenKind::RightBracket, "Expected ']' after array elements.");
             return arrayLiteral;
         }
 
         ErrorAtCurrent("Expected expression");
-        return nullptr;
     }
 
-    std::vector<ASTNodePtr> Parser::ParseExpressionList()
+    std::span<ASTNodePtr> Parser::ParseExpressionList()
     {
         std::vector<ASTNodePtr> expressions;
         expressions.push_back(ParseExpression()); // Parse the first expression
-        while (CheckType(TokenType::Punctuation) && Peek().lexeme == ",")
+        while (Check(TokenKind::Comma))
         {
             Advance();
             expressions.push_back(ParseExpression()); // Parse subsequent expressions.
         }
-        return expressions;
+        return m_arena.CopyArray(expressions);
     }
 
     ASTNodePtr Parser::ParseSwitchStatement()
     {
-        ConsumePunctuation("(", "Expected '(' after 'switch'.");
+        Consume(TokenKind::LeftParen, "Expected '(' after 'switch'.");
         auto expr = ParseExpression();
-        ConsumePunctuation(")", "Expected ')' after switch expression.");
-        ConsumePunctuation("{", "Expected '{' to start switch body.");
+        Consume(TokenKind::RightParen, "Expected ')' after switch expression.");
+        Consume(TokenKind::LeftBrace, "Expected '{' to start switch body.");
 
-        auto switchNode = std::make_unique<SwitchStatementNode>();
-        switchNode->expression = std::move(expr);
+        auto switchNode = m_arena.New<SwitchStatementNode>();
+        switchNode->expression = expr;
+        std::vector<std::pair<ASTNodePtr, ASTNodePtr>> cases;
 
-        while (!CheckType(TokenType::Punctuation) || Peek().lexeme != "}")
+        while (!Check(TokenKind::RightBrace))
         {
-            if (MatchKeyword("case"))
+            if (Match(TokenKind::Case))
             {
                 auto caseExpr = ParseExpression();
-                ConsumePunctuation(":", "Expected ':' after case expression.");
+                Consume(TokenKind::Colon, "Expected ':' after case expression.");
                 auto caseBlock = ParseBlock();
-                switchNode->cases.emplace_back(std::move(caseExpr), std::move(caseBlock));
+                cases.emplace_back(caseExpr, caseBlock);
             }
-            else if (MatchKeyword("default"))
+            else if (Match(TokenKind::Default))
             {
-                ConsumePunctuation(":", "Expected ':' after 'default'.");
+                Consume(TokenKind::Colon, "Expected ':' after 'default'.");
                 auto defaultBlock = ParseBlock();
                 if (switchNode->defaultCase)
                 {
                     ErrorAtCurrent("Multiple default clauses in switch statement.");
                 }
-                switchNode->defaultCase = std::move(defaultBlock);
+                switchNode->defaultCase = defaultBlock;
             }
             else
             {
@@ -841,7 +890,8 @@ namespace Arcanelab::Mano
             }
         }
 
-        ConsumePunctuation("}", "Expected '}' to close switch body.");
+        Consume(TokenKind::RightBrace, "Expected '}' to close switch body.");
+        switchNode->cases = m_arena.CopyArray(cases);
         return switchNode;
     }
 } // namespace Arcanelab::Mano
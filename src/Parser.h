@@ -1,40 +1,53 @@
 #pragma once
 #include <AST.h>
-#include <Lexer.h>
+#include <AstArena.h>
+#include <TokenStream.h>
 
-#include <string>
+#include <string_view>
+#include <vector>
 
 namespace Arcanelab::Mano
 {
     class Parser
     {
     public:
-        Parser(const std::vector<Token>& tokens);
+        // Syntax errors go to errorReporter; the parser recovers and keeps
+        // going, so one pass reports every error it can find.
+        Parser(TokenStream& tokens, ErrorReporter& errorReporter, AstArena& arena);
         ASTNodePtr ParseProgram();
 
     private:
-        const std::vector<Token>& m_tokens;
-        size_t m_current;
+        TokenStream& m_tokens;
+        const SourceMap& m_sourceMap;
+        ErrorReporter& m_errorReporter;
+        AstArena& m_arena;
+        uint32_t m_lastErrorOffset = 0;
+        bool m_hasErrorOffset = false;
+        uint32_t m_lineCursor = 0;
 
+        // Thrown after an error is reported; caught where parsing can resume.
+        struct ParseError {};
+
+        std::string_view Text(const Token& token) const;
         bool IsAtEnd() const;
         const Token& Peek() const;
         const Token& Previous() const;
         const Token& Advance();
-        bool CheckType(TokenType type) const;
-        bool Match(const std::initializer_list<TokenType>& types);
-        bool MatchKeyword(const std::string& expected);
-        bool MatchPunctuation(const std::string& expected);
-        const Token& Consume(TokenType type, const std::string& message);
-        const Token& ConsumePunctuation(const std::string& expected, const std::string& message);
-        void ErrorAtCurrent(const std::string& message);
+        bool Check(TokenKind kind) const;
+        bool Match(TokenKind kind);
+        const Token& Consume(TokenKind kind, std::string_view message);
+        [[noreturn]] void ErrorAtCurrent(std::string_view message);
+        void Synchronize();
+        bool AtDeclaration() const;
+        uint32_t CurrentLine();
 
         TypeNodePtr ParseType(const bool isConst, const bool allowArrayType);
         ASTNodePtr ParseDeclaration();
         ASTNodePtr ParseVariableDeclaration(const bool isConst);
         ASTNodePtr ParseFunctionDeclaration();
-        void ParseParameterList(std::vector<std::pair<std::string, TypeNodePtr>>& parameters);
+        void ParseParameterList(std::vector<Parameter>& parameters);
         ASTNodePtr ParseClassDeclaration();
-        std::vector<std::string> ParseEnumBlock();
+        std::span<std::string_view> ParseEnumBlock();
         ASTNodePtr ParseEnumDeclaration();
         ASTNodePtr ParseBlock();
         ASTNodePtr ParseClassBlock();
@@ -59,8 +72,8 @@ namespace Arcanelab::Mano
         ASTNodePtr ParseMultiplicativeExpression();
         ASTNodePtr ParseUnaryExpression();
         ASTNodePtr ParsePrimaryExpression();
-        std::vector<ASTNodePtr> ParseArgumentList();
-        std::vector<ASTNodePtr> ParseExpressionList();
+        std::span<ASTNodePtr> ParseArgumentList();
+        std::span<ASTNodePtr> ParseExpressionList();
         ASTNodePtr ParseSwitchStatement();
     };
 
@@ -0,0 +1,75 @@
+#include <Profiler.h>
+
+#include <ostream>
+#include <sstream>
+
+namespace Arcanelab::Mano
+{
+    Profiler::~Profiler()
+    {
+        Stop();
+    }
+
+    // A timer that falls behind ticks until it has caught up, so the ticks
+    // still measure time.
+    void Profiler::Start(std::chrono::microseconds interval)
+    {
+        Stop();
+        stopping = false;
+        timer = std::thread([this, interval]
+        {
+            std::unique_lock lock(timerMutex);
+            auto next = std::chrono::steady_clock::now() + interval;
+            while (!wake.wait_until(lock, next, [this] { return stopping; }))
+            {
+                Tick();
+                next += interval;
+            }
+        });
+    }
+
+    void Profiler::Stop()
+    {
+        {
+            std::lock_guard lock(timerMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (timer.joinable())
+            timer.join();
+    }
+
+    void Profiler::WriteFolded(std::ostream& out) const
+    {
+        std::lock_guard lock(mutex);
+        for (const auto& [stack, count] : stacks)
+            out << stack << ' ' << count << '\n';
+    }
+
+    std::string Profiler::TakeFolded()
+    {
+        std::ostringstream out;
+        std::lock_guard lock(mutex);
+        for (const auto& [stack, count] : stacks)
+            out << stack << ' ' << count << '\n';
+        stacks.clear();
+        return std::move(out).str();
+    }
+
+    uint64_t Profiler::GetSampledTicks() const
+    {
+        std::lock_guard lock(mutex);
+        return sampledTicks;
+    }
+
+    void Profiler::Record(std::string_view stack, uint64_t count)
+    {
+        std::lock_guard lock(mutex);
+        auto entry = stacks.find(stack);
+        if (entry == stacks.end())
+            stacks.emplace(stack, count);
+        else
+            entry->second += count;
+        sampledTicks += count;
+    }
+} // namespace Arcanelab::Mano
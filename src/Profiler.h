@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace Arcanelab::Mano
+{
+    // Sampling profiler for scripts. A timer ticks at the sampling interval,
+    // and every VM attached to the profiler answers a tick at its next
+    // safepoint: a backward jump, a call, or the return from a host
+    // function. It records its interpreted call stack there, each frame as
+    // the function's name and the source line it is at, and charges it with
+    // every tick since its previous sample. Time in straight-line code is
+    // therefore charged to the loop or call that ends it, and time in a host
+    // function to the line that called it.
+    //
+    // Samples are kept as folded stacks: one line per distinct stack, frames
+    // outermost first and joined by ';', then the ticks it was charged with.
+    //
+    //   main:12;Update:40;Physics.Step:88 17
+    //
+    // flamegraph.pl and speedscope read this as it is. Any number of VMs on
+    // any threads may share a profiler, which must outlive them.
+    class Profiler
+    {
+    public:
+        Profiler() = default;
+        ~Profiler();
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // Ticks every interval on a thread of its own until Stop.
+        void Start(std::chrono::microseconds interval = std::chrono::milliseconds(1));
+        void Stop();
+        // A single tick, for hosts that sample from a timer of their own.
+        void Tick() { ticks.fetch_add(1, std::memory_order_relaxed); }
+
+        // The stacks recorded since the last TakeFolded, in sorted order.
+        void WriteFolded(std::ostream& out) const;
+        // Returns the same and forgets them, so a live host can stream its
+        // profile out piece by piece.
+        std::string TakeFolded();
+        // Ticks charged to a stack since the profiler was created.
+        uint64_t GetSampledTicks() const;
+
+    private:
+        friend class VM;
+
+        std::atomic<uint64_t> ticks{ 0 };
+        mutable std::mutex mutex;
+        std::map<std::string, uint64_t, std::less<>> stacks;
+        uint64_t sampledTicks = 0;
+
+        std::thread timer;
+        std::mutex timerMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        void Record(std::string_view stack, uint64_t count);
+    };
+} // namespace Arcanelab::Mano
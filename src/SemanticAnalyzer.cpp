@@ -1,47 +1,363 @@
 #include "SemanticAnalyzer.h"
+#include <ASTVisitor.h>
+#include <Binding.h>
+#include <CompileStats.h>
+#include <ThreadPool.h>
 
-#include <memory>
+#include <algorithm>
+#include <charconv>
 #include <sstream>
 #include <stdexcept>
-#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace Arcanelab::Mano
 {
-    // Scope implementation
-    Symbol* Scope::Lookup(const std::string& name) const
+    namespace
+    {
+        bool IsIdentifierOf(const ASTNode* node, const Symbol* symbol)
+        {
+            return node->nodeType == ASTType::Identifier && static_cast<const IdentifierNode*>(node)->resolvedSymbol == symbol;
+        }
+
+        // Collects the array[index] accesses below a node and notes whether
+        // anything there assigns the array or the index, stores an element
+        // into any array of the same type, which may be the array itself, or
+        // calls anything but the array methods and builtins.
+        struct IndexScan : ASTVisitor<IndexScan>
+        {
+            const Symbol* array;
+            const Symbol* index;
+            std::vector<IndexAccessNode*> accesses;
+            bool reassigned = false;
+            bool elementStored = false;
+            bool calls = false;
+
+            IndexScan(const Symbol* array, const Symbol* index) : array(array), index(index) {}
+
+            void VisitBinaryExpression(BinaryExpressionNode* expression)
+            {
+                if (expression->op == BinaryOperator::Assign &&
+                    (IsIdentifierOf(expression->left, array) || (index && IsIdentifierOf(expression->left, index))))
+                    reassigned = true;
+                if (expression->op == BinaryOperator::Assign && expression->left->nodeType == ASTType::IndexAccess)
+                {
+                    const Type* element = static_cast<IndexAccessNode*>(expression->left)->evaluatedType;
+                    elementStored |= !element || !array->type ||
+                        element->unqualified == array->type->unqualified->element->unqualified;
+                }
+                VisitChildren(expression);
+            }
+
+            void VisitIndexAccess(IndexAccessNode* access)
+            {
+                if (index && IsIdentifierOf(access->object, array) && IsIdentifierOf(access->index, index))
+                    accesses.push_back(access);
+                VisitChildren(access);
+            }
+
+            void VisitFunctionCall(FunctionCallNode* call)
+            {
+                calls |= call->arrayMethod == ArrayMethod::None && call->arrayBuiltin == ArrayBuiltin::None;
+                VisitChildren(call);
+            }
+
+            void VisitObjectInstantiation(ObjectInstantiationNode* instantiation)
+            {
+                calls = true;
+                VisitChildren(instantiation);
+            }
+        };
+
+        // Finds the innermost block around a declaration: the scope of a
+        // local, or one enclosing it for a loop variable.
+        struct DeclarationScope : ASTVisitor<DeclarationScope>
+        {
+            const ASTNode* declaration;
+            BlockNode* block = nullptr;
+            BlockNode* scope = nullptr;
+
+            explicit DeclarationScope(const ASTNode* declaration) : declaration(declaration) {}
+
+            void VisitBlock(BlockNode* node)
+            {
+                BlockNode* outer = block;
+                block = node;
+                VisitChildren(node);
+                block = outer;
+            }
+
+            void VisitVariableDeclaration(VariableDeclarationNode* variable)
+            {
+                if (variable == declaration)
+                    scope = block;
+                VisitChildren(variable);
+            }
+        };
+
+        // A local copied out of array[index] can borrow the element when the
+        // array is a local that is never assigned and the block the copy
+        // lives in neither stores an element that might be in that array
+        // nor calls code that could. The array holds the element until then,
+        // since arrays never shrink.
+        bool CanBorrowElement(FunctionDeclarationNode* function, const ASTNode* declaration, const IndexAccessNode* access)
+        {
+            if (access->object->nodeType != ASTType::Identifier)
+                return false;
+            const Symbol* array = static_cast<const IdentifierNode*>(access->object)->resolvedSymbol;
+            if (!array || array->function != function || array->isAssigned || !array->type ||
+                array->type->unqualified->kind != Type::Kind::Array || !function->body)
+                return false;
+
+            DeclarationScope finder{ declaration };
+            finder.Visit(function->body);
+            if (!finder.scope)
+                return false;
+            IndexScan scan{ array, nullptr };
+            scan.Visit(finder.scope);
+            return !scan.reassigned && !scan.elementStored && !scan.calls;
+        }
+
+        // Reads an int, uint or bool case label, possibly negated, or an enum
+        // member, which yields its ordinal. Labels that only become constant
+        // once folded, such as `let` constants, are not read.
+        bool ReadCaseLabel(const ASTNode* label, uint64_t& value)
+        {
+            if (label->nodeType == ASTType::UnaryExpression)
+            {
+                auto* unary = static_cast<const UnaryExpressionNode*>(label);
+                if (unary->op != "-" || unary->operand->nodeType != ASTType::Literal || !ReadCaseLabel(unary->operand, value))
+                    return false;
+                value = 0 - value;
+                return static_cast<const LiteralNode*>(unary->operand)->evaluatedType->unqualified->kind != Type::Kind::Bool;
+            }
+            if (label->nodeType == ASTType::MemberAccess)
+            {
+                auto* access = static_cast<const MemberAccessNode*>(label);
+                if (!access->memberSymbol || access->memberSymbol->kind != Symbol::Kind::Enum)
+                    return false;
+                auto* enumeration = static_cast<const EnumDeclarationNode*>(access->memberSymbol->declarationSite);
+                auto member = std::find(enumeration->values.begin(), enumeration->values.end(), access->memberName);
+                value = static_cast<uint64_t>(member - enumeration->values.begin());
+                return member != enumeration->values.end();
+            }
+            if (label->nodeType != ASTType::Literal || !static_cast<const LiteralNode*>(label)->evaluatedType)
+                return false;
+
+            auto* literal = static_cast<const LiteralNode*>(label);
+            std::string_view text = literal->value;
+            switch (literal->evaluatedType->unqualified->kind)
+            {
+                case Type::Kind::Bool:
+                    value = text == "true" ? 1 : 0;
+                    return true;
+                case Type::Kind::Int:
+                {
+                    int64_t signedValue = 0;
+                    if (std::from_chars(text.data(), text.data() + text.size(), signedValue).ec != std::errc())
+                        return false;
+                    value = static_cast<uint64_t>(signedValue);
+                    return true;
+                }
+                case Type::Kind::UInt:
+                    return std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc();
+                default:
+                    return false;
+            }
+        }
+    }
+
+    SemanticAnalyzer::SemanticAnalyzer(ASTNode* root, AstArena& arena)
+        : SemanticAnalyzer({ &root, 1 }, arena)
+    {
+    }
+
+    SemanticAnalyzer::SemanticAnalyzer(std::span<ASTNode* const> modules, AstArena& arena)
+        : modules(modules.begin(), modules.end()), arena(arena), ownTypes(std::make_unique<TypeTable>(arena)),
+        types(*ownTypes), errors(modules.size(), ErrorReporter(ErrorReporter::Phase::Semantic))
     {
-        if (auto it = symbols.find(name); it != symbols.end())
-            return it->second.get();
-        return parent ? parent->Lookup(name) : nullptr;
     }
 
-    // SemanticAnalyzer implementation
-    SemanticAnalyzer::SemanticAnalyzer(ASTNodePtr& root) : root(root) {}
+    SemanticAnalyzer::SemanticAnalyzer(const SemanticAnalyzer& owner, AstArena& taskArena)
+        : arena(taskArena), types(owner.types), globals(owner.globals), classes(owner.classes),
+        binding(owner.binding), hostSymbols(owner.hostSymbols), isWorker(true)
+    {
+    }
 
     bool SemanticAnalyzer::Analyze()
+    {
+        std::vector<ASTNode*> declarations;
+        std::vector<size_t> declarationModules;
+        for (size_t i = 0; i < modules.size(); i++)
+        {
+            if (modules[i]->nodeType != ASTType::Program)
+            {
+                declarations.push_back(modules[i]);
+                declarationModules.push_back(i);
+                continue;
+            }
+            for (ASTNode* declaration : static_cast<ProgramNode*>(modules[i])->declarations)
+            {
+                declarations.push_back(declaration);
+                declarationModules.push_back(i);
+            }
+        }
+        return AnalyzeDeclarations(declarations, declarationModules);
+    }
+
+    bool SemanticAnalyzer::Analyze(std::span<ASTNode* const> declarations)
+    {
+        // Errors go to the module each declaration came from.
+        std::unordered_map<const ASTNode*, size_t> moduleOf;
+        for (size_t i = 0; i < modules.size(); i++)
+        {
+            for (const ASTNode* declaration : static_cast<ProgramNode*>(modules[i])->declarations)
+                moduleOf.emplace(declaration, i);
+        }
+        std::vector<size_t> declarationModules;
+        for (ASTNode* declaration : declarations)
+        {
+            auto module = moduleOf.find(declaration);
+            if (module == moduleOf.end())
+                throw std::invalid_argument("Declaration is not part of the analyzed modules");
+            declarationModules.push_back(module->second);
+        }
+        return AnalyzeDeclarations(declarations, declarationModules);
+    }
+
+    // The global scope is shared by every module; declaring them in order
+    // makes duplicates deterministic. The declaration pass only looks at
+    // top-level and class members; the second walk resolves types and checks
+    // returns and loop control in the same visit.
+    bool SemanticAnalyzer::AnalyzeDeclarations(std::span<ASTNode* const> declarations, std::span<const size_t> declarationModules)
     {
         try
         {
-            DeclarationPass(root.get());
-            TypeResolutionPass(root.get());
-            ValidationPass(root.get());
-            return errors.empty();
+            {
+                PassTimer timer(stats, "declare", ErrorReporter::Phase::Semantic);
+                for (currentModule = 0; currentModule < modules.size(); currentModule++)
+                {
+                    reporter = &errors[currentModule];
+                    DeclarationPass(modules[currentModule]);
+                }
+            }
+            {
+                PassTimer timer(stats, "resolve", ErrorReporter::Phase::Semantic);
+                ResolveDeclarations(declarations, declarationModules);
+            }
+            CountStats();
+            return !HasErrors();
         }
         catch (const std::exception& err)
         {
-            errors.push_back(err.what());
+            currentModule = std::min(currentModule, errors.size() - 1);
+            reporter = &errors[currentModule];
+            Error(err.what());
             return false;
         }
     }
 
-    const std::vector<std::string>& SemanticAnalyzer::GetErrors() const
+    // After the declaration pass, top-level declarations only depend on each
+    // other through what it settled: symbols, parameter types and class
+    // layouts. Each can therefore be resolved on its own by a worker with a
+    // scope stack, arena and error list of its own. Errors are collected per
+    // declaration and merged in declaration order, as a serial walk reports
+    // them.
+    void SemanticAnalyzer::ResolveDeclarations(std::span<ASTNode* const> declarations, std::span<const size_t> declarationModules)
     {
-        return errors;
+        const size_t threads = pool ? pool->ThreadCount() : 1;
+        if (threads == 1 || declarations.size() < 2)
+        {
+            for (size_t i = 0; i < declarations.size(); i++)
+            {
+                currentModule = declarationModules[i];
+                reporter = &errors[currentModule];
+                TypeResolutionPass(declarations[i]);
+            }
+            return;
+        }
+
+        // A few contiguous chunks per thread even out declarations of very
+        // different sizes without copying the globals for every one of them.
+        struct Chunk
+        {
+            AstArena arena;
+            std::vector<Symbol*> assignedShared;
+            size_t symbolCount = 0;
+            size_t scopeCount = 0;
+        };
+        std::vector<Chunk> chunks(std::min(declarations.size(), threads * 4));
+        std::vector<ErrorReporter> declarationErrors(declarations.size(), ErrorReporter(ErrorReporter::Phase::Semantic));
+        std::exception_ptr failure;
+        try
+        {
+            pool->ParallelFor(chunks.size(), [&](size_t index)
+            {
+                Chunk& chunk = chunks[index];
+                SemanticAnalyzer worker(*this, chunk.arena);
+                size_t first = declarations.size() * index / chunks.size();
+                size_t last = declarations.size() * (index + 1) / chunks.size();
+                for (size_t i = first; i < last; i++)
+                {
+                    worker.reporter = &declarationErrors[i];
+                    worker.currentLine = 0;
+                    worker.TypeResolutionPass(declarations[i]);
+                }
+                chunk.assignedShared = std::move(worker.assignedShared);
+                chunk.symbolCount = worker.symbolCount;
+                chunk.scopeCount = worker.scopeCount;
+            });
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+
+        // The trees point into the task arenas, failed or not.
+        for (Chunk& chunk : chunks)
+        {
+            arena.Adopt(chunk.arena);
+            for (Symbol* symbol : chunk.assignedShared)
+                symbol->isAssigned = true;
+            symbolCount += chunk.symbolCount;
+            scopeCount += chunk.scopeCount;
+        }
+        if (failure)
+            std::rethrow_exception(failure);
+        for (size_t i = 0; i < declarations.size(); i++)
+        {
+            for (const auto& error : declarationErrors[i].GetErrors())
+                errors[declarationModules[i]].Report(error.line, error.column, error.message, error.severity);
+        }
+    }
+
+    // Host symbols are created up front, so that calls resolved on
+    // different threads share them.
+    void SemanticAnalyzer::Bind(const Binding& hostBinding)
+    {
+        binding = &hostBinding;
+        hostSymbols.clear();
+        for (const HostFunction& host : hostBinding.Functions())
+        {
+            Symbol* symbol = NewSymbol();
+            symbol->kind = Symbol::Kind::Function;
+            symbol->name = host.name;
+            symbol->type = types.Get(host.returnType);
+            symbol->hostFunction = &host;
+            hostSymbols.push_back(symbol);
+        }
+    }
+
+    bool SemanticAnalyzer::HasErrors() const
+    {
+        return std::any_of(errors.begin(), errors.end(), [](const ErrorReporter& reporter) { return reporter.HasErrors(); });
     }
 
     void SemanticAnalyzer::DeclarationPass(ASTNode* node)
     {
+        uint32_t outerLine = currentLine;
+        if (node->line)
+            currentLine = node->line;
         switch (node->nodeType)
         {
             case ASTType::Program:
@@ -56,155 +372,359 @@ namespace Arcanelab::Mano
             case ASTType::VariableDeclaration:
                 HandleVariableDeclaration(static_cast<VariableDeclarationNode*>(node));
                 break;
+            case ASTType::EnumDeclaration:
+                HandleEnumDeclaration(static_cast<EnumDeclarationNode*>(node));
+                break;
             default:
-                if (auto* container = dynamic_cast<IHasDeclarations*>(node))
-                {
-                    for (auto& child : container->GetDeclarations())
-                    {
-                        DeclarationPass(child.get());
-                    }
-                }
+                ForEachChild(node, [this](ASTNode* child) { DeclarationPass(child); });
         }
+        currentLine = outerLine;
     }
 
     void SemanticAnalyzer::TypeResolutionPass(ASTNode* node)
     {
+        uint32_t outerLine = currentLine;
+        if (node->line)
+            currentLine = node->line;
         switch (node->nodeType)
         {
+            case ASTType::Program:
+                for (auto& declaration : static_cast<ProgramNode*>(node)->declarations)
+                {
+                    TypeResolutionPass(declaration);
+                }
+                break;
             case ASTType::VariableDeclaration:
                 ResolveVariableType(static_cast<VariableDeclarationNode*>(node));
                 break;
             case ASTType::FunctionDeclaration:
                 ResolveFunctionType(static_cast<FunctionDeclarationNode*>(node));
                 break;
+            case ASTType::ClassDeclaration:
+                ResolveClass(static_cast<ClassDeclarationNode*>(node));
+                break;
+            case ASTType::Block:
+                ResolveBlock(static_cast<BlockNode*>(node));
+                break;
+            case ASTType::ExpressionStatement:
+                TypeResolutionPass(static_cast<ExpressionStatementNode*>(node)->expression);
+                break;
+            case ASTType::ReturnStatement:
+                ResolveReturn(static_cast<ReturnStatementNode*>(node));
+                break;
+            case ASTType::IfStatement:
+                ResolveIfStatement(static_cast<IfStatementNode*>(node));
+                break;
+            case ASTType::SwitchStatement:
+                ResolveSwitchStatement(static_cast<SwitchStatementNode*>(node));
+                break;
             case ASTType::BinaryExpression:
                 ResolveBinaryExpression(static_cast<BinaryExpressionNode*>(node));
                 break;
+            case ASTType::UnaryExpression:
+                TypeResolutionPass(static_cast<UnaryExpressionNode*>(node)->operand);
+                break;
+            case ASTType::Literal:
+            {
+                auto* literal = static_cast<LiteralNode*>(node);
+                if (!literal->evaluatedType)
+                    literal->evaluatedType = GetLiteralType(literal);
+                break;
+            }
             case ASTType::Identifier:
                 ResolveIdentifier(static_cast<IdentifierNode*>(node));
                 break;
+            case ASTType::FunctionCall:
+                ResolveFunctionCall(static_cast<FunctionCallNode*>(node));
+                break;
+            case ASTType::MemberAccess:
+                ResolveMemberAccess(static_cast<MemberAccessNode*>(node));
+                break;
+            case ASTType::IndexAccess:
+                ResolveIndexAccess(static_cast<IndexAccessNode*>(node));
+                break;
+            case ASTType::ArrayLiteral:
+                ResolveArrayLiteral(static_cast<ArrayLiteralNode*>(node));
+                break;
             case ASTType::WhileStatement:
                 HandleWhileLoop(static_cast<WhileStatementNode*>(node));
                 break;
             case ASTType::ForStatement:
                 HandleForLoop(static_cast<ForStatementNode*>(node));
                 break;
-            default:
-                if (auto* container = dynamic_cast<IHasChildren*>(node))
-                {
-                    for (auto& child : container->GetChildren())
-                    {
-                        TypeResolutionPass(child.get());
-                    }
-                }
-        }
-    }
-
-    void SemanticAnalyzer::ValidationPass(ASTNode* node)
-    {
-        switch (node->nodeType)
-        {
-            case ASTType::ReturnStatement:
-                ValidateReturn(static_cast<ReturnStatementNode*>(node));
-                break;
             case ASTType::BreakStatement:
-            case ASTType::ContinueStatement:
-                ValidateLoopControl(node);
+                if (loopDepth == 0)
+                    Error("Break statement outside loop");
                 break;
-            case ASTType::FunctionDeclaration:
-                ValidateFunction(static_cast<FunctionDeclarationNode*>(node));
+            case ASTType::ContinueStatement:
+                if (loopDepth == 0)
+                    Error("Continue statement outside loop");
                 break;
             default:
-                if (auto* container = dynamic_cast<IHasChildren*>(node))
-                {
-                    for (auto& child : container->GetChildren())
-                    {
-                        ValidationPass(child.get());
-                    }
-                }
+                ForEachChild(node, [this](ASTNode* child) { TypeResolutionPass(child); });
         }
+        currentLine = outerLine;
     }
 
     void SemanticAnalyzer::HandleProgramDeclaration(ProgramNode* program)
     {
-        PushScope();
         for (auto& decl : program->declarations)
         {
-            DeclarationPass(decl.get());
+            DeclarationPass(decl);
         }
-        PopScope();
     }
 
     void SemanticAnalyzer::HandleFunctionDeclaration(FunctionDeclarationNode* function)
     {
-        auto symbol = std::make_unique<Symbol>();
-        symbol->kind = Symbol::Kind::Function;
-        symbol->name = function->name;
-        symbol->type = CloneType(function->returnType.get());
-        function->symbol = symbol.get();
-        currentScope()->symbols[function->name] = std::move(symbol);
-
-        PushScope();
-        for (auto& [name, type] : function->parameters)
+        if (LookupInCurrentScope(function->nameId))
         {
-            AddParameter(name, type.get());
+            Error("Duplicate function declaration: " + std::string(function->name));
+            return;
         }
-        PushScope();
+
+        auto* symbol = NewSymbol();
+        symbol->kind = Symbol::Kind::Function;
+        symbol->name = function->name;
+        symbol->type = ResolveType(function->returnType);
+        symbol->declarationSite = function;
+        function->symbol = symbol;
+        Declare(function->nameId, symbol);
+        // Calls check their arguments against these, possibly while another
+        // thread resolves the function itself.
+        for (Parameter& parameter : function->parameters)
+            ResolveType(parameter.type);
     }
 
-    void SemanticAnalyzer::AddParameter(const std::string& name, TypeNode* type)
+    void SemanticAnalyzer::AddParameter(Parameter& parameter)
     {
-        auto symbol = std::make_unique<Symbol>();
+        auto* symbol = NewSymbol();
         symbol->kind = Symbol::Kind::Variable;
-        symbol->name = name;
-        symbol->type = CloneType(type);
-        currentScope()->symbols[name] = std::move(symbol);
+        symbol->name = parameter.name;
+        symbol->type = ResolveType(parameter.type);
+        symbol->isInitialized = true;
+        parameter.symbol = symbol;
+        Declare(parameter.nameId, symbol);
+        AllocateSlot(symbol);
     }
 
     void SemanticAnalyzer::ResolveFunctionType(FunctionDeclarationNode* function)
     {
-        if (auto* body = dynamic_cast<BlockNode*>(function->body.get()))
+        // Functions nested in a block are declared when the walk reaches them.
+        if (!function->symbol)
+            HandleFunctionDeclaration(function);
+
+        FunctionDeclarationNode* enclosingFunction = currentFunction;
+        int enclosingLoopDepth = loopDepth;
+        bool enclosingHasReturn = currentFunctionHasReturn;
+        uint32_t enclosingSlotCount = slotCount;
+        size_t enclosingFunctionScope = functionScope;
+        size_t firstReference = references.size();
+        currentFunction = function;
+        loopDepth = 0;
+        currentFunctionHasReturn = false;
+
+        // Parameters take the first slots, matching the calling convention,
+        // after the instance for methods; PopScope hands the enclosing
+        // function its next slot back.
+        PushScope();
+        functionScope = scopeMarks.size() - 1;
+        nextSlot = function->symbol && function->symbol->owner ? 1 : 0;
+        slotCount = nextSlot;
+        for (Parameter& parameter : function->parameters)
         {
-            for (auto& statement : body->statements)
+            AddParameter(parameter);
+        }
+        if (function->body)
+            TypeResolutionPass(function->body);
+        PopScope();
+        function->slotCount = slotCount;
+        AssignOwnership(function, firstReference);
+
+        // Any return in the body counts; nested functions return for themselves.
+        const Type* returnType = ReturnTypeOf(function);
+        if (returnType && returnType->unqualified != types.Void() && !currentFunctionHasReturn)
+        {
+            Error("Function '" + std::string(function->name) + "' with return type '" +
+                std::string(returnType->name) + "' lacks return statement");
+        }
+
+        currentFunction = enclosingFunction;
+        loopDepth = enclosingLoopDepth;
+        currentFunctionHasReturn = enclosingHasReturn;
+        slotCount = enclosingSlotCount;
+        functionScope = enclosingFunctionScope;
+    }
+
+    // Runs once the body is resolved, when every assignment is known. A
+    // parameter the function never assigns borrows the caller's reference,
+    // which the caller keeps alive across the call. A local that is never
+    // assigned and starts out as a copy of such a parameter, or of another
+    // local that is never assigned, borrows too: the source keeps the object
+    // alive while the local is in scope. So does one copied out of an array
+    // that CanBorrowElement proves keeps the element. Everything else owns
+    // a count.
+    void SemanticAnalyzer::AssignOwnership(FunctionDeclarationNode* function, size_t firstReference)
+    {
+        std::vector<uint32_t> owned;
+        for (size_t i = firstReference; i < references.size(); i++)
+        {
+            Symbol* symbol = references[i];
+            bool borrowed = !symbol->isAssigned;
+            if (borrowed && symbol->declarationSite)
             {
-                TypeResolutionPass(statement.get());
+                ASTNode* initializer = static_cast<VariableDeclarationNode*>(symbol->declarationSite)->initializer;
+                if (initializer && initializer->nodeType == ASTType::Identifier)
+                {
+                    const Symbol* source = static_cast<IdentifierNode*>(initializer)->resolvedSymbol;
+                    borrowed = source && source->function == function && !source->isAssigned;
+                }
+                else if (initializer && initializer->nodeType == ASTType::IndexAccess)
+                    borrowed = CanBorrowElement(function, symbol->declarationSite, static_cast<IndexAccessNode*>(initializer));
+                else
+                    borrowed = false;
             }
+            symbol->isBorrowed = borrowed;
+            if (!borrowed)
+                owned.push_back(symbol->slot);
         }
-        PopScope();
-        PopScope();
+        references.resize(firstReference);
+        function->ownedSlots = arena.CopyArray(owned);
+    }
+
+    const Type* SemanticAnalyzer::ReturnTypeOf(const FunctionDeclarationNode* function) const
+    {
+        // Null when the declared type was never resolved (duplicate functions).
+        return function->returnType ? function->returnType->resolved : types.Void();
     }
 
     void SemanticAnalyzer::HandleClassDeclaration(ClassDeclarationNode* classDeclaration)
     {
-        auto symbol = std::make_unique<Symbol>();
+        auto* symbol = NewSymbol();
         symbol->kind = Symbol::Kind::Class;
         symbol->name = classDeclaration->name;
-        classDeclaration->symbol = symbol.get();
-        currentScope()->symbols[classDeclaration->name] = std::move(symbol);
+        symbol->type = types.Get(classDeclaration->name);
+        symbol->declarationSite = classDeclaration;
+        classDeclaration->symbol = symbol;
+        Declare(classDeclaration->nameId, symbol);
 
         PushScope();
-        if (auto* classBlock = dynamic_cast<ClassBlockNode*>(classDeclaration->body.get()))
+        if (classDeclaration->body && classDeclaration->body->nodeType == ASTType::ClassBlock)
+        {
+            auto* classBlock = static_cast<ClassBlockNode*>(classDeclaration->body);
+            for (auto& declaration : classBlock->declarations)
+            {
+                DeclarationPass(declaration);
+            }
+        }
+        // Kept so ResolveClass can reopen the scope for the method bodies.
+        std::vector<ScopeEntry> members(scopeEntries.begin() + scopeMarks.back().firstEntry, scopeEntries.end());
+        classDeclaration->members = arena.CopyArray(members);
+        PopScope();
+
+        classes[symbol->type] = classDeclaration;
+        LayoutClass(classDeclaration);
+    }
+
+    // Fields are packed by decreasing alignment, so no padding falls between
+    // them: 8-byte scalars and references (strings, arrays, objects) first,
+    // then the bools. Methods are numbered in declaration order.
+    void SemanticAnalyzer::LayoutClass(ClassDeclarationNode* classDeclaration)
+    {
+        std::vector<Symbol*> fields;
+        std::vector<Symbol*> methods;
+        for (const ScopeEntry& member : classDeclaration->members)
+        {
+            Symbol* symbol = member.symbol;
+            if (symbol->kind == Symbol::Kind::Variable)
+            {
+                symbol->owner = classDeclaration;
+                fields.push_back(symbol);
+            }
+            else if (symbol->kind == Symbol::Kind::Function)
+            {
+                symbol->owner = classDeclaration;
+                symbol->methodIndex = static_cast<uint32_t>(methods.size());
+                methods.push_back(symbol);
+            }
+        }
+
+        auto sizeOf = [this](const Symbol* field) -> uint32_t
         {
+            return field->type && field->type->unqualified == types.Bool() ? 1 : 8;
+        };
+        std::stable_sort(fields.begin(), fields.end(),
+            [&](const Symbol* a, const Symbol* b) { return sizeOf(a) > sizeOf(b); });
+
+        uint32_t offset = 0;
+        for (Symbol* field : fields)
+        {
+            field->fieldOffset = offset;
+            offset += sizeOf(field);
+        }
+        classDeclaration->instanceSize = (offset + 7) & ~7u;
+        classDeclaration->methods = arena.CopyArray(methods);
+    }
+
+    void SemanticAnalyzer::HandleEnumDeclaration(EnumDeclarationNode* enumeration)
+    {
+        if (LookupInCurrentScope(enumeration->nameId))
+        {
+            Error("Duplicate enum declaration: " + std::string(enumeration->name));
+            return;
+        }
+
+        auto* symbol = NewSymbol();
+        symbol->kind = Symbol::Kind::Enum;
+        symbol->name = enumeration->name;
+        symbol->type = types.Get(enumeration->name);
+        symbol->declarationSite = enumeration;
+        Declare(enumeration->nameId, symbol);
+    }
+
+    void SemanticAnalyzer::ResolveClass(ClassDeclarationNode* classDeclaration)
+    {
+        // Classes nested in functions are not declared yet.
+        if (!classDeclaration->symbol)
+            return;
+
+        EnterScope(classDeclaration->members);
+        if (classDeclaration->body && classDeclaration->body->nodeType == ASTType::ClassBlock)
+        {
+            auto* classBlock = static_cast<ClassBlockNode*>(classDeclaration->body);
             for (auto& declaration : classBlock->declarations)
             {
-                DeclarationPass(declaration.get());
+                TypeResolutionPass(declaration);
             }
         }
         PopScope();
     }
 
+    void SemanticAnalyzer::ResolveBlock(BlockNode* block)
+    {
+        PushScope();
+        for (auto& statement : block->statements)
+        {
+            TypeResolutionPass(statement);
+        }
+        block->symbolsCollected = true;
+        PopScope();
+    }
+
     void SemanticAnalyzer::ResolveVariableType(VariableDeclarationNode* variable)
     {
         if (!variable->declaredType)
         {
-            Error("Missing type annotation for variable: " + variable->name);
+            Error("Missing type annotation for variable: " + std::string(variable->name));
             return;
         }
 
+        const Type* declaredType = ResolveType(variable->declaredType);
         if (variable->initializer)
         {
-            TypeNodePtr initType = GetExpressionType(variable->initializer.get());
-            if (!CheckTypeCompatibility(*variable->declaredType, *initType))
+            TypeResolutionPass(variable->initializer);
+            CoerceLiteral(variable->initializer, declaredType);
+            const Type* initType = GetExpressionType(variable->initializer);
+            if (initType && !CheckTypeCompatibility(declaredType, initType))
             {
                 std::stringstream ss;
                 ss << "Type mismatch in variable '" << variable->name << "'. "
@@ -213,131 +733,604 @@ namespace Arcanelab::Mano
                 Error(ss.str());
             }
         }
-        variable->resolvedType = CloneType(variable->declaredType.get());
+        variable->resolvedType = declaredType;
+
+        // Globals and class members were declared up front; locals become
+        // visible once their initializer has been resolved.
+        if (currentFunction)
+            HandleVariableDeclaration(variable);
     }
 
     void SemanticAnalyzer::ResolveIdentifier(IdentifierNode* identifier)
     {
-        if (auto* symbol = currentScope()->Lookup(identifier->name))
+        if (auto* symbol = Lookup(identifier->nameId))
         {
             identifier->resolvedSymbol = symbol;
-            identifier->evaluatedType = CloneType(symbol->type.get());
+            identifier->evaluatedType = symbol->type;
         }
         else
         {
-            Error("Undefined identifier: " + identifier->name);
+            Error("Undefined identifier: " + std::string(identifier->name));
         }
     }
 
-    void SemanticAnalyzer::ValidateReturn(ReturnStatementNode* returnStatement)
+    void SemanticAnalyzer::ResolveReturn(ReturnStatementNode* returnStatement)
     {
+        returnStatement->enclosingFunction = currentFunction;
         if (!currentFunction)
         {
             Error("Return statement outside function");
             return;
         }
+        currentFunctionHasReturn = true;
 
-        TypeNodePtr returnType;
+        const Type* returnType = types.Void();
         if (returnStatement->expression)
         {
-            returnType = GetExpressionType(returnStatement->expression.get());
+            TypeResolutionPass(returnStatement->expression);
+            if (currentFunction->returnType)
+                CoerceLiteral(returnStatement->expression, ResolveType(currentFunction->returnType));
+            returnType = GetExpressionType(returnStatement->expression);
+            if (!returnType)
+                return;
+        }
+
+        const Type* expected = ReturnTypeOf(currentFunction);
+        if (expected && !CheckTypeCompatibility(expected, returnType))
+            Error("Return type mismatch in function " + std::string(currentFunction->name));
+    }
+
+    void SemanticAnalyzer::ResolveIfStatement(IfStatementNode* ifStatement)
+    {
+        TypeResolutionPass(ifStatement->condition);
+        const Type* condType = GetExpressionType(ifStatement->condition);
+        if (condType && condType->unqualified != types.Bool())
+        {
+            Error("If condition must be boolean");
+        }
+        TypeResolutionPass(ifStatement->thenBranch);
+        if (ifStatement->elseBranch)
+            TypeResolutionPass(ifStatement->elseBranch);
+    }
+
+    // Cases never fall through, so a label equal to an earlier one could
+    // never be taken. A switch over an enum that names every member is
+    // exhaustive, which lets code generation drop the test for the last one.
+    void SemanticAnalyzer::ResolveSwitchStatement(SwitchStatementNode* switchStatement)
+    {
+        TypeResolutionPass(switchStatement->expression);
+        const Type* switchType = GetExpressionType(switchStatement->expression);
+
+        std::unordered_set<uint64_t> labels;
+        const EnumDeclarationNode* enumeration = nullptr;
+        bool allMembers = !switchStatement->cases.empty();
+        for (auto& [caseExpression, caseBlock] : switchStatement->cases)
+        {
+            TypeResolutionPass(caseExpression);
+            if (switchType)
+            {
+                CoerceLiteral(caseExpression, switchType);
+                const Type* caseType = GetExpressionType(caseExpression);
+                if (caseType && !CheckTypeCompatibility(switchType, caseType))
+                {
+                    Error("Case type mismatch in switch statement");
+                }
+            }
+
+            uint64_t label = 0;
+            bool constant = ReadCaseLabel(caseExpression, label);
+            if (constant && !labels.insert(label).second)
+                Error("Duplicate case in switch statement");
+            if (constant && caseExpression->nodeType == ASTType::MemberAccess)
+            {
+                auto* member = static_cast<MemberAccessNode*>(caseExpression)->memberSymbol;
+                if (!enumeration)
+                    enumeration = static_cast<const EnumDeclarationNode*>(member->declarationSite);
+                allMembers &= member->declarationSite == enumeration;
+            }
+            else
+            {
+                allMembers = false;
+            }
+            TypeResolutionPass(caseBlock);
+        }
+        if (switchStatement->defaultCase)
+            TypeResolutionPass(switchStatement->defaultCase);
+
+        switchStatement->isExhaustive = allMembers && enumeration && labels.size() == enumeration->values.size() &&
+            switchType && switchType->unqualified == types.Get(enumeration->name);
+    }
+
+    void SemanticAnalyzer::ResolveFunctionCall(FunctionCallNode* call)
+    {
+        if (call->callTarget)
+            TypeResolutionPass(call->callTarget);
+        for (auto& argument : call->arguments)
+        {
+            TypeResolutionPass(argument);
+        }
+
+        Symbol* symbol = nullptr;
+        if (call->name.empty())
+        {
+            // Method calls: user.GetInfo(). Members of anything but a class
+            // instance or an array are left alone.
+            if (!call->callTarget || call->callTarget->nodeType != ASTType::MemberAccess)
+                return;
+            auto* access = static_cast<MemberAccessNode*>(call->callTarget);
+            const Type* objectType = GetExpressionType(access->object);
+            if (objectType && objectType->unqualified->kind == Type::Kind::Array)
+            {
+                ResolveArrayMethod(call, access, objectType);
+                return;
+            }
+            if (!access->memberSymbol)
+                return;
+            if (access->memberSymbol->kind != Symbol::Kind::Function)
+            {
+                Error("Member '" + std::string(access->memberName) + "' is not a method");
+                return;
+            }
+            symbol = access->memberSymbol;
+        }
+        else
+        {
+            symbol = Lookup(call->nameId);
+            // Inside its class the constructor shadows the class name; calling it still constructs.
+            if (symbol && symbol->owner && symbol->kind == Symbol::Kind::Function && symbol->name == symbol->owner->name)
+                symbol = symbol->owner->symbol;
+            if (!symbol && (ResolveHostCall(call) || ResolveArrayBuiltin(call)))
+                return;
+            if (!symbol || (symbol->kind != Symbol::Kind::Function && symbol->kind != Symbol::Kind::Class))
+            {
+                Error("Undefined function: " + std::string(call->name));
+                return;
+            }
+        }
+        call->resolvedFunction = symbol;
+
+        // Constructing an object calls the method named after its class, if any.
+        FunctionDeclarationNode* function = nullptr;
+        if (symbol->kind == Symbol::Kind::Function)
+        {
+            function = static_cast<FunctionDeclarationNode*>(symbol->declarationSite);
         }
         else
         {
-            returnType = std::make_unique<TypeNode>("void", false);
+            auto* classDeclaration = static_cast<ClassDeclarationNode*>(symbol->declarationSite);
+            Symbol* constructor = FindMember(classDeclaration, classDeclaration->nameId);
+            if (constructor && constructor->kind == Symbol::Kind::Function)
+                function = static_cast<FunctionDeclarationNode*>(constructor->declarationSite);
+            else if (!call->arguments.empty())
+                Error("Class '" + std::string(symbol->name) + "' has no constructor");
+        }
+        if (function && function->symbol && function->symbol->owner)
+            call->methodIndex = function->symbol->methodIndex;
+
+        if (function && function->parameters.size() != call->arguments.size())
+        {
+            Error("Argument count mismatch in call to '" + std::string(symbol->name) + "'");
+            function = nullptr;
+        }
+
+        std::vector<const Type*> argumentTypes;
+        argumentTypes.reserve(call->arguments.size());
+        for (size_t i = 0; i < call->arguments.size(); i++)
+        {
+            ASTNode* argument = call->arguments[i];
+            const Type* parameterType = function ? ResolveType(function->parameters[i].type) : nullptr;
+            if (parameterType)
+                CoerceLiteral(argument, parameterType);
+            const Type* argumentType = GetExpressionType(argument);
+            if (parameterType && argumentType && !CheckTypeCompatibility(parameterType, argumentType))
+            {
+                Error("Argument type mismatch in call to '" + std::string(symbol->name) + "'");
+            }
+            argumentTypes.push_back(argumentType);
+        }
+        call->argumentTypes = arena.CopyArray(argumentTypes);
+    }
+
+    void SemanticAnalyzer::ResolveMemberAccess(MemberAccessNode* access)
+    {
+        TypeResolutionPass(access->object);
+
+        // Enum members: Direction.North
+        if (access->object->nodeType == ASTType::Identifier)
+        {
+            auto* object = static_cast<IdentifierNode*>(access->object);
+            if (object->resolvedSymbol && object->resolvedSymbol->kind == Symbol::Kind::Enum)
+            {
+                auto* enumeration = static_cast<EnumDeclarationNode*>(object->resolvedSymbol->declarationSite);
+                for (const auto& value : enumeration->values)
+                {
+                    if (value == access->memberName)
+                    {
+                        access->memberSymbol = object->resolvedSymbol;
+                        access->evaluatedType = object->resolvedSymbol->type;
+                        return;
+                    }
+                }
+                Error("Enum '" + std::string(enumeration->name) + "' has no member '" + std::string(access->memberName) + "'");
+                return;
+            }
+        }
+
+        // Fields and methods of class instances: user.status, user.GetInfo()
+        const Type* objectType = GetExpressionType(access->object);
+        if (objectType && objectType->unqualified->kind == Type::Kind::Array)
+        {
+            if (access->memberName != "size" && access->memberName != "push")
+                Error("Array has no member '" + std::string(access->memberName) + "'");
+            return;
         }
+        ClassDeclarationNode* classDeclaration = objectType ? ClassOf(objectType) : nullptr;
+        if (!classDeclaration)
+            return;
 
-        if (!CheckTypeCompatibility(*currentFunction->returnType, *returnType))
+        Symbol* member = FindMember(classDeclaration, access->memberNameId);
+        if (!member || (member->kind != Symbol::Kind::Variable && member->kind != Symbol::Kind::Function))
         {
-            Error("Return type mismatch in function " + currentFunction->name);
+            Error("Class '" + std::string(classDeclaration->name) + "' has no member '" + std::string(access->memberName) + "'");
+            return;
+        }
+        access->memberSymbol = member;
+        if (member->kind == Symbol::Kind::Variable)
+        {
+            access->evaluatedType = member->type;
+            access->fieldOffset = member->fieldOffset;
         }
     }
 
+    // size() and push(value). Arrays declared with `let` keep their length.
+    void SemanticAnalyzer::ResolveArrayMethod(FunctionCallNode* call, MemberAccessNode* access, const Type* arrayType)
+    {
+        if (access->memberName == "size")
+        {
+            call->arrayMethod = ArrayMethod::Size;
+            if (!call->arguments.empty())
+                Error("Argument count mismatch in call to 'size'");
+            return;
+        }
+        if (access->memberName != "push")
+            return;
+
+        call->arrayMethod = ArrayMethod::Push;
+        if (arrayType->isConst)
+            Error("Cannot push to constant array");
+        if (call->arguments.size() != 1)
+        {
+            Error("Argument count mismatch in call to 'push'");
+            return;
+        }
+        const Type* elementType = arrayType->unqualified->element;
+        CoerceLiteral(call->arguments[0], elementType);
+        const Type* argumentType = GetExpressionType(call->arguments[0]);
+        if (argumentType && !CheckTypeCompatibility(elementType, argumentType))
+            Error("Argument type mismatch in call to 'push'");
+    }
+
+    // Returns false when the name is not a builtin. The first argument is
+    // the array the builtin reads or, for the ones that write, updates.
+    bool SemanticAnalyzer::ResolveArrayBuiltin(FunctionCallNode* call)
+    {
+        static constexpr std::pair<std::string_view, ArrayBuiltin> builtins[] =
+        {
+            { "sum", ArrayBuiltin::Sum }, { "min", ArrayBuiltin::Min }, { "max", ArrayBuiltin::Max },
+            { "dot", ArrayBuiltin::Dot }, { "fill", ArrayBuiltin::Fill }, { "copy", ArrayBuiltin::Copy },
+            { "add", ArrayBuiltin::Add }, { "mul", ArrayBuiltin::Mul }, { "scale", ArrayBuiltin::Scale },
+        };
+        auto it = std::find_if(std::begin(builtins), std::end(builtins), [&](const auto& b) { return b.first == call->name; });
+        if (it == std::end(builtins))
+            return false;
+
+        ArrayBuiltin builtin = it->second;
+        call->arrayBuiltin = builtin;
+        std::string name(call->name);
+        bool unary = builtin == ArrayBuiltin::Sum || builtin == ArrayBuiltin::Min || builtin == ArrayBuiltin::Max;
+        if (call->arguments.size() != (unary ? 1u : 2u))
+        {
+            Error("Argument count mismatch in call to '" + name + "'");
+            return true;
+        }
+
+        const Type* arrayType = GetExpressionType(call->arguments[0]);
+        if (!arrayType)
+            return true;
+        const Type* elementType = arrayType->unqualified->kind == Type::Kind::Array ? arrayType->unqualified->element : nullptr;
+        bool numeric = elementType && (elementType == types.Int() || elementType == types.UInt() || elementType == types.Float());
+        bool anyPrimitive = builtin == ArrayBuiltin::Fill || builtin == ArrayBuiltin::Copy;
+        if (!numeric && !(anyPrimitive && elementType == types.Bool()))
+        {
+            Error("'" + name + "' requires an array of " + (anyPrimitive ? "int, uint, float or bool" : "int, uint or float"));
+            return true;
+        }
+        if (!unary && builtin != ArrayBuiltin::Dot && arrayType->isConst)
+            Error("Cannot modify elements of constant array");
+
+        if (unary)
+            return true;
+        ASTNode* second = call->arguments[1];
+        const Type* expected = builtin == ArrayBuiltin::Fill || builtin == ArrayBuiltin::Scale ? elementType : arrayType->unqualified;
+        CoerceLiteral(second, expected);
+        const Type* secondType = GetExpressionType(second);
+        if (secondType && !CheckTypeCompatibility(expected, secondType))
+            Error("Argument type mismatch in call to '" + name + "'");
+        return true;
+    }
+
+    bool SemanticAnalyzer::ResolveHostCall(FunctionCallNode* call)
+    {
+        int32_t index = binding ? binding->Find(call->name) : -1;
+        if (index < 0)
+            return false;
+
+        const HostFunction& host = binding->Functions()[index];
+        call->resolvedFunction = hostSymbols[index];
+
+        bool countMatches = host.parameterTypes.size() == call->arguments.size();
+        if (!countMatches)
+            Error("Argument count mismatch in call to '" + host.name + "'");
+
+        std::vector<const Type*> argumentTypes;
+        argumentTypes.reserve(call->arguments.size());
+        for (size_t i = 0; i < call->arguments.size(); i++)
+        {
+            ASTNode* argument = call->arguments[i];
+            const Type* parameterType = countMatches ? types.Get(host.parameterTypes[i]) : nullptr;
+            if (parameterType)
+                CoerceLiteral(argument, parameterType);
+            const Type* argumentType = GetExpressionType(argument);
+            if (parameterType && argumentType && !CheckTypeCompatibility(parameterType, argumentType))
+                Error("Argument type mismatch in call to '" + host.name + "'");
+            argumentTypes.push_back(argumentType);
+        }
+        call->argumentTypes = arena.CopyArray(argumentTypes);
+        return true;
+    }
+
+    void SemanticAnalyzer::ResolveIndexAccess(IndexAccessNode* access)
+    {
+        TypeResolutionPass(access->object);
+        TypeResolutionPass(access->index);
+
+        const Type* objectType = GetExpressionType(access->object);
+        if (!objectType)
+            return;
+        if (objectType->unqualified->kind != Type::Kind::Array)
+        {
+            Error("Indexed value is not an array");
+            return;
+        }
+        const Type* indexType = GetExpressionType(access->index);
+        if (indexType && indexType->unqualified != types.Int() && indexType->unqualified != types.UInt())
+            Error("Array index must be an integer");
+        access->evaluatedType = objectType->unqualified->element;
+    }
+
+    void SemanticAnalyzer::ResolveArrayLiteral(ArrayLiteralNode* array)
+    {
+        const Type* elementType = nullptr;
+        for (auto& element : array->elements)
+        {
+            TypeResolutionPass(element);
+            if (elementType)
+                CoerceLiteral(element, elementType);
+            const Type* type = GetExpressionType(element);
+            if (!type)
+                continue;
+            if (!elementType)
+                elementType = type;
+            else if (!CheckTypeCompatibility(elementType, type))
+                Error("Array element type mismatch");
+        }
+        if (elementType)
+            array->evaluatedType = types.ArrayOf(elementType);
+    }
+
     void SemanticAnalyzer::Error(const std::string& message)
     {
-        errors.push_back(message);
+        reporter->Report(currentLine, 0, message);
+    }
+
+    Symbol* SemanticAnalyzer::NewSymbol()
+    {
+        symbolCount++;
+        return arena.New<Symbol>();
+    }
+
+    void SemanticAnalyzer::CountStats()
+    {
+        if (!stats)
+            return;
+        stats->symbols += symbolCount;
+        stats->scopes += scopeCount;
     }
 
     void SemanticAnalyzer::PushScope()
     {
-        auto scope = std::make_unique<Scope>();
-        scope->parent = currentScope();
-        scopeStack.push_back(std::move(scope));
+        scopeCount++;
+        scopeMarks.push_back({ scopeEntries.size(), nextSlot });
+    }
+
+    void SemanticAnalyzer::EnterScope(std::span<const ScopeEntry> entries)
+    {
+        PushScope();
+        scopeEntries.insert(scopeEntries.end(), entries.begin(), entries.end());
     }
 
     void SemanticAnalyzer::PopScope()
     {
-        if (!scopeStack.empty())
+        if (!scopeMarks.empty())
         {
-            scopeStack.pop_back();
+            scopeEntries.resize(scopeMarks.back().firstEntry);
+            nextSlot = scopeMarks.back().nextSlot;
+            scopeMarks.pop_back();
         }
     }
 
-    Scope* SemanticAnalyzer::currentScope() const
+    // Redeclaring a name in the same scope replaces it: globals overwrite
+    // their slot, and later entries in a nested scope are found first.
+    void SemanticAnalyzer::Declare(uint32_t nameId, Symbol* symbol)
     {
-        return scopeStack.empty() ? nullptr : scopeStack.back().get();
+        if (!scopeMarks.empty())
+        {
+            scopeEntries.push_back({ nameId, symbol });
+            return;
+        }
+        if (nameId >= globals.size())
+            globals.resize(static_cast<size_t>(nameId) + 1, nullptr);
+        globals[nameId] = symbol;
     }
 
-    TypeNodePtr SemanticAnalyzer::CloneType(TypeNode* type)
+    void SemanticAnalyzer::AllocateSlot(Symbol* symbol)
     {
-        return std::make_unique<TypeNode>(*type);
+        symbol->function = currentFunction;
+        if (!IsReference(symbol->type))
+        {
+            symbol->slot = nextSlot++;
+            if (nextSlot > slotCount)
+                slotCount = nextSlot;
+            return;
+        }
+
+        // A reference slot is released on exit and whenever its declaration
+        // runs again, so it must never have held anything else: it takes a
+        // slot no scope of the function has used, and closing scopes do not
+        // hand it back.
+        symbol->slot = slotCount;
+        nextSlot = ++slotCount;
+        for (size_t i = functionScope + 1; i < scopeMarks.size(); i++)
+            scopeMarks[i].nextSlot = nextSlot;
+        references.push_back(symbol);
     }
 
-    bool SemanticAnalyzer::CheckTypeCompatibility(const TypeNode& t1, const TypeNode& t2)
+    Symbol* SemanticAnalyzer::Lookup(uint32_t nameId) const
     {
-        if (t1.name == t2.name) return true;
-        if (IsArrayType(t1) && IsArrayType(t2))
+        for (size_t i = scopeEntries.size(); i-- > 0;)
         {
-            return CheckArrayCompatibility(t1, t2);
+            if (scopeEntries[i].nameId == nameId)
+                return scopeEntries[i].symbol;
         }
-        return false;
+        return nameId < globals.size() ? globals[nameId] : nullptr;
+    }
+
+    Symbol* SemanticAnalyzer::LookupInCurrentScope(uint32_t nameId) const
+    {
+        if (scopeMarks.empty())
+            return nameId < globals.size() ? globals[nameId] : nullptr;
+        for (size_t i = scopeEntries.size(); i-- > scopeMarks.back().firstEntry;)
+        {
+            if (scopeEntries[i].nameId == nameId)
+                return scopeEntries[i].symbol;
+        }
+        return nullptr;
+    }
+
+    ClassDeclarationNode* SemanticAnalyzer::ClassOf(const Type* type) const
+    {
+        auto it = classes.find(type->unqualified);
+        return it != classes.end() ? it->second : nullptr;
+    }
+
+    bool SemanticAnalyzer::IsReference(const Type* type) const
+    {
+        return type && (type->unqualified == types.String() || type->unqualified->kind == Type::Kind::Array || ClassOf(type));
+    }
+
+    Symbol* SemanticAnalyzer::FindMember(const ClassDeclarationNode* classDeclaration, uint32_t nameId)
+    {
+        for (const ScopeEntry& member : classDeclaration->members)
+        {
+            if (member.nameId == nameId)
+                return member.symbol;
+        }
+        return nullptr;
+    }
+
+    const Type* SemanticAnalyzer::ResolveType(TypeNode* node)
+    {
+        if (!node)
+            return nullptr;
+        if (!node->resolved)
+            node->resolved = types.Get(node->name, node->isConst);
+        return node->resolved;
+    }
+
+    bool SemanticAnalyzer::CheckTypeCompatibility(const Type* t1, const Type* t2)
+    {
+        return TypeTable::Compatible(t1, t2);
     }
 
     void SemanticAnalyzer::HandleVariableDeclaration(VariableDeclarationNode* variable)
     {
-        if (currentScope()->symbols.contains(variable->name))
+        if (LookupInCurrentScope(variable->nameId))
         {
-            Error("Duplicate variable declaration: " + variable->name);
+            Error("Duplicate variable declaration: " + std::string(variable->name));
             return;
         }
 
         if (!variable->declaredType)
         {
-            Error("Missing type annotation for variable: " + variable->name);
+            Error("Missing type annotation for variable: " + std::string(variable->name));
             return;
         }
 
-        auto symbol = std::make_unique<Symbol>();
+        auto* symbol = NewSymbol();
         symbol->kind = Symbol::Kind::Variable;
         symbol->name = variable->name;
-        symbol->type = CloneType(variable->declaredType.get());
+        symbol->type = ResolveType(variable->declaredType);
         symbol->declarationSite = variable;
-        symbol->scope = currentScope();
         symbol->isInitialized = variable->initializer != nullptr;
 
-        variable->symbol = symbol.get();
-        currentScope()->symbols[variable->name] = std::move(symbol);
+        variable->symbol = symbol;
+        Declare(variable->nameId, symbol);
+        if (currentFunction)
+            AllocateSlot(symbol);
     }
 
     void SemanticAnalyzer::ResolveBinaryExpression(BinaryExpressionNode* expression)
     {
-        TypeResolutionPass(expression->left.get());
-        TypeResolutionPass(expression->right.get());
+        TypeResolutionPass(expression->left);
+        TypeResolutionPass(expression->right);
 
-        auto leftType = GetExpressionType(expression->left.get());
-        auto rightType = GetExpressionType(expression->right.get());
+        const Type* leftType = GetExpressionType(expression->left);
+        if (leftType)
+            CoerceLiteral(expression->right, leftType);
+        const Type* rightType = GetExpressionType(expression->right);
+        if (rightType && expression->op != BinaryOperator::Assign)
+        {
+            CoerceLiteral(expression->left, rightType);
+            leftType = GetExpressionType(expression->left);
+        }
 
         if (expression->op == BinaryOperator::Assign)
         {
-            if (!CheckTypeCompatibility(*leftType, *rightType))
+            if (expression->left->nodeType == ASTType::Identifier)
+            {
+                if (Symbol* target = static_cast<IdentifierNode*>(expression->left)->resolvedSymbol)
+                {
+                    if (isWorker && !target->function)
+                        assignedShared.push_back(target);
+                    else
+                        target->isAssigned = true;
+                }
+            }
+            else if (expression->left->nodeType == ASTType::IndexAccess)
+            {
+                const Type* arrayType = GetExpressionType(static_cast<IndexAccessNode*>(expression->left)->object);
+                if (arrayType && arrayType->isConst)
+                    Error("Cannot modify elements of constant array");
+            }
+            if (leftType && rightType && !CheckTypeCompatibility(leftType, rightType))
             {
                 Error("Assignment type mismatch");
             }
-            expression->evaluatedType = CloneType(leftType.get());
+            expression->evaluatedType = leftType;
             return;
         }
 
-        if (!CheckTypeCompatibility(*leftType, *rightType))
+        if (leftType && rightType && !CheckTypeCompatibility(leftType, rightType))
         {
             Error("Operand type mismatch in binary expression");
         }
@@ -346,7 +1339,7 @@ namespace Arcanelab::Mano
         {
             case BinaryOperator::LogicalAnd:
             case BinaryOperator::LogicalOr:
-                expression->evaluatedType = std::make_unique<TypeNode>("bool", false);
+                expression->evaluatedType = types.Bool();
                 break;
             case BinaryOperator::Equal:
             case BinaryOperator::NotEqual:
@@ -354,163 +1347,184 @@ namespace Arcanelab::Mano
             case BinaryOperator::Greater:
             case BinaryOperator::LessEqual:
             case BinaryOperator::GreaterEqual:
-                expression->evaluatedType = std::make_unique<TypeNode>("bool", false);
+                expression->evaluatedType = types.Bool();
                 break;
             default:
-                expression->evaluatedType = CloneType(leftType.get());
+                expression->evaluatedType = leftType;
         }
     }
 
-    TypeNodePtr SemanticAnalyzer::GetExpressionType(ASTNode* expression)
+    // Returns nullptr when the expression could not be typed; the cause has
+    // either been reported already or the construct is not typed yet.
+    const Type* SemanticAnalyzer::GetExpressionType(ASTNode* expression)
     {
         switch (expression->nodeType)
         {
             case ASTType::Identifier:
-                return CloneType(static_cast<IdentifierNode*>(expression)->evaluatedType.get());
+                return static_cast<IdentifierNode*>(expression)->evaluatedType;
             case ASTType::Literal:
-                return GetLiteralType(static_cast<LiteralNode*>(expression));
+            {
+                auto* literal = static_cast<LiteralNode*>(expression);
+                return literal->evaluatedType ? literal->evaluatedType : GetLiteralType(literal);
+            }
             case ASTType::BinaryExpression:
-                return CloneType(static_cast<BinaryExpressionNode*>(expression)->evaluatedType.get());
+                return static_cast<BinaryExpressionNode*>(expression)->evaluatedType;
+            case ASTType::UnaryExpression:
+            {
+                auto* unary = static_cast<UnaryExpressionNode*>(expression);
+                if (unary->op == "!")
+                    return types.Bool();
+                return GetExpressionType(unary->operand);
+            }
             case ASTType::FunctionCall:
-                return CloneType(static_cast<FunctionCallNode*>(expression)->resolvedFunction->type.get());
+            {
+                auto* call = static_cast<FunctionCallNode*>(expression);
+                if (call->arrayMethod == ArrayMethod::Size)
+                    return types.UInt();
+                if (call->arrayMethod == ArrayMethod::Push)
+                    return types.Void();
+                if (call->arrayBuiltin != ArrayBuiltin::None)
+                {
+                    // sum, min, max and dot yield an element; the others update in place.
+                    ArrayBuiltin builtin = call->arrayBuiltin;
+                    if (builtin != ArrayBuiltin::Sum && builtin != ArrayBuiltin::Min && builtin != ArrayBuiltin::Max && builtin != ArrayBuiltin::Dot)
+                        return types.Void();
+                    const Type* arrayType = call->arguments.empty() ? nullptr : GetExpressionType(call->arguments[0]);
+                    return arrayType ? arrayType->unqualified->element : nullptr;
+                }
+                return call->resolvedFunction ? call->resolvedFunction->type : nullptr;
+            }
             case ASTType::ArrayLiteral:
-                return CloneType(static_cast<ArrayLiteralNode*>(expression)->evaluatedType.get());
+                return static_cast<ArrayLiteralNode*>(expression)->evaluatedType;
+            case ASTType::MemberAccess:
+                return static_cast<MemberAccessNode*>(expression)->evaluatedType;
+            case ASTType::IndexAccess:
+                return static_cast<IndexAccessNode*>(expression)->evaluatedType;
+            case ASTType::ObjectInstantiation:
+                return nullptr;
             default:
                 throw std::runtime_error("Unsupported expression type");
         }
     }
 
-    TypeNodePtr SemanticAnalyzer::GetLiteralType(LiteralNode* literal)
+    const Type* SemanticAnalyzer::GetLiteralType(LiteralNode* literal)
     {
-        auto type = std::make_unique<TypeNode>();
-        if (literal->value.find('.') != std::string::npos)
+        if (literal->value.front() == '"' && literal->value.back() == '"')
         {
-            type->name = "float";
+            return types.String();
         }
-        else if (literal->value == "true" || literal->value == "false")
+        else if (literal->value.find('.') != std::string::npos)
         {
-            type->name = "bool";
+            return types.Float();
         }
-        else if (literal->value.front() == '"' && literal->value.back() == '"')
-        {
-            type->name = "string";
-        }
-        else
-        {
-            type->name = "int";
-        }
-        return type;
-    }
-
-    void SemanticAnalyzer::ValidateLoopControl(ASTNode* node)
-    {
-        if (loopDepth == 0)
-        {
-            const char* msg = (node->nodeType == ASTType::BreakStatement)
-                ? "Break statement outside loop"
-                : "Continue statement outside loop";
-            Error(msg);
-        }
-    }
-
-    void SemanticAnalyzer::ValidateFunction(FunctionDeclarationNode* function)
-    {
-        TypeNode* returnType = function->symbol->type.get();
-        if (returnType->name == "void") return;
-
-        bool hasReturn = false;
-        CheckForReturns(function->body.get(), hasReturn);
-
-        if (!hasReturn)
+        else if (literal->value == "true" || literal->value == "false")
         {
-            Error("Function '" + function->name + "' with return type '" +
-                returnType->name + "' lacks return statement");
+            return types.Bool();
         }
+        return types.Int();
     }
 
-    void SemanticAnalyzer::CheckForReturns(ASTNode* node, bool& hasReturn)
+    // Integer literals have no fixed signedness: `var i: uint = 0` and
+    // `i < 10` both read the literal as the uint the context expects.
+    void SemanticAnalyzer::CoerceLiteral(ASTNode* expression, const Type* target)
     {
-        if (hasReturn) return;
-
-        switch (node->nodeType)
+        // Array literals take the element type of their context, which also
+        // gives `[]` a type.
+        if (expression->nodeType == ASTType::ArrayLiteral && target->unqualified->kind == Type::Kind::Array)
         {
-            case ASTType::ReturnStatement:
-                hasReturn = true;
-                break;
-            case ASTType::IfStatement:
+            auto* array = static_cast<ArrayLiteralNode*>(expression);
+            const Type* elementType = target->unqualified->element;
+            bool matches = true;
+            for (ASTNode* element : array->elements)
             {
-                auto* ifstatement = static_cast<IfStatementNode*>(node);
-                CheckForReturns(ifstatement->thenBranch.get(), hasReturn);
-                if (ifstatement->elseBranch)
-                {
-                    CheckForReturns(ifstatement->elseBranch.get(), hasReturn);
-                }
-                break;
+                CoerceLiteral(element, elementType);
+                const Type* type = GetExpressionType(element);
+                if (type && !CheckTypeCompatibility(elementType, type))
+                    matches = false;
             }
-            default:
-                if (auto* container = dynamic_cast<IHasChildren*>(node))
-                {
-                    for (auto& child : container->GetChildren())
-                    {
-                        CheckForReturns(child.get(), hasReturn);
-                        if (hasReturn) break;
-                    }
-                }
+            if (matches)
+                array->evaluatedType = target->unqualified;
+            return;
         }
-    }
-
-    bool SemanticAnalyzer::IsArrayType(const TypeNode& type)
-    {
-        return type.name.size() > 2 &&
-            type.name.front() == '[' &&
-            type.name.back() == ']';
-    }
-
-    bool SemanticAnalyzer::CheckArrayCompatibility(const TypeNode& t1, const TypeNode& t2)
-    {
-        std::string elem1 = t1.name.substr(1, t1.name.size() - 2);
-        std::string elem2 = t2.name.substr(1, t2.name.size() - 2);
-        TypeNode tn1{ elem1, false, false };
-        TypeNode tn2{ elem2, false, false };
-        return CheckTypeCompatibility(tn1, tn2);
-    }
+        if (expression->nodeType != ASTType::Literal || target->unqualified != types.UInt())
+            return;
 
-    Symbol* SemanticAnalyzer::GetClassSymbol(const TypeNode& type)
-    {
-        if (auto* sym = currentScope()->Lookup(type.name))
-        {
-            return sym->kind == Symbol::Kind::Class ? sym : nullptr;
-        }
-        return nullptr;
+        auto* literal = static_cast<LiteralNode*>(expression);
+        if (GetExpressionType(literal) == types.Int())
+            literal->evaluatedType = types.UInt();
     }
 
     void SemanticAnalyzer::HandleWhileLoop(WhileStatementNode* node)
     {
-        TypeResolutionPass(node->condition.get());
-        TypeNodePtr condType = GetExpressionType(node->condition.get());
-        if (condType->name != "bool")
+        TypeResolutionPass(node->condition);
+        const Type* condType = GetExpressionType(node->condition);
+        if (condType && condType->unqualified != types.Bool())
         {
             Error("While condition must be boolean");
         }
         loopDepth++;
-        TypeResolutionPass(node->body.get());
+        TypeResolutionPass(node->body);
         loopDepth--;
     }
 
     void SemanticAnalyzer::HandleForLoop(ForStatementNode* node)
     {
-        if (node->init) TypeResolutionPass(node->init.get());
+        // The loop variable lives in its own scope around the body.
+        PushScope();
+        if (node->init) TypeResolutionPass(node->init);
         if (node->condition)
         {
-            TypeNodePtr condType = GetExpressionType(node->condition.get());
-            if (condType->name != "bool")
+            TypeResolutionPass(node->condition);
+            const Type* condType = GetExpressionType(node->condition);
+            if (condType && condType->unqualified != types.Bool())
             {
                 Error("For loop condition must be boolean");
             }
         }
-        if (node->update) TypeResolutionPass(node->update.get());
+        if (node->update) TypeResolutionPass(node->update);
         loopDepth++;
-        TypeResolutionPass(node->body.get());
+        TypeResolutionPass(node->body);
         loopDepth--;
+        HoistBoundsChecks(node);
+        PopScope();
+    }
+
+    // `for (...; i < a.size(); ...)` over a local array and a local uint
+    // index proves a[i] in range inside the body, as long as the body does
+    // not assign either of them: arrays never shrink, so nothing the body
+    // calls can invalidate the test.
+    void SemanticAnalyzer::HoistBoundsChecks(ForStatementNode* node)
+    {
+        if (!node->condition || node->condition->nodeType != ASTType::BinaryExpression)
+            return;
+        auto* condition = static_cast<BinaryExpressionNode*>(node->condition);
+        if (condition->op != BinaryOperator::Less || condition->left->nodeType != ASTType::Identifier ||
+            condition->right->nodeType != ASTType::FunctionCall)
+            return;
+        auto* size = static_cast<FunctionCallNode*>(condition->right);
+        if (size->arrayMethod != ArrayMethod::Size)
+            return;
+        ASTNode* arrayExpression = static_cast<MemberAccessNode*>(size->callTarget)->object;
+        if (arrayExpression->nodeType != ASTType::Identifier)
+            return;
+
+        const Symbol* index = static_cast<IdentifierNode*>(condition->left)->resolvedSymbol;
+        const Symbol* array = static_cast<IdentifierNode*>(arrayExpression)->resolvedSymbol;
+        if (!index || !array || index->function != currentFunction || array->function != currentFunction ||
+            !index->type || index->type->unqualified != types.UInt())
+            return;
+
+        IndexScan scan{ array, index };
+        scan.Visit(node->body);
+        if (node->update)
+        {
+            IndexScan update{ array, nullptr };
+            update.Visit(node->update);
+            scan.reassigned |= update.reassigned;
+        }
+        if (scan.reassigned)
+            return;
+        for (IndexAccessNode* access : scan.accesses)
+            access->boundsChecked = false;
     }
 } // namespace Arcanelab::Mano
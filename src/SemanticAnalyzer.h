@@ -1,102 +1,192 @@
-#pragma once
-
-#include <AST.h>
-
-#include <sstream>
-
-namespace Arcanelab::Mano
-{
-    struct Scope
-    {
-        std::unordered_map<std::string, std::unique_ptr<Symbol>> symbols;
-        Scope* parent = nullptr;
-        Symbol* Lookup(const std::string& name) const;
-    };
-
-    struct Symbol
-    {
-        enum class Kind { Variable, Function, Class, Enum, Type };
-        Kind kind;
-        std::string name;
-        TypeNodePtr type;
-        Scope* scope = nullptr;
-        ASTNode* declarationSite = nullptr;
-        bool isInitialized = false;
-    };
-
-    class SemanticAnalyzer
-    {
-    public:
-        explicit SemanticAnalyzer(ASTNodePtr& root);
-        bool Analyze();
-        const std::vector<std::string>& GetErrors() const;
-
-    private:
-        ASTNodePtr& root;
-        std::vector<std::unique_ptr<Scope>> scopeStack;
-        std::vector<std::string> errors;
-        FunctionDeclarationNode* currentFunction = nullptr;
-        int loopDepth = 0;
-
-        // Pass handlers
-        void DeclarationPass(ASTNode* node);
-        void TypeResolutionPass(ASTNode* node);
-        void ValidationPass(ASTNode* node);
-
-        // Declaration pass implementations
-        void HandleProgramDeclaration(ProgramNode* program);
-        void HandleFunctionDeclaration(FunctionDeclarationNode* func);
-        void HandleClassDeclaration(ClassDeclarationNode* cls);
-        void HandleVariableDeclaration(VariableDeclarationNode* var);
-        void AddParameter(const std::string& name, TypeNode* type);
-
-        // Type resolution implementations
-        void ResolveVariableType(VariableDeclarationNode* var);
-        void ResolveIdentifier(IdentifierNode* id);
-        void ResolveBinaryExpression(BinaryExpressionNode* expr);
-        void ResolveFunctionType(FunctionDeclarationNode* func);
-
-        // Validation implementations
-        void ValidateReturn(ReturnStatementNode* ret);
-        void ValidateLoopControl(ASTNode* node);
-        void ValidateFunction(FunctionDeclarationNode* func);
-        void CheckForReturns(ASTNode* node, bool& hasReturn);
-
-        // Helper methods
-        void PushScope();
-        void PopScope();
-        Scope* currentScope() const;
-        TypeNodePtr CloneType(TypeNode* type);
-        bool CheckTypeCompatibility(const TypeNode& t1, const TypeNode& t2);
-        bool IsArrayType(const TypeNode& type);
-        bool CheckArrayCompatibility(const TypeNode& t1, const TypeNode& t2);
-        Symbol* GetClassSymbol(const TypeNode& type);
-        TypeNodePtr GetExpressionType(ASTNode* expr);
-        TypeNodePtr GetLiteralType(LiteralNode* lit);
-
-        // Loop handlers
-        void HandleWhileLoop(WhileStatementNode* node);
-        void HandleForLoop(ForStatementNode* node);
-
-        template<typename T>
-        void Error(const std::string& format, const T& arg)
-        {
-            std::ostringstream ss;
-            ss << arg;
-            errors.push_back(format + ss.str());
-        }
-        void Error(const std::string& message);
-
-        struct IHasDeclarations
-        {
-            virtual std::vector<ASTNodePtr>& GetDeclarations() = 0;
-            virtual ~IHasDeclarations() = default;
-        };
-
-        struct IHasChildren
-        {
-            virtual std::vector<ASTNodePtr>& GetChildren() = 0;
-            virtual ~IHasChildren() = default;
-        };
-    };
-} // namespace Arcanelab::Mano
+#pragma once
+
+#include <AST.h>
+#include <AstArena.h>
+#include <ErrorReporter.h>
+#include <TypeTable.h>
+
+#include <memory>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    class Binding;
+    struct CompileStats;
+    struct HostFunction;
+    class ThreadPool;
+
+    // Symbols live in the analyzer's arena and outlive analysis.
+    struct Symbol
+    {
+        enum class Kind { Variable, Function, Class, Enum, Type };
+        Kind kind;
+        std::string_view name;
+        const Type* type = nullptr;
+        ASTNode* declarationSite = nullptr;
+        bool isInitialized = false;
+        bool isAssigned = false;            // Target of an assignment anywhere
+        // Parameters and locals live in a fixed frame slot of their function;
+        // function is null for globals and class members.
+        FunctionDeclarationNode* function = nullptr;
+        uint32_t slot = 0;
+        // Fields and methods point back at their class. Fields sit at a fixed
+        // byte offset in the instance, methods at a fixed index in the class's
+        // method table; methods take the instance in slot 0.
+        ClassDeclarationNode* owner = nullptr;
+        uint32_t fieldOffset = 0;
+        uint32_t methodIndex = 0;
+        // Reference-typed parameters and locals either own a count on the
+        // object or borrow one that something else keeps alive.
+        bool isBorrowed = false;
+        // Host functions have no declaration site; they are called through
+        // the Binding they were registered with.
+        const HostFunction* hostFunction = nullptr;
+    };
+
+    class SemanticAnalyzer
+    {
+    public:
+        SemanticAnalyzer(ASTNode* root, AstArena& arena);
+        // Analyzes several modules that share one global scope. Declarations
+        // are collected module by module, so errors come out in module order.
+        // All modules must have been lexed against the same IdentifierTable.
+        SemanticAnalyzer(std::span<ASTNode* const> modules, AstArena& arena);
+        bool Analyze();
+        // Declares everything but resolves only the given top-level
+        // declarations, for a recompile in which the others are unchanged
+        // and known to be correct.
+        bool Analyze(std::span<ASTNode* const> declarations);
+        // Makes the binding's host functions callable by name; calls to them
+        // are checked against their C++ signatures.
+        void Bind(const Binding& binding);
+        // Times the declaration and resolution passes, and adds the symbols
+        // and scopes created, to stats, which must outlive Analyze.
+        void SetStats(CompileStats* compileStats) { stats = compileStats; }
+        // Resolves top-level declarations on pool, which must outlive Analyze;
+        // null, the default, resolves them on the calling thread. Each task
+        // has its own scopes, arena and errors, and errors are merged in
+        // declaration order, so the result does not depend on the thread count.
+        void SetThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+        // One reporter per module, in module order. Errors carry the line of
+        // the statement or declaration they were found in and no column.
+        const std::vector<ErrorReporter>& GetErrors() const { return errors; }
+        bool HasErrors() const;
+
+    private:
+        std::vector<ASTNode*> modules;
+        AstArena& arena;
+        std::unique_ptr<TypeTable> ownTypes;    // Null in the workers, which share their owner's
+        TypeTable& types;
+        // Globals are indexed by identifier id. Every nested scope is the run
+        // of scopeEntries from its mark to the next one; lookups scan the
+        // runs backwards, innermost first, and then fall back to the globals.
+        // A mark also remembers the next free frame slot, so sibling scopes
+        // reuse the slots of the ones that closed before them.
+        struct ScopeMark
+        {
+            size_t firstEntry;
+            uint32_t nextSlot;
+        };
+
+        std::vector<Symbol*> globals;
+        std::unordered_map<const Type*, ClassDeclarationNode*> classes;   // Keyed by unqualified type
+        std::vector<ScopeEntry> scopeEntries;
+        std::vector<ScopeMark> scopeMarks;
+        uint32_t nextSlot = 0;
+        uint32_t slotCount = 0;
+        size_t functionScope = 0;               // Mark of the current function's parameter scope
+        std::vector<Symbol*> references;        // Reference-typed slots of the functions being resolved
+        std::vector<ErrorReporter> errors;
+        ErrorReporter* reporter = nullptr;      // Where Error reports: a module's, or a task's
+        size_t currentModule = 0;
+        uint32_t currentLine = 0;               // Of the innermost statement or declaration being checked
+        const Binding* binding = nullptr;
+        std::vector<Symbol*> hostSymbols;       // Created by Bind, indexed like the binding
+        FunctionDeclarationNode* currentFunction = nullptr;
+        bool currentFunctionHasReturn = false;
+        int loopDepth = 0;
+        CompileStats* stats = nullptr;
+        size_t symbolCount = 0;
+        size_t scopeCount = 0;
+        ThreadPool* pool = nullptr;
+        // Workers do not write to symbols other tasks can see; assignments
+        // to globals and fields are applied once every task has finished.
+        bool isWorker = false;
+        std::vector<Symbol*> assignedShared;
+
+        // A worker resolving declarations of owner's modules on another thread.
+        SemanticAnalyzer(const SemanticAnalyzer& owner, AstArena& taskArena);
+        bool AnalyzeDeclarations(std::span<ASTNode* const> declarations, std::span<const size_t> declarationModules);
+        void ResolveDeclarations(std::span<ASTNode* const> declarations, std::span<const size_t> declarationModules);
+
+        // Pass handlers
+        void DeclarationPass(ASTNode* node);
+        void TypeResolutionPass(ASTNode* node);
+
+        // Declaration pass implementations
+        void HandleProgramDeclaration(ProgramNode* program);
+        void HandleFunctionDeclaration(FunctionDeclarationNode* func);
+        void HandleClassDeclaration(ClassDeclarationNode* cls);
+        void HandleVariableDeclaration(VariableDeclarationNode* var);
+        void HandleEnumDeclaration(EnumDeclarationNode* enumeration);
+        void AddParameter(Parameter& parameter);
+        void LayoutClass(ClassDeclarationNode* cls);
+        void AssignOwnership(FunctionDeclarationNode* function, size_t firstReference);
+
+        // Type resolution implementations
+        void ResolveVariableType(VariableDeclarationNode* var);
+        void ResolveIdentifier(IdentifierNode* id);
+        void ResolveBinaryExpression(BinaryExpressionNode* expr);
+        void ResolveFunctionType(FunctionDeclarationNode* func);
+        void ResolveClass(ClassDeclarationNode* cls);
+        void ResolveBlock(BlockNode* block);
+        void ResolveReturn(ReturnStatementNode* ret);
+        void ResolveIfStatement(IfStatementNode* ifStatement);
+        void ResolveSwitchStatement(SwitchStatementNode* switchStatement);
+        void ResolveFunctionCall(FunctionCallNode* call);
+        void ResolveMemberAccess(MemberAccessNode* access);
+        void ResolveArrayLiteral(ArrayLiteralNode* array);
+        void ResolveArrayMethod(FunctionCallNode* call, MemberAccessNode* access, const Type* arrayType);
+        bool ResolveArrayBuiltin(FunctionCallNode* call);
+        bool ResolveHostCall(FunctionCallNode* call);
+        void ResolveIndexAccess(IndexAccessNode* access);
+        void HoistBoundsChecks(ForStatementNode* node);
+
+        // Helper methods
+        Symbol* NewSymbol();
+        void CountStats();
+        void PushScope();
+        void EnterScope(std::span<const ScopeEntry> entries);
+        void PopScope();
+        void Declare(uint32_t nameId, Symbol* symbol);
+        void AllocateSlot(Symbol* symbol);
+        Symbol* Lookup(uint32_t nameId) const;
+        Symbol* LookupInCurrentScope(uint32_t nameId) const;
+        ClassDeclarationNode* ClassOf(const Type* type) const;
+        bool IsReference(const Type* type) const;
+        static Symbol* FindMember(const ClassDeclarationNode* cls, uint32_t nameId);
+        const Type* ResolveType(TypeNode* node);
+        const Type* ReturnTypeOf(const FunctionDeclarationNode* function) const;
+        bool CheckTypeCompatibility(const Type* t1, const Type* t2);
+        const Type* GetExpressionType(ASTNode* expr);
+        const Type* GetLiteralType(LiteralNode* lit);
+        void CoerceLiteral(ASTNode* expr, const Type* target);
+
+        // Loop handlers
+        void HandleWhileLoop(WhileStatementNode* node);
+        void HandleForLoop(ForStatementNode* node);
+
+        template<typename T>
+        void Error(const std::string& format, const T& arg)
+        {
+            std::ostringstream ss;
+            ss << arg;
+            Error(format + ss.str());
+        }
+        void Error(const std::string& message);
+    };
+} // namespace Arcanelab::Mano
@@ -0,0 +1,62 @@
+#include <SharedModule.h>
+
+namespace Arcanelab::Mano
+{
+    SharedModule::SharedModule(std::shared_ptr<const Module> module)
+        : globalCount(module->globalCount), initFunction(module->initFunction)
+    {
+        functions.reserve(module->functions.size());
+        for (const FunctionProto& function : module->functions)
+            functions.push_back({ function.code.data(), function.constants.data(), static_cast<uint32_t>(function.code.size()), function.numParams, function.frameSize, function.name, function.lines });
+        classes.reserve(module->classes.size());
+        for (const ClassInfo& info : module->classes)
+            classes.push_back({ info.instanceSize, info.referenceFields });
+        strings.reserve(module->strings.size());
+        for (const StringConstant& constant : module->strings)
+            strings.push_back({ constant.text, constant.hash });
+        hostImports.reserve(module->hostImports.size());
+        for (const Mano::HostImport& import : module->hostImports)
+            hostImports.push_back({ import.index, import.signature });
+        owner = std::move(module);
+    }
+
+    SharedModule::SharedModule(std::shared_ptr<const ModuleImage> image)
+        : globalCount(image->GetGlobalCount()), initFunction(image->GetInitFunction())
+    {
+        functions.reserve(image->GetFunctionCount());
+        for (uint32_t i = 0; i < image->GetFunctionCount(); i++)
+        {
+            ModuleImage::Function function = image->GetFunction(i);
+            functions.push_back({ function.code.data(), function.constants.data(), static_cast<uint32_t>(function.code.size()), function.numParams, function.frameSize, function.name, function.lines });
+        }
+        classes.reserve(image->GetClassCount());
+        for (uint32_t i = 0; i < image->GetClassCount(); i++)
+        {
+            ModuleImage::Class info = image->GetClass(i);
+            classes.push_back({ info.instanceSize, info.referenceFields });
+        }
+        strings.reserve(image->GetStringCount());
+        for (uint32_t i = 0; i < image->GetStringCount(); i++)
+        {
+            ModuleImage::String constant = image->GetString(i);
+            strings.push_back({ constant.text, constant.hash });
+        }
+        hostImports.reserve(image->GetHostImportCount());
+        for (uint32_t i = 0; i < image->GetHostImportCount(); i++)
+        {
+            ModuleImage::HostImport import = image->GetHostImport(i);
+            hostImports.push_back({ import.index, import.signature });
+        }
+        owner = std::move(image);
+    }
+
+    int32_t SharedModule::FindFunction(std::string_view name) const
+    {
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            if (functions[i].name == name)
+                return static_cast<int32_t>(i);
+        }
+        return -1;
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Bytecode.h>
+#include <ModuleImage.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Compiled code in the form the interpreter runs it: function and class
+    // tables pointing into a Module or a ModuleImage, which the shared
+    // module keeps alive. Nothing in it changes after construction, so any
+    // number of VMs on any number of threads run one copy without locking;
+    // each VM owns only its stack, globals, objects and string pool.
+    class SharedModule
+    {
+    public:
+        struct Function
+        {
+            const Instruction* code;
+            const Value* constants;
+            uint32_t codeSize;
+            uint32_t numParams;
+            uint32_t frameSize;
+            std::string_view name;
+            std::span<const LineStart> lines;
+        };
+
+        struct Class
+        {
+            uint32_t instanceSize;
+            std::span<const uint32_t> referenceFields;
+        };
+
+        struct String
+        {
+            std::string_view text;
+            uint32_t hash;
+        };
+
+        struct HostImport
+        {
+            uint32_t index;
+            std::string_view signature;
+        };
+
+        explicit SharedModule(std::shared_ptr<const Module> module);
+        explicit SharedModule(std::shared_ptr<const ModuleImage> image);
+        SharedModule(const SharedModule&) = delete;
+        SharedModule& operator=(const SharedModule&) = delete;
+
+        const std::vector<Function>& GetFunctions() const { return functions; }
+        const std::vector<Class>& GetClasses() const { return classes; }
+        const std::vector<String>& GetStrings() const { return strings; }
+        const std::vector<HostImport>& GetHostImports() const { return hostImports; }
+        uint32_t GetGlobalCount() const { return globalCount; }
+        int32_t GetInitFunction() const { return initFunction; }
+        int32_t FindFunction(std::string_view name) const;
+
+    private:
+        std::shared_ptr<const void> owner;      // The Module or ModuleImage the tables point into
+        std::vector<Function> functions;
+        std::vector<Class> classes;
+        std::vector<String> strings;
+        std::vector<HostImport> hostImports;
+        uint32_t globalCount = 0;
+        int32_t initFunction = -1;
+    };
+} // namespace Arcanelab::Mano
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MANO_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MANO_SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MANO_SIMD_NEON 1
+#endif
+
+// Block scanners for the lexer's long runs: whitespace, comment bodies and
+// string contents. Each routine handles whole 16/32-byte blocks with the
+// widest vector unit the target was compiled for and finishes the tail
+// with the scalar loop, which is also the fallback on other targets.
+namespace Arcanelab::Mano::Simd
+{
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || (static_cast<unsigned char>(c) - '\t') <= ('\r' - '\t');
+    }
+
+#if MANO_SIMD_AVX2
+    constexpr size_t BlockSize = 32;
+    using Block = __m256i;
+
+    inline Block Load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    inline Block Equal(Block v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+    inline Block Or(Block a, Block b) { return _mm256_or_si256(a, b); }
+    inline uint32_t Mask(Block v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+
+    inline Block Space(Block v)
+    {
+        // '\t'..'\r' is one unsigned range: (v - '\t') <= 4.
+        Block shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        Block inRange = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+        return Or(inRange, Equal(v, ' '));
+    }
+#elif MANO_SIMD_SSE2
+    constexpr size_t BlockSize = 16;
+    using Block = __m128i;
+
+    inline Block Load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline Block Equal(Block v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+    inline Block Or(Block a, Block b) { return _mm_or_si128(a, b); }
+    inline uint32_t Mask(Block v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+
+    inline Block Space(Block v)
+    {
+        Block shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        Block inRange = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+        return Or(inRange, Equal(v, ' '));
+    }
+#elif MANO_SIMD_NEON
+    constexpr size_t BlockSize = 16;
+    using Block = uint8x16_t;
+
+    inline Block Load(const char* p) { return vld1q_u8(reinterpret_cast<const uint8_t*>(p)); }
+    inline Block Equal(Block v, char c) { return vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(c))); }
+    inline Block Or(Block a, Block b) { return vorrq_u8(a, b); }
+
+    // NEON has no movemask; narrowing gives 4 bits per byte instead, so the
+    // bit index of a match is divided by four below.
+    inline uint64_t NibbleMask(Block v)
+    {
+        uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    }
+
+    inline Block Space(Block v)
+    {
+        Block inRange = vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t'));
+        return Or(inRange, Equal(v, ' '));
+    }
+#endif
+
+    // Index of the first set lane, or BlockSize when none is set.
+    template<typename Matches>
+    inline size_t FirstIn(Matches matches)
+    {
+#if MANO_SIMD_NEON
+        uint64_t mask = NibbleMask(matches);
+        return mask ? static_cast<size_t>(std::countr_zero(mask)) / 4 : BlockSize;
+#elif MANO_SIMD_AVX2 || MANO_SIMD_SSE2
+        uint32_t mask = Mask(matches);
+        return mask ? static_cast<size_t>(std::countr_zero(mask)) : BlockSize;
+#else
+        (void)matches;
+        return 0;
+#endif
+    }
+
+    // First byte in [p, end) that is not whitespace.
+    inline const char* SkipSpaces(const char* p, const char* end)
+    {
+#if MANO_SIMD_AVX2 || MANO_SIMD_SSE2 || MANO_SIMD_NEON
+        while (end - p >= static_cast<ptrdiff_t>(BlockSize))
+        {
+            Block v = Load(p);
+#if MANO_SIMD_NEON
+            size_t index = FirstIn(vmvnq_u8(Space(v)));
+#else
+            uint32_t mask = ~Mask(Space(v));
+            if constexpr (BlockSize == 16)
+                mask &= 0xFFFF;
+            size_t index = mask ? static_cast<size_t>(std::countr_zero(mask)) : BlockSize;
+#endif
+            if (index < BlockSize)
+                return p + index;
+            p += BlockSize;
+        }
+#endif
+        while (p < end && IsSpace(*p))
+            p++;
+        return p;
+    }
+
+    // First occurrence of c in [p, end), or end.
+    inline const char* Find(const char* p, const char* end, char c)
+    {
+#if MANO_SIMD_AVX2 || MANO_SIMD_SSE2 || MANO_SIMD_NEON
+        while (end - p >= static_cast<ptrdiff_t>(BlockSize))
+        {
+            size_t index = FirstIn(Equal(Load(p), c));
+            if (index < BlockSize)
+                return p + index;
+            p += BlockSize;
+        }
+#endif
+        while (p < end && *p != c)
+            p++;
+        return p;
+    }
+
+    // First occurrence of a or b in [p, end), or end.
+    inline const char* FindEither(const char* p, const char* end, char a, char b)
+    {
+#if MANO_SIMD_AVX2 || MANO_SIMD_SSE2 || MANO_SIMD_NEON
+        while (end - p >= static_cast<ptrdiff_t>(BlockSize))
+        {
+            Block v = Load(p);
+            size_t index = FirstIn(Or(Equal(v, a), Equal(v, b)));
+            if (index < BlockSize)
+                return p + index;
+            p += BlockSize;
+        }
+#endif
+        while (p < end && *p != a && *p != b)
+            p++;
+        return p;
+    }
+} // namespace Arcanelab::Mano::Simd
@@ -0,0 +1,45 @@
+#include <SourceMap.h>
+#include <SimdScan.h>
+
+#include <algorithm>
+
+namespace Arcanelab::Mano
+{
+    SourceMap::Location SourceMap::Resolve(uint32_t offset) const
+    {
+        if (lineStarts.empty())
+            BuildIndex();
+
+        auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        uint32_t line = static_cast<uint32_t>(next - lineStarts.begin());
+        return { line, offset - lineStarts[line - 1] + 1 };
+    }
+
+    SourceMap::Location SourceMap::Resolve(const Token& token) const
+    {
+        // String tokens exclude their quotes but are located at the opening one.
+        uint32_t offset = token.type == TokenType::String ? token.offset - 1 : token.offset;
+        return Resolve(offset);
+    }
+
+    uint32_t SourceMap::Line(uint32_t offset, uint32_t& cursor) const
+    {
+        if (lineStarts.empty())
+            BuildIndex();
+
+        if (cursor >= lineStarts.size() || lineStarts[cursor] > offset)
+            cursor = Resolve(offset).line - 1;
+        while (cursor + 1 < lineStarts.size() && lineStarts[cursor + 1] <= offset)
+            cursor++;
+        return cursor + 1;
+    }
+
+    void SourceMap::BuildIndex() const
+    {
+        const char* data = source.data();
+        const char* end = data + source.size();
+        lineStarts.push_back(0);
+        for (const char* p = Simd::Find(data, end, '\n'); p != end; p = Simd::Find(p + 1, end, '\n'))
+            lineStarts.push_back(static_cast<uint32_t>(p + 1 - data));
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Token.h>
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Resolves token offsets to line/column. The newline index is built on
+    // the first lookup, so a clean compile never pays for it.
+    class SourceMap
+    {
+    public:
+        struct Location
+        {
+            uint32_t line;      // 1-based
+            uint32_t column;    // 1-based, in bytes
+        };
+
+        explicit SourceMap(std::string_view source) : source(source) {}
+
+        std::string_view Source() const { return source; }
+        std::string_view Text(const Token& token) const { return source.substr(token.offset, token.length); }
+        Location Resolve(uint32_t offset) const;
+        Location Resolve(const Token& token) const;
+        // Line of an offset for callers that walk the source front to back.
+        // cursor starts at 0 and carries the line index between calls, so a
+        // forward walk costs one step per line instead of a search per call.
+        uint32_t Line(uint32_t offset, uint32_t& cursor) const;
+
+    private:
+        std::string_view source;
+        mutable std::vector<uint32_t> lineStarts; // Offset of the first byte of every line
+
+        void BuildIndex() const;
+    };
+} // namespace Arcanelab::Mano
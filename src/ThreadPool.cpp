@@ -0,0 +1,96 @@
+#include <ThreadPool.h>
+
+#include <algorithm>
+
+namespace Arcanelab::Mano
+{
+    ThreadPool::ThreadPool(size_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 1; i < threadCount; i++)
+            workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+    {
+        if (count == 0)
+            return;
+        if (workers.empty() || count == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                body(i);
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            job = &body;
+            jobCount = count;
+            nextIndex.store(0, std::memory_order_relaxed);
+            failure = nullptr;
+            pendingWorkers = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        RunJob();
+
+        // Every worker has to check in before the job can be replaced, or a
+        // late one could pick up indices of the next job with this body.
+        std::unique_lock lock(mutex);
+        done.wait(lock, [this] { return pendingWorkers == 0; });
+        job = nullptr;
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+    void ThreadPool::WorkerLoop()
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            RunJob();
+
+            std::lock_guard lock(mutex);
+            if (--pendingWorkers == 0)
+                done.notify_one();
+        }
+    }
+
+    void ThreadPool::RunJob()
+    {
+        size_t index;
+        while ((index = nextIndex.fetch_add(1, std::memory_order_relaxed)) < jobCount)
+        {
+            try
+            {
+                (*job)(index);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                if (!failure)
+                    failure = std::current_exception();
+            }
+        }
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Arcanelab::Mano
+{
+    // Fixed set of worker threads for data-parallel compile steps. The
+    // calling thread takes part in every job, so a pool with no workers
+    // simply runs the job inline.
+    class ThreadPool
+    {
+    public:
+        // threadCount counts the caller; 0 picks one per hardware thread.
+        explicit ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t ThreadCount() const { return workers.size() + 1; }
+
+        // Calls body(i) for every i in [0, count) and returns once all calls
+        // have finished. Indices are handed out in order but may complete in
+        // any order; the first exception thrown is rethrown here.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        // Current job; written under the mutex before generation is bumped.
+        const std::function<void(size_t)>* job = nullptr;
+        size_t jobCount = 0;
+        std::atomic<size_t> nextIndex = 0;
+        std::exception_ptr failure;
+        uint64_t generation = 0;
+        size_t pendingWorkers = 0;
+        bool stopping = false;
+
+        void WorkerLoop();
+        void RunJob();
+    };
+} // namespace Arcanelab::Mano
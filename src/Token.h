@@ -1,10 +1,10 @@
 #pragma once
 
-#include <string_view>
+#include <cstdint>
 
 namespace Arcanelab::Mano
 {
-    enum class TokenType
+    enum class TokenType : uint8_t
     {
         Identifier,    // e.g., foo
         Keyword,       // e.g., var, fun, class, enum, if, etc.
@@ -16,11 +16,38 @@ namespace Arcanelab::Mano
         Unknown        // any token that does not match known types
     };
 
+    // Exact identity of a keyword, operator or punctuation token, so later
+    // stages switch on it instead of comparing lexemes.
+    enum class TokenKind : uint8_t
+    {
+        // Literals and names
+        Identifier, Number, String, EndOfFile, Unknown,
+
+        // Keywords
+        Var, Fun, Class, Enum, If, Else, For, While, Break, Continue, Return, Let,
+        Int, UInt, Float, Bool, StringType, Switch, Case, Default, Const, True, False,
+
+        // Operators
+        Plus, Minus, Star, Slash, Percent, Assign, Bang, Less, Greater,
+        Ampersand, Pipe, Caret, EqualEqual, BangEqual, LessEqual, GreaterEqual,
+        AmpersandAmpersand, PipePipe, LessLess, GreaterGreater,
+
+        // Punctuation
+        LeftParen, RightParen, LeftBrace, RightBrace, LeftBracket, RightBracket,
+        Comma, Colon, Semicolon, Dot
+    };
+
+    // Id carried by tokens and AST names that are not interned identifiers.
+    inline constexpr uint32_t NoIdentifier = UINT32_MAX;
+
+    // Tokens only record where their lexeme lives in the source; the lexeme
+    // text and line/column come from the SourceMap when they are needed.
     struct Token
     {
+        uint32_t offset;
+        uint32_t length;
         TokenType type;
-        std::string_view lexeme;
-        size_t line;
-        size_t column;
+        TokenKind kind;
+        uint32_t nameId = NoIdentifier; // IdentifierTable id, Identifier tokens only
     };
 } // namespace
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Lexer.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace Arcanelab::Mano
+{
+    // Pull-based view of the lexer's output. Tokens are scanned on demand
+    // into a small ring holding the previous token, the current one and a
+    // fixed lookahead, so the parser runs in the same pass as the lexer and
+    // token memory stays constant no matter how large the source is.
+    class TokenStream
+    {
+    public:
+        static constexpr size_t Lookahead = 2;
+
+        // Time spent inside the lexer and the tokens it produced, for
+        // --stats; only kept when the stream is given one to fill.
+        struct LexTiming
+        {
+            std::chrono::steady_clock::duration time{};
+            size_t tokens = 0;  // Not counting EndOfFile
+        };
+
+        explicit TokenStream(Lexer& lexer, LexTiming* timing = nullptr) : lexer(lexer), timing(timing)
+        {
+            for (size_t i = 0; i <= Lookahead; i++)
+                Fill();
+        }
+        TokenStream(const TokenStream&) = delete;
+        TokenStream& operator=(const TokenStream&) = delete;
+
+        // distance 0 is the current token; at most Lookahead tokens further.
+        const Token& Peek(size_t distance = 0) const { return ring[(current + distance) & Mask]; }
+        const Token& Previous() const { return ring[(current - 1) & Mask]; }
+        bool IsAtEnd() const { return Peek().kind == TokenKind::EndOfFile; }
+
+        // Moves to the next token; stays on EndOfFile once it is reached.
+        void Advance()
+        {
+            if (IsAtEnd())
+                return;
+            current++;
+            Fill();
+        }
+
+        const SourceMap& GetSourceMap() const { return lexer.GetSourceMap(); }
+
+    private:
+        // Previous + current + lookahead, rounded up to a power of two.
+        static constexpr size_t Capacity = 4;
+        static constexpr size_t Mask = Capacity - 1;
+        static_assert((Capacity & Mask) == 0 && Capacity >= Lookahead + 2);
+
+        Lexer& lexer;
+        LexTiming* timing;
+        std::array<Token, Capacity> ring{};
+        size_t current = 0;     // Absolute index of the current token
+        size_t scanned = 0;     // Absolute index one past the last scanned token
+
+        void Fill()
+        {
+            // Past the end the lexer keeps producing EndOfFile, so the
+            // lookahead slots stay valid.
+            if (timing)
+                return FillTimed();
+            ring[scanned & Mask] = lexer.NextToken();
+            scanned++;
+        }
+
+        void FillTimed()
+        {
+            auto start = std::chrono::steady_clock::now();
+            const Token& token = ring[scanned & Mask] = lexer.NextToken();
+            timing->time += std::chrono::steady_clock::now() - start;
+            timing->tokens += token.kind != TokenKind::EndOfFile;
+            scanned++;
+        }
+    };
+} // namespace Arcanelab::Mano
@@ -0,0 +1,62 @@
+#include <TypeTable.h>
+
+#include <string>
+
+namespace Arcanelab::Mano
+{
+    TypeTable::TypeTable(AstArena& arena) : arena(arena)
+    {
+        voidType = Create(Type::Kind::Void, "void", nullptr);
+        boolType = Create(Type::Kind::Bool, "bool", nullptr);
+        intType = Create(Type::Kind::Int, "int", nullptr);
+        uintType = Create(Type::Kind::UInt, "uint", nullptr);
+        floatType = Create(Type::Kind::Float, "float", nullptr);
+        stringType = Create(Type::Kind::String, "string", nullptr);
+    }
+
+    const Type* TypeTable::Get(std::string_view name, bool isConst)
+    {
+        std::lock_guard lock(mutex);
+        const Type* type = Intern(name);
+        return isConst ? ConstOf(type) : type;
+    }
+
+    const Type* TypeTable::ArrayOf(const Type* element)
+    {
+        return Get("[" + std::string(element->unqualified->name) + "]");
+    }
+
+    const Type* TypeTable::Intern(std::string_view name)
+    {
+        if (auto it = types.find(name); it != types.end())
+            return it->second;
+        if (name.size() > 2 && name.front() == '[' && name.back() == ']')
+        {
+            const Type* element = Intern(name.substr(1, name.size() - 2));
+            return Create(Type::Kind::Array, arena.CopyString(name), element);
+        }
+        return Create(Type::Kind::Named, arena.CopyString(name), nullptr);
+    }
+
+    Type* TypeTable::Create(Type::Kind kind, std::string_view name, const Type* element)
+    {
+        auto* type = arena.New<Type>();
+        type->kind = kind;
+        type->name = name;
+        type->element = element;
+        types.emplace(name, type);
+        return type;
+    }
+
+    const Type* TypeTable::ConstOf(const Type* type)
+    {
+        if (auto it = constTypes.find(type); it != constTypes.end())
+            return it->second;
+
+        auto* qualified = arena.New<Type>(*type);
+        qualified->isConst = true;
+        qualified->unqualified = type;
+        constTypes.emplace(type, qualified);
+        return qualified;
+    }
+} // namespace Arcanelab::Mano
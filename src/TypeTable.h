@@ -0,0 +1,64 @@
+#pragma once
+
+#include <AstArena.h>
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace Arcanelab::Mano
+{
+    // Canonical semantic type. Every distinct {name, const} combination
+    // exists exactly once per TypeTable, so types are compared by pointer.
+    struct Type
+    {
+        enum class Kind { Void, Bool, Int, UInt, Float, String, Array, Named };
+
+        Kind kind = Kind::Named;
+        std::string_view name;            // Spelling without qualifiers, e.g. "[int]"
+        bool isConst = false;
+        const Type* element = nullptr;    // Arrays only
+        const Type* unqualified = this;   // Same type with const stripped
+    };
+
+    class TypeTable
+    {
+    public:
+        explicit TypeTable(AstArena& arena);
+        TypeTable(const TypeTable&) = delete;
+        TypeTable& operator=(const TypeTable&) = delete;
+
+        // Interns a type by its source spelling; "[T]" yields an array of T.
+        // Safe to call from several threads, which the analyzer's parallel
+        // resolution does; the arena is only touched under the lock.
+        const Type* Get(std::string_view name, bool isConst = false);
+        const Type* ArrayOf(const Type* element);
+
+        const Type* Void() const { return voidType; }
+        const Type* Bool() const { return boolType; }
+        const Type* Int() const { return intType; }
+        const Type* UInt() const { return uintType; }
+        const Type* Float() const { return floatType; }
+        const Type* String() const { return stringType; }
+
+        // Assignment and comparison ignore const; everything else must match exactly.
+        static bool Compatible(const Type* a, const Type* b) { return a->unqualified == b->unqualified; }
+
+    private:
+        std::mutex mutex;
+        AstArena& arena;
+        std::unordered_map<std::string_view, Type*> types;   // Keyed by unqualified spelling
+        std::unordered_map<const Type*, Type*> constTypes;   // Keyed by unqualified type
+
+        const Type* voidType;
+        const Type* boolType;
+        const Type* intType;
+        const Type* uintType;
+        const Type* floatType;
+        const Type* stringType;
+
+        const Type* Intern(std::string_view name);
+        Type* Create(Type::Kind kind, std::string_view name, const Type* element);
+        const Type* ConstOf(const Type* type);
+    };
+} // namespace Arcanelab::Mano
@@ -0,0 +1,867 @@
+#include <VM.h>
+
+#include <Binding.h>
+#include <Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MANO_COMPUTED_GOTO 1
+#else
+#define MANO_COMPUTED_GOTO 0
+#endif
+
+namespace Arcanelab::Mano
+{
+    namespace
+    {
+        // The sample clock of a VM without a profiler.
+        constinit const std::atomic<uint64_t> NeverTicks{ 0 };
+    }
+
+    VM::VM(size_t stackSize, size_t maxCallDepth)
+        : stack(stackSize), maxCallDepth(maxCallDepth), callBase(stack.data()),
+          jitContext{ nullptr, this, &CallFromJit }, sampleClock(&NeverTicks)
+    {
+        frames.reserve(maxCallDepth);
+    }
+
+    VM::~VM()
+    {
+        FreeAllObjects();
+    }
+
+    void VM::Bind(const Binding& hostBinding)
+    {
+        binding = &hostBinding;
+        hostFunctions = hostBinding.Functions().data();
+    }
+
+    void VM::CheckImport(uint32_t index, std::string_view signature) const
+    {
+        if (!binding || index >= binding->Functions().size() || hostFunctions[index].signature != signature)
+            throw RuntimeError("Host function '" + std::string(signature) + "' is not bound");
+    }
+
+    void VM::Load(std::shared_ptr<const SharedModule> shared)
+    {
+        for (const SharedModule::HostImport& import : shared->GetHostImports())
+            CheckImport(import.index, import.signature);
+        FreeAllObjects();
+        module = std::move(shared);
+        classes = module->GetClasses().data();
+        // Strings are objects with a count, so each VM has its own copies.
+        stringConstants.reserve(module->GetStrings().size());
+        for (const SharedModule::String& constant : module->GetStrings())
+            AddStringConstant(constant.text, constant.hash);
+        ResetJit();
+#if MANO_VM_COUNTERS
+        ResetCounters();
+#endif
+        Start(module->GetGlobalCount(), module->GetInitFunction());
+    }
+
+    // An aliasing pointer with no owner leaves the lifetime to the caller.
+    void VM::Load(const Module& borrowed)
+    {
+        Load(std::make_shared<const SharedModule>(std::shared_ptr<const Module>(std::shared_ptr<const Module>(), &borrowed)));
+    }
+
+    void VM::Load(const ModuleImage& borrowed)
+    {
+        Load(std::make_shared<const SharedModule>(std::shared_ptr<const ModuleImage>(std::shared_ptr<const ModuleImage>(), &borrowed)));
+    }
+
+    void VM::Reload(std::shared_ptr<const SharedModule> shared)
+    {
+        if (!module || shared->GetFunctions().size() != module->GetFunctions().size()
+            || shared->GetClasses().size() != module->GetClasses().size()
+            || shared->GetGlobalCount() != globals.size() || shared->GetStrings().size() < stringConstants.size())
+            throw RuntimeError("Reloaded module does not match the loaded one");
+        for (const SharedModule::HostImport& import : shared->GetHostImports())
+            CheckImport(import.index, import.signature);
+
+        // The string pool only grows, so the constants already created keep their indices.
+        module = std::move(shared);
+        classes = module->GetClasses().data();
+        const std::vector<SharedModule::String>& strings = module->GetStrings();
+        for (size_t i = stringConstants.size(); i < strings.size(); i++)
+            AddStringConstant(strings[i].text, strings[i].hash);
+        ResetJit();
+#if MANO_VM_COUNTERS
+        ResetCounters();
+#endif
+    }
+
+    void VM::Reload(const Module& borrowed)
+    {
+        Reload(std::make_shared<const SharedModule>(std::shared_ptr<const Module>(std::shared_ptr<const Module>(), &borrowed)));
+    }
+
+    void VM::AddStringConstant(std::string_view text, uint32_t hash)
+    {
+        if (text.size() > UINT32_MAX)
+            throw RuntimeError("String constant too long");
+        size_t size = sizeof(Object) + sizeof(StringHeader) + text.size();
+        auto* object = new (::operator new(size)) Object{ StringClass, 1, nullptr, nullptr };
+        auto* header = reinterpret_cast<StringHeader*>(object->Fields());
+        header->length = static_cast<uint32_t>(text.size());
+        header->hash = hash;
+        std::memcpy(header->Chars(), text.data(), text.size());
+        stringConstants.push_back(object);
+    }
+
+    void VM::Start(uint32_t globalCount, int32_t initFunction)
+    {
+        globals.assign(globalCount, Value::Int(0));
+        jitContext.globals = globals.data();
+        if (initFunction >= 0)
+            Call(initFunction);
+    }
+
+    Value VM::Call(int32_t functionIndex, std::span<const Value> arguments)
+    {
+        if (!module || functionIndex < 0 || static_cast<size_t>(functionIndex) >= module->GetFunctions().size())
+            throw RuntimeError("Invalid function index");
+
+        const SharedModule::Function& function = module->GetFunctions()[functionIndex];
+        if (arguments.size() != function.numParams)
+            throw RuntimeError("Argument count mismatch in call to '" + std::string(function.name) + "'");
+        Value* base = callBase;
+        if (function.frameSize > static_cast<size_t>(stack.data() + stack.size() - base))
+            throw RuntimeError("Stack overflow");
+
+        std::copy(arguments.begin(), arguments.end(), base);
+        // Ticks that passed while the VM was idle are nobody's.
+        if (base == stack.data())
+            sampledTicks = sampleClock->load(std::memory_order_relaxed);
+
+        size_t depth = frames.size();
+        try
+        {
+            // A call from a host function runs above the script that called
+            // the host, whose frame shows in the profiler's stacks.
+            if (base != stack.data())
+                frames.push_back(hostCallSite);
+            Value result;
+            if (const JitCompiler::CompiledFunction* compiled = TierUp(static_cast<uint32_t>(functionIndex)))
+                result = RunCompiled(compiled, compiled->targets[0], base) ? base[0] : Value::Int(0);
+            else
+                result = Execute(&function, base);
+            frames.resize(depth);
+            return result;
+        }
+        catch (...)
+        {
+            frames.resize(depth);
+            callBase = base;
+            throw;
+        }
+    }
+
+    void VM::SetJitEnabled(bool enabled)
+    {
+        jitRequested = enabled && JitCompiler::Available;
+        jitEnabled = jitRequested && !profiler;
+        ResetJit();
+    }
+
+    void VM::SetProfiler(Profiler* attached)
+    {
+        profiler = attached;
+        sampleClock = profiler ? &profiler->ticks : &NeverTicks;
+        sampledTicks = sampleClock->load(std::memory_order_relaxed);
+        jitEnabled = jitRequested && !profiler;
+        ResetJit();
+    }
+
+#if MANO_VM_COUNTERS
+    void VM::ResetCounters()
+    {
+        size_t functionCount = module ? module->GetFunctions().size() : 0;
+        counters.opcodes.fill(0);
+        counters.calls.assign(functionCount, 0);
+        counters.instructions.assign(functionCount, 0);
+    }
+#endif
+
+    void VM::ResetJit()
+    {
+        jit.Clear();
+        jitSlots.assign(module ? module->GetFunctions().size() : 0, JitSlot{});
+    }
+
+    // Counts a call or a backward jump, compiling the function once it is hot.
+    inline const JitCompiler::CompiledFunction* VM::TierUp(uint32_t functionIndex)
+    {
+        JitSlot& slot = jitSlots[functionIndex];
+        if (slot.compiled || !jitEnabled || slot.rejected || ++slot.hotness < JitThreshold)
+            return slot.compiled;
+        slot.compiled = jit.Compile(module->GetFunctions()[functionIndex]);
+        slot.rejected = !slot.compiled;
+        return slot.compiled;
+    }
+
+    // True if the function returned a value, which is then in base[0].
+    bool VM::RunCompiled(const JitCompiler::CompiledFunction* compiled, const void* target, Value* base)
+    {
+        nativeDepth++;
+        JitStatus status = compiled->entry(base, &jitContext, target);
+        nativeDepth--;
+        switch (status)
+        {
+            case JitStatus::Returned:
+                return true;
+            case JitStatus::ReturnedVoid:
+                return false;
+            case JitStatus::DivisionByZero:
+                throw RuntimeError("Division by zero");
+            case JitStatus::Failed:
+                break;
+        }
+        std::exception_ptr failure = std::exchange(jitFailure, nullptr);
+        std::rethrow_exception(failure);
+    }
+
+    // Calls the host makes back into the VM start above the calling frame.
+    void VM::CallHost(uint32_t index, const CallFrame& site, Value* arguments)
+    {
+        const HostFunction& host = hostFunctions[index];
+        Value* caller = callBase;
+        CallFrame outerSite = hostCallSite;
+        callBase = site.base + site.function->frameSize;
+        hostCallSite = site;
+        host.trampoline(arguments, host.context, *this);
+        hostCallSite = outerSite;
+        callBase = caller;
+    }
+
+    // Charges the ticks since the previous sample to the interpreted stack,
+    // with the running function at instruction at.
+    void VM::Sample(const SharedModule::Function* function, const Instruction* at)
+    {
+        uint64_t now = sampleClock->load(std::memory_order_relaxed);
+        uint64_t count = now - sampledTicks;
+        sampledTicks = now;
+
+        auto append = [this](const SharedModule::Function* frameFunction, const Instruction* instruction)
+        {
+            sampleStack += frameFunction->name;
+            if (uint32_t line = LineAt(frameFunction->lines, static_cast<uint32_t>(instruction - frameFunction->code)))
+            {
+                sampleStack += ':';
+                sampleStack += std::to_string(line);
+            }
+        };
+        sampleStack.clear();
+        // Frames hold return addresses, one past the call.
+        for (const CallFrame& frame : frames)
+        {
+            append(frame.function, frame.ip - 1);
+            sampleStack += ';';
+        }
+        append(function, at);
+        profiler->Record(sampleStack, count);
+    }
+
+    // CALL from machine code. The callee runs compiled if it is, or once it
+    // turns hot, and interpreted otherwise; errors are held for RunCompiled.
+    JitStatus VM::CallFromJit(JitContext* context, uint32_t functionIndex, Value* base)
+    {
+        VM& vm = *static_cast<VM*>(context->vm);
+        try
+        {
+            const SharedModule::Function& callee = vm.module->GetFunctions()[functionIndex];
+            if (callee.frameSize > static_cast<size_t>(vm.stack.data() + vm.stack.size() - base))
+                throw RuntimeError("Stack overflow");
+            if (vm.frames.size() + vm.nativeDepth >= vm.maxCallDepth)
+                throw RuntimeError("Maximum call depth exceeded");
+
+            if (const JitCompiler::CompiledFunction* compiled = vm.TierUp(functionIndex))
+            {
+                vm.nativeDepth++;
+                JitStatus status = compiled->entry(base, context, compiled->targets[0]);
+                vm.nativeDepth--;
+                return status == JitStatus::ReturnedVoid ? JitStatus::Returned : status;
+            }
+            vm.Execute(&callee, base);
+            return JitStatus::Returned;
+        }
+        catch (...)
+        {
+            vm.jitFailure = std::current_exception();
+            return JitStatus::Failed;
+        }
+    }
+
+    Object* VM::NewObject(uint32_t classIndex)
+    {
+        size_t fieldSize = classIndex == ArrayClass || classIndex == ReferenceArrayClass
+            ? sizeof(ArrayHeader)
+            : classes[classIndex].instanceSize;
+        auto* object = new (::operator new(sizeof(Object) + fieldSize)) Object{ classIndex, 1, nullptr, liveObjects };
+        std::memset(object->Fields(), 0, fieldSize);
+        if (liveObjects)
+            liveObjects->previous = object;
+        liveObjects = object;
+        liveObjectCount++;
+        return object;
+    }
+
+    // The string is linked like any other object; the caller fills in the
+    // characters.
+    Object* VM::NewString(size_t length)
+    {
+        if (length > UINT32_MAX)
+            throw RuntimeError("String too long");
+        size_t size = sizeof(Object) + sizeof(StringHeader) + length;
+        auto* object = new (::operator new(size)) Object{ StringClass, 1, nullptr, liveObjects };
+        auto* header = reinterpret_cast<StringHeader*>(object->Fields());
+        header->length = static_cast<uint32_t>(length);
+        header->hash = 0;
+        if (liveObjects)
+            liveObjects->previous = object;
+        liveObjects = object;
+        liveObjectCount++;
+        return object;
+    }
+
+    // Sizes the result up front, so a chain of any length allocates once.
+    Object* VM::Concat(const Value* parts, uint32_t count)
+    {
+        size_t length = 0;
+        for (uint32_t p = 0; p < count; p++)
+            length += StringOf(parts[p]).size();
+
+        Object* result = NewString(length);
+        char* out = reinterpret_cast<StringHeader*>(result->Fields())->Chars();
+        for (uint32_t p = 0; p < count; p++)
+        {
+            std::string_view part = StringOf(parts[p]);
+            std::memcpy(out, part.data(), part.size());
+            out += part.size();
+        }
+        return result;
+    }
+
+    Object* VM::NewArray(ArrayElement element, uint32_t capacity)
+    {
+        Object* object = NewObject(element == ArrayElement::Reference ? ReferenceArrayClass : ArrayClass);
+        auto* header = reinterpret_cast<ArrayHeader*>(object->Fields());
+        header->elementSize = element == ArrayElement::Byte ? 1 : 8;
+        if (capacity)
+        {
+            header->data = static_cast<std::byte*>(std::malloc(size_t(capacity) * header->elementSize));
+            if (!header->data)
+                throw std::bad_alloc();
+            header->capacity = capacity;
+        }
+        return object;
+    }
+
+    // Doubling keeps pushes amortized constant time.
+    void VM::Push(Object* array, Value value)
+    {
+        auto* header = reinterpret_cast<ArrayHeader*>(array->Fields());
+        if (header->length == header->capacity)
+        {
+            if (header->capacity == UINT32_MAX)
+                throw RuntimeError("Array too long");
+            uint64_t capacity = std::max<uint64_t>(8, uint64_t(header->capacity) * 2);
+            capacity = std::min<uint64_t>(capacity, UINT32_MAX);
+            void* data = std::realloc(header->data, capacity * header->elementSize);
+            if (!data)
+                throw std::bad_alloc();
+            header->data = static_cast<std::byte*>(data);
+            header->capacity = static_cast<uint32_t>(capacity);
+        }
+        if (header->elementSize == 1)
+            header->data[header->length] = static_cast<std::byte>(value.u);
+        else
+            std::memcpy(header->data + size_t(header->length) * 8, &value, sizeof(Value));
+        header->length++;
+    }
+
+    Value VM::CreateString(std::string_view text)
+    {
+        Object* object = NewString(text.size());
+        std::memcpy(reinterpret_cast<StringHeader*>(object->Fields())->Chars(), text.data(), text.size());
+        Value value;
+        value.o = object;
+        return value;
+    }
+
+    std::string_view VM::StringOf(Value value)
+    {
+        if (!value.o)
+            return {};
+        auto* header = reinterpret_cast<StringHeader*>(value.o->Fields());
+        return { header->Chars(), header->length };
+    }
+
+    // Dropping the last reference releases the object's own references in
+    // turn; the queue keeps long chains from recursing.
+    void VM::Release(Object* object)
+    {
+        if (--object->refCount != 0)
+            return;
+
+        releaseQueue.push_back(object);
+        while (!releaseQueue.empty())
+        {
+            Object* dead = releaseQueue.back();
+            releaseQueue.pop_back();
+            if (dead->classIndex == ArrayClass || dead->classIndex == ReferenceArrayClass)
+            {
+                auto* header = reinterpret_cast<ArrayHeader*>(dead->Fields());
+                if (dead->classIndex == ReferenceArrayClass)
+                {
+                    for (uint32_t e = 0; e < header->length; e++)
+                    {
+                        Object* element;
+                        std::memcpy(&element, header->data + size_t(e) * 8, sizeof(element));
+                        if (element && --element->refCount == 0)
+                            releaseQueue.push_back(element);
+                    }
+                }
+                std::free(header->data);
+            }
+            else if (dead->classIndex != StringClass)
+            {
+                for (uint32_t word : classes[dead->classIndex].referenceFields)
+                {
+                    Object* field;
+                    std::memcpy(&field, dead->Fields() + 8 * word, sizeof(field));
+                    if (field && --field->refCount == 0)
+                        releaseQueue.push_back(field);
+                }
+            }
+
+            if (dead->previous)
+                dead->previous->next = dead->next;
+            else
+                liveObjects = dead->next;
+            if (dead->next)
+                dead->next->previous = dead->previous;
+            ::operator delete(dead);
+            liveObjectCount--;
+        }
+    }
+
+    void VM::FreeAllObjects()
+    {
+        while (liveObjects)
+        {
+            Object* next = liveObjects->next;
+            if (liveObjects->classIndex == ArrayClass || liveObjects->classIndex == ReferenceArrayClass)
+                std::free(reinterpret_cast<ArrayHeader*>(liveObjects->Fields())->data);
+            ::operator delete(liveObjects);
+            liveObjects = next;
+        }
+        liveObjectCount = 0;
+        for (Object* constant : stringConstants)
+            ::operator delete(constant);
+        stringConstants.clear();
+    }
+
+    namespace
+    {
+        std::byte* FieldsOf(Value object)
+        {
+            if (!object.o)
+                throw RuntimeError("Null object reference");
+            return object.o->Fields();
+        }
+
+        ArrayHeader& ArrayOf(Value array)
+        {
+            if (!array.o)
+                throw RuntimeError("Null array reference");
+            return *reinterpret_cast<ArrayHeader*>(array.o->Fields());
+        }
+
+        std::byte* ElementOf(Value array, Value index, uint32_t elementSize)
+        {
+            ArrayHeader& header = ArrayOf(array);
+            if (index.u >= header.length)
+                throw RuntimeError("Array index out of bounds");
+            return header.data + index.u * elementSize;
+        }
+
+        // Only reached when the analyzer proved the index in range.
+        std::byte* ElementOfUnchecked(Value array, Value index)
+        {
+            return reinterpret_cast<ArrayHeader*>(array.o->Fields())->data + index.u * 8;
+        }
+
+        uint32_t HashOf(Object* string)
+        {
+            auto* header = reinterpret_cast<StringHeader*>(string->Fields());
+            if (header->hash == 0)
+                header->hash = HashString({ header->Chars(), header->length });
+            return header->hash;
+        }
+
+        // Same object, then length, then the hashes once both are known (or
+        // the strings are long enough to be worth hashing), then the bytes.
+        bool StringsEqual(Value left, Value right)
+        {
+            if (left.o == right.o)
+                return true;
+            std::string_view a = VM::StringOf(left);
+            std::string_view b = VM::StringOf(right);
+            if (a.size() != b.size())
+                return false;
+            if (a.empty())
+                return true;
+            auto* leftHeader = reinterpret_cast<StringHeader*>(left.o->Fields());
+            auto* rightHeader = reinterpret_cast<StringHeader*>(right.o->Fields());
+            if ((leftHeader->hash && rightHeader->hash) || a.size() >= 64)
+            {
+                if (HashOf(left.o) != HashOf(right.o))
+                    return false;
+            }
+            return std::memcmp(a.data(), b.data(), a.size()) == 0;
+        }
+    }
+
+    // arguments[0] is the array the kernel reads or updates; the second one
+    // is a same-typed array or a scalar.
+    Value VM::RunKernel(KernelOp kernel, const Value* arguments)
+    {
+        ArrayHeader& array = ArrayOf(arguments[0]);
+        auto* words = reinterpret_cast<int64_t*>(array.data);
+        auto* unsignedWords = reinterpret_cast<uint64_t*>(array.data);
+        auto* floats = reinterpret_cast<double*>(array.data);
+        size_t count = array.length;
+
+        auto other = [&]() -> std::byte*
+        {
+            ArrayHeader& source = ArrayOf(arguments[1]);
+            if (source.length != array.length)
+                throw RuntimeError("Array length mismatch in " + std::string(KernelName(kernel)));
+            return source.data;
+        };
+        auto nonEmpty = [&]
+        {
+            if (count == 0)
+                throw RuntimeError("Empty array in " + std::string(KernelName(kernel)));
+        };
+
+        switch (kernel)
+        {
+            case KernelOp::SUM_I: return Value::Int(kernels.SumI(words, count));
+            case KernelOp::SUM_F: return Value::Float(kernels.SumF(floats, count));
+            case KernelOp::DOT_I: return Value::Int(kernels.DotI(words, reinterpret_cast<const int64_t*>(other()), count));
+            case KernelOp::DOT_F: return Value::Float(kernels.DotF(floats, reinterpret_cast<const double*>(other()), count));
+            case KernelOp::MIN_I: nonEmpty(); return Value::Int(kernels.MinI(words, count));
+            case KernelOp::MIN_U: nonEmpty(); return Value::UInt(kernels.MinU(unsignedWords, count));
+            case KernelOp::MIN_F: nonEmpty(); return Value::Float(kernels.MinF(floats, count));
+            case KernelOp::MAX_I: nonEmpty(); return Value::Int(kernels.MaxI(words, count));
+            case KernelOp::MAX_U: nonEmpty(); return Value::UInt(kernels.MaxU(unsignedWords, count));
+            case KernelOp::MAX_F: nonEmpty(); return Value::Float(kernels.MaxF(floats, count));
+            case KernelOp::ADD_I: kernels.AddI(words, reinterpret_cast<const int64_t*>(other()), count); break;
+            case KernelOp::ADD_F: kernels.AddF(floats, reinterpret_cast<const double*>(other()), count); break;
+            case KernelOp::MUL_I: kernels.MulI(words, reinterpret_cast<const int64_t*>(other()), count); break;
+            case KernelOp::MUL_F: kernels.MulF(floats, reinterpret_cast<const double*>(other()), count); break;
+            case KernelOp::SCALE_I: kernels.ScaleI(words, arguments[1].i, count); break;
+            case KernelOp::SCALE_F: kernels.ScaleF(floats, arguments[1].f, count); break;
+            case KernelOp::FILL_W: std::fill_n(words, count, arguments[1].i); break;
+            case KernelOp::FILL_B: if (count) std::memset(array.data, static_cast<int>(arguments[1].u), count); break;
+            case KernelOp::COPY_W: { std::byte* source = other(); if (count) std::memmove(array.data, source, count * 8); break; }
+            case KernelOp::COPY_B: { std::byte* source = other(); if (count) std::memmove(array.data, source, count); break; }
+            default: throw RuntimeError("Invalid kernel");
+        }
+        return Value::Int(0);
+    }
+
+    Value VM::Execute(const SharedModule::Function* function, Value* base)
+    {
+        const SharedModule::Function* functions = module->GetFunctions().data();
+        const Value* stackEnd = stack.data() + stack.size();
+        const size_t entryDepth = frames.size();
+
+        const Instruction* ip = function->code;
+        const Value* K = function->constants;
+        Value* R = base;
+        Value* G = globals.data();
+        Object* const* strings = stringConstants.data();
+        Instruction i;
+
+#define RA R[GetA(i)]
+#define RB R[GetB(i)]
+#define RC R[GetC(i)]
+
+#if MANO_VM_COUNTERS
+#define VM_COUNT() (counters.opcodes[i & 0xFF]++, counters.instructions[function - functions]++)
+#define VM_COUNT_CALL() counters.calls[function - functions]++
+#else
+#define VM_COUNT()
+#define VM_COUNT_CALL()
+#endif
+
+        // A tick of the profiler is answered at the next backward jump, call
+        // or return from the host.
+#define VM_SAMPLE(at) if (sampleClock->load(std::memory_order_relaxed) != sampledTicks) Sample(function, at)
+
+        VM_COUNT_CALL();
+
+#if MANO_COMPUTED_GOTO
+        static const void* dispatchTable[] =
+        {
+#define MANO_OPCODE_LABEL(name) &&L_##name,
+            MANO_OPCODES(MANO_OPCODE_LABEL)
+#undef MANO_OPCODE_LABEL
+        };
+#define VM_DISPATCH() do { i = *ip++; VM_COUNT(); goto *dispatchTable[i & 0xFF]; } while (0)
+#define VM_BEGIN() VM_DISPATCH();
+#define VM_OP(name) L_##name:
+#define VM_NEXT() VM_DISPATCH()
+#define VM_END()
+#else
+#define VM_BEGIN() for (;;) { i = *ip++; VM_COUNT(); switch (GetOp(i)) {
+#define VM_OP(name) case OpCode::name:
+#define VM_NEXT() break
+#define VM_END() default: throw RuntimeError("Invalid opcode"); } }
+#endif
+
+        // Signed arithmetic wraps around like the unsigned one instead of being undefined.
+#define VM_ARITH_I(op) RA.i = static_cast<int64_t>(static_cast<uint64_t>(RB.i) op static_cast<uint64_t>(RC.i))
+#define VM_ARITH_U(op) RA.u = RB.u op RC.u
+#define VM_ARITH_F(op) RA.f = RB.f op RC.f
+#define VM_COMPARE(field, op) RA.u = (RB.field op RC.field) ? 1 : 0
+
+        VM_BEGIN()
+
+        VM_OP(MOVE)  { RA = RB; VM_NEXT(); }
+        VM_OP(LOADK) { RA = K[GetBx(i)]; VM_NEXT(); }
+        VM_OP(LOADI) { RA.i = GetSBx(i); VM_NEXT(); }
+        VM_OP(LOADB) { RA.u = GetB(i); VM_NEXT(); }
+        VM_OP(LOADS) { RA.o = strings[GetBx(i)]; VM_NEXT(); }
+        VM_OP(GETG)  { RA = G[GetBx(i)]; VM_NEXT(); }
+        VM_OP(SETG)  { G[GetBx(i)] = RA; VM_NEXT(); }
+        VM_OP(SETG_R)
+        {
+            Object* old = G[GetBx(i)].o;
+            G[GetBx(i)] = RA;
+            if (old)
+                Release(old);
+            VM_NEXT();
+        }
+
+        VM_OP(ADD_I) { VM_ARITH_I(+); VM_NEXT(); }
+        VM_OP(SUB_I) { VM_ARITH_I(-); VM_NEXT(); }
+        VM_OP(MUL_I) { VM_ARITH_I(*); VM_NEXT(); }
+        VM_OP(DIV_I)
+        {
+            int64_t divisor = RC.i;
+            if (divisor == 0)
+                throw RuntimeError("Division by zero");
+            RA.i = (divisor == -1) ? static_cast<int64_t>(0 - static_cast<uint64_t>(RB.i)) : RB.i / divisor;
+            VM_NEXT();
+        }
+        VM_OP(MOD_I)
+        {
+            int64_t divisor = RC.i;
+            if (divisor == 0)
+                throw RuntimeError("Division by zero");
+            RA.i = (divisor == -1) ? 0 : RB.i % divisor;
+            VM_NEXT();
+        }
+
+        VM_OP(ADD_U) { VM_ARITH_U(+); VM_NEXT(); }
+        VM_OP(SUB_U) { VM_ARITH_U(-); VM_NEXT(); }
+        VM_OP(MUL_U) { VM_ARITH_U(*); VM_NEXT(); }
+        VM_OP(DIV_U)
+        {
+            if (RC.u == 0)
+                throw RuntimeError("Division by zero");
+            VM_ARITH_U(/);
+            VM_NEXT();
+        }
+        VM_OP(MOD_U)
+        {
+            if (RC.u == 0)
+                throw RuntimeError("Division by zero");
+            VM_ARITH_U(%);
+            VM_NEXT();
+        }
+
+        VM_OP(ADD_F) { VM_ARITH_F(+); VM_NEXT(); }
+        VM_OP(SUB_F) { VM_ARITH_F(-); VM_NEXT(); }
+        VM_OP(MUL_F) { VM_ARITH_F(*); VM_NEXT(); }
+        VM_OP(DIV_F) { VM_ARITH_F(/); VM_NEXT(); }
+        VM_OP(MOD_F) { RA.f = std::fmod(RB.f, RC.f); VM_NEXT(); }
+
+        VM_OP(BAND)  { VM_ARITH_U(&); VM_NEXT(); }
+        VM_OP(BOR)   { VM_ARITH_U(|); VM_NEXT(); }
+        VM_OP(BXOR)  { VM_ARITH_U(^); VM_NEXT(); }
+        VM_OP(SHL)   { RA.u = RB.u << (RC.u & 63); VM_NEXT(); }
+        VM_OP(SHR_I) { RA.i = RB.i >> (RC.u & 63); VM_NEXT(); }
+        VM_OP(SHR_U) { RA.u = RB.u >> (RC.u & 63); VM_NEXT(); }
+
+        VM_OP(NEG_I) { RA.i = static_cast<int64_t>(0 - static_cast<uint64_t>(RB.i)); VM_NEXT(); }
+        VM_OP(NEG_F) { RA.f = -RB.f; VM_NEXT(); }
+        VM_OP(NOT)   { RA.u = RB.u ^ 1; VM_NEXT(); }
+
+        VM_OP(EQ_I) { VM_COMPARE(i, ==); VM_NEXT(); }
+        VM_OP(NE_I) { VM_COMPARE(i, !=); VM_NEXT(); }
+        VM_OP(LT_I) { VM_COMPARE(i, <); VM_NEXT(); }
+        VM_OP(LE_I) { VM_COMPARE(i, <=); VM_NEXT(); }
+        VM_OP(LT_U) { VM_COMPARE(u, <); VM_NEXT(); }
+        VM_OP(LE_U) { VM_COMPARE(u, <=); VM_NEXT(); }
+        VM_OP(EQ_F) { VM_COMPARE(f, ==); VM_NEXT(); }
+        VM_OP(NE_F) { VM_COMPARE(f, !=); VM_NEXT(); }
+        VM_OP(LT_F) { VM_COMPARE(f, <); VM_NEXT(); }
+        VM_OP(LE_F) { VM_COMPARE(f, <=); VM_NEXT(); }
+        VM_OP(EQ_B) { VM_COMPARE(u, ==); VM_NEXT(); }
+        VM_OP(NE_B) { VM_COMPARE(u, !=); VM_NEXT(); }
+        VM_OP(EQ_S) { RA.u = StringsEqual(RB, RC) ? 1 : 0; VM_NEXT(); }
+        VM_OP(NE_S) { RA.u = StringsEqual(RB, RC) ? 0 : 1; VM_NEXT(); }
+        VM_OP(CONCAT) { RA.o = Concat(&RB, GetC(i)); VM_NEXT(); }
+
+        VM_OP(NEW)    { RA.o = NewObject(GetBx(i)); VM_NEXT(); }
+        VM_OP(GETF)   { std::memcpy(&RA, FieldsOf(RB) + 8 * GetC(i), sizeof(Value)); VM_NEXT(); }
+        VM_OP(SETF)   { std::memcpy(FieldsOf(RA) + 8 * GetC(i), &RB, sizeof(Value)); VM_NEXT(); }
+        VM_OP(SETF_R)
+        {
+            std::byte* field = FieldsOf(RA) + 8 * GetC(i);
+            Object* old;
+            std::memcpy(&old, field, sizeof(old));
+            std::memcpy(field, &RB, sizeof(Value));
+            if (old)
+                Release(old);
+            VM_NEXT();
+        }
+        VM_OP(GETF_B) { RA.u = static_cast<uint8_t>(FieldsOf(RB)[GetC(i)]); VM_NEXT(); }
+        VM_OP(SETF_B) { FieldsOf(RA)[GetC(i)] = static_cast<std::byte>(RB.u); VM_NEXT(); }
+        VM_OP(NEWA)   { RA.o = NewArray(static_cast<ArrayElement>(GetB(i)), GetC(i)); VM_NEXT(); }
+        VM_OP(LEN)    { RA.u = RB.o ? reinterpret_cast<ArrayHeader*>(RB.o->Fields())->length : 0; VM_NEXT(); }
+        VM_OP(PUSH)   { ArrayOf(RA); Push(RA.o, RB); VM_NEXT(); }
+        VM_OP(GETA)   { std::memcpy(&RA, ElementOf(RB, RC, 8), sizeof(Value)); VM_NEXT(); }
+        VM_OP(GETA_B) { RA.u = static_cast<uint8_t>(*ElementOf(RB, RC, 1)); VM_NEXT(); }
+        VM_OP(GETA_N) { std::memcpy(&RA, ElementOfUnchecked(RB, RC), sizeof(Value)); VM_NEXT(); }
+        VM_OP(SETA)   { std::memcpy(ElementOf(RA, RB, 8), &RC, sizeof(Value)); VM_NEXT(); }
+        VM_OP(SETA_B) { *ElementOf(RA, RB, 1) = static_cast<std::byte>(RC.u); VM_NEXT(); }
+        VM_OP(SETA_R)
+        {
+            std::byte* element = ElementOf(RA, RB, 8);
+            Object* old;
+            std::memcpy(&old, element, sizeof(old));
+            std::memcpy(element, &RC, sizeof(Value));
+            if (old)
+                Release(old);
+            VM_NEXT();
+        }
+        VM_OP(SETA_N) { std::memcpy(ElementOfUnchecked(RA, RB), &RC, sizeof(Value)); VM_NEXT(); }
+        VM_OP(KERNEL) { RA = RunKernel(static_cast<KernelOp>(GetC(i)), &RB); VM_NEXT(); }
+        VM_OP(RETAIN) { if (RA.o) RA.o->refCount++; VM_NEXT(); }
+        VM_OP(RELEASE) { if (RA.o) Release(RA.o); VM_NEXT(); }
+
+        VM_OP(JMP)
+        {
+            int32_t offset = GetSJ(i);
+            ip += offset;
+            // Loops count towards compiling the function, whose machine code
+            // then takes over at the loop header and runs it to the end.
+            if (offset < 0)
+            {
+                VM_SAMPLE(ip - offset - 1);
+                if (const JitCompiler::CompiledFunction* compiled = TierUp(static_cast<uint32_t>(function - functions)))
+                {
+                    if (RunCompiled(compiled, compiled->targets[ip - function->code], R))
+                        goto returned;
+                    goto returnedVoid;
+                }
+            }
+            VM_NEXT();
+        }
+        VM_OP(JMPF) { if (RA.u == 0) ip += GetSBx(i); VM_NEXT(); }
+        VM_OP(JMPT) { if (RA.u != 0) ip += GetSBx(i); VM_NEXT(); }
+        // The table is the Bx jumps that follow, one per index from zero;
+        // an index out of range skips all of them.
+        VM_OP(JTAB) { ip += RA.u < GetBx(i) ? RA.u : GetBx(i); VM_NEXT(); }
+
+        VM_OP(CALL)
+        {
+            const SharedModule::Function* callee = &functions[GetBx(i)];
+            Value* calleeBase = R + GetA(i);
+            if (calleeBase + callee->frameSize > stackEnd)
+                throw RuntimeError("Stack overflow");
+            if (frames.size() + nativeDepth >= maxCallDepth)
+                throw RuntimeError("Maximum call depth exceeded");
+            if (const JitCompiler::CompiledFunction* compiled = TierUp(GetBx(i)))
+            {
+                RunCompiled(compiled, compiled->targets[0], calleeBase);
+                VM_NEXT();
+            }
+
+            frames.push_back({ function, ip, R });
+            function = callee;
+            ip = callee->code;
+            K = callee->constants;
+            R = calleeBase;
+            VM_COUNT_CALL();
+            VM_SAMPLE(ip);
+            VM_NEXT();
+        }
+        VM_OP(CALLH)
+        {
+            CallHost(GetBx(i), { function, ip, R }, R + GetA(i));
+            VM_SAMPLE(ip - 1);
+            VM_NEXT();
+        }
+        VM_OP(RET)
+        {
+            // The callee window starts at the caller's R[A], so the result lands there.
+            R[0] = RA;
+        returned:
+            if (frames.size() == entryDepth)
+                return R[0];
+            const CallFrame& frame = frames.back();
+            function = frame.function;
+            ip = frame.ip;
+            R = frame.base;
+            K = function->constants;
+            frames.pop_back();
+            VM_NEXT();
+        }
+        VM_OP(RET0)
+        {
+        returnedVoid:
+            if (frames.size() == entryDepth)
+                return Value::Int(0);
+            const CallFrame& frame = frames.back();
+            function = frame.function;
+            ip = frame.ip;
+            R = frame.base;
+            K = function->constants;
+            frames.pop_back();
+            VM_NEXT();
+        }
+
+        VM_END()
+
+#undef VM_COMPARE
+#undef VM_ARITH_F
+#undef VM_ARITH_U
+#undef VM_ARITH_I
+#undef VM_END
+#undef VM_NEXT
+#undef VM_OP
+#undef VM_BEGIN
+#undef VM_DISPATCH
+#undef VM_SAMPLE
+#undef VM_COUNT_CALL
+#undef VM_COUNT
+#undef RC
+#undef RB
+#undef RA
+    }
+} // namespace Arcanelab::Mano
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <ArrayKernels.h>
+#include <Bytecode.h>
+#include <Jit.h>
+#include <ModuleImage.h>
+#include <SharedModule.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Building with MANO_VM_COUNTERS=1 makes the interpreter count the
+// instructions it runs per opcode and per function, and the calls it makes
+// per function. Off by default, which leaves no trace of the counting.
+#ifndef MANO_VM_COUNTERS
+#define MANO_VM_COUNTERS 0
+#endif
+
+namespace Arcanelab::Mano
+{
+    struct RuntimeError : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Instance header. The fields follow at the offsets the analyzer laid
+    // out and start zeroed, which makes every object field null. A VM and
+    // its objects belong to one thread, so the count is a plain integer.
+    // Live objects are also linked into a list, so unloading a module or
+    // unwinding from a runtime error frees whatever is still referenced.
+    struct alignas(8) Object
+    {
+        uint32_t classIndex;
+        uint32_t refCount;
+        Object* previous;
+        Object* next;
+
+        std::byte* Fields() { return reinterpret_cast<std::byte*>(this + 1); }
+    };
+
+    // Strings are immutable objects of StringClass. The length, a hash that
+    // is filled in on first comparison and the characters share the
+    // allocation with the header, so a string costs one allocation.
+    struct StringHeader
+    {
+        uint32_t length;
+        uint32_t hash;
+
+        char* Chars() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    // Arrays keep their elements packed in a separate buffer, so the object
+    // stays put while the buffer grows.
+    struct ArrayHeader
+    {
+        std::byte* data;
+        uint32_t length;
+        uint32_t capacity;
+        uint32_t elementSize;
+    };
+
+    class Binding;
+    class Profiler;
+    struct HostFunction;
+
+    class VM
+    {
+    public:
+        explicit VM(size_t stackSize = 64 * 1024, size_t maxCallDepth = 1024);
+        ~VM();
+        VM(const VM&) = delete;
+        VM& operator=(const VM&) = delete;
+
+        // Supplies the host functions modules call. Bind before loading a
+        // module that imports any; the binding must outlive the VM.
+        void Bind(const Binding& binding);
+        // Binds the module and runs its global initializers. Objects of a
+        // previously loaded module are freed. The VM executes the module's
+        // code and constants where they are and shares them with every other
+        // VM running it; only globals, objects and the string pool are its
+        // own. Every host function the module imports must be bound with the
+        // signature it was compiled against.
+        void Load(std::shared_ptr<const SharedModule> module);
+        // Runs a module or image the caller keeps alive for as long as it is
+        // loaded.
+        void Load(const Module& module);
+        void Load(const ModuleImage& image);
+        // Switches to a recompiled module with the loaded module's globals
+        // and classes, keeping the globals and every live object; global
+        // initializers do not run again. Must not be called from inside a call.
+        void Reload(std::shared_ptr<const SharedModule> module);
+        void Reload(const Module& module);
+        // Host functions may call back into the VM; the call runs above the
+        // caller's frame.
+        Value Call(int32_t functionIndex, std::span<const Value> arguments = {});
+
+        // Functions called or looping JitThreshold times are compiled to
+        // machine code where the JIT supports the machine and every
+        // instruction they use, and a running loop switches over at its
+        // header. On by default; turning it off or on drops compiled code
+        // and counts. Must not be called from inside a call.
+        void SetJitEnabled(bool enabled);
+        static constexpr uint32_t JitThreshold = 1000;
+
+        // Samples the calls this VM runs into profiler; null stops. Machine
+        // code has no safepoints to sample at, so the JIT is off while a
+        // profiler is attached, and compiled code and counts are dropped on
+        // either change. Must not be called from inside a call.
+        void SetProfiler(Profiler* profiler);
+
+#if MANO_VM_COUNTERS
+        // Since the module was loaded or the counters were reset. Only the
+        // interpreter counts; turn the JIT off to count everything.
+        struct Counters
+        {
+            std::array<uint64_t, static_cast<size_t>(OpCode::Count)> opcodes{};
+            std::vector<uint64_t> calls;            // Per function of the module
+            std::vector<uint64_t> instructions;     // Per function of the module
+        };
+
+        const Counters& GetCounters() const { return counters; }
+        void ResetCounters();
+#endif
+
+        const std::vector<Value>& GetGlobals() const { return globals; }
+        size_t GetLiveObjectCount() const { return liveObjectCount; }
+
+        // Characters of a string value; a null string reads as empty. The
+        // view is valid while the string is referenced.
+        static std::string_view StringOf(Value value);
+        // A new string holding a copy of the text, owned by the caller.
+        Value CreateString(std::string_view text);
+
+    private:
+        struct CallFrame
+        {
+            const SharedModule::Function* function;
+            const Instruction* ip;
+            Value* base;
+        };
+
+        struct JitSlot
+        {
+            const JitCompiler::CompiledFunction* compiled = nullptr;
+            uint32_t hotness = 0;
+            bool rejected = false;                  // Uses an instruction the JIT cannot compile
+        };
+
+        std::shared_ptr<const SharedModule> module;
+        const SharedModule::Class* classes = nullptr;   // Of the module
+        std::vector<Value> stack;
+        std::vector<Value> globals;
+        std::vector<CallFrame> frames;
+        Object* liveObjects = nullptr;
+        size_t liveObjectCount = 0;
+        std::vector<Object*> releaseQueue;
+        std::vector<Object*> stringConstants;   // The string pool, held by the VM and not on the live list
+        size_t maxCallDepth;
+        const Binding* binding = nullptr;
+        const HostFunction* hostFunctions = nullptr;
+        Value* callBase;                        // Where Call puts its arguments, above any host call in progress
+        CallFrame hostCallSite{};               // The CALLH of the host call in progress
+        const Kernels::KernelSet& kernels = Kernels::Active();
+        JitCompiler jit;
+        std::vector<JitSlot> jitSlots;          // One per function of the module
+        JitContext jitContext;
+        bool jitEnabled = JitCompiler::Available;   // As set, unless a profiler is attached
+        bool jitRequested = JitCompiler::Available;
+        size_t nativeDepth = 0;                 // Calls running in machine code, which have no frames
+        std::exception_ptr jitFailure;          // Thrown inside a call from machine code, rethrown once back
+        Profiler* profiler = nullptr;
+        const std::atomic<uint64_t>* sampleClock;   // The profiler's ticks, or ones that never advance
+        uint64_t sampledTicks = 0;              // Ticks already charged to a sample
+        std::string sampleStack;
+#if MANO_VM_COUNTERS
+        Counters counters;
+#endif
+
+        void CheckImport(uint32_t index, std::string_view signature) const;
+        void AddStringConstant(std::string_view text, uint32_t hash);
+        void Start(uint32_t globalCount, int32_t initFunction);
+        Value Execute(const SharedModule::Function* function, Value* base);
+        void ResetJit();
+        const JitCompiler::CompiledFunction* TierUp(uint32_t functionIndex);
+        bool RunCompiled(const JitCompiler::CompiledFunction* compiled, const void* target, Value* base);
+        void CallHost(uint32_t index, const CallFrame& site, Value* arguments);
+        void Sample(const SharedModule::Function* function, const Instruction* at);
+        static JitStatus CallFromJit(JitContext* context, uint32_t functionIndex, Value* base);
+        Object* NewObject(uint32_t classIndex);
+        Object* NewString(size_t length);
+        Object* Concat(const Value* parts, uint32_t count);
+        Object* NewArray(ArrayElement element, uint32_t capacity);
+        void Push(Object* array, Value value);
+        Value RunKernel(KernelOp kernel, const Value* arguments);
+        void Release(Object* object);
+        void FreeAllObjects();
+    };
+} // namespace Arcanelab::Mano
@@ -1,25 +1,156 @@
 #include <Compiler.h>
 
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <new>
 #include <sstream>
+#include <utility>
+#include <vector>
 
-int main()
+// Counts heap traffic for --stats. Every block carries its size in front
+// of it, and whether it was counted, so that frees of counted blocks can be
+// counted too; without --stats the counters are never touched. The array
+// and nothrow forms of new forward to this one; the array and sized
+// deletes are defined to forward to the plain delete.
+namespace
 {
-    const std::string fileName = "semantictest.mano";
-    std::ifstream file(fileName);
-    if (!file)
+    constexpr std::size_t HeapHeader = alignof(std::max_align_t);
+    static_assert(HeapHeader >= 2 * sizeof(std::size_t));
+}
+
+void* operator new(std::size_t size)
+{
+    if (size > SIZE_MAX - HeapHeader)
+        throw std::bad_alloc();
+    void* block = std::malloc(size + HeapHeader);
+    if (!block)
+        throw std::bad_alloc();
+    auto* header = static_cast<std::size_t*>(block);
+    header[0] = size;
+    header[1] = Arcanelab::Mano::heapCounters.Allocated(size);
+    return static_cast<std::byte*>(block) + HeapHeader;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (!pointer)
+        return;
+    void* block = static_cast<std::byte*>(pointer) - HeapHeader;
+    const auto* header = static_cast<const std::size_t*>(block);
+    if (header[1])
+        Arcanelab::Mano::heapCounters.Freed(header[0]);
+    std::free(block);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+int main(int argc, char** argv)
+{
+    // --image <path> caches the compiled program between runs; --stats
+    // prints where compile time and memory went as JSON on stdout.
+    // --dump-tokens <path> and --dump-ast <path> write the debug dumps,
+    // the AST as a tree, json or binary as chosen by --ast-format.
+    // --profile <path> samples the run and writes folded stacks.
+    std::vector<std::string> fileNames;
+    std::string imagePath;
+    std::string profilePath;
+    bool printStats = false;
+    Arcanelab::Mano::DumpOptions dumps;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--image" && i + 1 < argc)
+            imagePath = argv[++i];
+        else if (argument == "--profile" && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (argument == "--stats")
+            printStats = true;
+        else if (argument == "--dump-tokens" && i + 1 < argc)
+            dumps.tokensPath = argv[++i];
+        else if (argument == "--dump-ast" && i + 1 < argc)
+            dumps.astPath = argv[++i];
+        else if (argument == "--ast-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "tree")
+                dumps.astFormat = Arcanelab::Mano::AstDumpFormat::Tree;
+            else if (format == "json")
+                dumps.astFormat = Arcanelab::Mano::AstDumpFormat::Json;
+            else if (format == "binary")
+                dumps.astFormat = Arcanelab::Mano::AstDumpFormat::Binary;
+            else
+            {
+                std::cerr << "Unknown AST format " << format << ", expected tree, json or binary\n";
+                return 1;
+            }
+        }
+        else
+            fileNames.push_back(argument);
+    }
+    if (fileNames.empty())
+        fileNames.push_back("semantictest.mano");
+
+    std::vector<Arcanelab::Mano::SourceFile> files;
+    for (const auto& fileName : fileNames)
     {
-        std::cerr << "Failed to open " << fileName << "\n";
-        return 1;
+        std::ifstream file(fileName);
+        if (!file)
+        {
+            std::cerr << "Failed to open " << fileName << "\n";
+            return 1;
+        }
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        files.push_back({ fileName, buffer.str() });
     }
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
 
     Arcanelab::Mano::Compiler compiler;
-    compiler.Run(source);
+    Arcanelab::Mano::CompileStats stats;
+    if (!imagePath.empty())
+        compiler.SetImageCache(imagePath);
+    compiler.SetDumps(std::move(dumps));
+    if (printStats)
+    {
+        Arcanelab::Mano::heapCounters.enabled = true;
+        compiler.SetStats(&stats);
+    }
+    Arcanelab::Mano::Profiler profiler;
+    if (!profilePath.empty())
+    {
+        compiler.SetProfiler(&profiler);
+        profiler.Start();
+    }
+    bool succeeded = compiler.Run(files);
+    if (printStats)
+        stats.WriteJson(std::cout);
+    if (!profilePath.empty())
+    {
+        profiler.Stop();
+        std::ofstream profile(profilePath);
+        profiler.WriteFolded(profile);
+        if (!profile.flush())
+        {
+            std::cerr << "Failed to write profile: " << profilePath << "\n";
+            return 1;
+        }
+    }
     
-    return 0;
+    return succeeded ? 0 : 1;
 }
@@ -14,8 +14,29 @@ else
     set_optimize("fastest")
 end
 
+if is_plat("linux") then
+    add_syslinks("pthread")
+end
+
+-- xmake f --vm_counters=y makes the VM count instructions per opcode and
+-- per function, and calls per function (VM::GetCounters)
+option("vm_counters")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count interpreted instructions and calls in the VM")
+    add_defines("MANO_VM_COUNTERS=1")
+option_end()
+
 target("Mano")
     set_kind("binary")
     set_targetdir("bin")
     add_includedirs("src/")
     add_files("src/*.cpp")
+    add_options("vm_counters")
+
+target("bench")
+    set_kind("binary")
+    set_targetdir("bin")
+    add_includedirs("src/", "bench/")
+    add_files("bench/*.cpp", "src/*.cpp|main.cpp")
+    add_options("vm_counters")